@@ -1,29 +1,12 @@
-QT       += core gui
-QT       += serialport
-
-
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-CONFIG += c++11
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    main.cpp \
-    mainwindow.cpp
-
-HEADERS += \
-    mainwindow.h
-
-FORMS += \
-    mainwindow.ui
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
-
-
+TEMPLATE = subdirs
+
+# app:       图传/丢包率测试界面
+# cli:       命令行测试工具, 输出JSON
+# simulator: 伪终端模块模拟器 (仅Linux)
+# tests:     QtTest 基准和端到端测试, make check
+SUBDIRS += \
+    app \
+    cli \
+    tests
+
+linux: SUBDIRS += simulator
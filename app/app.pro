@@ -0,0 +1,37 @@
+QT       += core gui
+QT       += serialport
+
+
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11
+
+TARGET = 2G4_Test
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    imagetranscoder.cpp \
+    logmodel.cpp \
+    mainwindow.cpp \
+    sweepdialog.cpp
+
+HEADERS += \
+    imagetranscoder.h \
+    logmodel.h \
+    mainwindow.h \
+    sweepdialog.h
+
+FORMS += \
+    mainwindow.ui
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,69 @@
+#include "imagetranscoder.h"
+#include <QBuffer>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+
+namespace ImageTranscoder {
+
+namespace {
+
+QByteArray encode(const QImage &image, int quality)
+{
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpg");
+    writer.setQuality(quality);
+    writer.setProgressiveScanWrite(true);
+    writer.setOptimizedWrite(true);
+    if (!writer.write(image)) {
+        return QByteArray();
+    }
+    return data;
+}
+
+}
+
+bool toProgressiveJpeg(const QString &path, qint64 maxBytes, QByteArray *jpeg, QString *error)
+{
+    QImageReader reader(path);
+    reader.setAutoTransform(true);
+    QImage image = reader.read();
+    if (image.isNull()) {
+        *error = reader.errorString();
+        return false;
+    }
+
+    *jpeg = encode(image, DefaultQuality);
+    if (jpeg->isEmpty()) {
+        *error = "JPEG encoding failed";
+        return false;
+    }
+    if (maxBytes <= 0) {
+        return true;
+    }
+
+    //质量每次降一档, 到底了就缩到0.7倍从高质量重来
+    int quality = DefaultQuality;
+    while (jpeg->size() > maxBytes) {
+        quality -= 10;
+        if (quality < MinQuality) {
+            int width = image.width() * 7 / 10;
+            int height = image.height() * 7 / 10;
+            if (qMin(width, height) < MinSide) {
+                break;
+            }
+            image = image.scaled(width, height, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            quality = DefaultQuality;
+        }
+        QByteArray smaller = encode(image, quality);
+        if (smaller.isEmpty()) {
+            break;
+        }
+        *jpeg = smaller;
+    }
+    return true;
+}
+
+}
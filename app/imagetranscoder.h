@@ -0,0 +1,21 @@
+#ifndef IMAGETRANSCODER_H
+#define IMAGETRANSCODER_H
+
+#include <QByteArray>
+#include <QString>
+
+// 发送前把图片重新编码成渐进式JPEG: 第一个扫描就是整张图的粗略版本, 对端收到它就能先看,
+// 配合只发前几层(TransferOptions::layers)拿清晰度换空口时间
+// 要用QtGui解码, 所以放在界面里, 命令行直接发已经是渐进式的JPEG
+namespace ImageTranscoder {
+
+const int DefaultQuality = 85;
+const int MinQuality = 30;
+const int MinSide = 64;             // 为了大小预算缩图时短边不小于这个
+
+// 有大小预算时先降质量, 最低质量还超就缩小再试; 实在压不下去返回最小的那个
+bool toProgressiveJpeg(const QString &path, qint64 maxBytes, QByteArray *jpeg, QString *error);
+
+}
+
+#endif // IMAGETRANSCODER_H
@@ -0,0 +1,114 @@
+#include "logmodel.h"
+#include <QDateTime>
+
+LogModel::LogModel(int capacity, QObject *parent)
+    : QAbstractListModel(parent), lines(qMax(1, capacity))
+{
+    pending.reserve(lines.size());
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(RefreshIntervalMs);
+    connect(&flushTimer, &QTimer::timeout, this, &LogModel::flush);
+}
+
+int LogModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : count;
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= count) {
+        return QVariant();
+    }
+    const Line &line = lines.at((head + index.row()) % lines.size());
+    return QString("[%1] %2").arg(QDateTime::fromMSecsSinceEpoch(line.time).toString("HH:mm:ss.zzz"), line.text);
+}
+
+void LogModel::appendData(const QByteArray &data)
+{
+    partial.append(data);
+
+    int start = 0;
+    int end;
+    while ((end = partial.indexOf('\n', start)) >= 0) {
+        int length = end - start;
+        if (length > 0 && partial.at(end - 1) == '\r') {
+            length--;
+        }
+        if (length > 0) {
+            enqueue(QString::fromUtf8(partial.constData() + start, qMin(length, MaxLineLength)));
+        }
+        start = end + 1;
+    }
+    partial.remove(0, start);
+
+    //一直没有换行的数据也不能无限攒
+    if (partial.size() >= MaxLineLength) {
+        enqueue(QString::fromUtf8(partial.constData(), MaxLineLength));
+        partial.clear();
+    }
+}
+
+void LogModel::appendLine(const QString &text)
+{
+    enqueue(text.left(MaxLineLength));
+}
+
+void LogModel::enqueue(const QString &text)
+{
+    //界面来不及刷的时候只留最新的一屏缓冲
+    if (pending.size() >= lines.size()) {
+        pending.remove(0, lines.size() / 2 + 1);
+    }
+    Line line;
+    line.time = QDateTime::currentMSecsSinceEpoch();
+    line.text = text;
+    pending.append(line);
+
+    if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+}
+
+void LogModel::flush()
+{
+    if (pending.isEmpty()) {
+        return;
+    }
+
+    int capacity = lines.size();
+    int incoming = qMin(pending.size(), capacity);
+    int skip = pending.size() - incoming;
+
+    int overflow = count + incoming - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        head = (head + overflow) % capacity;
+        count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count, count + incoming - 1);
+    for (int i = skip; i < pending.size(); i++) {
+        lines[(head + count) % capacity] = pending.at(i);
+        count++;
+    }
+    endInsertRows();
+
+    qint64 lastTime = pending.last().time;
+    pending.resize(0);     //保留容量, 不反复分配
+    emit flushed(lastTime);
+}
+
+void LogModel::clear()
+{
+    beginResetModel();
+    for (int i = 0; i < lines.size(); i++) {
+        lines[i].text.clear();
+    }
+    head = 0;
+    count = 0;
+    pending.resize(0);
+    partial.clear();
+    endResetModel();
+}
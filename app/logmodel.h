@@ -0,0 +1,51 @@
+#ifndef LOGMODEL_H
+#define LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QTimer>
+#include <QVector>
+
+// 日志列表模型
+// 固定容量的环形缓冲, 满了覆盖最旧的行, 跑几个小时内存也不涨;
+// 新行先攒着, 按固定刷新率一批交给视图, 串口数据再密界面也只按刷新率重排
+class LogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    static const int DefaultCapacity = 5000;
+    static const int RefreshIntervalMs = 100;
+    static const int MaxLineLength = 1024;      // 超长的行截断, 单行内存也有上限
+
+    explicit LogModel(int capacity = DefaultCapacity, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void appendData(const QByteArray &data);    // 串口原始数据, 按行拆开, 半行等下一次
+    void appendLine(const QString &text);
+    void clear();
+
+signals:
+    void flushed(qint64 lastTime);      // 一批行进了视图, 带最后一行的时间(ms)
+
+private slots:
+    void flush();
+
+private:
+    struct Line {
+        qint64 time = 0;    // ms since epoch, 显示时才格式化
+        QString text;
+    };
+
+    void enqueue(const QString &text);
+
+    QVector<Line> lines;
+    int head = 0;
+    int count = 0;
+    QVector<Line> pending;
+    QByteArray partial;
+    QTimer flushTimer;
+};
+
+#endif // LOGMODEL_H
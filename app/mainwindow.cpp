@@ -0,0 +1,698 @@
+#include "mainwindow.h"
+#include "ui_mainwindow.h"
+#include "atframer.h"
+#include "batchtransfer.h"
+#include "imagetranscoder.h"
+#include "jpegscans.h"
+#include "linkengine.h"
+#include "logmodel.h"
+#include "sweepdialog.h"
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QDebug>
+#include <QFileDialog>
+#include <QFile>
+#include <QStandardPaths>
+#include <QImageReader>
+#include <QHBoxLayout>
+#include <QDateTime>
+#include <QDir>
+#include <QScrollBar>
+
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow) {
+    ui->setupUi(this);
+    fillSerialPortInfo();
+
+    //链路引擎放到工作线程, 拖动窗口或者刷日志都不影响收发节奏
+    LinkEngine::registerMetaTypes();
+    engine = new LinkEngine;
+    engine->moveToThread(&engineThread);
+    connect(&engineThread, &QThread::finished, engine, &QObject::deleteLater);
+
+    connect(this, &MainWindow::openPortRequested, engine, &LinkEngine::openPort);
+    connect(this, &MainWindow::closePortRequested, engine, &LinkEngine::closePort);
+    connect(this, &MainWindow::writeConfigRequested, engine, &LinkEngine::writeConfig);
+    connect(this, &MainWindow::transferRequested, engine, &LinkEngine::startTransfer);
+    connect(this, &MainWindow::stripedTransferRequested, engine, &LinkEngine::startStripedTransfer);
+    connect(this, &MainWindow::batchRequested, engine, &LinkEngine::startBatch);
+    connect(this, &MainWindow::streamRequested, engine, &LinkEngine::startStream);
+    connect(this, &MainWindow::transferStopRequested, engine, &LinkEngine::stopTransfer);
+    connect(this, &MainWindow::perTestRequested, engine, &LinkEngine::startPerTest);
+    connect(this, &MainWindow::perTestStopRequested, engine, &LinkEngine::stopPerTest);
+    connect(this, &MainWindow::sweepRequested, engine, &LinkEngine::startSweep);
+    connect(this, &MainWindow::sweepStopRequested, engine, &LinkEngine::stopSweep);
+    connect(this, &MainWindow::receiveRequested, engine, &LinkEngine::startReceive);
+    connect(this, &MainWindow::receiveStopRequested, engine, &LinkEngine::stopReceive);
+    connect(this, &MainWindow::commandRequested, engine, &LinkEngine::sendCommand);
+    connect(this, &MainWindow::captureRequested, engine, &LinkEngine::startCapture);
+    connect(this, &MainWindow::latencyExportRequested, engine, &LinkEngine::exportLatency);
+    connect(this, &MainWindow::baudRateRequested, engine, &LinkEngine::negotiateBaudRate);
+    connect(this, &MainWindow::uartPrefetchRequested, engine, &LinkEngine::setUartPrefetch);
+    connect(ui->prefetchBox, &QCheckBox::toggled, this, &MainWindow::uartPrefetchRequested);
+
+    connect(engine, &LinkEngine::portOpened, this, &MainWindow::onPortOpened);
+    connect(engine, &LinkEngine::portClosed, this, &MainWindow::onPortClosed);
+    connect(engine, &LinkEngine::portError, this, &MainWindow::onPortError);
+    connect(engine, &LinkEngine::commandFailed, this, &MainWindow::onCommandFailed);
+    connect(engine, &LinkEngine::baudRateNegotiated, this, [this](bool ok, int baudRate) {
+        modemBaudRate = baudRate;   // AT+BAUD模块会记住, 下次按这个打开
+        logModel->appendLine((ok ? "UART baud rate " : "baud rate negotiation failed, staying at ") + QString::number(baudRate));
+    });
+    connect(engine, &LinkEngine::configApplied, this, [this](bool ok) {
+        if (!ok) {
+            logModel->appendLine("radio config not applied");
+        }
+    });
+    connect(engine, &LinkEngine::dataReceived, this, &MainWindow::onDataReceived);
+    connect(engine, &LinkEngine::uplinkQuality, this, &MainWindow::onUplinkQuality);
+    connect(engine, &LinkEngine::downlinkQuality, this, &MainWindow::onDownlinkQuality);
+    connect(engine, &LinkEngine::transferProgress, this, &MainWindow::onTransferProgress);
+    connect(engine, &LinkEngine::transferFinished, this, &MainWindow::onTransferFinished);
+    connect(engine, &LinkEngine::batchProgress, this, &MainWindow::onBatchProgress);
+    connect(engine, &LinkEngine::batchFileFinished, this, &MainWindow::onBatchFileFinished);
+    connect(engine, &LinkEngine::batchFinished, this, &MainWindow::onBatchFinished);
+    connect(engine, &LinkEngine::streamProgress, this, &MainWindow::onStreamProgress);
+    connect(engine, &LinkEngine::streamFrameFinished, this, &MainWindow::onStreamFrameFinished);
+    connect(engine, &LinkEngine::streamFinished, this, &MainWindow::onStreamFinished);
+    connect(engine, &LinkEngine::perTestProgress, this, &MainWindow::onPerTestProgress);
+    connect(engine, &LinkEngine::perTestFinished, this, &MainWindow::onPerTestFinished);
+    connect(engine, &LinkEngine::receiveProgress, this, &MainWindow::onReceiveProgress);
+    connect(engine, &LinkEngine::fileReceived, this, &MainWindow::onFileReceived);
+    connect(engine, &LinkEngine::previewReceived, this, &MainWindow::onPreviewReceived);
+    connect(engine, &LinkEngine::receiveFinished, this, &MainWindow::onReceiveFinished);
+    connect(engine, &LinkEngine::latencySummary, this, &MainWindow::onLatencySummary);
+
+    //扫参窗口不模态, 测的时候主窗口照样看实时丢包率
+    sweepDialog = new SweepDialog(this);
+    connect(sweepDialog, &SweepDialog::sweepRequested, this, &MainWindow::onSweepStarted);
+    connect(sweepDialog, &SweepDialog::sweepStopRequested, this, &MainWindow::sweepStopRequested);
+    connect(sweepDialog, &SweepDialog::sweepStopRequested, this, [this]() { onSweepFinished(false, "stopped"); });
+    connect(engine, &LinkEngine::sweepPointFinished, sweepDialog, &SweepDialog::addPoint);
+    connect(engine, &LinkEngine::sweepFinished, sweepDialog, &SweepDialog::sweepFinished);
+    connect(engine, &LinkEngine::sweepFinished, this, &MainWindow::onSweepFinished);
+
+    engineThread.start();
+
+    ui->progressBar->setValue(0);
+
+    // 初始化时禁用文件选择和发送按钮
+    setLinkControlsEnabled(false);
+
+
+    // 设置lineEditFile为只读
+    ui->lineEditFile->setReadOnly(true);
+
+    //日志: 环形缓冲模型 + 列表视图, 按固定刷新率批量刷
+    logModel = new LogModel(LogModel::DefaultCapacity, this);
+    ui->listViewLog->setModel(logModel);
+    connect(logModel, &LogModel::rowsAboutToBeInserted, this, &MainWindow::onLogAboutToGrow);
+    connect(logModel, &LogModel::flushed, this, &MainWindow::onLogFlushed);
+}
+
+
+// MainWindow 析构函数
+MainWindow::~MainWindow()
+{
+    engineThread.quit();
+    engineThread.wait();
+    delete ui;
+}
+
+// 填充串口信息
+void MainWindow::fillSerialPortInfo() {
+    auto portsInfo = QSerialPortInfo::availablePorts();
+    for (const auto& info : portsInfo) {
+        ui->comboBoxUart->addItem(info.portName() + " " + info.description(), info.portName());
+    }
+}
+
+void MainWindow::setLinkControlsEnabled(bool enabled)
+{
+    ui->pushButtonFile->setEnabled(enabled);
+    ui->pushButtonFolder->setEnabled(enabled);
+    ui->pushButtonTransmit->setEnabled(enabled);
+    ui->testButton->setEnabled(enabled);
+    ui->sweepButton->setEnabled(enabled);
+    ui->read->setEnabled(enabled);
+    ui->pushButtonReceive->setEnabled(enabled);
+}
+
+// 处理打开/关闭串口的按钮
+void MainWindow::on_pushButtonUart_released()
+{
+    if (portOpen) {
+        emit closePortRequested();
+    } else {
+        // 下拉框可编辑, 列表里没有的按输入的路径打开(比如模拟器的伪终端)
+        auto text = ui->comboBoxUart->currentText().trimmed();
+        auto index = ui->comboBoxUart->findText(text);
+        auto portName = index >= 0 ? ui->comboBoxUart->itemData(index).toString() : text;
+        emit openPortRequested(portName, modemBaudRate);
+    }
+}
+
+void MainWindow::onPortOpened(const QString &portName)
+{
+    Q_UNUSED(portName);
+    portOpen = true;
+    ui->pushButtonUart->setText("Close Port");
+
+    // 串口打开成功时启用文件选择和发送按钮
+    setLinkControlsEnabled(true);
+    ui->lineEditFile->setEnabled(true);
+    ui->comboBoxUart->setEnabled(false);
+    ui->comboBoxBaud->setEnabled(false);
+    sweepDialog->setLinkReady(true);
+
+    //按模块当前的波特率打开, 选的不一样再和模块一起换
+    int baudRate = ui->comboBoxBaud->currentText().toInt();
+    if (baudRate > 0 && baudRate != modemBaudRate) {
+        emit baudRateRequested(baudRate);
+    }
+}
+
+void MainWindow::onPortClosed()
+{
+    portOpen = false;
+    ui->pushButtonUart->setText("Open Port");
+
+    // 串口关闭时禁用文件选择和发送按钮
+    setLinkControlsEnabled(false);
+    ui->comboBoxUart->setEnabled(true);
+    ui->comboBoxBaud->setEnabled(true);
+    ui->testButton->setText("Start Test");
+    ui->pushButtonReceive->setText("Receive");
+    ui->pushButtonTransmit->setText("Transmit");
+    streamRunning = false;
+    ui->progressBar->setValue(0);
+    sweepDialog->setLinkReady(false);
+}
+
+void MainWindow::onPortError(const QString &message)
+{
+    QMessageBox::warning(this, "Warning", message);
+}
+
+void MainWindow::onCommandFailed(const QByteArray &command, const QString &reason)
+{
+    //图传自己会重传, 这里只记日志不弹窗
+    logModel->appendLine("AT failed (" + reason + "): " + QString::fromLatin1(command));
+}
+
+void MainWindow::on_pushButtonFile_released()
+{
+    //可以多选, 多个文件排队连着发
+    auto filenames = QFileDialog::getOpenFileNames(this, "Select File",
+                                                   QStandardPaths::writableLocation(QStandardPaths::DesktopLocation),
+                                                   "Images (*.jpg;*.png);;All Files (*.*)");
+    if (!filenames.isEmpty()) {
+        showSelection(filenames);
+    }
+}
+
+void MainWindow::on_pushButtonFolder_released()
+{
+    auto dir = QFileDialog::getExistingDirectory(this, "Select Folder",
+                                                 QStandardPaths::writableLocation(QStandardPaths::DesktopLocation));
+    if (!dir.isEmpty()) {
+        showSelection(QStringList{dir});
+    }
+}
+
+void MainWindow::showSelection(const QStringList &paths)
+{
+    selectedPaths = paths;
+    QStringList files = BatchTransfer::expandPaths(paths);
+    ui->lineEditFile->setText(files.size() == 1 && paths.size() == 1 ? files.first()
+                              : paths.first() + " (" + QString::number(files.size()) + " files)");
+
+    // 获取文件大小信息
+    qint64 sizeInBytes = 0;
+    for (const QString &file : files) {
+        sizeInBytes += QFileInfo(file).size();
+    }
+    double sizeInKB = sizeInBytes / 1024.0;  // 转换为千字节
+
+    // 设置 QLabel 显示文件大小
+    ui->labelPictureSize->setText("size: " + QString::number(sizeInKB, 'f', 2) + " KB");
+}
+
+// 发送文件按钮
+void MainWindow::on_pushButtonTransmit_clicked()
+{
+    //连续图传时这个按钮是停止
+    if (streamRunning) {
+        emit transferStopRequested();
+        streamRunning = false;
+        ui->pushButtonTransmit->setText("Transmit");
+        setLinkControlsEnabled(portOpen);
+        ui->lineEditFile->setEnabled(true);
+        logModel->appendLine("stream stopped");
+        return;
+    }
+
+    TransferOptions options;
+    options.filePath = ui->lineEditFile->text();
+    QStringList files = BatchTransfer::expandPaths(selectedPaths);
+    if (files.size() == 1) {
+        options.filePath = files.first();
+    }
+    options.mtu = ui->lineEditFile_mtu->text().toInt();
+    if (options.mtu <= 0 || options.mtu > AtFramer::MaxMtu) {
+        QMessageBox::warning(this, "Warning", "MTU must be 1-" + QString::number(AtFramer::MaxMtu) + " bytes");
+        return;
+    }
+    options.window = ui->windowBox->value();
+    options.fecBlock = ui->fecBox->isChecked() ? options.window : 0;
+    options.adaptive = ui->adaptiveBox->isChecked();
+    options.delta = ui->deltaBox->isChecked();
+    options.checked = ui->crcBox->isChecked();
+    options.layers = ui->layersBox->value();
+
+    ui->progressBar->setValue(0);
+    if (ui->testButton->text() == "Stop Test") {
+        ui->testButton->setText("Start Test");
+    }
+
+    //设置相关状态栏失能
+    setLinkControlsEnabled(false);
+    ui->lineEditFile->setEnabled(false);
+
+    //选了目录又勾了连续图传: 一直发目录里最新的那张
+    if (ui->streamBox->isChecked() && selectedPaths.size() == 1 && QFileInfo(selectedPaths.first()).isDir()) {
+        StreamOptions stream;
+        stream.transfer = options;
+        stream.directory = selectedPaths.first();
+        streamRunning = true;
+        ui->pushButtonTransmit->setText("Stop Stream");
+        ui->pushButtonTransmit->setEnabled(true);
+        emit streamRequested(stream);
+        return;
+    }
+
+    //多个文件或者目录: 排队连着发, 结果写日志, 不弹窗
+    if (files.size() > 1 || (selectedPaths.size() == 1 && QFileInfo(selectedPaths.first()).isDir())) {
+        BatchOptions batch;
+        batch.transfer = options;
+        batch.paths = selectedPaths;
+        batchRunning = true;
+        emit batchRequested(batch);
+        return;
+    }
+
+    //填了别的串口就分条发, 每条链路依次用信道列表里当前信道往后的频点
+    QStringList ports;
+    for (const QString &port : ui->stripePortsEdit->text().split(',')) {
+        if (!port.trimmed().isEmpty()) {
+            ports.append(port.trimmed());
+        }
+    }
+    if (ui->progressiveBox->isChecked() && files.size() == 1) {
+        QString transcoded = transcodeProgressive(options.filePath);
+        if (transcoded.isEmpty()) {
+            setLinkControlsEnabled(portOpen);
+            ui->lineEditFile->setEnabled(true);
+            return;
+        }
+        options.filePath = transcoded;
+    }
+    if (ports.isEmpty()) {
+        emit transferRequested(options);
+        return;
+    }
+    StripeOptions stripe;
+    stripe.transfer = options;
+    stripe.ports = ports;
+    stripe.baudRate = QSerialPort::Baud115200;
+    for (int i = 0; i <= ports.size(); i++) {
+        int index = (ui->channelBox->currentIndex() + i) % qMax(1, ui->channelBox->count());
+        stripe.frequencies.append(ui->channelBox->itemText(index));
+    }
+    emit stripedTransferRequested(stripe);
+}
+
+// 重新编码成渐进式JPEG放到临时目录, 文件名不变只换扩展名, 对端按这个名字存
+QString MainWindow::transcodeProgressive(const QString &path)
+{
+    QByteArray jpeg;
+    QString error;
+    if (!ImageTranscoder::toProgressiveJpeg(path, qint64(ui->budgetBox->value()) * 1024, &jpeg, &error)) {
+        logModel->appendLine("cannot re-encode " + path + ": " + error);
+        return QString();
+    }
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/QT_ISM2400");
+    dir.mkpath(".");
+    QFile file(dir.filePath(QFileInfo(path).completeBaseName() + ".jpg"));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(jpeg) != jpeg.size()) {
+        logModel->appendLine("cannot write " + file.fileName() + ": " + file.errorString());
+        return QString();
+    }
+    file.close();
+
+    QVector<qint64> scans = JpegScans::scanEnds(jpeg.constData(), jpeg.size());
+    logModel->appendLine(QString("progressive JPEG: %1 KB -> %2 KB, %3 scans, first scan %4 KB")
+                         .arg(QFileInfo(path).size() / 1024.0, 0, 'f', 1).arg(jpeg.size() / 1024.0, 0, 'f', 1)
+                         .arg(scans.size()).arg(scans.isEmpty() ? 0.0 : scans.first() / 1024.0, 0, 'f', 1));
+    return file.fileName();
+}
+
+void MainWindow::onTransferProgress(const TransferStats &stats)
+{
+    //统计
+    //批量传输时进度条显示总进度
+    int progress = stats.fileSize > 0 ? static_cast<int>((static_cast<double>(stats.bytesAcked) / stats.fileSize) * 100) : 0;
+    if (!batchRunning) {
+        ui->progressBar->setValue(progress);
+    }
+
+    double lossRatePercentage = 0.0;
+    if (stats.packetsSent > 0) {  // 防止除以零
+        lossRatePercentage = (double)stats.ackReceived / (double)stats.packetsSent * 100.0;
+    }
+
+    double bytesPerSecond = stats.elapsedMs > 0 ? (double)(stats.bytesAcked - stats.resumedFrom) / (stats.elapsedMs / 1000.0) * 8 / 1000 : 0.0;
+    ui->labelRate->setText("Rate: "+QString::number(bytesPerSecond,'f', 3)+" kbps"+"\t\t"+QString::number(stats.elapsedMs/1000)\
+                                +" s");
+
+    ui->labelRate_2->setText(QString::number(stats.ackReceived)+"/"+QString::number(stats.packetsSent) + "\t\t"+ QString::number(lossRatePercentage, 'f', 2) + "%");
+    if (stats.layers > 1) {
+        ui->labelRate_2->setText(ui->labelRate_2->text() + QString("\tlayer %1/%2").arg(stats.layersAcked).arg(stats.layers));
+    }
+    if (stats.links > 1) {
+        ui->labelRate_2->setText(ui->labelRate_2->text() + "\t" + QString::number(stats.activeLinks) + "/" + QString::number(stats.links) + " links");
+    }
+
+    //自适应模式下模块的SF会变, 界面跟着显示当前值
+    if (stats.rateSwitches > 0 && stats.spreadingFactor > 0) {
+        ui->sf->setCurrentText(QString::number(stats.spreadingFactor));
+    }
+}
+
+void MainWindow::onTransferFinished(bool ok, const QString &message)
+{
+    setLinkControlsEnabled(portOpen);
+    ui->lineEditFile->setEnabled(true);
+
+    //结果写日志, 不弹模态框
+    if (ok) {
+        ui->progressBar->setValue(100);
+        logModel->appendLine("transfer complete: " + message);
+    } else {
+        logModel->appendLine("transfer failed: " + message);
+    }
+}
+
+void MainWindow::onBatchProgress(const BatchStats &stats)
+{
+    int progress = stats.totalBytes > 0 ? static_cast<int>(double(stats.bytesDone) / stats.totalBytes * 100) : 0;
+    ui->progressBar->setValue(progress);
+
+    double kbps = stats.elapsedMs > 0 ? double(stats.bytesDone) * 8 / stats.elapsedMs : 0.0;
+    ui->labelPictureSize->setText("file " + QString::number(stats.fileIndex + 1) + "/" + QString::number(stats.fileCount)
+                                  + "  total " + QString::number(kbps, 'f', 3) + " kbps");
+}
+
+void MainWindow::onBatchFileFinished(const BatchStats &stats, bool ok, const QString &message)
+{
+    //单个文件的速率按它自己的用时算
+    const TransferStats &file = stats.current;
+    double kbps = file.elapsedMs > 0 ? double(file.bytesAcked - file.resumedFrom) * 8 / file.elapsedMs : 0.0;
+    logModel->appendLine(QString("[%1/%2] %3 %4, %5 kbps")
+                         .arg(stats.fileIndex + 1).arg(stats.fileCount).arg(stats.fileName)
+                         .arg(ok ? QString("ok") : message).arg(kbps, 0, 'f', 3));
+}
+
+void MainWindow::onBatchFinished(const BatchStats &stats)
+{
+    batchRunning = false;
+    setLinkControlsEnabled(portOpen);
+    ui->lineEditFile->setEnabled(true);
+
+    double kbps = stats.elapsedMs > 0 ? double(stats.bytesDone) * 8 / stats.elapsedMs : 0.0;
+    logModel->appendLine(QString("batch finished: %1 sent, %2 failed, %3 s, %4 kbps")
+                         .arg(stats.filesDone).arg(stats.filesFailed).arg(stats.elapsedMs / 1000)
+                         .arg(kbps, 0, 'f', 3));
+}
+
+void MainWindow::onStreamProgress(const StreamStats &stats)
+{
+    ui->labelPictureSize->setText(QString("frames %1/%2  dropped %3  age %4 ms")
+                                  .arg(stats.framesDelivered).arg(stats.framesCaptured)
+                                  .arg(stats.framesDropped + stats.framesPreempted)
+                                  .arg(stats.lastAgeMs, 0, 'f', 0));
+}
+
+void MainWindow::onStreamFrameFinished(const StreamStats &stats, bool ok, const QString &message)
+{
+    onStreamProgress(stats);
+    if (ok) {
+        logModel->appendLine(QString("%1 delivered, age %2 ms (p50 %3, p99 %4)")
+                             .arg(stats.fileName).arg(stats.lastAgeMs, 0, 'f', 0)
+                             .arg(stats.ageP50Ms, 0, 'f', 0).arg(stats.ageP99Ms, 0, 'f', 0));
+    } else {
+        logModel->appendLine(stats.fileName + " " + message);
+    }
+}
+
+void MainWindow::onStreamFinished(const StreamStats &stats)
+{
+    streamRunning = false;
+    ui->pushButtonTransmit->setText("Transmit");
+    setLinkControlsEnabled(portOpen);
+    ui->lineEditFile->setEnabled(true);
+
+    logModel->appendLine(QString("stream finished: %1 of %2 frames delivered, %3 dropped, %4 preempted, age p50 %5 ms p99 %6 ms")
+                         .arg(stats.framesDelivered).arg(stats.framesCaptured).arg(stats.framesDropped)
+                         .arg(stats.framesPreempted).arg(stats.ageP50Ms, 0, 'f', 0).arg(stats.ageP99Ms, 0, 'f', 0));
+}
+
+void MainWindow::onDataReceived(const QByteArray &data)
+{
+    //这里只进缓冲, 界面由定时批量刷新
+    logModel->appendData(data);
+}
+
+void MainWindow::onLogAboutToGrow()
+{
+    QScrollBar *bar = ui->listViewLog->verticalScrollBar();
+    logAtBottom = bar->value() >= bar->maximum();
+}
+
+void MainWindow::onLogFlushed(qint64 lastTime)
+{
+    if (logAtBottom) {
+        ui->listViewLog->scrollToBottom();
+    }
+    ui->time->setText(QDateTime::fromMSecsSinceEpoch(lastTime).toString());
+}
+
+void MainWindow::on_captureBox_toggled(bool checked)
+{
+    QString path;
+    if (checked) {
+        path = QFileDialog::getSaveFileName(this, "Raw Capture File",
+                                            QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
+                                            "Serial capture (*.cap);;All files (*)");
+        if (path.isEmpty()) {
+            ui->captureBox->blockSignals(true);
+            ui->captureBox->setChecked(false);
+            ui->captureBox->blockSignals(false);
+            return;
+        }
+    }
+    emit captureRequested(path);
+}
+
+void MainWindow::on_pushButtonExportLatency_released()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export Latency",
+                                                QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
+                                                "CSV (*.csv);;JSON (*.json)");
+    if (!path.isEmpty()) {
+        emit latencyExportRequested(path);
+    }
+}
+
+void MainWindow::onLatencySummary(const LatencySummary &summary)
+{
+    //串口/空口/应答三段的p50/p99, 完整的在提示里
+    QStringList parts;
+    QStringList details;
+    for (const LatencyStage &stage : summary.stages) {
+        QString text = QString("%1 %2/%3").arg(stage.name).arg(stage.p50Ms, 0, 'f', 1).arg(stage.p99Ms, 0, 'f', 1);
+        if (stage.name == "uart" || stage.name == "air" || stage.name == "reply") {
+            parts << text;
+        }
+        details << text + QString(" ms, max %1 ms, n=%2").arg(stage.maxMs, 0, 'f', 1).arg(stage.count);
+    }
+    parts << QString("uart %1%").arg(summary.uartShare * 100, 0, 'f', 0);
+    ui->labelLatency->setText("p50/p99 ms: " + parts.join("  "));
+    ui->labelLatency->setToolTip(details.join("\n"));
+}
+
+void MainWindow::onUplinkQuality(int rssi, int snr)
+{
+    ui->rssi->setText(QString::number(rssi));
+    ui->snr->setText(QString::number(snr));
+}
+
+void MainWindow::onDownlinkQuality(int rssi, int snr)
+{
+    ui->rssi_2->setText(QString::number(rssi));
+    ui->snr_2->setText(QString::number(snr));
+}
+
+
+void MainWindow::on_updateTimer_timeout() {
+
+}
+
+RadioConfig MainWindow::radioConfigFromUi() const
+{
+    RadioConfig config;
+    config.frequency = ui->channelBox->currentText();
+    config.bandwidth = ui->bwBox->currentText().toInt();
+    config.spreadingFactor = ui->sf->currentText().toInt();
+    config.codingRate = ui->crBox->currentIndex();
+    config.preamble = ui->prembleBox->value();
+    return config;
+}
+
+void MainWindow::on_read_released()
+{
+    emit writeConfigRequested(radioConfigFromUi());
+}
+
+
+void MainWindow::on_testButton_released()
+{
+    if(ui->testButton->text() == "Start Test")
+    {
+        ui->testButton->setText("Stop Test");
+
+        PerTestOptions options;
+        options.mtu = ui->lineEditFile_mtu->text().toInt();
+        options.maxPackets = ui->MaxPacket->text().toULongLong();
+        emit perTestRequested(options);
+    }
+    else
+    {
+        ui->testButton->setText("Start Test");
+        emit perTestStopRequested();
+    }
+
+}
+
+void MainWindow::onPerTestProgress(const PerStats &stats)
+{
+    double lossRatePercentage = 0.0;
+    if (stats.sent > 0) {  // 防止除以零
+        lossRatePercentage = (double)stats.acked / stats.sent * 100.0;
+    }
+
+    ui->lostRate->setText(QString::number(stats.acked) + "/" +
+                          QString::number(stats.sent) + "\t\t" +
+                          QString::number(lossRatePercentage, 'f', 2) + "%");
+
+    double bytesPerSecond = stats.elapsedMs > 0 ? (double)stats.acked*stats.mtu /(stats.elapsedMs/1000.0) * 8 / 1000 : 0.0;
+    ui->bytesPerSecond->setText("Rate: "+QString::number(bytesPerSecond,'f', 3)+" kbps"+"\t\t"+QString::number(stats.elapsedMs/1000)\
+                                +" s");
+}
+
+void MainWindow::onPerTestFinished()
+{
+    ui->testButton->setText("Start Test");
+}
+
+void MainWindow::on_sweepButton_released()
+{
+    //没在扫的时候默认值跟着主窗口当前的参数
+    sweepDialog->setDefaults(radioConfigFromUi(), ui->lineEditFile_mtu->text().toInt());
+    sweepDialog->show();
+    sweepDialog->raise();
+}
+
+void MainWindow::onSweepStarted(const SweepOptions &options)
+{
+    //扫参前先把界面上的参数写下去, 扫完调回这组
+    emit writeConfigRequested(radioConfigFromUi());
+    setLinkControlsEnabled(false);
+    ui->sweepButton->setEnabled(true);
+    emit sweepRequested(options);
+}
+
+void MainWindow::onSweepFinished(bool ok, const QString &message)
+{
+    setLinkControlsEnabled(portOpen);
+    logModel->appendLine((ok ? "sweep: " : "sweep failed: ") + message);
+}
+
+void MainWindow::on_pushButtonReceive_released()
+{
+    if (ui->pushButtonReceive->text() == "Receive") {
+        QString dir = QFileDialog::getExistingDirectory(this, "Save Received Files To",
+                                                        QStandardPaths::writableLocation(QStandardPaths::DownloadLocation));
+        if (dir.isEmpty()) {
+            return;
+        }
+        //接收时不能同时发送
+        setLinkControlsEnabled(false);
+        ui->pushButtonReceive->setEnabled(true);
+        ui->pushButtonReceive->setText("Stop Receive");
+        ui->progressBar->setValue(0);
+
+        ReceiveOptions options;
+        options.outputDir = dir;
+        emit receiveRequested(options);
+    } else {
+        emit receiveStopRequested();
+    }
+}
+
+void MainWindow::onReceiveProgress(const ReceiveStats &stats)
+{
+    int progress = stats.fileSize > 0 ? static_cast<int>(double(stats.bytesReceived) / stats.fileSize * 100) : 0;
+    ui->progressBar->setValue(progress);
+
+    double kbps = stats.elapsedMs > 0 ? double(stats.bytesReceived - stats.resumedFrom) * 8 / stats.elapsedMs : 0.0;
+    ui->labelRate->setText("Rate: " + QString::number(kbps, 'f', 3) + " kbps" + "\t\t" + QString::number(stats.elapsedMs / 1000) + " s");
+    QString status = QString::number(stats.packetsReceived) + " rx\t" + QString::number(stats.duplicates) + " dup\t";
+    if (stats.checked) {
+        status += QString::number(stats.crcErrors) + " crc\t";
+    }
+    ui->labelRate_2->setText(status + QString::number(stats.filesCompleted) + " files");
+    ui->rssi->setText(QString::number(stats.rssi));
+    ui->snr->setText(QString::number(stats.snr));
+}
+
+void MainWindow::onFileReceived(const QString &path)
+{
+    ui->progressBar->setValue(100);
+    logModel->appendLine("received " + path);
+}
+
+void MainWindow::onPreviewReceived(const QString &path, int layers)
+{
+    logModel->appendLine(QString("preview (%1 scans): %2").arg(layers).arg(path));
+}
+
+void MainWindow::onReceiveFinished()
+{
+    ui->pushButtonReceive->setText("Receive");
+    setLinkControlsEnabled(portOpen);
+}
+
+void MainWindow::on_pushButtonTransmit_released()
+{
+
+}
+
+
+void MainWindow::on_ate_clicked()
+{
+    emit commandRequested("ATE\r\n");
+}
+
+
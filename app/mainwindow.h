@@ -0,0 +1,118 @@
+#ifndef MAINWINDOW_H
+#define MAINWINDOW_H
+
+#include <QMainWindow>
+#include <QThread>
+#include "linktypes.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui { class MainWindow; }
+QT_END_NAMESPACE
+
+class LinkEngine;
+class LogModel;
+class SweepDialog;
+
+class MainWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    MainWindow(QWidget *parent = nullptr);
+    ~MainWindow();
+
+    void fillSerialPortInfo();
+
+signals:
+    void openPortRequested(const QString &portName, int baudRate);
+    void closePortRequested();
+    void writeConfigRequested(const RadioConfig &config);
+    void transferRequested(const TransferOptions &options);
+    void stripedTransferRequested(const StripeOptions &options);
+    void batchRequested(const BatchOptions &options);
+    void streamRequested(const StreamOptions &options);
+    void transferStopRequested();
+    void perTestRequested(const PerTestOptions &options);
+    void perTestStopRequested();
+    void sweepRequested(const SweepOptions &options);
+    void sweepStopRequested();
+    void receiveRequested(const ReceiveOptions &options);
+    void receiveStopRequested();
+    void commandRequested(const QByteArray &command);
+    void captureRequested(const QString &path);
+    void latencyExportRequested(const QString &path);
+    void baudRateRequested(int baudRate);
+    void uartPrefetchRequested(bool enabled);
+
+private slots:
+    void on_pushButtonUart_released();
+    void on_pushButtonFile_released();
+    void on_pushButtonFolder_released();
+    void on_pushButtonTransmit_clicked();
+    void on_updateTimer_timeout();
+
+    void on_read_released();
+    void on_testButton_released();
+    void on_sweepButton_released();
+    void on_pushButtonReceive_released();
+
+    void on_pushButtonTransmit_released();
+
+
+    void on_ate_clicked();
+    void on_captureBox_toggled(bool checked);
+    void on_pushButtonExportLatency_released();
+
+
+    void onPortOpened(const QString &portName);
+    void onPortClosed();
+    void onPortError(const QString &message);
+    void onCommandFailed(const QByteArray &command, const QString &reason);
+    void onDataReceived(const QByteArray &data);
+    void onLogAboutToGrow();
+    void onLogFlushed(qint64 lastTime);
+    void onUplinkQuality(int rssi, int snr);
+    void onDownlinkQuality(int rssi, int snr);
+    void onTransferProgress(const TransferStats &stats);
+    void onTransferFinished(bool ok, const QString &message);
+    void onBatchProgress(const BatchStats &stats);
+    void onBatchFileFinished(const BatchStats &stats, bool ok, const QString &message);
+    void onBatchFinished(const BatchStats &stats);
+    void onStreamProgress(const StreamStats &stats);
+    void onStreamFrameFinished(const StreamStats &stats, bool ok, const QString &message);
+    void onStreamFinished(const StreamStats &stats);
+    void onPerTestProgress(const PerStats &stats);
+    void onPerTestFinished();
+    void onSweepStarted(const SweepOptions &options);
+    void onSweepFinished(bool ok, const QString &message);
+    void onReceiveProgress(const ReceiveStats &stats);
+    void onFileReceived(const QString &path);
+    void onPreviewReceived(const QString &path, int layers);
+    void onReceiveFinished();
+    void onLatencySummary(const LatencySummary &summary);
+
+private:
+    void setLinkControlsEnabled(bool enabled);
+    void showSelection(const QStringList &paths);
+    QString transcodeProgressive(const QString &path);
+    RadioConfig radioConfigFromUi() const;
+
+    Ui::MainWindow *ui;
+
+    //串口和协议状态机都在工作线程里, 界面只收进度和统计
+    QThread engineThread;
+    LinkEngine *engine;
+    bool portOpen = false;
+    int modemBaudRate = 115200;     // 模块当前的串口波特率, AT+BAUD换过之后按新的打开
+    QStringList selectedPaths;  // 选的文件(可以多个)或目录, 多于一个文件时批量发
+    bool batchRunning = false;
+    bool streamRunning = false;     // 连续图传时发送按钮变成停止
+    SweepDialog *sweepDialog;
+
+    LogModel *logModel;
+    bool logAtBottom = true;    // 用户往上翻日志时不自动滚动
+
+
+};
+
+#endif // MAINWINDOW_H
@@ -0,0 +1,311 @@
+#include "sweepdialog.h"
+#include <QColor>
+#include <QFile>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QStandardPaths>
+#include <QTableWidget>
+#include <QVBoxLayout>
+#include <algorithm>
+
+static const char *const crNames[] = { "4/5", "4/6", "4/7", "LI 4/5", "LI 4/6", "LI 4/7" };
+
+static QString codingRateName(int index)
+{
+    return index >= 0 && index < 6 ? QString(crNames[index]) : QString::number(index);
+}
+
+SweepDialog::SweepDialog(QWidget *parent) : QDialog(parent)
+{
+    setWindowTitle("PER Sweep");
+    resize(820, 640);
+
+    frequencyEdit = new QLineEdit(this);
+    bandwidthEdit = new QLineEdit(this);
+    spreadingFactorEdit = new QLineEdit(this);
+    codingRateEdit = new QLineEdit(this);
+    codingRateEdit->setToolTip("Coding rate index as in the CR box: 0..2 = 4/5..4/7, 3..5 = long interleaved");
+    preambleEdit = new QLineEdit(this);
+    mtuEdit = new QLineEdit(this);
+
+    packetsBox = new QSpinBox(this);
+    packetsBox->setRange(1, 100000);
+    packetsBox->setValue(int(SweepOptions().packetsPerPoint));
+    minPacketsBox = new QSpinBox(this);
+    minPacketsBox->setRange(1, 100000);
+    minPacketsBox->setValue(int(SweepOptions().minPackets));
+    ciBox = new QSpinBox(this);
+    ciBox->setRange(0, 500);
+    ciBox->setValue(qRound(SweepOptions().ciHalfWidth * 1000));
+    ciBox->setToolTip("Stop a point early once the 95% interval of the PER is within +/- this many 0.1%; 0 sends every packet");
+
+    QFormLayout *form = new QFormLayout;
+    form->addRow("Frequencies (Hz)", frequencyEdit);
+    form->addRow("Bandwidths (kHz)", bandwidthEdit);
+    form->addRow("SF", spreadingFactorEdit);
+    form->addRow("CR index", codingRateEdit);
+    form->addRow("Preambles", preambleEdit);
+    form->addRow("MTU", mtuEdit);
+    form->addRow("Packets per point", packetsBox);
+    form->addRow("Min packets", minPacketsBox);
+    form->addRow("CI half width (0.1%)", ciBox);
+
+    startButton = new QPushButton("Start Sweep", this);
+    exportButton = new QPushButton("Export CSV", this);
+    statusLabel = new QLabel("-", this);
+    connect(startButton, &QPushButton::clicked, this, &SweepDialog::onStartClicked);
+    connect(exportButton, &QPushButton::clicked, this, &SweepDialog::onExportClicked);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(startButton);
+    buttons->addWidget(exportButton);
+    buttons->addWidget(statusLabel);
+    buttons->addStretch();
+
+    resultTable = new QTableWidget(this);
+    resultTable->setColumnCount(11);
+    resultTable->setHorizontalHeaderLabels({"Freq", "BW", "SF", "CR", "Preamble", "MTU",
+                                            "Acked/Sent", "PER %", "95% CI %", "Goodput kbps", "Time s"});
+    resultTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    heatmap = new QTableWidget(this);
+    heatmap->setToolTip("Best goodput (kbps) per SF x BW over the other swept values");
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addLayout(buttons);
+    layout->addWidget(resultTable, 3);
+    layout->addWidget(heatmap, 2);
+
+    setLinkReady(false);
+}
+
+void SweepDialog::setDefaults(const RadioConfig &radio, int mtu)
+{
+    if (running) {
+        return;
+    }
+    frequencyEdit->setText(radio.frequency);
+    bandwidthEdit->setText(QString::number(radio.bandwidth));
+    spreadingFactorEdit->setText(QString::number(radio.spreadingFactor));
+    codingRateEdit->setText(QString::number(radio.codingRate));
+    preambleEdit->setText(QString::number(radio.preamble));
+    mtuEdit->setText(QString::number(mtu));
+}
+
+void SweepDialog::setLinkReady(bool ready)
+{
+    linkReady = ready;
+    if (!ready && running) {
+        sweepFinished(false, "port closed");
+    }
+    startButton->setEnabled(ready || running);
+}
+
+QVector<int> SweepDialog::parseInts(const QString &text)
+{
+    QVector<int> values;
+    for (const QString &part : text.split(',')) {
+        bool ok;
+        int value = part.trimmed().toInt(&ok);
+        if (ok) {
+            values.append(value);
+        }
+    }
+    return values;
+}
+
+void SweepDialog::onStartClicked()
+{
+    if (running) {
+        emit sweepStopRequested();
+        sweepFinished(false, "stopped");
+        return;
+    }
+
+    SweepOptions options;
+    for (const QString &part : frequencyEdit->text().split(',')) {
+        if (!part.trimmed().isEmpty()) {
+            options.frequencies.append(part.trimmed());
+        }
+    }
+    options.bandwidths = parseInts(bandwidthEdit->text());
+    options.spreadingFactors = parseInts(spreadingFactorEdit->text());
+    options.codingRates = parseInts(codingRateEdit->text());
+    options.preambles = parseInts(preambleEdit->text());
+    options.mtus = parseInts(mtuEdit->text());
+    options.packetsPerPoint = quint64(packetsBox->value());
+    options.minPackets = quint64(minPacketsBox->value());
+    options.ciHalfWidth = ciBox->value() / 1000.0;
+
+    results.clear();
+    resultTable->setRowCount(0);
+    updateHeatmap();
+    running = true;
+    startButton->setText("Stop Sweep");
+    statusLabel->setText("running");
+    emit sweepRequested(options);
+}
+
+QColor SweepDialog::heatColor(double value, double best)
+{
+    //红(差)到绿(最好)
+    double ratio = best > 0 ? qBound(0.0, value / best, 1.0) : 0.0;
+    return QColor::fromHsv(int(ratio * 120), 110, 255);
+}
+
+void SweepDialog::addPoint(const SweepPoint &point, int index, int count)
+{
+    results.append(point);
+    statusLabel->setText(QString("%1/%2").arg(index + 1).arg(count));
+
+    double best = 0;
+    for (const SweepPoint &result : results) {
+        best = qMax(best, result.goodputKbps);
+    }
+
+    int row = resultTable->rowCount();
+    resultTable->setRowCount(row + 1);
+    QStringList cells;
+    cells << point.radio.frequency << QString::number(point.radio.bandwidth)
+          << QString::number(point.radio.spreadingFactor) << codingRateName(point.radio.codingRate)
+          << QString::number(point.radio.preamble) << QString::number(point.mtu);
+    if (point.reachable) {
+        cells << QString("%1/%2").arg(point.acked).arg(point.sent)
+              << QString::number(point.per * 100, 'f', 2)
+              << QString("%1 - %2").arg(point.perLow * 100, 0, 'f', 2).arg(point.perHigh * 100, 0, 'f', 2)
+              << QString::number(point.goodputKbps, 'f', 3)
+              << QString::number(point.elapsedMs / 1000.0, 'f', 1);
+    } else {
+        cells << "no reply" << "-" << "-" << "-" << "-";
+    }
+    for (int column = 0; column < cells.size(); column++) {
+        resultTable->setItem(row, column, new QTableWidgetItem(cells[column]));
+    }
+
+    //最好的点会变, 有效速率一列整列重新上色
+    for (int i = 0; i < results.size(); i++) {
+        QTableWidgetItem *item = resultTable->item(i, 9);
+        if (item && results[i].reachable) {
+            item->setBackground(heatColor(results[i].goodputKbps, best));
+        }
+    }
+    resultTable->scrollToBottom();
+    updateHeatmap();
+}
+
+void SweepDialog::updateHeatmap()
+{
+    QVector<int> spreadingFactors;
+    QVector<int> bandwidths;
+    for (const SweepPoint &point : results) {
+        if (!spreadingFactors.contains(point.radio.spreadingFactor)) {
+            spreadingFactors.append(point.radio.spreadingFactor);
+        }
+        if (!bandwidths.contains(point.radio.bandwidth)) {
+            bandwidths.append(point.radio.bandwidth);
+        }
+    }
+    std::sort(spreadingFactors.begin(), spreadingFactors.end());
+    std::sort(bandwidths.begin(), bandwidths.end());
+
+    //每格取其它维度(频点/CR/前导码/MTU)里最好的那个点
+    QVector<QVector<const SweepPoint *>> cells(spreadingFactors.size(), QVector<const SweepPoint *>(bandwidths.size(), nullptr));
+    double best = 0;
+    for (const SweepPoint &point : results) {
+        if (!point.reachable) {
+            continue;
+        }
+        const SweepPoint *&cell = cells[spreadingFactors.indexOf(point.radio.spreadingFactor)][bandwidths.indexOf(point.radio.bandwidth)];
+        if (!cell || point.goodputKbps > cell->goodputKbps) {
+            cell = &point;
+        }
+        best = qMax(best, point.goodputKbps);
+    }
+
+    heatmap->clear();
+    heatmap->setRowCount(spreadingFactors.size());
+    heatmap->setColumnCount(bandwidths.size());
+    QStringList rows;
+    for (int sf : spreadingFactors) {
+        rows << "SF" + QString::number(sf);
+    }
+    QStringList columns;
+    for (int bw : bandwidths) {
+        columns << QString::number(bw) + " kHz";
+    }
+    heatmap->setVerticalHeaderLabels(rows);
+    heatmap->setHorizontalHeaderLabels(columns);
+
+    for (int r = 0; r < spreadingFactors.size(); r++) {
+        for (int c = 0; c < bandwidths.size(); c++) {
+            const SweepPoint *cell = cells[r][c];
+            QTableWidgetItem *item = new QTableWidgetItem(cell ? QString::number(cell->goodputKbps, 'f', 2) : QString("-"));
+            if (cell) {
+                item->setBackground(heatColor(cell->goodputKbps, best));
+                item->setToolTip(QString("%1 Hz, CR %2, preamble %3, MTU %4, PER %5%")
+                                 .arg(cell->radio.frequency).arg(codingRateName(cell->radio.codingRate))
+                                 .arg(cell->radio.preamble).arg(cell->mtu).arg(cell->per * 100, 0, 'f', 2));
+            }
+            heatmap->setItem(r, c, item);
+        }
+    }
+}
+
+void SweepDialog::sweepFinished(bool ok, const QString &message)
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    startButton->setText("Start Sweep");
+    startButton->setEnabled(linkReady);
+
+    //标出最好的点
+    const SweepPoint *best = nullptr;
+    for (const SweepPoint &point : results) {
+        if (point.reachable && (!best || point.goodputKbps > best->goodputKbps)) {
+            best = &point;
+        }
+    }
+    QString text = ok ? message : "failed: " + message;
+    if (best) {
+        text += QString(" | best: %1 Hz BW%2 SF%3 CR %4 MTU %5, %6 kbps")
+                .arg(best->radio.frequency).arg(best->radio.bandwidth).arg(best->radio.spreadingFactor)
+                .arg(codingRateName(best->radio.codingRate)).arg(best->mtu).arg(best->goodputKbps, 0, 'f', 3);
+    }
+    statusLabel->setText(text);
+}
+
+void SweepDialog::onExportClicked()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Export Sweep",
+                                                QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
+                                                "CSV (*.csv)");
+    if (path.isEmpty()) {
+        return;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        statusLabel->setText(path + ": " + file.errorString());
+        return;
+    }
+    file.write("frequency,bandwidth,sf,cr,preamble,mtu,reachable,sent,acked,per,per_low,per_high,goodput_kbps,elapsed_ms\n");
+    for (const SweepPoint &point : results) {
+        QStringList fields;
+        fields << point.radio.frequency << QString::number(point.radio.bandwidth)
+               << QString::number(point.radio.spreadingFactor) << QString::number(point.radio.codingRate)
+               << QString::number(point.radio.preamble) << QString::number(point.mtu)
+               << QString::number(point.reachable ? 1 : 0) << QString::number(point.sent)
+               << QString::number(point.acked) << QString::number(point.per, 'f', 5)
+               << QString::number(point.perLow, 'f', 5) << QString::number(point.perHigh, 'f', 5)
+               << QString::number(point.goodputKbps, 'f', 3) << QString::number(point.elapsedMs);
+        file.write(fields.join(",").toUtf8() + "\n");
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef SWEEPDIALOG_H
+#define SWEEPDIALOG_H
+
+#include <QDialog>
+#include <QVector>
+#include "linktypes.h"
+
+class QColor;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTableWidget;
+
+// 扫参设置和结果
+// 每个维度填逗号分隔的取值, 逐点结果进表格(有效速率按颜色深浅),
+// 热力图按 SF x BW 取每格里最好的有效速率; 结果可以导出CSV
+class SweepDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SweepDialog(QWidget *parent = nullptr);
+
+    void setDefaults(const RadioConfig &radio, int mtu);
+    void setLinkReady(bool ready);
+
+public slots:
+    void addPoint(const SweepPoint &point, int index, int count);
+    void sweepFinished(bool ok, const QString &message);
+
+signals:
+    void sweepRequested(const SweepOptions &options);
+    void sweepStopRequested();
+
+private slots:
+    void onStartClicked();
+    void onExportClicked();
+
+private:
+    static QVector<int> parseInts(const QString &text);
+    static QColor heatColor(double value, double best);
+    void updateHeatmap();
+
+    QLineEdit *frequencyEdit;
+    QLineEdit *bandwidthEdit;
+    QLineEdit *spreadingFactorEdit;
+    QLineEdit *codingRateEdit;
+    QLineEdit *preambleEdit;
+    QLineEdit *mtuEdit;
+    QSpinBox *packetsBox;
+    QSpinBox *minPacketsBox;
+    QSpinBox *ciBox;            // 置信区间半宽, 0.1%
+    QPushButton *startButton;
+    QPushButton *exportButton;
+    QLabel *statusLabel;
+    QTableWidget *resultTable;
+    QTableWidget *heatmap;
+
+    bool running = false;
+    bool linkReady = false;
+    QVector<SweepPoint> results;
+};
+
+#endif // SWEEPDIALOG_H
@@ -0,0 +1,462 @@
+#include "benchrunner.h"
+#include <QTextStream>
+#include <QTimer>
+#include <QtMath>
+#include <algorithm>
+
+BenchRunner::BenchRunner(const BenchOptions &options, QObject *parent)
+    : QObject(parent), options(options)
+{
+    connect(&engine, &LinkEngine::portOpened, this, &BenchRunner::onPortOpened);
+    connect(&engine, &LinkEngine::portError, this, &BenchRunner::onPortError);
+    connect(&engine, &LinkEngine::commandFailed, this, &BenchRunner::onCommandFailed);
+    connect(&engine, &LinkEngine::baudRateNegotiated, this, &BenchRunner::onBaudRateNegotiated);
+    connect(&engine, &LinkEngine::transferProgress, this, &BenchRunner::onTransferProgress);
+    connect(&engine, &LinkEngine::transferFinished, this, &BenchRunner::onTransferFinished);
+    connect(&engine, &LinkEngine::perTestProgress, this, &BenchRunner::onPerTestProgress);
+    connect(&engine, &LinkEngine::perTestFinished, this, &BenchRunner::onPerTestFinished);
+    connect(&engine, &LinkEngine::replyLatency, this, &BenchRunner::onReplyLatency);
+    connect(&engine, &LinkEngine::receiveProgress, this, &BenchRunner::onReceiveProgress);
+    connect(&engine, &LinkEngine::fileReceived, this, &BenchRunner::onFileReceived);
+    connect(&engine, &LinkEngine::previewReceived, this, [this](const QString &path, int layers) {
+        QTextStream(stderr) << "preview (" << layers << " scans) at " << receiveStats.elapsedMs << " ms: " << path << "\n";
+    });
+    connect(&engine, &LinkEngine::batchProgress, this, &BenchRunner::onBatchProgress);
+    connect(&engine, &LinkEngine::batchFileFinished, this, &BenchRunner::onBatchFileFinished);
+    connect(&engine, &LinkEngine::batchFinished, this, &BenchRunner::onBatchFinished);
+    connect(&engine, &LinkEngine::streamProgress, this, [this](const StreamStats &stats) { streamStats = stats; });
+    connect(&engine, &LinkEngine::streamFrameFinished, this, &BenchRunner::onStreamFrameFinished);
+    connect(&engine, &LinkEngine::streamFinished, this, &BenchRunner::onStreamFinished);
+    connect(&engine, &LinkEngine::sweepPointFinished, this, &BenchRunner::onSweepPoint);
+    connect(&engine, &LinkEngine::sweepFinished, this, &BenchRunner::finish);
+    connect(&replay, &SerialReplay::replayFinished, this, &BenchRunner::onReplayFinished);
+}
+
+void BenchRunner::start()
+{
+    if (!options.capturePath.isEmpty()) {
+        engine.startCapture(options.capturePath);
+    }
+    engine.setPipelineDepth(options.atDepth);
+    engine.setUartPrefetch(options.prefetch);
+    if (options.replayPath.isEmpty()) {
+        engine.openPort(options.portName, options.baudRate);
+        return;
+    }
+
+    //回放: 抓包代替串口, 跑的还是同样的测试, 结果里多一段回放统计
+    QString error;
+    if (!replay.load(options.replayPath, &error)) {
+        finish(false, "replay failed: " + error);
+        return;
+    }
+    replay.setOptions(options.replay);
+    engine.openDevice(&replay, options.replayPath, options.baudRate);
+}
+
+void BenchRunner::onReplayFinished()
+{
+    QTimer::singleShot(ReplayLingerMs, this, [this]() {
+        if (!finished) {
+            finish(false, "replay trace ended before the run finished");
+        }
+    });
+}
+
+void BenchRunner::onPortOpened()
+{
+    if (options.uartBaud > 0 && options.uartBaud != options.baudRate) {
+        engine.negotiateBaudRate(options.uartBaud);
+        return;
+    }
+    run();
+}
+
+void BenchRunner::onBaudRateNegotiated(bool ok, int baudRate)
+{
+    //协商不成功就按原波特率接着测, 报告里的uart.baud是实际用的
+    if (!ok) {
+        QTextStream(stderr) << "baud rate negotiation failed, staying at " << baudRate << "\n";
+    }
+    run();
+}
+
+void BenchRunner::run()
+{
+    engine.writeConfig(options.radio);
+    engine.setAckTimeout(options.ackTimeout);
+
+    if (options.receive) {
+        engine.startReceive(options.receiver);
+    } else if (options.sweep) {
+        elapsed.start();
+        engine.startSweep(options.sweepOptions);
+    } else if (options.perTest) {
+        engine.startPerTest(options.per);
+    } else if (options.stream) {
+        StreamOptions stream = options.streamOptions;
+        stream.transfer = options.transfer;
+        engine.startStream(stream);
+    } else if (!options.batchPaths.isEmpty()) {
+        BatchOptions batch;
+        batch.transfer = options.transfer;
+        batch.paths = options.batchPaths;
+        engine.startBatch(batch);
+    } else if (!options.stripe.ports.isEmpty()) {
+        StripeOptions stripe = options.stripe;
+        stripe.transfer = options.transfer;
+        stripe.baudRate = options.baudRate;
+        engine.startStripedTransfer(stripe);
+    } else {
+        engine.startTransfer(options.transfer);
+    }
+}
+
+void BenchRunner::onPortError(const QString &message)
+{
+    finish(false, message);
+}
+
+void BenchRunner::onCommandFailed(const QByteArray &command, const QString &reason)
+{
+    //不结束测试, 协议层自己会重传; 只提示一下
+    QTextStream(stderr) << "AT command failed (" << reason << "): " << QString::fromLatin1(command) << "\n";
+}
+
+void BenchRunner::onTransferProgress(const TransferStats &stats)
+{
+    transferStats = stats;
+}
+
+void BenchRunner::onTransferFinished(bool ok, const QString &message)
+{
+    finish(ok, message);
+}
+
+void BenchRunner::onPerTestProgress(const PerStats &stats)
+{
+    perStats = stats;
+}
+
+void BenchRunner::onPerTestFinished()
+{
+    finish(true, "PER test finished");
+}
+
+void BenchRunner::onReplyLatency(double ms)
+{
+    latencies.append(ms);
+}
+
+void BenchRunner::onReceiveProgress(const ReceiveStats &stats)
+{
+    receiveStats = stats;
+}
+
+void BenchRunner::onFileReceived(const QString &path)
+{
+    if (!receivedPath.isEmpty()) {
+        return;
+    }
+    receivedPath = path;
+    QTimer::singleShot(ReceiveLingerMs, this, [this]() { finish(true, "received " + receivedPath); });
+}
+
+void BenchRunner::onBatchProgress(const BatchStats &stats)
+{
+    batchStats = stats;
+}
+
+void BenchRunner::onBatchFileFinished(const BatchStats &stats, bool ok, const QString &message)
+{
+    batchStats = stats;
+
+    const TransferStats &current = stats.current;
+    QJsonObject file;
+    file["file"] = stats.fileName;
+    file["ok"] = ok;
+    file["message"] = message;
+    file["fileSize"] = double(current.fileSize);
+    file["bytesAcked"] = double(current.bytesAcked);
+    file["resumedFrom"] = double(current.resumedFrom);
+    file["deltaTargetSize"] = double(current.deltaTargetSize);
+    file["packetsSent"] = current.packetsSent;
+    file["retries"] = current.retries;
+    file["elapsedMs"] = double(current.elapsedMs);
+    file["goodputKbps"] = current.elapsedMs > 0 ? double(current.bytesAcked - current.resumedFrom) * 8 / current.elapsedMs : 0.0;
+    batchFiles.append(file);
+}
+
+void BenchRunner::onBatchFinished(const BatchStats &stats)
+{
+    batchStats = stats;
+    finish(stats.fileCount > 0 && stats.filesFailed == 0,
+           QString("%1 of %2 files sent").arg(stats.filesDone).arg(stats.fileCount));
+}
+
+void BenchRunner::onStreamFrameFinished(const StreamStats &stats, bool ok, const QString &message)
+{
+    streamStats = stats;
+    QTextStream(stderr) << stats.fileName << ": "
+                        << (ok ? QString("age %1 ms").arg(stats.lastAgeMs, 0, 'f', 0) : message)
+                        << QString(" (%1 delivered, %2 dropped, %3 preempted)").arg(stats.framesDelivered)
+                           .arg(stats.framesDropped).arg(stats.framesPreempted) << "\n";
+}
+
+void BenchRunner::onStreamFinished(const StreamStats &stats)
+{
+    streamStats = stats;
+    finish(stats.framesDelivered > 0, QString("%1 of %2 frames delivered").arg(stats.framesDelivered).arg(stats.framesCaptured));
+}
+
+void BenchRunner::onSweepPoint(const SweepPoint &point, int index, int count)
+{
+    sweepPoints.append(point);
+    QTextStream(stderr) << QString("[%1/%2] SF%3 BW%4 CR%5 MTU%6: ").arg(index + 1).arg(count)
+                           .arg(point.radio.spreadingFactor).arg(point.radio.bandwidth)
+                           .arg(point.radio.codingRate).arg(point.mtu)
+                        << (point.reachable ? QString("PER %1%, %2 kbps").arg(point.per * 100, 0, 'f', 2)
+                                              .arg(point.goodputKbps, 0, 'f', 3) : QString("no reply")) << "\n";
+}
+
+static QJsonObject sweepPointJson(const SweepPoint &point)
+{
+    QJsonObject item;
+    item["frequency"] = point.radio.frequency;
+    item["bandwidthKhz"] = point.radio.bandwidth;
+    item["spreadingFactor"] = point.radio.spreadingFactor;
+    item["codingRate"] = point.radio.codingRate;
+    item["preamble"] = point.radio.preamble;
+    item["mtu"] = point.mtu;
+    item["reachable"] = point.reachable;
+    item["packetsSent"] = double(point.sent);
+    item["acks"] = double(point.acked);
+    item["per"] = point.per;
+    item["perLow"] = point.perLow;
+    item["perHigh"] = point.perHigh;
+    item["goodputKbps"] = point.goodputKbps;
+    item["elapsedMs"] = double(point.elapsedMs);
+    return item;
+}
+
+void BenchRunner::finish(bool ok, const QString &message)
+{
+    finished = true;
+    this->ok = ok;
+    this->message = message;
+    QString error;
+    if (!options.tracePath.isEmpty() && !engine.tracer()->save(options.tracePath, &error)) {
+        this->message += " (latency export failed: " + error + ")";
+    }
+    engine.closePort();
+    emit done();
+}
+
+static double percentile(const QVector<double> &sorted, double p)
+{
+    if (sorted.isEmpty()) {
+        return 0.0;
+    }
+    int index = qBound(0, qCeil(p / 100.0 * sorted.size()) - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+static double ratio(double numerator, double denominator)
+{
+    return denominator > 0 ? numerator / denominator : 0.0;
+}
+
+QJsonObject BenchRunner::result() const
+{
+    QJsonObject radio;
+    radio["frequency"] = options.radio.frequency;
+    radio["bandwidthKhz"] = options.radio.bandwidth;
+    radio["spreadingFactor"] = options.radio.spreadingFactor;
+    radio["codingRate"] = options.radio.codingRate;
+    radio["preamble"] = options.radio.preamble;
+
+    QJsonObject root;
+    root["mode"] = options.receive ? "receive" : options.sweep ? "sweep" : options.perTest ? "per"
+                 : options.stream ? "stream" : !options.batchPaths.isEmpty() ? "batch" : "transfer";
+    root["port"] = options.replayPath.isEmpty() ? options.portName : QString();
+    root["radio"] = radio;
+    root["ok"] = ok;
+    root["message"] = message;
+
+    qint64 elapsedMs;
+    double payloadBytes;
+    if (options.receive) {
+        elapsedMs = receiveStats.elapsedMs;
+        payloadBytes = receiveStats.bytesReceived - receiveStats.resumedFrom;
+        root["file"] = receivedPath;
+        root["windowMode"] = receiveStats.windowMode;
+        root["fecMode"] = receiveStats.fecMode;
+        root["fileSize"] = double(receiveStats.fileSize);
+        root["bytesReceived"] = double(receiveStats.bytesReceived);
+        root["resumedFrom"] = double(receiveStats.resumedFrom);
+        root["previewLayers"] = receiveStats.previewLayers;
+        root["checked"] = receiveStats.checked;
+        root["crcErrors"] = double(receiveStats.crcErrors);
+        root["repairRounds"] = receiveStats.repairRounds;
+        root["packetsReceived"] = double(receiveStats.packetsReceived);
+        root["duplicates"] = double(receiveStats.duplicates);
+        root["repliesSent"] = double(receiveStats.repliesSent);
+        root["rssi"] = receiveStats.rssi;
+        root["snr"] = receiveStats.snr;
+    } else if (options.sweep) {
+        //逐点结果, 外加有效速率最高的点
+        elapsedMs = elapsed.isValid() ? elapsed.elapsed() : 0;
+        payloadBytes = 0;
+        QJsonArray points;
+        const SweepPoint *best = nullptr;
+        for (const SweepPoint &point : sweepPoints) {
+            points.append(sweepPointJson(point));
+            payloadBytes += double(point.acked) * point.mtu;
+            if (point.reachable && (!best || point.goodputKbps > best->goodputKbps)) {
+                best = &point;
+            }
+        }
+        root["points"] = points;
+        if (best) {
+            root["best"] = sweepPointJson(*best);
+        }
+    } else if (options.perTest) {
+        elapsedMs = perStats.elapsedMs;
+        payloadBytes = double(perStats.acked) * perStats.mtu;
+        root["mtu"] = options.per.mtu;
+        root["packetsSent"] = double(perStats.sent);
+        root["acks"] = double(perStats.acked);
+        root["ackRatio"] = ratio(perStats.acked, perStats.sent);
+        root["lost"] = double(perStats.sent - qMin(perStats.sent, perStats.acked));   // 丢包率测试不重发
+    } else if (options.stream) {
+        //只算送达的帧, 被打断的帧发出去的部分不算
+        elapsedMs = streamStats.elapsedMs;
+        payloadBytes = streamStats.bytesDelivered;
+        root["source"] = options.streamOptions.command.isEmpty() ? options.streamOptions.directory : options.streamOptions.command;
+        root["mtu"] = options.transfer.mtu;
+        root["window"] = options.transfer.window;
+        root["framesCaptured"] = double(streamStats.framesCaptured);
+        root["framesDelivered"] = double(streamStats.framesDelivered);
+        root["framesDropped"] = double(streamStats.framesDropped);
+        root["framesPreempted"] = double(streamStats.framesPreempted);
+        root["framesFailed"] = double(streamStats.framesFailed);
+        QJsonObject age;
+        age["last"] = streamStats.lastAgeMs;
+        age["mean"] = streamStats.ageMeanMs;
+        age["p50"] = streamStats.ageP50Ms;
+        age["p99"] = streamStats.ageP99Ms;
+        age["max"] = streamStats.ageMaxMs;
+        root["frameAgeMs"] = age;
+    } else if (!options.batchPaths.isEmpty()) {
+        //总速率按整批的用时算, 文件之间的握手也算在里面
+        elapsedMs = batchStats.elapsedMs;
+        payloadBytes = batchStats.bytesDone;
+        root["paths"] = QJsonArray::fromStringList(options.batchPaths);
+        root["mtu"] = options.transfer.mtu;
+        root["window"] = options.transfer.window;
+        root["fecBlock"] = options.transfer.fecBlock;
+        root["fileCount"] = batchStats.fileCount;
+        root["filesDone"] = batchStats.filesDone;
+        root["filesFailed"] = batchStats.filesFailed;
+        root["totalBytes"] = double(batchStats.totalBytes);
+        root["bytesAcked"] = double(batchStats.bytesDone);
+        root["files"] = batchFiles;
+    } else {
+        elapsedMs = transferStats.elapsedMs;
+        payloadBytes = transferStats.bytesAcked - transferStats.resumedFrom;    // 只算这次发的
+        root["file"] = options.transfer.filePath;
+        root["mtu"] = options.transfer.mtu;
+        root["window"] = options.transfer.window;
+        root["windowMode"] = transferStats.windowMode;
+        root["fecBlock"] = options.transfer.fecBlock;
+        root["fecMode"] = transferStats.fecMode;
+        root["lossEstimate"] = transferStats.lossRate;
+        root["adaptive"] = options.transfer.adaptive;
+        root["finalSpreadingFactor"] = transferStats.spreadingFactor;
+        root["finalMtu"] = transferStats.mtu;
+        root["rateSwitches"] = transferStats.rateSwitches;
+        root["fileSize"] = double(transferStats.fileSize);
+        root["bytesAcked"] = double(transferStats.bytesAcked);
+        root["resumedFrom"] = double(transferStats.resumedFrom);
+        root["delta"] = options.transfer.delta;
+        root["deltaTargetSize"] = double(transferStats.deltaTargetSize);    // 0: 整个文件发的
+        root["layers"] = transferStats.layers;
+        root["layersAcked"] = transferStats.layersAcked;
+        root["firstLayerMs"] = double(transferStats.firstLayerMs);      // 对端能出第一张预览的时间
+        root["checked"] = transferStats.checked;
+        root["repairRounds"] = transferStats.repairRounds;
+        root["repairBytes"] = double(transferStats.repairBytes);
+        root["packetsSent"] = transferStats.packetsSent;
+        root["acks"] = transferStats.ackReceived;
+        root["ackRatio"] = ratio(transferStats.ackReceived, transferStats.packetsSent);
+        root["retries"] = transferStats.retries;
+        root["links"] = transferStats.links;
+    }
+    root["elapsedMs"] = double(elapsedMs);
+    root["goodputKbps"] = ratio(payloadBytes * 8.0, double(elapsedMs));    // bit/ms = kbit/s
+
+    QVector<double> sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double value : sorted) {
+        sum += value;
+    }
+    QJsonObject latency;
+    latency["count"] = sorted.size();
+    latency["min"] = sorted.isEmpty() ? 0.0 : sorted.first();
+    latency["mean"] = ratio(sum, sorted.size());
+    latency["p50"] = percentile(sorted, 50);
+    latency["p90"] = percentile(sorted, 90);
+    latency["p99"] = percentile(sorted, 99);
+    latency["max"] = sorted.isEmpty() ? 0.0 : sorted.last();
+    root["latencyMs"] = latency;
+
+    //单包各阶段: 串口, 空口, 应答, 总计, 超时重发
+    LatencySummary summary = engine.tracer()->summary();
+    QJsonObject stages;
+    for (const LatencyStage &stage : summary.stages) {
+        QJsonObject item;
+        item["count"] = double(stage.count);
+        item["p50"] = stage.p50Ms;
+        item["p99"] = stage.p99Ms;
+        item["max"] = stage.maxMs;
+        stages[stage.name] = item;
+    }
+    root["stagesMs"] = stages;
+
+    //串口占比高说明瓶颈在主机到模块, 试试--uart-baud和--prefetch
+    QJsonObject uart;
+    uart["baud"] = engine.currentBaudRate();
+    uart["prefetch"] = engine.uartPrefetch();
+    uart["uartShare"] = summary.uartShare;
+    uart["airShare"] = 1.0 - summary.uartShare;
+    root["uart"] = uart;
+
+    if (!options.replayPath.isEmpty()) {
+        //引擎写出的和抓包不一样时, 后面的时序只是参考
+        ReplayStats stats = replay.stats();
+        QJsonObject item;
+        item["trace"] = options.replayPath;
+        item["speed"] = options.replay.speed;
+        item["gated"] = options.replay.gated;
+        item["records"] = stats.records;
+        item["replayed"] = stats.replayed;
+        item["rxBytes"] = double(stats.rxBytes);
+        item["txBytes"] = double(stats.txBytes);
+        item["txExpected"] = double(stats.txExpected);
+        item["firstMismatch"] = double(stats.firstMismatch);
+        item["stalls"] = stats.stalls;
+        item["traceMs"] = double(stats.traceMs);
+        item["elapsedMs"] = double(stats.elapsedMs);
+        item["speedup"] = ratio(double(stats.traceMs), double(stats.elapsedMs));
+        root["replay"] = item;
+    }
+
+    QJsonObject rto;
+    rto["adaptive"] = options.ackTimeout <= 0;
+    rto["srttMs"] = engine.rto()->smoothedRtt();
+    rto["rttvarMs"] = engine.rto()->rttVariance();
+    root["rto"] = rto;
+
+    return root;
+}
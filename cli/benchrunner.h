@@ -0,0 +1,100 @@
+#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <QObject>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QVector>
+#include "linkengine.h"
+#include "linktypes.h"
+#include "serialreplay.h"
+
+struct BenchOptions {
+    QString portName;
+    int baudRate = 115200;
+    RadioConfig radio;
+    int ackTimeout = 0;         // 0 = 按空口时间和实测RTT自适应
+    int atDepth = AtCommandQueue::DefaultDepth;    // 同时等回复的AT命令条数
+    int uartBaud = 0;           // >0 时打开串口后协商到这个波特率
+    bool prefetch = false;      // 当前包在空口上时预写下一包
+    bool perTest = false;       // false = 图传
+    bool receive = false;       // 接收端, 收完一个文件结束
+    bool sweep = false;         // 扫参, 逐点跑丢包率测试
+    SweepOptions sweepOptions;
+    TransferOptions transfer;
+    StripeOptions stripe;       // 给了多个串口时分条发, transfer沿用上面的
+    QStringList batchPaths;     // 多个文件或目录: 排队连着发, transfer沿用上面的
+    bool stream = false;        // 连续图传, 送达streamOptions.maxFrames帧或者相机命令退出后结束
+    StreamOptions streamOptions;
+    PerTestOptions per;
+    ReceiveOptions receiver;
+    QString capturePath;        // 非空时抓串口原始数据
+    QString replayPath;         // 非空时不开串口, 回放这个抓包文件
+    ReplayOptions replay;
+    QString tracePath;          // 非空时结束后导出单包延迟直方图, .json 或 CSV
+};
+
+// 命令行跑一次图传或丢包率测试, 结束后给出JSON结果
+// 引擎就在主线程里跑, 命令行没有界面要保持响应
+class BenchRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int ReceiveLingerMs = 3000;    // 收完后再等一会, 发送端重发的结束包也要回
+    static const int ReplayLingerMs = 5000;     // 抓包放完了引擎还没跑完就算失败
+
+    explicit BenchRunner(const BenchOptions &options, QObject *parent = nullptr);
+
+    void start();
+    QJsonObject result() const;
+    bool succeeded() const { return ok; }
+
+signals:
+    void done();
+
+private slots:
+    void onPortOpened();
+    void onBaudRateNegotiated(bool ok, int baudRate);
+    void onPortError(const QString &message);
+    void onCommandFailed(const QByteArray &command, const QString &reason);
+    void onTransferProgress(const TransferStats &stats);
+    void onTransferFinished(bool ok, const QString &message);
+    void onPerTestProgress(const PerStats &stats);
+    void onPerTestFinished();
+    void onReplyLatency(double ms);
+    void onReceiveProgress(const ReceiveStats &stats);
+    void onFileReceived(const QString &path);
+    void onBatchProgress(const BatchStats &stats);
+    void onBatchFileFinished(const BatchStats &stats, bool ok, const QString &message);
+    void onBatchFinished(const BatchStats &stats);
+    void onStreamFrameFinished(const StreamStats &stats, bool ok, const QString &message);
+    void onStreamFinished(const StreamStats &stats);
+    void onSweepPoint(const SweepPoint &point, int index, int count);
+    void onReplayFinished();
+
+private:
+    void run();
+    void finish(bool ok, const QString &message);
+
+    BenchOptions options;
+    SerialReplay replay;        // 引擎析构时还会关它, 放在引擎前面
+    LinkEngine engine;
+    bool finished = false;
+
+    bool ok = false;
+    QString message;
+    TransferStats transferStats;
+    PerStats perStats;
+    ReceiveStats receiveStats;
+    BatchStats batchStats;
+    QJsonArray batchFiles;      // 批量传输每个文件一项
+    StreamStats streamStats;
+    QVector<SweepPoint> sweepPoints;
+    QString receivedPath;
+    QVector<double> latencies;
+    QElapsedTimer elapsed;      // 扫参的总用时, 含调参
+};
+
+#endif // BENCHRUNNER_H
@@ -0,0 +1,19 @@
+# 命令行测试工具: 不开界面跑图传/丢包率测试, 结果输出JSON, 方便做回归
+# 例: ./2G4_Bench --port /dev/ttyUSB0 --sf 7 --mtu 200 --file image1.jpg > result.json
+
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = 2G4_Bench
+
+include(../core/core.pri)
+
+SOURCES += \
+    benchrunner.cpp \
+    framingbench.cpp \
+    main.cpp
+
+HEADERS += \
+    benchrunner.h \
+    framingbench.h
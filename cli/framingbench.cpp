@@ -0,0 +1,53 @@
+#include "framingbench.h"
+#include "atframer.h"
+#include "hexcodec.h"
+#include <QElapsedTimer>
+#include <QString>
+
+QJsonObject runFramingBenchmark(int mtu, int frames)
+{
+    //64KB 假文件, 按块轮流取
+    QByteArray fileData(64 * 1024, '\0');
+    for (int i = 0; i < fileData.size(); i++) {
+        fileData[i] = static_cast<char>(i * 31);
+    }
+    int chunks = qMax(1, fileData.size() / mtu);
+    quint64 checksum = 0;   // 防止编译器把循环优化掉
+
+    AtFramer framer;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; i++) {
+        TxFrame frame;
+        frame.header[0] = static_cast<uchar>(i);
+        frame.headerSize = 1;
+        frame.data = fileData.constData() + (i % chunks) * mtu;
+        frame.size = mtu;
+        int length;
+        const char *command = framer.build(frame, &length);
+        checksum += static_cast<uchar>(command[length / 2]);
+    }
+    qint64 framerNs = timer.nsecsElapsed();
+
+    //原来的写法: 拷贝, 转16进制, QString拼接, 再转回字节
+    timer.restart();
+    for (int i = 0; i < frames; i++) {
+        QByteArray chunk = fileData.mid((i % chunks) * mtu, mtu);
+        QString hexString = QString("%1").arg(i & 0xFF, 2, 16, QChar('0'));
+        QString command = "AT+PSEND=" + hexString + QString::fromLatin1(chunk.toHex()) + "\r\n";
+        QByteArray bytes = command.toLocal8Bit();
+        checksum += static_cast<uchar>(bytes.at(bytes.size() / 2));
+    }
+    qint64 legacyNs = timer.nsecsElapsed();
+
+    QJsonObject result;
+    result["mode"] = "framing";
+    result["mtu"] = mtu;
+    result["frames"] = frames;
+    result["hexImplementation"] = Hex::implementation();
+    result["framerNsPerFrame"] = double(framerNs) / frames;
+    result["legacyNsPerFrame"] = double(legacyNs) / frames;
+    result["speedup"] = framerNs > 0 ? double(legacyNs) / framerNs : 0.0;
+    result["checksum"] = double(checksum);
+    return result;
+}
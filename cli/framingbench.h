@@ -0,0 +1,9 @@
+#ifndef FRAMINGBENCH_H
+#define FRAMINGBENCH_H
+
+#include <QJsonObject>
+
+// PSEND命令拼装的微基准: 新的AtFramer对比原来 mid()+toHex()+字符串拼接 的写法
+QJsonObject runFramingBenchmark(int mtu, int frames);
+
+#endif // FRAMINGBENCH_H
@@ -0,0 +1,217 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTextStream>
+#include "atframer.h"
+#include "benchrunner.h"
+#include "framingbench.h"
+
+// --sweep "sf=7,8,9;bw=125,250;cr=0,1;preamble=8;mtu=50,100;freq=915000000,916000000", 没给的维度用--sf等的值
+static bool parseSweep(const QString &spec, SweepOptions *sweep)
+{
+    for (const QString &item : spec.split(';')) {
+        if (item.trimmed().isEmpty()) {
+            continue;
+        }
+        int equals = item.indexOf('=');
+        if (equals <= 0) {
+            return false;
+        }
+        QString key = item.left(equals).trimmed();
+        QStringList values;
+        for (const QString &value : item.mid(equals + 1).split(',')) {
+            if (!value.trimmed().isEmpty()) {
+                values.append(value.trimmed());
+            }
+        }
+        if (key == "freq") {
+            sweep->frequencies = values;
+            continue;
+        }
+        QVector<int> numbers;
+        for (const QString &value : values) {
+            bool ok;
+            numbers.append(value.toInt(&ok));
+            if (!ok) {
+                return false;
+            }
+        }
+        if (key == "sf") {
+            sweep->spreadingFactors = numbers;
+        } else if (key == "bw") {
+            sweep->bandwidths = numbers;
+        } else if (key == "cr") {
+            sweep->codingRates = numbers;
+        } else if (key == "preamble") {
+            sweep->preambles = numbers;
+        } else if (key == "mtu") {
+            sweep->mtus = numbers;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("2G4_Bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless file transfer / PER benchmark, prints a JSON report");
+    parser.addHelpOption();
+
+    QCommandLineOption portOption({"p", "port"}, "Serial port name or path; repeat to stripe a file transfer over several modems.", "port");
+    QCommandLineOption baudOption("baud", "Serial baud rate.", "baud", "115200");
+    QCommandLineOption freqOption("freq", "Channel frequency in Hz; repeat to give each striped port its own channel.", "hz", "915000000");
+    QCommandLineOption bwOption("bw", "Bandwidth in kHz (125, 250, 500).", "khz", "125");
+    QCommandLineOption sfOption("sf", "Spreading factor (5-12).", "sf", "5");
+    QCommandLineOption crOption("cr", "Coding rate index: 0-2 = 4/5..4/7, 3-5 = long interleaved.", "index", "0");
+    QCommandLineOption preambleOption("preamble", "Preamble length.", "symbols", "8");
+    QCommandLineOption mtuOption("mtu", "Payload bytes per packet.", "bytes", "100");
+    QCommandLineOption windowOption("window", "Transfer window size, 1 = stop-and-wait.", "frames", "8");
+    QCommandLineOption fecOption("fec", "Erasure-coded transfer with this many chunks per source block (1-128).", "chunks", "0");
+    QCommandLineOption adaptiveOption("adaptive", "Adapt SF and MTU during window transfers.");
+    QCommandLineOption noResumeOption("no-resume", "Always start window transfers from offset 0, ignoring the session journal.");
+    QCommandLineOption deltaOption("delta", "Send only the blocks that changed since the last delivered version of the file, if the peer still has it.");
+    QCommandLineOption layersOption("layers", "For progressive JPEGs, send only the first N scans (coarse to fine; default: all).", "count", "0");
+    QCommandLineOption crcOption("crc", "Add a CRC32C to every window chunk and verify the whole file at the end; damaged ranges are resent.");
+    QCommandLineOption deltaCacheOption("delta-cache", "Directory of last delivered file versions for --delta (default in the user data directory).", "dir");
+    QCommandLineOption fileOption({"f", "file"}, "Send this file (transfer benchmark); repeat it or give a directory to send a batch.", "path");
+    QCommandLineOption streamOption("stream", "Stream the newest file in this directory continuously, dropping frames the link cannot keep up with.", "dir");
+    QCommandLineOption streamCommandOption("stream-cmd", "Stream JPEG frames from this camera command's stdout (MJPEG) continuously.", "command");
+    QCommandLineOption framesOption("frames", "Stop streaming after this many frames are delivered (default: until the camera command exits).", "count", "0");
+    QCommandLineOption preemptOption("preempt", "Abandon the frame being sent when a newer one arrives and less than this fraction is acked (0 = never).", "fraction", "0.5");
+    QCommandLineOption receiveOption("receive", "Receive one file into this directory.", "dir");
+    QCommandLineOption packetsOption({"n", "packets"}, "Run a PER test until this many packets are acked.", "count");
+    QCommandLineOption sweepOption("sweep", "PER sweep over \"sf=..;bw=..;cr=..;preamble=..;mtu=..;freq=..\" (comma lists); --packets caps each point.", "spec");
+    QCommandLineOption ciOption("ci", "Stop a sweep point once the 95% PER interval is within +/- this fraction (0 = send all packets).", "fraction", "0.02");
+    QCommandLineOption timeoutOption("ack-timeout", "Fixed ACK timeout in ms after TX DONE (default adaptive).", "ms", "0");
+    QCommandLineOption depthOption("at-depth", "AT commands in flight before waiting for OK/ERROR (PSEND always waits for TX DONE).", "count", "1");
+    QCommandLineOption uartBaudOption("uart-baud", "After opening the port switch host and modem to this baud rate with AT+BAUD.", "baud");
+    QCommandLineOption prefetchOption("prefetch", "Write the next PSEND to the modem while the current packet is on air; only the line end is sent after TX DONE.");
+    QCommandLineOption framingOption("bench-framing", "Micro-benchmark PSEND framing for this many frames, no port needed.", "frames");
+    QCommandLineOption captureOption("capture", "Record raw serial traffic with timestamps to this file.", "path");
+    QCommandLineOption replayOption("replay", "Run against a --capture file instead of a port: the recorded modem output is fed back to the engine.", "path");
+    QCommandLineOption speedOption("speed", "Replay speed factor (1 = recorded timing, 0 = as fast as possible).", "factor", "1");
+    QCommandLineOption ungatedOption("replay-ungated", "Replay purely by timestamps instead of waiting for the engine to write what the capture wrote before each reply.");
+    QCommandLineOption traceOption("trace", "Export per-packet latency histograms (UART, airtime, reply) to this .csv or .json file.", "path");
+    QCommandLineOption outputOption({"o", "output"}, "Write the JSON report to a file instead of stdout.", "path");
+    parser.addOptions({portOption, baudOption, freqOption, bwOption, sfOption, crOption, preambleOption,
+                       mtuOption, windowOption, fecOption, adaptiveOption, noResumeOption, deltaOption, deltaCacheOption, layersOption, crcOption, fileOption, streamOption, streamCommandOption, framesOption, preemptOption, receiveOption, packetsOption, sweepOption, ciOption, timeoutOption, depthOption, uartBaudOption, prefetchOption, framingOption, captureOption, replayOption, speedOption, ungatedOption, traceOption, outputOption});
+    parser.process(a);
+
+    QTextStream err(stderr);
+    if (parser.isSet(framingOption)) {
+        int mtu = qBound(1, parser.value(mtuOption).toInt(), AtFramer::MaxMtu);
+        int frames = qMax(1, parser.value(framingOption).toInt());
+        QTextStream(stdout) << QJsonDocument(runFramingBenchmark(mtu, frames)).toJson();
+        return 0;
+    }
+
+    int modes = int(parser.isSet(fileOption)) + int(parser.isSet(packetsOption) && !parser.isSet(sweepOption))
+            + int(parser.isSet(receiveOption)) + int(parser.isSet(sweepOption))
+            + int(parser.isSet(streamOption) || parser.isSet(streamCommandOption));
+    if (parser.isSet(portOption) == parser.isSet(replayOption) || modes != 1) {
+        err << "need --port or --replay and exactly one of --file, --stream, --packets, --sweep or --receive\n";
+        return 2;
+    }
+
+    QStringList ports = parser.values(portOption);
+    QStringList files = parser.values(fileOption);
+    bool batch = files.size() > 1 || (files.size() == 1 && QFileInfo(files.first()).isDir());
+    if (parser.isSet(streamOption) && parser.isSet(streamCommandOption)) {
+        err << "--stream and --stream-cmd are exclusive\n";
+        return 2;
+    }
+    if (ports.size() > 1 && (!parser.isSet(fileOption) || batch)) {
+        err << "several --port values only work with a single --file\n";
+        return 2;
+    }
+
+    BenchOptions options;
+    options.portName = ports.value(0);
+    options.stripe.ports = ports.mid(1);
+    options.stripe.frequencies = parser.values(freqOption);
+    options.baudRate = parser.value(baudOption).toInt();
+    options.radio.frequency = parser.value(freqOption);
+    options.radio.bandwidth = parser.value(bwOption).toInt();
+    options.radio.spreadingFactor = parser.value(sfOption).toInt();
+    options.radio.codingRate = parser.value(crOption).toInt();
+    options.radio.preamble = parser.value(preambleOption).toInt();
+    options.ackTimeout = parser.value(timeoutOption).toInt();
+    options.uartBaud = parser.value(uartBaudOption).toInt();
+    options.prefetch = parser.isSet(prefetchOption);
+    options.atDepth = qBound(1, parser.value(depthOption).toInt(), int(AtCommandQueue::Capacity));
+    options.perTest = parser.isSet(packetsOption) && !parser.isSet(sweepOption);
+    options.receive = parser.isSet(receiveOption);
+    options.receiver.outputDir = parser.value(receiveOption);
+    options.transfer.filePath = files.value(0);
+    if (batch) {
+        options.batchPaths = files;
+    }
+    options.transfer.mtu = parser.value(mtuOption).toInt();
+    options.transfer.window = parser.value(windowOption).toInt();
+    options.transfer.fecBlock = parser.value(fecOption).toInt();
+    options.transfer.adaptive = parser.isSet(adaptiveOption);
+    options.transfer.resume = !parser.isSet(noResumeOption);
+    options.transfer.delta = parser.isSet(deltaOption);
+    options.transfer.deltaCacheDir = parser.value(deltaCacheOption);
+    options.transfer.layers = qMax(0, parser.value(layersOption).toInt());
+    options.transfer.checked = parser.isSet(crcOption);
+    options.stream = parser.isSet(streamOption) || parser.isSet(streamCommandOption);
+    options.streamOptions.directory = parser.value(streamOption);
+    options.streamOptions.command = parser.value(streamCommandOption);
+    options.streamOptions.maxFrames = qMax(0, parser.value(framesOption).toInt());
+    options.streamOptions.preemptBelow = qBound(0.0, parser.value(preemptOption).toDouble(), 1.0);
+    options.per.mtu = options.transfer.mtu;
+    options.per.maxPackets = parser.value(packetsOption).toULongLong();
+    options.sweep = parser.isSet(sweepOption);
+    if (options.sweep) {
+        if (!parseSweep(parser.value(sweepOption), &options.sweepOptions)) {
+            err << "invalid --sweep\n";
+            return 2;
+        }
+        if (parser.isSet(packetsOption)) {
+            options.sweepOptions.packetsPerPoint = parser.value(packetsOption).toULongLong();
+        }
+        options.sweepOptions.ciHalfWidth = parser.value(ciOption).toDouble();
+        if (options.sweepOptions.mtus.isEmpty()) {
+            options.sweepOptions.mtus.append(options.transfer.mtu);
+        }
+    }
+    options.capturePath = parser.value(captureOption);
+    options.replayPath = parser.value(replayOption);
+    options.replay.speed = qMax(0.0, parser.value(speedOption).toDouble());
+    options.replay.gated = !parser.isSet(ungatedOption);
+    options.tracePath = parser.value(traceOption);
+
+    if (options.transfer.mtu <= 0 || options.transfer.mtu > AtFramer::MaxMtu || options.transfer.window < 1 || options.transfer.fecBlock < 0
+            || options.transfer.fecBlock > 128 || options.radio.spreadingFactor < 5
+            || options.radio.spreadingFactor > 12 || options.radio.codingRate < 0 || options.radio.codingRate > 5) {
+        err << "invalid --mtu, --window, --fec, --sf or --cr\n";
+        return 2;
+    }
+
+    BenchRunner runner(options);
+    QObject::connect(&runner, &BenchRunner::done, &a, &QCoreApplication::quit, Qt::QueuedConnection);
+    runner.start();
+    a.exec();
+
+    QByteArray json = QJsonDocument(runner.result()).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            err << file.fileName() << ": " << file.errorString() << "\n";
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    return runner.succeeded() ? 0 : 1;
+}
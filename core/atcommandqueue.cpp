@@ -0,0 +1,316 @@
+#include "atcommandqueue.h"
+#include "linklog.h"
+#include <QDebug>
+#include <cstring>
+
+//PSEND的hex后面多一个非十六进制字符, 模块回AT_PARAM_ERROR
+const char AtCommandQueue::DiscardCommand[] = "Z\r\n";
+
+AtCommandQueue::AtCommandQueue(AtCommandWriter *writer, QObject *parent) : QObject(parent), writer(writer),
+    ring(Capacity), timer(new QTimer(this))
+{
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &AtCommandQueue::onTimer);
+    clock.start();
+}
+
+void AtCommandQueue::setDepth(int depth)
+{
+    maxInFlight = qBound(1, depth, Capacity);
+    pump();
+}
+
+void AtCommandQueue::setPrefetch(bool enabled)
+{
+    prefetch = enabled;
+    if (!enabled && prefetchState == PrefetchPending) {
+        prefetchState = NoPrefetch;
+    }
+}
+
+void AtCommandQueue::prefetchFrame(const char *command, int size)
+{
+    if (!prefetch || prefetchState != NoPrefetch || size <= 2) {
+        return;
+    }
+    prefetchBuffer.resize(size);
+    memcpy(prefetchBuffer.data(), command, size);
+    prefetchState = PrefetchPending;
+    writePrefetch();
+}
+
+void AtCommandQueue::writePrefetch()
+{
+    if (prefetchState != PrefetchPending) {
+        return;
+    }
+
+    //只有一包在空口上, 后面没有排队的命令时才写, 不打乱顺序
+    const Entry *onAir = nullptr;
+    for (int i = 0; i < count; i++) {
+        const Entry &entry = at(i);
+        if (entry.state == Queued) {
+            return;
+        }
+        if (entry.state == Written) {
+            if (!entry.frame || !entry.replied) {
+                return;
+            }
+            onAir = &entry;
+        }
+    }
+    if (!onAir) {
+        return;
+    }
+    writer->writeCommand(prefetchBuffer.constData(), prefetchBuffer.size() - 2, false);
+    prefetchState = PrefetchWritten;
+}
+
+bool AtCommandQueue::enqueue(const char *command, int size, int timeoutMs, int retries, const Callback &done)
+{
+    return push(command, size, false, timeoutMs, retries, done);
+}
+
+bool AtCommandQueue::enqueueFrame(const char *command, int size, int txDoneTimeoutMs)
+{
+    //PSEND只在射频忙时重发, 超时不重发: 没回OK也可能已经发出去了, 重传交给协议层
+    return push(command, size, true, txDoneTimeoutMs, DefaultRetries, Callback());
+}
+
+bool AtCommandQueue::push(const char *command, int size, bool frame, int timeoutMs, int retries, const Callback &done)
+{
+    //预写过的半行要么就是这一包, 要么先丢掉
+    bool matched = false;
+    if (prefetchState == PrefetchPending) {
+        prefetchState = NoPrefetch;
+    } else if (prefetchState == PrefetchWritten) {
+        prefetchState = NoPrefetch;
+        matched = frame && size == prefetchBuffer.size() && memcmp(prefetchBuffer.constData(), command, size) == 0;
+        if (!matched && push(DiscardCommand, int(sizeof(DiscardCommand)) - 1, false, DefaultTimeoutMs, 0, Callback())) {
+            at(count - 1).anyReply = true;
+        }
+    }
+
+    if (count == Capacity) {
+        emit commandFailed(QByteArray(command, size).trimmed(), "queue full");
+        if (done) {
+            done(false);
+        }
+        return false;
+    }
+
+    //槽里的缓冲区够大就不重新分配
+    Entry &entry = at(count);
+    entry.command.resize(size);
+    memcpy(entry.command.data(), command, size);
+    entry.frame = frame;
+    entry.timeoutMs = timeoutMs;
+    entry.retries = retries;
+    entry.done = done;
+    entry.state = Queued;
+    entry.replied = false;
+    entry.prefetched = matched;
+    entry.anyReply = false;
+    entry.reason = nullptr;
+    count++;
+
+    pump();
+    return true;
+}
+
+void AtCommandQueue::clear()
+{
+    //串口关了, 还没回的都不会再回了; 模块里的半行补完丢掉
+    timer->stop();
+    if (prefetchState == PrefetchWritten) {
+        writer->writeCommand(DiscardCommand, int(sizeof(DiscardCommand)) - 1, false);
+    }
+    prefetchState = NoPrefetch;
+    for (int i = 0; i < count; i++) {
+        Entry &entry = at(i);
+        if (entry.state == Queued || entry.state == Written) {
+            entry.state = Failed;
+            entry.reason = "port closed";
+        }
+    }
+    holdUntil = 0;
+    popFinished();
+}
+
+AtCommandQueue::Entry *AtCommandQueue::firstWaitingReply()
+{
+    for (int i = 0; i < count; i++) {
+        Entry &entry = at(i);
+        if (entry.state == Written && !entry.replied) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void AtCommandQueue::handleEvent(const AtEvent &event)
+{
+    Entry *entry = nullptr;
+    switch (event.type) {
+    case AtEvent::Ok:
+        //模块按顺序回, 对上最早一条还没回的
+        entry = firstWaitingReply();
+        if (!entry) {
+            return;     // 超时放弃的命令迟到的OK
+        }
+        entry->replied = true;
+        if (!entry->frame) {
+            finish(*entry, true, nullptr);
+        }
+        popFinished();
+        pump();
+        writePrefetch();    // 当前包开始发了
+        return;
+
+    case AtEvent::Error:
+        entry = firstWaitingReply();
+        if (!entry) {
+            return;
+        }
+        if (entry->anyReply) {
+            finish(*entry, true, nullptr);
+        } else if (event.busy && entry->retries > 0) {
+            entry->retries--;
+            retry(*entry, BusyRetryMs);
+        } else {
+            finish(*entry, false, event.busy ? "busy" : "error");
+        }
+        break;
+
+    case AtEvent::TxDone:
+        for (int i = 0; i < count; i++) {
+            if (at(i).state == Written && at(i).frame) {
+                finish(at(i), true, nullptr);
+                break;
+            }
+        }
+        if (prefetchState == PrefetchPending) {
+            prefetchState = NoPrefetch;     // 没赶上, 下一包整条写
+        }
+        break;
+
+    default:
+        return;
+    }
+
+    popFinished();
+    pump();
+}
+
+void AtCommandQueue::onTimer()
+{
+    qint64 t = now();
+    for (int i = 0; i < count; i++) {
+        Entry &entry = at(i);
+        if (entry.state != Written || entry.deadline > t) {
+            continue;
+        }
+        if (entry.frame) {
+            finish(entry, false, entry.replied ? "no TX DONE" : "timeout");
+        } else if (entry.retries > 0) {
+            entry.retries--;
+            retry(entry, 0);
+        } else {
+            finish(entry, false, "timeout");
+        }
+    }
+    popFinished();
+    pump();
+}
+
+void AtCommandQueue::finish(Entry &entry, bool ok, const char *reason)
+{
+    entry.state = ok ? Succeeded : Failed;
+    entry.reason = reason;
+}
+
+void AtCommandQueue::retry(Entry &entry, qint64 delayMs)
+{
+    qCDebug(lcLink) << "AT retry:" << entry.command.trimmed();
+    entry.state = Queued;
+    entry.replied = false;
+    entry.prefetched = false;   // 预写的那行已经被模块执行掉了
+    holdUntil = qMax(holdUntil, now() + delayMs);
+}
+
+void AtCommandQueue::popFinished()
+{
+    //按入队顺序完成, 回调里可以再入队
+    while (count > 0 && (at(0).state == Succeeded || at(0).state == Failed)) {
+        Entry &entry = at(0);
+        bool ok = entry.state == Succeeded;
+        Callback done;
+        std::swap(done, entry.done);
+        if (!ok) {
+            emit commandFailed(entry.command.trimmed(), QString::fromLatin1(entry.reason));
+        }
+        head = (head + 1) % Capacity;
+        count--;
+        if (done) {
+            done(ok);
+        }
+    }
+}
+
+void AtCommandQueue::pump()
+{
+    if (now() < holdUntil) {
+        armTimer();
+        return;
+    }
+
+    int inFlight = 0;
+    bool frameInFlight = false;
+    for (int i = 0; i < count; i++) {
+        if (at(i).state == Written) {
+            inFlight++;
+            frameInFlight = frameInFlight || at(i).frame;
+        }
+    }
+
+    for (int i = 0; i < count && inFlight < maxInFlight && !frameInFlight; i++) {
+        Entry &entry = at(i);
+        if (entry.state != Queued) {
+            continue;
+        }
+        //PSEND等前面的都回完才写, 写了之后等TX DONE
+        if (entry.frame && inFlight > 0) {
+            break;
+        }
+        entry.state = Written;
+        entry.deadline = now() + entry.timeoutMs;
+        if (entry.prefetched) {
+            writer->writeCommand(entry.command.constData() + entry.command.size() - 2, 2, true);
+        } else {
+            writer->writeCommand(entry.command.constData(), entry.command.size(), entry.frame);
+        }
+        inFlight++;
+        frameInFlight = entry.frame;
+    }
+    armTimer();
+}
+
+void AtCommandQueue::armTimer()
+{
+    //下一个要处理的时间点: 最早的超时, 或者忙等结束
+    qint64 next = -1;
+    for (int i = 0; i < count; i++) {
+        const Entry &entry = at(i);
+        if (entry.state == Written && (next < 0 || entry.deadline < next)) {
+            next = entry.deadline;
+        }
+        if (entry.state == Queued && holdUntil > now() && (next < 0 || holdUntil < next)) {
+            next = holdUntil;
+        }
+    }
+    if (next < 0) {
+        timer->stop();
+        return;
+    }
+    timer->start(int(qMax<qint64>(0, next - now())));
+}
@@ -0,0 +1,118 @@
+#ifndef ATCOMMANDQUEUE_H
+#define ATCOMMANDQUEUE_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+#include "atparser.h"
+
+class AtCommandWriter
+{
+public:
+    virtual ~AtCommandWriter() {}
+    virtual void writeCommand(const char *data, int size, bool frame) = 0;  // frame: AT+PSEND
+};
+
+// AT命令队列
+// 模块按顺序回OK/ERROR, 按先进先出对上已经写出去的命令; 最多同时有depth条在等回复,
+// 模块回一条才补写一条, 不会比模块接收得快. AT+PSEND当屏障: 前面的都回完才写, 之后的等TX DONE再写,
+// 射频在发的时候串口上不会再来别的命令.
+// 每条命令单独超时; AT_BUSY_ERROR和超时按命令给的次数重发, 其它错误直接失败.
+// 命令存在固定个数的槽里, 缓冲区重复使用, 每包不分配内存
+// 预写(prefetch): 当前包在空口上(PSEND已回OK)时, 先把下一包PSEND除了\r\n的部分写过去,
+// 模块收到行尾才执行, TX DONE后只补\r\n, 串口时间和空口时间重叠. 下一包和预写的不一样时补一个非法字符
+// 让模块把这半行当错误命令丢掉
+class AtCommandQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void(bool ok)> Callback;
+
+    static const int Capacity = 64;
+    static const int DefaultDepth = 1;
+    static const int DefaultTimeoutMs = 1000;
+    static const int DefaultRetries = 2;
+    static const int BusyRetryMs = 20;      // 射频忙时隔这么久重发
+    static const char DiscardCommand[];     // 接在预写的半行后面, 凑成模块回错误的一行
+
+    explicit AtCommandQueue(AtCommandWriter *writer, QObject *parent = nullptr);
+
+    void setDepth(int depth);
+    int depth() const { return maxInFlight; }
+    int pending() const { return count; }
+
+    // 普通命令回OK算完成; frame(AT+PSEND)要等到TX DONE. done在完成或失败时调用
+    bool enqueue(const char *command, int size, int timeoutMs = DefaultTimeoutMs,
+                 int retries = DefaultRetries, const Callback &done = Callback());
+    bool enqueueFrame(const char *command, int size, int txDoneTimeoutMs);
+
+    void setPrefetch(bool enabled);
+    bool prefetchEnabled() const { return prefetch; }
+    // 下一包大概率就是它; 真正发的时候还是走enqueueFrame, 内容一样才只补行尾
+    void prefetchFrame(const char *command, int size);
+
+    void handleEvent(const AtEvent &event);
+    void clear();
+
+signals:
+    void commandFailed(const QByteArray &command, const QString &reason);
+
+private slots:
+    void onTimer();
+
+private:
+    enum PrefetchState {
+        NoPrefetch,
+        PrefetchPending,        // 等当前包回OK再写
+        PrefetchWritten         // 半行已经在模块里
+    };
+
+    enum State {
+        Queued,
+        Written,
+        Succeeded,
+        Failed
+    };
+
+    struct Entry {
+        QByteArray command;
+        bool frame = false;
+        int timeoutMs = 0;
+        int retries = 0;
+        Callback done;
+        State state = Queued;
+        bool replied = false;   // 收到OK, frame还在等TX DONE
+        bool prefetched = false;    // 命令体已经预写过, 只差\r\n
+        bool anyReply = false;      // 丢弃预写半行的命令, 回OK/ERROR都算完成
+        qint64 deadline = 0;
+        const char *reason = nullptr;
+    };
+
+    Entry &at(int index) { return ring[(head + index) % Capacity]; }
+    bool push(const char *command, int size, bool frame, int timeoutMs, int retries, const Callback &done);
+    Entry *firstWaitingReply();
+    void finish(Entry &entry, bool ok, const char *reason);
+    void retry(Entry &entry, qint64 delayMs);
+    void popFinished();
+    void writePrefetch();
+    void pump();
+    void armTimer();
+    qint64 now() const { return clock.elapsed(); }
+
+    AtCommandWriter *writer;
+    QVector<Entry> ring;
+    int head = 0;
+    int count = 0;
+    int maxInFlight = DefaultDepth;
+    qint64 holdUntil = 0;       // 忙错误后先停一会再写
+    bool prefetch = false;
+    PrefetchState prefetchState = NoPrefetch;
+    QByteArray prefetchBuffer;
+    QElapsedTimer clock;
+    QTimer *timer;
+};
+
+#endif // ATCOMMANDQUEUE_H
@@ -0,0 +1,33 @@
+#include "atframer.h"
+#include "hexcodec.h"
+#include <cstring>
+
+TxFrame TxFrame::fromPayload(const QByteArray &payload)
+{
+    TxFrame frame;
+    frame.data = payload.constData();
+    frame.size = payload.size();
+    return frame;
+}
+
+const char *AtFramer::build(const TxFrame &frame, int *length)
+{
+    if (frame.headerSize < 0 || frame.headerSize > TxFrame::MaxHeaderSize
+            || frame.size < 0 || frame.headerSize + frame.size > MaxPayloadSize) {
+        *length = 0;
+        return nullptr;
+    }
+
+    char *p = buffer;
+    memcpy(p, "AT+PSEND=", PrefixSize);
+    p += PrefixSize;
+    Hex::encodeUpper(frame.header, frame.headerSize, p);
+    p += 2 * frame.headerSize;
+    Hex::encodeUpper(reinterpret_cast<const uchar *>(frame.data), frame.size, p);
+    p += 2 * frame.size;
+    *p++ = '\r';
+    *p++ = '\n';
+
+    *length = static_cast<int>(p - buffer);
+    return buffer;
+}
@@ -0,0 +1,35 @@
+#ifndef ATFRAMER_H
+#define ATFRAMER_H
+
+#include <QByteArray>
+
+// 一包要发的负载: 帧头放在结构体里, 数据只是指针(一般指向文件数据), 不拷贝
+// data在发送和超时重发期间必须一直有效
+struct TxFrame {
+    static const int MaxHeaderSize = 8;
+
+    uchar header[MaxHeaderSize];
+    int headerSize = 0;
+    const char *data = nullptr;
+    int size = 0;
+
+    static TxFrame fromPayload(const QByteArray &payload);
+};
+
+// AT+PSEND 命令拼装
+// 前缀, 帧头, 16进制负载和CRLF直接写进固定大小的缓冲区, 每包不分配内存
+class AtFramer
+{
+public:
+    static const int MaxPayloadSize = 255;  // RUI3 单包上限, 超了模块回AT_PARAM_ERROR
+    static const int MaxMtu = MaxPayloadSize - TxFrame::MaxHeaderSize;  // 任何帧头下都发得出去的最大MTU
+
+    // 返回的命令在下一次build之前有效; 负载超长返回nullptr
+    const char *build(const TxFrame &frame, int *length);
+
+private:
+    static const int PrefixSize = 9;    // AT+PSEND=
+    char buffer[PrefixSize + 2 * MaxPayloadSize + 2];
+};
+
+#endif // ATFRAMER_H
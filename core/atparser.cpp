@@ -0,0 +1,219 @@
+#include "atparser.h"
+#include "transferprotocol.h"
+#include <cstring>
+
+namespace {
+
+const char TxDonePrefix[] = "+EVT:TXP2P DONE";
+const char RxP2PPrefix[] = "+EVT:RXP2P:";
+
+bool startsWith(const char *p, int size, const char *prefix, int prefixSize)
+{
+    return size >= prefixSize && memcmp(p, prefix, prefixSize) == 0;
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 解析有符号十进制数, 成功时p指向数字后一个字符
+bool parseInt(const char *&p, const char *end, int *value)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') {
+        return false;
+    }
+    int v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    *value = negative ? -v : v;
+    return true;
+}
+
+}
+
+AtParser::AtParser(AtEventHandler *handler) : handler(handler)
+{
+    pending.reserve(4096);
+    backlog.reserve(4096);
+}
+
+void AtParser::reset()
+{
+    lineSize = 0;
+    overflow = false;
+    pending.resize(0);
+}
+
+void AtParser::feed(const char *data, int size)
+{
+    if (feeding) {
+        //处理事件时又被喂了数据(比如事件处理里调用了processEvents), 排到当前数据之后
+        pending.append(data, size);
+        return;
+    }
+
+    feeding = true;
+    consume(data, size);
+    while (!pending.isEmpty()) {
+        backlog.swap(pending);
+        consume(backlog.constData(), backlog.size());
+        backlog.resize(0);
+    }
+    feeding = false;
+}
+
+void AtParser::consume(const char *data, int size)
+{
+    for (int i = 0; i < size; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            if (overflow) {
+                overflow = false;
+                overflowLines++;
+            } else {
+                processLine();
+            }
+            lineSize = 0;
+        } else if (c == '\r') {
+            //行尾的\r不存
+        } else if (!overflow) {
+            if (lineSize < MaxLineSize) {
+                line[lineSize++] = c;
+            } else {
+                overflow = true;
+            }
+        }
+    }
+}
+
+void AtParser::processLine()
+{
+    const char *p = line;
+    int size = lineSize;
+    if (size == 0) {
+        return;
+    }
+
+    AtEvent event;
+    if (size == 2 && p[0] == 'O' && p[1] == 'K') {
+        event.type = AtEvent::Ok;
+        emitEvent(event);
+    } else if (startsWith(p, size, "ERROR", 5)
+               || (startsWith(p, size, "AT_", 3) && size >= 8 && memcmp(p + size - 5, "ERROR", 5) == 0)) {
+        event.type = AtEvent::Error;
+        event.busy = startsWith(p, size, "AT_BUSY_ERROR", 13);
+        emitEvent(event);
+    } else if (startsWith(p, size, TxDonePrefix, sizeof(TxDonePrefix) - 1)) {
+        event.type = AtEvent::TxDone;
+        emitEvent(event);
+    } else if (startsWith(p, size, RxP2PPrefix, sizeof(RxP2PPrefix) - 1)) {
+        processRxP2P(p + sizeof(RxP2PPrefix) - 1, p + size);
+    }
+    //其余行(命令回显, 版本信息等)忽略
+}
+
+void AtParser::processRxP2P(const char *p, const char *end)
+{
+    AtEvent event;
+    event.type = AtEvent::RxP2P;
+    if (!parseInt(p, end, &event.rssi) || p >= end || *p++ != ':') {
+        return;
+    }
+    if (!parseInt(p, end, &event.snr)) {
+        return;
+    }
+
+    int payloadSize = 0;
+    if (p < end && *p == ':') {
+        p++;
+        while (p + 1 < end && payloadSize < MaxPayloadSize) {
+            int hi = hexValue(p[0]);
+            int lo = hexValue(p[1]);
+            if (hi < 0 || lo < 0) {
+                break;
+            }
+            payload[payloadSize++] = static_cast<uchar>((hi << 4) | lo);
+            p += 2;
+        }
+    }
+    event.payload = payload;
+    event.payloadSize = payloadSize;
+    emitEvent(event);
+
+    //对端回的应答
+    if (payloadSize >= 3 && payload[0] == 0x55 && payload[1] == 0xAA) {
+        AtEvent reply;
+        if (payload[2] == 0x55) {
+            reply.type = AtEvent::Ack;
+            if (payloadSize >= 5) {
+                reply.hasLinkInfo = true;
+                reply.rssi = static_cast<qint8>(payload[3]);
+                reply.snr = static_cast<qint8>(payload[4]);
+            }
+            emitEvent(reply);
+        } else if (payload[2] == 0x56) {
+            Protocol::Sack sack;
+            if (Protocol::parseSack(payload, payloadSize, &sack)) {
+                reply.type = AtEvent::Sack;
+                reply.hasLinkInfo = true;
+                reply.rssi = sack.rssi;
+                reply.snr = sack.snr;
+                reply.expectedSeq = sack.expectedSeq;
+                reply.bitmap = sack.bitmap;
+                emitEvent(reply);
+            }
+        } else if (payload[2] == 0x58) {
+            Protocol::ResumeAck ack;
+            if (Protocol::parseResumeAck(payload, payloadSize, &ack)) {
+                reply.type = AtEvent::ResumeAck;
+                reply.hasLinkInfo = true;
+                reply.rssi = ack.rssi;
+                reply.snr = ack.snr;
+                reply.offset = ack.offset;
+                emitEvent(reply);
+            }
+        } else if (payload[2] == 0x59) {
+            Protocol::Verdict verdict;
+            if (Protocol::parseVerdict(payload, payloadSize, &verdict)) {
+                reply.type = AtEvent::Verdict;
+                reply.hasLinkInfo = true;
+                reply.rssi = verdict.rssi;
+                reply.snr = verdict.snr;
+                reply.ranges = static_cast<quint8>(verdict.ranges.size());
+                reply.payload = payload;
+                reply.payloadSize = payloadSize;
+                emitEvent(reply);
+            }
+        } else {
+            Protocol::FecStatus status;
+            if (Protocol::parseFecStatus(payload, payloadSize, &status)) {
+                reply.type = AtEvent::FecStatus;
+                reply.hasLinkInfo = true;
+                reply.rssi = status.rssi;
+                reply.snr = status.snr;
+                reply.decodedBlocks = status.decodedBlocks;
+                reply.rank = status.rank;
+                reply.received = status.received;
+                emitEvent(reply);
+            }
+        }
+    }
+}
+
+void AtParser::emitEvent(const AtEvent &event)
+{
+    if (handler) {
+        handler->onAtEvent(event);
+    }
+}
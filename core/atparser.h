@@ -0,0 +1,81 @@
+#ifndef ATPARSER_H
+#define ATPARSER_H
+
+#include <QByteArray>
+
+// 串口解析出的事件
+struct AtEvent {
+    enum Type {
+        TxDone,     // +EVT:TXP2P DONE
+        RxP2P,      // +EVT:RXP2P:rssi:snr:payload
+        Ack,        // 负载为 55AA55[rssi snr] 的RXP2P
+        Sack,       // 负载为 55AA56... 的RXP2P (窗口协议)
+        FecStatus,  // 负载为 55AA57... 的RXP2P (纠删码协议)
+        ResumeAck,  // 负载为 55AA58... 的RXP2P (续传)
+        Verdict,    // 负载为 55AA59... 的RXP2P (校验模式)
+        Ok,         // OK
+        Error       // ERROR / AT_xxx_ERROR
+    };
+
+    Type type = Ok;
+    int rssi = 0;               // RxP2P: 本端测的上行; Ack/Sack: 对端测的下行
+    int snr = 0;
+    bool hasLinkInfo = false;   // Ack: 老固件的ACK可能不带rssi/snr
+    const uchar *payload = nullptr;     // RxP2P/Verdict: 解码后的负载, 只在回调期间有效
+    int payloadSize = 0;
+    quint16 expectedSeq = 0;    // Sack
+    quint32 bitmap = 0;         // Sack
+    quint16 decodedBlocks = 0;  // FecStatus
+    quint8 rank = 0;            // FecStatus
+    quint8 received = 0;        // FecStatus
+    quint32 offset = 0;         // ResumeAck
+    quint8 ranges = 0;          // Verdict: 要补的段数, 0是校验通过; 段本身从payload解
+    bool busy = false;          // Error: AT_BUSY_ERROR, 射频忙, 过一会重发能成功
+};
+
+class AtEventHandler
+{
+public:
+    virtual ~AtEventHandler() {}
+    virtual void onAtEvent(const AtEvent &event) = 0;
+};
+
+// 逐字节, 按行分帧的AT响应解析器
+// 每个字节只处理一次, 行缓冲和负载缓冲都是固定大小, 解析过程不分配内存;
+// 跨多次read的半行会保留到下次继续拼接, 不会丢事件
+class AtParser
+{
+public:
+    static const int MaxLineSize = 1100;
+    static const int MaxPayloadSize = 512;
+
+    explicit AtParser(AtEventHandler *handler = nullptr);
+
+    void setHandler(AtEventHandler *handler) { this->handler = handler; }
+    void feed(const char *data, int size);
+    void feed(const QByteArray &data) { feed(data.constData(), data.size()); }
+    void reset();
+
+    quint64 droppedLines() const { return overflowLines; }
+
+private:
+    void consume(const char *data, int size);
+    void processLine();
+    void processRxP2P(const char *p, const char *end);
+    void emitEvent(const AtEvent &event);
+
+    AtEventHandler *handler;
+
+    char line[MaxLineSize];
+    int lineSize = 0;
+    bool overflow = false;      // 当前行超长, 丢弃到行尾
+    quint64 overflowLines = 0;
+
+    uchar payload[MaxPayloadSize];
+
+    bool feeding = false;       // 回调里重入feed时先排队, 保证字节顺序
+    QByteArray pending;
+    QByteArray backlog;
+};
+
+#endif // ATPARSER_H
@@ -0,0 +1,152 @@
+#include "batchtransfer.h"
+#include "filesender.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+BatchTransfer::BatchTransfer(FileSender *sender, QObject *parent) : QObject(parent), sender(sender)
+{
+}
+
+QStringList BatchTransfer::expandPaths(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDir dir(path);
+            for (const QString &name : dir.entryList(QDir::Files | QDir::Readable, QDir::Name)) {
+                files.append(dir.filePath(name));
+            }
+        } else if (info.isFile() && info.isReadable()) {
+            files.append(path);
+        } else {
+            qWarning() << "skipping" << path;
+        }
+    }
+    return files;
+}
+
+void BatchTransfer::start(const BatchOptions &options)
+{
+    stop();
+
+    transfer = options.transfer;
+    files = expandPaths(options.paths);
+    stats = BatchStats();
+    stats.fileCount = files.size();
+    for (const QString &file : files) {
+        stats.totalBytes += QFileInfo(file).size();
+    }
+    finishedBytes = 0;
+    nextIndex = -1;
+    nextSource.clear();
+
+    running = true;
+    elapsed.start();
+
+    //第一个文件没有可预读的, 现打开
+    for (int i = 0; i < files.size(); i++) {
+        QSharedPointer<ChunkSource> source = load(i);
+        if (source) {
+            startFile(i, source);
+            return;
+        }
+    }
+    running = false;
+    emit finished(stats);
+}
+
+void BatchTransfer::stop()
+{
+    running = false;
+    nextSource.clear();
+}
+
+QSharedPointer<ChunkSource> BatchTransfer::load(int index)
+{
+    QString error;
+    QSharedPointer<ChunkSource> source = ChunkSource::open(files.at(index), &error);
+    if (source) {
+        return source;
+    }
+
+    //打不开的文件算失败, 跳过; 可能是在预读, 当前文件的统计不动
+    stats.filesFailed++;
+    BatchStats failed = stats;
+    failed.fileIndex = index;
+    failed.fileName = QFileInfo(files.at(index)).fileName();
+    failed.current = TransferStats();
+    emit fileDone(failed, false, files.at(index) + " open failed: " + error);
+    return source;
+}
+
+void BatchTransfer::startFile(int index, const QSharedPointer<ChunkSource> &source)
+{
+    stats.fileIndex = index;
+    stats.fileName = QFileInfo(files.at(index)).fileName();
+    stats.current = TransferStats();
+
+    TransferOptions options = transfer;
+    options.filePath = files.at(index);
+    options.chained = index + 1 < files.size();
+    sender->start(options, source);
+
+    //开始包已经写出去了, 趁它在空中把下一个文件打开
+    if (running && stats.fileIndex == index) {
+        preloadNext();
+    }
+}
+
+void BatchTransfer::preloadNext()
+{
+    nextIndex = -1;
+    nextSource.clear();
+    for (int i = stats.fileIndex + 1; i < files.size(); i++) {
+        nextSource = load(i);
+        if (nextSource) {
+            nextIndex = i;
+            return;
+        }
+    }
+    //后面没有能发的了, 当前文件要发结束包
+    sender->setChained(false);
+}
+
+void BatchTransfer::fileProgress(const TransferStats &stats)
+{
+    if (!running) {
+        return;
+    }
+    this->stats.current = stats;
+    this->stats.bytesDone = finishedBytes + stats.bytesAcked;
+    this->stats.elapsedMs = elapsed.elapsed();
+    emit progress(this->stats);
+}
+
+void BatchTransfer::fileFinished(bool ok, const QString &message)
+{
+    if (!running) {
+        return;
+    }
+    if (ok) {
+        stats.filesDone++;
+    } else {
+        stats.filesFailed++;
+    }
+    finishedBytes += stats.current.bytesAcked;
+    stats.bytesDone = finishedBytes;
+    stats.elapsedMs = elapsed.elapsed();
+    emit fileDone(stats, ok, message);
+
+    if (running && nextIndex >= 0) {
+        int index = nextIndex;
+        QSharedPointer<ChunkSource> source = nextSource;
+        nextIndex = -1;
+        nextSource.clear();
+        startFile(index, source);
+        return;
+    }
+    running = false;
+    emit finished(stats);
+}
@@ -0,0 +1,58 @@
+#ifndef BATCHTRANSFER_H
+#define BATCHTRANSFER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QStringList>
+#include "chunksource.h"
+#include "linktypes.h"
+
+class FileSender;
+
+// 批量传输: 一串文件排队用同一个FileSender发
+// 当前文件开始发以后就把下一个文件打开映射好(管道读进内存), 发完直接接着发, 中间不等界面;
+// 除最后一个外都标成chained, 下一个文件的开始包兼作结束包.
+// 某个文件失败不影响后面的, 结果里分别计数
+class BatchTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BatchTransfer(FileSender *sender, QObject *parent = nullptr);
+
+    // 目录展开成里面的文件(按名字排序), 读不了的去掉
+    static QStringList expandPaths(const QStringList &paths);
+
+    bool isRunning() const { return running; }
+    void start(const BatchOptions &options);
+    void stop();
+
+    // 当前文件的FileSender进度和结果
+    void fileProgress(const TransferStats &stats);
+    void fileFinished(bool ok, const QString &message);
+
+signals:
+    void progress(const BatchStats &stats);
+    void fileDone(const BatchStats &stats, bool ok, const QString &message);
+    void finished(const BatchStats &stats);
+
+private:
+    void startFile(int index, const QSharedPointer<ChunkSource> &source);
+    void preloadNext();
+    QSharedPointer<ChunkSource> load(int index);
+
+    FileSender *sender;
+    bool running = false;
+    TransferOptions transfer;
+    QStringList files;
+    BatchStats stats;
+    qint64 finishedBytes = 0;   // 已结束的文件确认了的字节数
+    QElapsedTimer elapsed;
+
+    //预读的下一个文件
+    int nextIndex = -1;
+    QSharedPointer<ChunkSource> nextSource;
+};
+
+#endif // BATCHTRANSFER_H
@@ -0,0 +1,88 @@
+#include "chunksource.h"
+
+QSharedPointer<ChunkSource> ChunkSource::open(const QString &path, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return QSharedPointer<ChunkSource>();
+    }
+
+    //管道, 字符设备: 读到结束为止
+    if (file.isSequential()) {
+        return fromData(file.readAll());
+    }
+    file.close();
+
+    QSharedPointer<MappedChunkSource> mapped(new MappedChunkSource);
+    if (!mapped->open(path, error)) {
+        return QSharedPointer<ChunkSource>();
+    }
+    return mapped;
+}
+
+QSharedPointer<ChunkSource> ChunkSource::fromData(const QByteArray &data)
+{
+    return QSharedPointer<ChunkSource>(new BufferChunkSource(data));
+}
+
+MappedChunkSource::~MappedChunkSource()
+{
+    if (whole) {
+        file.unmap(whole);
+    }
+    if (window) {
+        file.unmap(window);
+    }
+}
+
+bool MappedChunkSource::open(const QString &path, QString *error)
+{
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+
+    //大小按打开时算, 之后还在增长的部分不发
+    fileSize = file.size();
+    if (fileSize > 0) {
+        whole = file.map(0, fileSize);
+    }
+    return true;
+}
+
+const char *MappedChunkSource::chunk(qint64 offset, int length)
+{
+    if (offset < 0 || length < 0 || offset + length > fileSize) {
+        return nullptr;
+    }
+    if (whole) {
+        return reinterpret_cast<const char *>(whole) + offset;
+    }
+    if (fileSize == 0) {
+        return "";
+    }
+
+    //窗口按WindowSize对齐, 映射两个窗口长, 一块不会跨出去
+    if (!window || offset < windowOffset || offset + length > windowOffset + windowLength) {
+        if (window) {
+            file.unmap(window);
+        }
+        windowOffset = offset - offset % WindowSize;
+        windowLength = qMin(2 * WindowSize, fileSize - windowOffset);
+        window = file.map(windowOffset, windowLength);
+        if (!window) {
+            return nullptr;
+        }
+    }
+    return reinterpret_cast<const char *>(window) + (offset - windowOffset);
+}
+
+const char *BufferChunkSource::chunk(qint64 offset, int length)
+{
+    if (offset < 0 || length < 0 || offset + length > buffer.size()) {
+        return nullptr;
+    }
+    return buffer.constData() + offset;
+}
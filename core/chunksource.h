@@ -0,0 +1,60 @@
+#ifndef CHUNKSOURCE_H
+#define CHUNKSOURCE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+
+// 待发送文件的数据源, 偏移是64位的
+// 发送端按块取只读指针直接交给组帧, 不复制; 普通文件映射到内存, 不整个读进来
+class ChunkSource
+{
+public:
+    virtual ~ChunkSource() {}
+
+    virtual qint64 size() const = 0;
+
+    // [offset, offset+length) 的只读视图, 下一次调用chunk()之前有效; 读不到返回nullptr
+    virtual const char *chunk(qint64 offset, int length) = 0;
+
+    // 普通文件用映射; 管道之类不能映射的按顺序读进内存(协议要先知道文件大小)
+    static QSharedPointer<ChunkSource> open(const QString &path, QString *error);
+    static QSharedPointer<ChunkSource> fromData(const QByteArray &data);
+};
+
+// QFile::map映射整个文件, 地址空间不够(32位系统上的大文件)时退回按窗口映射
+class MappedChunkSource : public ChunkSource
+{
+public:
+    static const qint64 WindowSize = 64 * 1024 * 1024;
+
+    ~MappedChunkSource();
+
+    bool open(const QString &path, QString *error);
+    qint64 size() const override { return fileSize; }
+    const char *chunk(qint64 offset, int length) override;
+
+private:
+    QFile file;
+    qint64 fileSize = 0;
+    uchar *whole = nullptr;
+    uchar *window = nullptr;
+    qint64 windowOffset = 0;
+    qint64 windowLength = 0;
+};
+
+// 已经在内存里的数据
+class BufferChunkSource : public ChunkSource
+{
+public:
+    explicit BufferChunkSource(const QByteArray &data) : buffer(data) {}
+
+    qint64 size() const override { return buffer.size(); }
+    const char *chunk(qint64 offset, int length) override;
+
+private:
+    QByteArray buffer;
+};
+
+#endif // CHUNKSOURCE_H
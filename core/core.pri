@@ -0,0 +1,74 @@
+# 链路引擎: 串口, AT解析, 图传/丢包率测试状态机, 协议和空口时间计算
+# 界面, 命令行和测试工程共用
+
+QT += serialport
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/atcommandqueue.cpp \
+    $$PWD/atframer.cpp \
+    $$PWD/atparser.cpp \
+    $$PWD/batchtransfer.cpp \
+    $$PWD/chunksource.cpp \
+    $$PWD/crc32c.cpp \
+    $$PWD/deltacache.cpp \
+    $$PWD/deltacodec.cpp \
+    $$PWD/fec.cpp \
+    $$PWD/filereceiver.cpp \
+    $$PWD/filesender.cpp \
+    $$PWD/framestreamer.cpp \
+    $$PWD/hexcodec.cpp \
+    $$PWD/integritycheck.cpp \
+    $$PWD/jpegscans.cpp \
+    $$PWD/latencyhistogram.cpp \
+    $$PWD/linkengine.cpp \
+    $$PWD/linklog.cpp \
+    $$PWD/loraairtime.cpp \
+    $$PWD/packettracer.cpp \
+    $$PWD/persweep.cpp \
+    $$PWD/pertest.cpp \
+    $$PWD/ratecontroller.cpp \
+    $$PWD/rtoestimator.cpp \
+    $$PWD/serialcapture.cpp \
+    $$PWD/serialreplay.cpp \
+    $$PWD/sessionjournal.cpp \
+    $$PWD/slidingwindow.cpp \
+    $$PWD/stripedtransfer.cpp \
+    $$PWD/stripequeue.cpp \
+    $$PWD/transferprotocol.cpp
+
+HEADERS += \
+    $$PWD/atcommandqueue.h \
+    $$PWD/atframer.h \
+    $$PWD/atparser.h \
+    $$PWD/batchtransfer.h \
+    $$PWD/chunksource.h \
+    $$PWD/crc32c.h \
+    $$PWD/deltacache.h \
+    $$PWD/deltacodec.h \
+    $$PWD/fec.h \
+    $$PWD/filereceiver.h \
+    $$PWD/filesender.h \
+    $$PWD/framestreamer.h \
+    $$PWD/hexcodec.h \
+    $$PWD/integritycheck.h \
+    $$PWD/jpegscans.h \
+    $$PWD/latencyhistogram.h \
+    $$PWD/linkengine.h \
+    $$PWD/linklog.h \
+    $$PWD/linktypes.h \
+    $$PWD/loraairtime.h \
+    $$PWD/packettracer.h \
+    $$PWD/persweep.h \
+    $$PWD/pertest.h \
+    $$PWD/ratecontroller.h \
+    $$PWD/rtoestimator.h \
+    $$PWD/serialcapture.h \
+    $$PWD/serialreplay.h \
+    $$PWD/sessionjournal.h \
+    $$PWD/slidingwindow.h \
+    $$PWD/stripedtransfer.h \
+    $$PWD/stripequeue.h \
+    $$PWD/transferprotocol.h
@@ -0,0 +1,168 @@
+#include "crc32c.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_HAVE_SSE42
+#include <nmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define CRC_HAVE_ARMV8
+#include <arm_acle.h>
+#endif
+
+namespace Crc32c {
+
+namespace {
+
+const quint32 Polynomial = 0x82F63B78;  // 反射后的0x1EDC6F41
+
+// slicing-by-8: 每次查8张表处理8个字节
+struct Table {
+    quint32 t[8][256];
+
+    Table()
+    {
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? Polynomial : 0);
+            }
+            t[0][i] = crc;
+        }
+        for (int k = 1; k < 8; k++) {
+            for (int i = 0; i < 256; i++) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const Table &table()
+{
+    static const Table instance;
+    return instance;
+}
+
+#ifdef CRC_HAVE_SSE42
+__attribute__((target("sse4.2")))
+quint32 extendSse42(quint32 crc, const uchar *data, qint64 size)
+{
+    quint32 c = ~crc;
+#ifdef __x86_64__
+    quint64 c64 = c;
+    for (; size >= 8; size -= 8, data += 8) {
+        quint64 word;
+        memcpy(&word, data, 8);
+        c64 = _mm_crc32_u64(c64, word);
+    }
+    c = static_cast<quint32>(c64);
+#endif
+    for (; size >= 4; size -= 4, data += 4) {
+        quint32 word;
+        memcpy(&word, data, 4);
+        c = _mm_crc32_u32(c, word);
+    }
+    for (; size > 0; size--) {
+        c = _mm_crc32_u8(c, *data++);
+    }
+    return ~c;
+}
+#endif
+
+#ifdef CRC_HAVE_ARMV8
+quint32 extendArmv8(quint32 crc, const uchar *data, qint64 size)
+{
+    quint32 c = ~crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        quint64 word;
+        memcpy(&word, data, 8);
+        c = __crc32cd(c, word);
+    }
+    for (; size > 0; size--) {
+        c = __crc32cb(c, *data++);
+    }
+    return ~c;
+}
+#endif
+
+enum Implementation {
+    Scalar,
+    Sse42,
+    Armv8
+};
+
+Implementation detect()
+{
+#ifdef CRC_HAVE_SSE42
+    if (__builtin_cpu_supports("sse4.2")) {
+        return Sse42;
+    }
+#endif
+#ifdef CRC_HAVE_ARMV8
+    return Armv8;
+#else
+    return Scalar;
+#endif
+}
+
+Implementation selected()
+{
+    static const Implementation implementation = detect();
+    return implementation;
+}
+
+}
+
+quint32 extendScalar(quint32 crc, const uchar *data, qint64 size)
+{
+    const Table &t = table();
+    quint32 c = ~crc;
+
+    //按小端一次取8字节, 大端机器逐字节算
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    for (; size >= 8; size -= 8, data += 8) {
+        quint32 lo;
+        quint32 hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= c;
+        c = t.t[7][lo & 0xFF] ^ t.t[6][(lo >> 8) & 0xFF] ^ t.t[5][(lo >> 16) & 0xFF] ^ t.t[4][lo >> 24]
+                ^ t.t[3][hi & 0xFF] ^ t.t[2][(hi >> 8) & 0xFF] ^ t.t[1][(hi >> 16) & 0xFF] ^ t.t[0][hi >> 24];
+    }
+#endif
+    for (; size > 0; size--) {
+        c = (c >> 8) ^ t.t[0][(c ^ *data++) & 0xFF];
+    }
+    return ~c;
+}
+
+quint32 extend(quint32 crc, const uchar *data, qint64 size)
+{
+    switch (selected()) {
+#ifdef CRC_HAVE_SSE42
+    case Sse42:
+        return extendSse42(crc, data, size);
+#endif
+#ifdef CRC_HAVE_ARMV8
+    case Armv8:
+        return extendArmv8(crc, data, size);
+#endif
+    default:
+        return extendScalar(crc, data, size);
+    }
+}
+
+const char *implementation()
+{
+    switch (selected()) {
+    case Sse42:
+        return "sse4.2";
+    case Armv8:
+        return "armv8";
+    default:
+        return "scalar";
+    }
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QtGlobal>
+
+// CRC32C(Castagnoli), 运行时按CPU选SSE4.2/ARMv8 CRC指令或查表(slicing-by-8)实现
+// 窗口协议的校验模式每块都算一次, 收完整个文件再算一次
+namespace Crc32c {
+
+// 接着上一段的结果算, 第一段crc传0; 和一次算完整段的结果一样
+quint32 extend(quint32 crc, const uchar *data, qint64 size);
+quint32 extendScalar(quint32 crc, const uchar *data, qint64 size);
+
+inline quint32 compute(const uchar *data, qint64 size) { return extend(0, data, size); }
+
+const char *implementation();   // "sse4.2" / "armv8" / "scalar"
+
+}
+
+#endif // CRC32C_H
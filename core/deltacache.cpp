@@ -0,0 +1,116 @@
+#include "deltacache.h"
+#include "sessionjournal.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+DeltaCache::DeltaCache(const QString &directory)
+    : dir(directory.isEmpty() ? defaultDirectory() : directory)
+{
+}
+
+QString DeltaCache::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/QT_ISM2400/delta";
+}
+
+QString DeltaCache::pathOf(const QByteArray &hash) const
+{
+    return QDir(dir).filePath(QString::fromLatin1(hash.toHex()) + ".bin");
+}
+
+QString DeltaCache::indexPath() const
+{
+    return QDir(dir).filePath("index.json");
+}
+
+QByteArray DeltaCache::latest(const QString &fileName) const
+{
+    QFile file(indexPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QJsonArray versions = QJsonDocument::fromJson(file.readAll()).object().value(fileName).toArray();
+    if (versions.isEmpty()) {
+        return QByteArray();
+    }
+    return QByteArray::fromHex(versions.at(0).toString().toLatin1());
+}
+
+bool DeltaCache::load(const QByteArray &hash, QByteArray *data) const
+{
+    if (hash.isEmpty()) {
+        return false;
+    }
+    QFile file(pathOf(hash));
+    if (!file.open(QIODevice::ReadOnly) || file.size() > MaxFileSize) {
+        return false;
+    }
+    //缓存文件被改过就不能当基准
+    *data = file.readAll();
+    return SessionJournal::sessionId(*data) == hash;
+}
+
+bool DeltaCache::store(const QString &fileName, const QByteArray &data, const QByteArray &hash) const
+{
+    if (hash.isEmpty() || data.size() > MaxFileSize) {
+        return false;
+    }
+    QDir().mkpath(dir);
+    if (!QFileInfo::exists(pathOf(hash))) {
+        QSaveFile file(pathOf(hash));
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        file.write(data);
+        if (!file.commit()) {
+            return false;
+        }
+    }
+
+    //新版本放最前面, 每个文件名只留最近几个
+    QJsonObject index;
+    QFile current(indexPath());
+    if (current.open(QIODevice::ReadOnly)) {
+        index = QJsonDocument::fromJson(current.readAll()).object();
+        current.close();
+    }
+    QString hex = QString::fromLatin1(hash.toHex());
+    QJsonArray versions;
+    versions.append(hex);
+    for (const QJsonValue &value : index.value(fileName).toArray()) {
+        if (value.toString() != hex && versions.size() < KeepVersions) {
+            versions.append(value);
+        }
+    }
+    index[fileName] = versions;
+
+    QSaveFile file(indexPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(index).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        return false;
+    }
+
+    //哪个文件名都不再引用的版本删掉
+    QSet<QString> referenced;
+    for (const QString &name : index.keys()) {
+        for (const QJsonValue &value : index.value(name).toArray()) {
+            referenced.insert(value.toString() + ".bin");
+        }
+    }
+    for (const QString &blob : QDir(dir).entryList(QStringList() << "*.bin", QDir::Files)) {
+        if (!referenced.contains(blob)) {
+            QFile::remove(QDir(dir).filePath(blob));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef DELTACACHE_H
+#define DELTACACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+// 差量传输的基准文件缓存, 发送端和接收端各存一份
+// 每个成功送达的文件按内容哈希(同续传的会话ID)存一份, index.json记每个文件名最近的几个版本;
+// 发送端拿上一次送达的版本做基准, 接收端按开始包里的基准哈希找
+class DeltaCache
+{
+public:
+    static const int KeepVersions = 2;      // 结束包的应答丢了时发送端还会拿上一个版本做基准
+    static const qint64 MaxFileSize = 16 * 1024 * 1024;    // 编码和重建都在内存里做
+
+    explicit DeltaCache(const QString &directory = QString());
+
+    // 发送端默认目录, 界面和命令行共用
+    static QString defaultDirectory();
+
+    QString directory() const { return dir; }
+
+    // 这个文件名最近一次存的版本的哈希, 没有返回空
+    QByteArray latest(const QString &fileName) const;
+    bool load(const QByteArray &hash, QByteArray *data) const;
+    bool store(const QString &fileName, const QByteArray &data, const QByteArray &hash) const;
+
+private:
+    QString pathOf(const QByteArray &hash) const;
+    QString indexPath() const;
+
+    QString dir;
+};
+
+#endif // DELTACACHE_H
@@ -0,0 +1,215 @@
+#include "deltacodec.h"
+#include <QHash>
+#include <QVector>
+#include <cstring>
+
+namespace DeltaCodec {
+
+namespace {
+
+void appendBigEndian(QByteArray &out, quint32 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        out.append(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+quint32 readBigEndian(const uchar *p, int bytes)
+{
+    quint32 value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// rsync的弱校验: a是字节和, b是按位置加权的和, 各取低16位
+struct Checksum {
+    quint32 a = 0;
+    quint32 b = 0;
+
+    void reset(const uchar *data, int length)
+    {
+        a = 0;
+        b = 0;
+        for (int i = 0; i < length; i++) {
+            a += data[i];
+            b += quint32(length - i) * data[i];
+        }
+        a &= 0xFFFF;
+        b &= 0xFFFF;
+    }
+
+    // 窗口右移一个字节
+    void roll(uchar out, uchar in, int length)
+    {
+        a = (a - out + in) & 0xFFFF;
+        b = (b - quint32(length) * out + a) & 0xFFFF;
+    }
+
+    quint32 value() const { return a | (b << 16); }
+};
+
+class Writer
+{
+public:
+    Writer(const uchar *target, QByteArray *out) : target(target), out(out) {}
+
+    void copy(int block)
+    {
+        if (copyCount > 0 && copyStart + copyCount == block && copyCount < MaxRun) {
+            copyCount++;
+            return;
+        }
+        flushCopy();
+        copyStart = block;
+        copyCount = 1;
+    }
+
+    void literal(int from, int to)
+    {
+        if (from >= to) {
+            return;
+        }
+        flushCopy();
+        while (from < to) {
+            int length = qMin(MaxRun, to - from);
+            out->append(static_cast<char>(OpData));
+            appendBigEndian(*out, static_cast<quint32>(length), 2);
+            out->append(reinterpret_cast<const char *>(target) + from, length);
+            from += length;
+        }
+    }
+
+    void flushCopy()
+    {
+        if (copyCount == 0) {
+            return;
+        }
+        out->append(static_cast<char>(OpCopy));
+        appendBigEndian(*out, static_cast<quint32>(copyStart), 4);
+        appendBigEndian(*out, static_cast<quint32>(copyCount), 2);
+        copyCount = 0;
+    }
+
+private:
+    const uchar *target;
+    QByteArray *out;
+    int copyStart = 0;
+    int copyCount = 0;
+};
+
+}
+
+QByteArray encode(const QByteArray &base, const QByteArray &target, int blockSize)
+{
+    const int b = qBound(16, blockSize, MaxRun);
+    const uchar *basePtr = reinterpret_cast<const uchar *>(base.constData());
+    const uchar *targetPtr = reinterpret_cast<const uchar *>(target.constData());
+    const int fullBlocks = base.size() / b;
+    const int tail = base.size() % b;
+
+    //基准的整块按弱校验建索引, 校验相同的块串成链
+    QHash<quint32, int> head;
+    QVector<int> next(fullBlocks, -1);
+    head.reserve(fullBlocks);
+    Checksum sum;
+    for (int block = fullBlocks - 1; block >= 0; block--) {
+        sum.reset(basePtr + qint64(block) * b, b);
+        next[block] = head.value(sum.value(), -1);
+        head.insert(sum.value(), block);
+    }
+
+    QByteArray out;
+    appendBigEndian(out, static_cast<quint32>(b), 2);
+    Writer writer(targetPtr, &out);
+
+    const int n = target.size();
+    int pos = 0;
+    int literalStart = 0;
+    int expected = -1;          // 接着上一次复制的块, 命中多个时优先它, 复制指令能合并
+    bool valid = false;
+    while (pos + b <= n) {
+        if (!valid) {
+            sum.reset(targetPtr + pos, b);
+            valid = true;
+        }
+
+        int match = -1;
+        for (int block = head.value(sum.value(), -1); block >= 0; block = next.at(block)) {
+            if (memcmp(basePtr + qint64(block) * b, targetPtr + pos, b) == 0) {
+                if (match < 0 || block == expected) {
+                    match = block;
+                }
+                if (block == expected) {
+                    break;
+                }
+            }
+        }
+
+        if (match >= 0) {
+            writer.literal(literalStart, pos);
+            writer.copy(match);
+            expected = match + 1;
+            pos += b;
+            literalStart = pos;
+            valid = false;
+            continue;
+        }
+
+        if (pos + b < n) {
+            sum.roll(targetPtr[pos], targetPtr[pos + b], b);
+        }
+        pos++;
+    }
+
+    //基准最后不足一块的部分和新文件结尾一样也能复制
+    if (tail > 0 && n - literalStart >= tail
+            && memcmp(basePtr + qint64(fullBlocks) * b, targetPtr + n - tail, tail) == 0) {
+        writer.literal(literalStart, n - tail);
+        writer.copy(fullBlocks);
+        literalStart = n;
+    }
+    writer.literal(literalStart, n);
+    writer.flushCopy();
+    return out;
+}
+
+bool apply(const QByteArray &base, const QByteArray &delta, QByteArray *target)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(delta.constData());
+    const int size = delta.size();
+    if (size < 2) {
+        return false;
+    }
+    const int b = static_cast<int>(readBigEndian(p, 2));
+    if (b == 0) {
+        return false;
+    }
+
+    target->clear();
+    int pos = 2;
+    while (pos < size) {
+        if (p[pos] == OpCopy && pos + 7 <= size) {
+            qint64 from = qint64(readBigEndian(p + pos + 1, 4)) * b;
+            qint64 length = qMin<qint64>(qint64(readBigEndian(p + pos + 5, 2)) * b, base.size() - from);
+            if (from >= base.size() || length <= 0) {
+                return false;
+            }
+            target->append(base.constData() + from, static_cast<int>(length));
+            pos += 7;
+        } else if (p[pos] == OpData && pos + 3 <= size) {
+            int length = static_cast<int>(readBigEndian(p + pos + 1, 2));
+            if (pos + 3 + length > size) {
+                return false;
+            }
+            target->append(delta.constData() + pos + 3, length);
+            pos += 3 + length;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef DELTACODEC_H
+#define DELTACODEC_H
+
+#include <QByteArray>
+
+// 差量编码(rsync式): 基准文件按固定大小分块, 新文件上逐字节滑动弱校验找和基准相同的块,
+// 找到的发复制指令, 找不到的原样发
+//
+// 差量格式:
+//   块大小(2) | 指令...
+//   复制    01 | 基准块号(4) | 块数(2)      基准的最后一块不足块大小的按实际长度复制
+//   原样    02 | 长度(2) | 数据
+//
+// 发送端手上就有基准文件, 弱校验命中后直接逐字节比, 不用再算强哈希;
+// 重建后的文件由开始包里的目标哈希校验
+namespace DeltaCodec {
+
+const int DefaultBlockSize = 64;
+const int MaxRun = 0xFFFF;
+
+const quint8 OpCopy = 0x01;
+const quint8 OpData = 0x02;
+
+QByteArray encode(const QByteArray &base, const QByteArray &target, int blockSize = DefaultBlockSize);
+
+// 差量格式不对或者引用了基准外的块返回false
+bool apply(const QByteArray &base, const QByteArray &delta, QByteArray *target);
+
+}
+
+#endif // DELTACODEC_H
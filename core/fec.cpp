@@ -0,0 +1,193 @@
+#include "fec.h"
+#include <cstring>
+
+namespace Gf256 {
+
+struct Tables {
+    uchar exp[512];
+    uchar log[256];
+    uchar product[256][256];
+
+    Tables()
+    {
+        int x = 1;
+        for (int i = 0; i < 255; i++) {
+            exp[i] = static_cast<uchar>(x);
+            log[x] = static_cast<uchar>(i);
+            x <<= 1;
+            if (x & 0x100) {
+                x ^= 0x11D;
+            }
+        }
+        for (int i = 255; i < 512; i++) {
+            exp[i] = exp[i - 255];
+        }
+        log[0] = 0;
+
+        for (int a = 0; a < 256; a++) {
+            for (int b = 0; b < 256; b++) {
+                product[a][b] = (a && b) ? exp[log[a] + log[b]] : 0;
+            }
+        }
+    }
+};
+
+static const Tables &tables()
+{
+    static const Tables instance;
+    return instance;
+}
+
+uchar mul(uchar a, uchar b)
+{
+    return tables().product[a][b];
+}
+
+uchar inv(uchar a)
+{
+    //a必须非0
+    return tables().exp[255 - tables().log[a]];
+}
+
+void mulAdd(uchar *dst, const uchar *src, uchar coef, int size)
+{
+    if (coef == 0) {
+        return;
+    }
+    if (coef == 1) {
+        //系数1就是异或, 按8字节一组做
+        int i = 0;
+        for (; i + 8 <= size; i += 8) {
+            quint64 a, b;
+            memcpy(&a, dst + i, 8);
+            memcpy(&b, src + i, 8);
+            a ^= b;
+            memcpy(dst + i, &a, 8);
+        }
+        for (; i < size; i++) {
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+
+    const uchar *row = tables().product[coef];
+    for (int i = 0; i < size; i++) {
+        dst[i] ^= row[src[i]];
+    }
+}
+
+void scale(uchar *data, uchar coef, int size)
+{
+    if (coef == 1) {
+        return;
+    }
+    const uchar *row = tables().product[coef];
+    for (int i = 0; i < size; i++) {
+        data[i] = row[data[i]];
+    }
+}
+
+}
+
+void FecEncoder::setBlock(const uchar *symbols, int sourceCount, int symbolSize)
+{
+    source = symbols;
+    k = sourceCount;
+    this->symbolSize = symbolSize;
+}
+
+uchar FecEncoder::coefficient(int repair, int source)
+{
+    //x和y取自不相交的集合, x^y永远不为0
+    return Gf256::inv(static_cast<uchar>((MaxSourceSymbols + repair) ^ source));
+}
+
+void FecEncoder::encode(int id, uchar *out) const
+{
+    if (id < k) {
+        memcpy(out, source + id * symbolSize, symbolSize);
+        return;
+    }
+
+    int repair = id - k;
+    memset(out, 0, symbolSize);
+    for (int i = 0; i < k; i++) {
+        Gf256::mulAdd(out, source + i * symbolSize, coefficient(repair, i), symbolSize);
+    }
+}
+
+void FecDecoder::reset(int sourceCount, int symbolSize)
+{
+    k = sourceCount;
+    this->symbolSize = symbolSize;
+    rankValue = 0;
+    rows.fill(0, k * k);
+    rowData.fill('\0', k * symbolSize);
+    hasPivot.fill(false, k);
+    seen.fill(false, k + FecEncoder::MaxRepairSymbols);
+    scratchCoefficients.resize(k);
+    scratchData.resize(symbolSize);
+}
+
+bool FecDecoder::addSymbol(int id, const uchar *data)
+{
+    if (id < 0 || id >= seen.size() || seen.at(id) || isDecoded()) {
+        return false;
+    }
+    seen[id] = true;
+
+    uchar *coefficients = scratchCoefficients.data();
+    uchar *values = reinterpret_cast<uchar *>(scratchData.data());
+    if (id < k) {
+        memset(coefficients, 0, k);
+        coefficients[id] = 1;
+    } else {
+        for (int i = 0; i < k; i++) {
+            coefficients[i] = FecEncoder::coefficient(id - k, i);
+        }
+    }
+    memcpy(values, data, symbolSize);
+
+    //用已有的主元行消去
+    for (int c = 0; c < k; c++) {
+        uchar factor = coefficients[c];
+        if (factor && hasPivot.at(c)) {
+            Gf256::mulAdd(coefficients, rows.constData() + c * k, factor, k);
+            Gf256::mulAdd(values, reinterpret_cast<const uchar *>(rowData.constData()) + c * symbolSize, factor, symbolSize);
+        }
+    }
+
+    int pivot = 0;
+    while (pivot < k && coefficients[pivot] == 0) {
+        pivot++;
+    }
+    if (pivot == k) {
+        return false;   //线性相关, 没有新信息
+    }
+
+    uchar normalize = Gf256::inv(coefficients[pivot]);
+    Gf256::scale(coefficients, normalize, k);
+    Gf256::scale(values, normalize, symbolSize);
+
+    //新主元列从其它行里消掉, 保持简化阶梯形
+    uchar *allRows = rows.data();
+    uchar *allData = reinterpret_cast<uchar *>(rowData.data());
+    for (int c = 0; c < k; c++) {
+        uchar factor = allRows[c * k + pivot];
+        if (factor && hasPivot.at(c)) {
+            Gf256::mulAdd(allRows + c * k, coefficients, factor, k);
+            Gf256::mulAdd(allData + c * symbolSize, values, factor, symbolSize);
+        }
+    }
+
+    memcpy(allRows + pivot * k, coefficients, k);
+    memcpy(allData + pivot * symbolSize, values, symbolSize);
+    hasPivot[pivot] = true;
+    rankValue++;
+    return true;
+}
+
+const uchar *FecDecoder::sourceSymbol(int index) const
+{
+    return reinterpret_cast<const uchar *>(rowData.constData()) + index * symbolSize;
+}
@@ -0,0 +1,76 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <QByteArray>
+#include <QVector>
+
+// GF(256) 运算, 本原多项式 x^8+x^4+x^3+x^2+1 (0x11D)
+// 乘法用256x256整表, 按块运算时每个字节一次查表
+namespace Gf256 {
+
+uchar mul(uchar a, uchar b);
+uchar inv(uchar a);
+
+// dst ^= coef * src
+void mulAdd(uchar *dst, const uchar *src, uchar coef, int size);
+// data *= coef
+void scale(uchar *data, uchar coef, int size);
+
+}
+
+// 系统Reed-Solomon纠删码 (Cauchy矩阵)
+// 一个源块K个等长符号, 编号0..K-1是源符号本身, K..K+127是校验符号;
+// 收到任意K个不同编号的符号就能恢复整个源块
+class FecEncoder
+{
+public:
+    static const int MaxSourceSymbols = 128;
+    static const int MaxRepairSymbols = 128;
+
+    // symbols: K个源符号首尾相接, 调用方保证在编码期间有效
+    void setBlock(const uchar *symbols, int sourceCount, int symbolSize);
+
+    int sourceCount() const { return k; }
+    int symbolCount() const { return k + MaxRepairSymbols; }
+
+    // 生成编号为id的符号, out至少symbolSize字节
+    void encode(int id, uchar *out) const;
+
+    // 第repair个校验符号里第source个源符号的系数 1/(x^y), x = 128+repair, y = source
+    static uchar coefficient(int repair, int source);
+
+private:
+    const uchar *source = nullptr;
+    int k = 0;
+    int symbolSize = 0;
+};
+
+// 增量高斯消元解码, 每收到一个符号消元一次, 秩够K时源符号直接可读
+class FecDecoder
+{
+public:
+    void reset(int sourceCount, int symbolSize);
+
+    // 返回true表示这个符号带来了新信息(秩加一)
+    bool addSymbol(int id, const uchar *data);
+
+    int rank() const { return rankValue; }
+    int sourceCount() const { return k; }
+    bool isDecoded() const { return k > 0 && rankValue == k; }
+
+    // 解码完成后第index个源符号
+    const uchar *sourceSymbol(int index) const;
+
+private:
+    int k = 0;
+    int symbolSize = 0;
+    int rankValue = 0;
+    QVector<uchar> rows;        // K x K 系数, 第c行是主元在第c列的行(简化阶梯形)
+    QByteArray rowData;         // K x symbolSize
+    QVector<bool> hasPivot;
+    QVector<bool> seen;         // 已收到的符号编号, 重复的直接丢
+    QVector<uchar> scratchCoefficients;
+    QByteArray scratchData;
+};
+
+#endif // FEC_H
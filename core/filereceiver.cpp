@@ -0,0 +1,738 @@
+#include "filereceiver.h"
+#include "deltacodec.h"
+#include "jpegscans.h"
+#include "linkengine.h"
+#include "linklog.h"
+#include "persweep.h"
+#include "transferprotocol.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+
+FileReceiver::FileReceiver(LinkEngine *link) : QObject(link), link(link), revertTimer(new QTimer(this))
+{
+    revertTimer->setSingleShot(true);
+    revertTimer->setInterval(Protocol::SwitchRevertMs);
+    connect(revertTimer, &QTimer::timeout, this, &FileReceiver::onRevertTimeout);
+}
+
+FileReceiver::~FileReceiver()
+{
+    closeOutput(false);
+}
+
+void FileReceiver::start(const ReceiveOptions &options)
+{
+    stop();
+
+    outputDir = options.outputDir.isEmpty() ? QDir::currentPath() : options.outputDir;
+    if (!QDir().mkpath(outputDir)) {
+        qWarning() << "cannot create" << outputDir;
+    }
+    journal = SessionJournal(QDir(outputDir).filePath(".sessions"));
+    journaled = false;
+    deltaCache = DeltaCache(QDir(outputDir).filePath(".delta"));
+    deltaSession = false;
+    stats = ReceiveStats();
+    session = Idle;
+    endedSession = Idle;
+    pendingSpreadingFactor = 0;
+    previousSpreadingFactor = 0;
+    retunePending = false;
+    retuned = false;
+    running = true;
+    elapsed.start();
+    lastReport.start();
+
+    //一直收, 回包时不用退出接收
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=65533\r\n"));
+    reportProgress(true);
+}
+
+void FileReceiver::stop()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    revertTimer->stop();
+    closeOutput(false);
+    session = Idle;
+    if (retuned) {
+        retuned = false;
+        link->writeConfig(retuneHome);
+    }
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=0\r\n"));
+    emit finished();
+}
+
+void FileReceiver::handleEvent(const AtEvent &event)
+{
+    if (!running) {
+        return;
+    }
+
+    if (event.type == AtEvent::TxDone) {
+        if (retunePending) {
+            retunePending = false;
+            if (!retuned) {
+                retuneHome = link->radioConfig();
+                retuned = true;
+            }
+            applyConfig(retuneConfig);
+            if (PerSweep::sameRadio(retuneConfig, retuneHome)) {
+                retuned = false;
+                revertTimer->stop();
+            } else {
+                revertTimer->start();
+            }
+            return;
+        }
+        //切换包的SACK已经发出去了, 这时候再改参数
+        if (pendingSpreadingFactor != 0) {
+            int spreadingFactor = pendingSpreadingFactor;
+            pendingSpreadingFactor = 0;
+            previousSpreadingFactor = link->radioConfig().spreadingFactor;
+            applySpreadingFactor(spreadingFactor);
+            revertTimer->start();
+        }
+        return;
+    }
+
+    //ACK/SACK/FEC状态是发给发送端的, 接收端只管数据
+    const uchar *p = event.payload;
+    bool isReply = event.payloadSize >= 3 && p[0] == 0x55 && p[1] == 0xAA && p[2] >= 0x55 && p[2] <= 0x59;
+    if (event.type == AtEvent::RxP2P && event.payloadSize > 0 && !isReply) {
+        //扫参时一直看着, 多久收不到包就退回原参数
+        if (retuned) {
+            revertTimer->start();
+        } else {
+            revertTimer->stop();
+        }
+        receive(event.payload, event.payloadSize, event.rssi, event.snr);
+    }
+}
+
+void FileReceiver::receive(const uchar *payload, int size, int rssi, int snr)
+{
+    stats.packetsReceived++;
+    stats.rssi = rssi;
+    stats.snr = snr;
+
+    QByteArray packet = QByteArray::fromRawData(reinterpret_cast<const char *>(payload), size);
+    switch (Protocol::packetKind(packet)) {
+    case Protocol::StartKind:
+        receiveStart(packet, rssi, snr);
+        break;
+
+    case Protocol::SwitchKind:
+        receiveSwitch(packet, rssi, snr);
+        break;
+
+    case Protocol::RetuneKind:
+        receiveRetune(packet, rssi, snr);
+        break;
+
+    case Protocol::EndKind: {
+        //结束包的应答丢了会重发, 按刚结束的会话回同样的应答
+        Session ended = session != Idle ? session : endedSession;
+        bool verified = session != Idle ? checked : endedChecked;
+        if (session == WindowSession && checked) {
+            //校验模式: 整个文件的CRC对不上就回要补的段, 会话不结束, 等发送端补完再发结束包
+            Protocol::Verdict verdict;
+            verdict.rssi = rssi;
+            verdict.snr = snr;
+            verdict.ranges = integrity.damagedRanges(mapped, fileSize);
+            reply(Protocol::verdictPacket(verdict));
+            if (!verdict.ranges.isEmpty()) {
+                stats.repairRounds++;
+                qCDebug(lcLink) << stats.fileName << "failed the integrity check," << verdict.ranges.size() << "ranges to repair";
+                //续传不能越过坏的段
+                segmentOffset = verdict.ranges.first().offset;
+                chunkCount = 0;
+                expectedIndex = 0;
+                chunkReceived.clear();
+                break;
+            }
+        } else if (verified && ended == WindowSession) {
+            reply(Protocol::verdictPacket(Protocol::Verdict()));
+        } else if (ended == WindowSession) {
+            sendSack(rssi, snr);
+        } else if (ended == FecSession) {
+            sendFecStatus(rssi, snr);
+        } else {
+            reply(Protocol::legacyAck(rssi, snr));
+        }
+        if (session != Idle) {
+            closeOutput(true);
+        }
+        endedSession = ended;
+        endedChecked = verified;
+        session = Idle;
+        break;
+    }
+
+    default:
+        if (session == FecSession && size > Protocol::FecHeaderSize && (payload[2] & Protocol::FlagFec)) {
+            receiveFecData(payload, size, rssi, snr);
+        } else if (session == WindowSession && size >= (checked ? Protocol::CheckedHeaderSize : Protocol::WindowHeaderSize)
+                   && (payload[2] & ~Protocol::FlagMask) == 0) {
+            receiveWindowData(payload, size, rssi, snr);
+        } else {
+            //停等协议的数据包和丢包率测试的包都回ACK
+            receiveLegacyData(payload, size, rssi, snr);
+        }
+        break;
+    }
+
+    reportProgress(false);
+}
+
+void FileReceiver::receiveStart(const QByteArray &payload, int rssi, int snr)
+{
+    Protocol::StartInfo start;
+    if (!Protocol::parseStart(payload, &start)) {
+        return;
+    }
+
+    //重发的开始包: 上一个应答丢了, 同一个文件不重新开始
+    bool resend = session != Idle && stats.fileName == start.fileName
+            && ((session == LegacySession && start.version == Protocol::VersionLegacy)
+                || (session == WindowSession && start.version == Protocol::VersionWindow && expectedIndex == 0
+                    && !journaled && !striped && !deltaSession)
+                || (session == WindowSession && start.version == Protocol::VersionStripe && striped
+                    && segmentOffset == 0 && expectedIndex == 0)
+                || (session == WindowSession && start.version == Protocol::VersionResume && expectedIndex == 0
+                    && journaled && record.id == start.sessionId)
+                || (session == WindowSession && start.version == Protocol::VersionDelta && expectedIndex == 0
+                    && deltaSession && deltaBaseHash == start.baseHash)
+                || (session == WindowSession && start.version == Protocol::VersionChecked && expectedIndex == 0
+                    && checked && integrity.fileCrc() == start.fileCrc)
+                || (session == FecSession && start.version == Protocol::VersionFec && fecDecoded == 0));
+    if (!resend) {
+        //批量传输的下一个文件不发结束包, 上一个收完了就按正常结束处理
+        closeOutput(sessionComplete());
+        session = Idle;
+        endedSession = Idle;
+        endedChecked = false;
+        checked = false;
+        stats.fileName = start.fileName;
+        stats.bytesReceived = 0;
+        stats.windowMode = false;
+        stats.fecMode = false;
+        stats.resumedFrom = 0;
+        stats.previewLayers = 0;
+        stats.checked = false;
+        journaled = false;
+        striped = false;
+        previewPath.clear();
+        previewScanned = 0;
+        previewScanner.reset();
+        elapsed.restart();
+
+        if ((start.version == Protocol::VersionResume || start.version == Protocol::VersionChecked) && start.mtu > 0) {
+            //日志里有同一个会话, 输出文件也还在, 就从已连续收到的地方续; 校验开始包的会话ID全0是不续传
+            bool wantResume = start.version == Protocol::VersionResume
+                    || start.sessionId != QByteArray(Protocol::SessionIdSize, '\0');
+            SessionRecord saved;
+            bool resume = wantResume && journal.load(start.sessionId, &saved) && saved.fileSize == start.fileSize
+                    && QFileInfo(outputPath(start.fileName)).size() == start.fileSize;
+            if (!openOutput(start.fileName, start.fileSize, resume)) {
+                return;
+            }
+            session = WindowSession;
+            stats.windowMode = true;
+            mtu = start.mtu;
+            segmentOffset = resume ? saved.offset : 0;
+            chunkCount = static_cast<quint32>((fileSize - segmentOffset + mtu - 1) / mtu);
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+            stats.resumedFrom = segmentOffset;
+            stats.bytesReceived = segmentOffset;
+            checked = start.version == Protocol::VersionChecked;
+            stats.checked = checked;
+            integrity.reset(start.fileCrc);
+
+            if (wantResume) {
+                record = SessionRecord();
+                record.id = start.sessionId;
+                record.fileName = start.fileName;
+                record.fileSize = start.fileSize;
+                record.window = start.window;
+                journaled = true;
+                saveJournal();
+            }
+        } else if (start.version == Protocol::VersionDelta && start.mtu > 0) {
+            //没有这个基准就回ACK, 发送端改发整个文件
+            if (!deltaCache.load(start.baseHash, &deltaBase)) {
+                qCDebug(lcLink) << "no delta base for" << start.fileName << ", asking for the whole file";
+                reply(Protocol::legacyAck(rssi, snr));
+                return;
+            }
+            if (!openOutput(start.fileName + ".delta", start.fileSize, false)) {
+                return;
+            }
+            session = WindowSession;
+            stats.windowMode = true;
+            mtu = start.mtu;
+            segmentOffset = 0;
+            chunkCount = static_cast<quint32>((fileSize + mtu - 1) / mtu);
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+            deltaSession = true;
+            deltaFileName = start.fileName;
+            deltaBaseHash = start.baseHash;
+            deltaTargetHash = start.targetHash;
+            deltaTargetSize = start.targetSize;
+        } else if (start.version == Protocol::VersionFec && start.mtu > 0 && start.window > 0
+                && start.window <= FecEncoder::MaxSourceSymbols) {
+            if (!openOutput(start.fileName, start.fileSize, false)) {
+                return;
+            }
+            session = FecSession;
+            stats.fecMode = true;
+            mtu = start.mtu;
+            fecBlockSize = start.window;
+            chunkCount = static_cast<quint32>((fileSize + mtu - 1) / mtu);
+            fecBlockCount = (chunkCount + fecBlockSize - 1) / fecBlockSize;
+            fecDecoded = 0;
+            fecReceived = 0;
+            startFecBlock();
+        } else if ((start.version == Protocol::VersionWindow || start.version == Protocol::VersionStripe)
+                && start.mtu > 0) {
+            //分条传输别的链路也在写这个文件, 不能截断
+            striped = start.version == Protocol::VersionStripe;
+            if (!openOutput(start.fileName, start.fileSize, striped)) {
+                return;
+            }
+            session = WindowSession;
+            stats.windowMode = true;
+            mtu = start.mtu;
+            segmentOffset = 0;
+            chunkCount = static_cast<quint32>((fileSize + mtu - 1) / mtu);
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+        } else {
+            if (!openOutput(start.fileName, -1, false)) {
+                return;
+            }
+            session = LegacySession;
+            lastLegacyIndex = -1;
+        }
+        qCDebug(lcLink) << "receiving" << start.fileName << start.fileSize << "bytes, version" << start.version;
+    }
+
+    if (session == FecSession) {
+        sendFecStatus(rssi, snr);
+    } else if (session == WindowSession && (journaled || checked)) {
+        Protocol::ResumeAck ack;
+        ack.rssi = rssi;
+        ack.snr = snr;
+        ack.offset = static_cast<quint32>(segmentOffset);
+        reply(Protocol::resumeAckPacket(ack));
+    } else if (session == WindowSession) {
+        sendSack(rssi, snr);
+    } else {
+        reply(Protocol::legacyAck(rssi, snr));
+    }
+}
+
+void FileReceiver::receiveSwitch(const QByteArray &payload, int rssi, int snr)
+{
+    Protocol::SwitchInfo change;
+    if (session != WindowSession || !Protocol::parseSwitch(payload, &change) || change.mtu <= 0
+            || change.offset > fileSize) {
+        return;
+    }
+
+    //偏移之前的都已确认, 之后的按新MTU重新编号, 重复的切换包结果一样
+    segmentOffset = change.offset;
+    mtu = change.mtu;
+    chunkCount = static_cast<quint32>((fileSize - segmentOffset + mtu - 1) / mtu);
+    expectedIndex = 0;
+    chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+    if (!striped) {
+        stats.bytesReceived = segmentOffset;
+    }
+    if (change.spreadingFactor != link->radioConfig().spreadingFactor) {
+        pendingSpreadingFactor = change.spreadingFactor;
+    }
+    sendSack(rssi, snr);
+}
+
+void FileReceiver::receiveRetune(const QByteArray &payload, int rssi, int snr)
+{
+    Protocol::RetuneInfo info;
+    if (!Protocol::parseRetune(payload, &info) || info.spreadingFactor < 5 || info.spreadingFactor > 12
+            || info.bandwidth <= 0) {
+        return;
+    }
+    //重发的调参包(上一个ACK丢了, 已经切过来了)只回ACK
+    RadioConfig config = PerSweep::retuned(link->radioConfig(), info);
+    if (!PerSweep::sameRadio(config, link->radioConfig())) {
+        retunePending = true;
+        retuneConfig = config;
+    }
+    reply(Protocol::legacyAck(rssi, snr));
+}
+
+void FileReceiver::receiveLegacyData(const uchar *payload, int size, int rssi, int snr)
+{
+    if (session == LegacySession && size > Protocol::LegacyHeaderSize) {
+        //重发的包序号不变, 不重复写
+        int index = payload[0];
+        if (index != lastLegacyIndex) {
+            int dataSize = size - Protocol::LegacyHeaderSize;
+            output.write(reinterpret_cast<const char *>(payload) + Protocol::LegacyHeaderSize, dataSize);
+            stats.bytesReceived += dataSize;
+            lastLegacyIndex = index;
+        } else {
+            stats.duplicates++;
+        }
+    }
+    reply(Protocol::legacyAck(rssi, snr));
+}
+
+void FileReceiver::receiveWindowData(const uchar *payload, int size, int rssi, int snr)
+{
+    quint16 seq = static_cast<quint16>((payload[0] << 8) | payload[1]);
+    quint8 flags = payload[2];
+
+    //16位序号按期望序号展开
+    qint32 delta = static_cast<qint16>(seq - static_cast<quint16>(expectedIndex & 0xFFFF));
+    qint64 index = qint64(expectedIndex) + delta;
+    const int headerSize = checked ? Protocol::CheckedHeaderSize : Protocol::WindowHeaderSize;
+    if (index >= 0 && index < chunkCount && !chunkReceived.at(static_cast<int>(index))) {
+        qint64 offset = segmentOffset + index * mtu;
+        int dataSize = static_cast<int>(qMin<qint64>(size - headerSize, fileSize - offset));
+        if (checked) {
+            //CRC对不上当没收到, SACK里不置位, 发送端只重发这一块
+            const uchar *c = payload + Protocol::WindowHeaderSize;
+            quint32 crc = (quint32(c[0]) << 24) | (quint32(c[1]) << 16) | (quint32(c[2]) << 8) | quint32(c[3]);
+            if (dataSize != size - headerSize || !integrity.addChunk(offset, payload + headerSize, dataSize, crc)) {
+                stats.crcErrors++;
+                if (flags & Protocol::FlagAckRequest) {
+                    sendSack(rssi, snr);
+                }
+                return;
+            }
+        }
+        if (dataSize > 0) {
+            memcpy(mapped + offset, payload + headerSize, dataSize);
+            stats.bytesReceived += dataSize;
+        }
+        chunkReceived[static_cast<int>(index)] = true;
+        while (expectedIndex < chunkCount && chunkReceived.at(static_cast<int>(expectedIndex))) {
+            expectedIndex++;
+        }
+    } else {
+        stats.duplicates++;
+    }
+
+    if (flags & Protocol::FlagAckRequest) {
+        sendSack(rssi, snr);
+    }
+}
+
+void FileReceiver::receiveFecData(const uchar *payload, int size, int rssi, int snr)
+{
+    quint16 block = static_cast<quint16>((payload[0] << 8) | payload[1]);
+    quint8 flags = payload[2];
+    int symbol = payload[3];
+    fecReceived++;
+
+    if (block == static_cast<quint16>(fecDecoded & 0xFFFF) && fecDecoded < fecBlockCount
+            && size - Protocol::FecHeaderSize == mtu) {
+        decoder.addSymbol(symbol, payload + Protocol::FecHeaderSize);
+        if (decoder.isDecoded()) {
+            //源符号写回文件, 末块补的0按文件大小截掉
+            qint64 blockOffset = qint64(fecDecoded) * fecBlockSize * mtu;
+            for (int i = 0; i < decoder.sourceCount(); i++) {
+                qint64 offset = blockOffset + qint64(i) * mtu;
+                int copy = static_cast<int>(qMin<qint64>(mtu, fileSize - offset));
+                if (copy > 0) {
+                    memcpy(mapped + offset, decoder.sourceSymbol(i), copy);
+                    stats.bytesReceived += copy;
+                }
+            }
+            fecDecoded++;
+            startFecBlock();
+        }
+    } else {
+        stats.duplicates++;
+    }
+
+    if (flags & Protocol::FlagAckRequest) {
+        sendFecStatus(rssi, snr);
+    }
+}
+
+void FileReceiver::startFecBlock()
+{
+    if (fecDecoded < fecBlockCount) {
+        int symbols = static_cast<int>(qMin<quint32>(fecBlockSize, chunkCount - fecDecoded * fecBlockSize));
+        decoder.reset(symbols, mtu);
+    }
+}
+
+void FileReceiver::reply(const QByteArray &payload)
+{
+    stats.repliesSent++;
+    link->sendPayload(payload);
+}
+
+void FileReceiver::sendSack(int rssi, int snr)
+{
+    Protocol::Sack sack;
+    sack.rssi = rssi;
+    sack.snr = snr;
+    sack.expectedSeq = static_cast<quint16>(expectedIndex & 0xFFFF);
+    for (int i = 0; i < 31; i++) {
+        quint32 index = expectedIndex + 1 + i;
+        if (index >= chunkCount) {
+            break;
+        }
+        if (chunkReceived.at(static_cast<int>(index))) {
+            sack.bitmap |= (1u << i);
+        }
+    }
+    reply(Protocol::sackPacket(sack));
+
+    if (journaled && journalTimer.elapsed() >= SessionJournal::SaveIntervalMs) {
+        saveJournal();
+    }
+}
+
+void FileReceiver::saveJournal()
+{
+    record.offset = qMin<qint64>(segmentOffset + qint64(expectedIndex) * mtu, fileSize);
+    record.mtu = mtu;
+    record.radio = link->radioConfig();
+    if (!journal.save(record)) {
+        qWarning() << "cannot write session journal in" << journal.directory();
+    }
+    journalTimer.restart();
+}
+
+void FileReceiver::sendFecStatus(int rssi, int snr)
+{
+    Protocol::FecStatus status;
+    status.rssi = rssi;
+    status.snr = snr;
+    status.decodedBlocks = static_cast<quint16>(fecDecoded & 0xFFFF);
+    status.rank = static_cast<quint8>(fecDecoded < fecBlockCount ? decoder.rank() : 0);
+    status.received = fecReceived;
+    reply(Protocol::fecStatusPacket(status));
+}
+
+void FileReceiver::applySpreadingFactor(int spreadingFactor)
+{
+    RadioConfig config = link->radioConfig();
+    config.spreadingFactor = spreadingFactor;
+    applyConfig(config);
+}
+
+void FileReceiver::applyConfig(const RadioConfig &config)
+{
+    link->writeConfig(config);
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=65533\r\n"));
+}
+
+void FileReceiver::onRevertTimeout()
+{
+    if (running && retuned) {
+        qCDebug(lcLink) << "no packet after retune, back to" << retuneHome.frequency << "SF" << retuneHome.spreadingFactor;
+        retuned = false;
+        applyConfig(retuneHome);
+        return;
+    }
+    //切换后一直没收到包, 发送端多半已经退回旧参数
+    if (running && previousSpreadingFactor != 0) {
+        qCDebug(lcLink) << "no packet after rate switch, back to SF" << previousSpreadingFactor;
+        applySpreadingFactor(previousSpreadingFactor);
+    }
+}
+
+QString FileReceiver::outputPath(const QString &fileName) const
+{
+    //只取文件名部分, 不让对端写到输出目录外面
+    QString name = QFileInfo(fileName).fileName();
+    if (name.isEmpty()) {
+        name = "received.bin";
+    }
+    return QDir(outputDir).filePath(name);
+}
+
+bool FileReceiver::openOutput(const QString &fileName, qint64 size, bool keep)
+{
+    output.setFileName(outputPath(fileName));
+    QIODevice::OpenMode mode = QIODevice::ReadWrite;
+    if (!keep) {
+        mode |= QIODevice::Truncate;
+    }
+    if (!output.open(mode)) {
+        qWarning() << "cannot write" << output.fileName() << output.errorString();
+        return false;
+    }
+
+    fileSize = size;
+    stats.fileSize = qMax<qint64>(size, 0);
+    if (size > 0) {
+        //先占好空间再映射, 块按偏移直接写进去
+        if (!output.resize(size) || !(mapped = output.map(0, size))) {
+            qWarning() << "cannot map" << output.fileName() << output.errorString();
+            output.close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileReceiver::sessionComplete() const
+{
+    if (session == WindowSession) {
+        return !striped && !checked && expectedIndex >= chunkCount;    // 校验模式只有结束包校验过才算收完
+    }
+    if (session == FecSession) {
+        return fecDecoded >= fecBlockCount;
+    }
+    return false;
+}
+
+void FileReceiver::closeOutput(bool complete)
+{
+    if (!output.isOpen()) {
+        return;
+    }
+    if (journaled) {
+        //没收完的留着下次续传, 收完了日志就没用了
+        if (complete) {
+            journal.remove(record.id);
+        } else {
+            saveJournal();
+        }
+        journaled = false;
+    }
+    if (mapped) {
+        output.unmap(mapped);
+        mapped = nullptr;
+    }
+    output.close();
+
+    QString path = output.fileName();
+    if (complete && deltaSession) {
+        path = rebuildFromDelta();
+        complete = !path.isEmpty();
+    } else if (complete && !striped) {
+        cacheReceived(path);
+    } else if (deltaSession) {
+        QFile::remove(path);    // 没收完的差量没用, 下次重新发
+    }
+    deltaSession = false;
+    deltaBase.clear();
+
+    if (complete && !previewPath.isEmpty()) {
+        QFile::remove(previewPath);     // 有整张图了
+    }
+    if (complete) {
+        stats.filesCompleted++;
+        qCDebug(lcLink) << "received" << path << stats.bytesReceived << "bytes";
+        reportProgress(true);
+        emit fileReceived(path);
+    }
+}
+
+QString FileReceiver::rebuildFromDelta()
+{
+    QFile deltaFile(output.fileName());
+    QByteArray delta;
+    if (deltaFile.open(QIODevice::ReadOnly)) {
+        delta = deltaFile.readAll();
+        deltaFile.close();
+    }
+    deltaFile.remove();
+
+    QByteArray target;
+    if (!DeltaCodec::apply(deltaBase, delta, &target) || target.size() != deltaTargetSize
+            || SessionJournal::sessionId(target) != deltaTargetHash) {
+        qWarning() << "cannot rebuild" << deltaFileName << "from its delta";
+        return QString();
+    }
+    QSaveFile file(outputPath(deltaFileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "cannot write" << file.fileName() << file.errorString();
+        return QString();
+    }
+    file.write(target);
+    if (!file.commit()) {
+        qWarning() << "cannot write" << file.fileName() << file.errorString();
+        return QString();
+    }
+    if (!deltaCache.store(QFileInfo(file.fileName()).fileName(), target, deltaTargetHash)) {
+        qWarning() << "cannot write delta cache in" << deltaCache.directory();
+    }
+    return file.fileName();
+}
+
+void FileReceiver::cacheReceived(const QString &path)
+{
+    //下次发送端可能拿它做基准发差量
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() > DeltaCache::MaxFileSize) {
+        return;
+    }
+    QByteArray data = file.readAll();
+    if (!deltaCache.store(QFileInfo(path).fileName(), data, SessionJournal::sessionId(data))) {
+        qWarning() << "cannot write delta cache in" << deltaCache.directory();
+    }
+}
+
+void FileReceiver::reportProgress(bool force)
+{
+    //按固定间隔报, 不每包都发信号
+    if (!force && lastReport.elapsed() < ProgressIntervalMs) {
+        return;
+    }
+    lastReport.restart();
+    updatePreview();
+    stats.elapsedMs = elapsed.elapsed();
+    emit progress(stats);
+}
+
+void FileReceiver::updatePreview()
+{
+    if (!mapped || deltaSession || striped) {
+        return;
+    }
+    qint64 contiguous = 0;
+    if (session == WindowSession) {
+        contiguous = qMin<qint64>(segmentOffset + qint64(expectedIndex) * mtu, fileSize);
+    } else if (session == FecSession) {
+        contiguous = qMin<qint64>(qint64(fecDecoded) * fecBlockSize * mtu, fileSize);
+    }
+    if (contiguous <= previewScanned || contiguous >= fileSize) {
+        return;
+    }
+    previewScanned = contiguous;
+
+    previewScanner.feed(reinterpret_cast<const char *>(mapped), contiguous);
+    const QVector<qint64> &ends = previewScanner.ends();
+    if (ends.size() <= stats.previewLayers) {
+        return;
+    }
+    QFileInfo info(output.fileName());
+    QSaveFile file(info.dir().filePath(info.completeBaseName() + ".preview.jpg"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(mapped), ends.last());
+    file.write("\xFF\xD9", 2);
+    if (!file.commit()) {
+        return;
+    }
+    previewPath = file.fileName();
+    stats.previewLayers = ends.size();
+    emit previewReady(previewPath, stats.previewLayers);
+}
@@ -0,0 +1,152 @@
+#ifndef FILERECEIVER_H
+#define FILERECEIVER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
+#include <QVector>
+#include "atparser.h"
+#include "deltacache.h"
+#include "fec.h"
+#include "integritycheck.h"
+#include "jpegscans.h"
+#include "linktypes.h"
+#include "sessionjournal.h"
+
+class LinkEngine;
+
+// 图传接收端, 和FileSender配对, 两台电脑各接一个模块就能对测
+// 模块一直开着接收(PRECV=65533), 收到+EVT:RXP2P按协议回ACK/SACK/FEC状态, rssi/snr填本端测到的值;
+// 窗口和纠删码协议的开始包带文件大小, 输出文件先占好空间再映射到内存, 乱序的块直接拷到对应位置,
+// 文件多大接收每包的开销都一样; 停等协议不知道大小, 按顺序追加写
+// 分条开始包不截断输出文件, 几个接收端(各接一个模块, 不同频点)可以写同一个文件
+// 扫参的调参包回ACK后切到包里的射频参数, 一段时间收不到包就退回第一次调参前的参数
+// 续传开始包按会话ID找日志, 回已连续收到的偏移, 没收完的文件接着写
+// 收完的文件存进输出目录下的差量缓存, 差量开始包按基准哈希找, 差量收完重建出文件
+// 校验开始包: 每块的CRC32C对不上就当没收到, 结束包到了按整个文件的CRC校验, 对不上回要补的段, 会话不结束
+// JPEG连续收到的部分每多一个完整扫描就写一张 名字.preview.jpg, 渐进式JPEG第一个扫描到了就能看
+class FileReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int ProgressIntervalMs = 100;
+
+    explicit FileReceiver(LinkEngine *link);
+    ~FileReceiver();
+
+    bool isRunning() const { return running; }
+    void start(const ReceiveOptions &options);
+    void stop();
+    void handleEvent(const AtEvent &event);
+
+signals:
+    void progress(const ReceiveStats &stats);
+    void fileReceived(const QString &path);
+    void previewReady(const QString &path, int layers);
+    void finished();
+
+private slots:
+    void onRevertTimeout();
+
+private:
+    enum Session {
+        Idle,
+        LegacySession,
+        WindowSession,
+        FecSession
+    };
+
+    void receive(const uchar *payload, int size, int rssi, int snr);
+    void receiveStart(const QByteArray &payload, int rssi, int snr);
+    void receiveSwitch(const QByteArray &payload, int rssi, int snr);
+    void receiveRetune(const QByteArray &payload, int rssi, int snr);
+    void receiveLegacyData(const uchar *payload, int size, int rssi, int snr);
+    void receiveWindowData(const uchar *payload, int size, int rssi, int snr);
+    void receiveFecData(const uchar *payload, int size, int rssi, int snr);
+    void startFecBlock();
+    void reply(const QByteArray &payload);
+    void sendSack(int rssi, int snr);
+    void sendFecStatus(int rssi, int snr);
+    void applySpreadingFactor(int spreadingFactor);
+    void applyConfig(const RadioConfig &config);
+
+    QString outputPath(const QString &fileName) const;
+    bool openOutput(const QString &fileName, qint64 size, bool keep);
+    void saveJournal();
+    bool sessionComplete() const;
+    void closeOutput(bool complete);
+    QString rebuildFromDelta();
+    void cacheReceived(const QString &path);
+    void reportProgress(bool force);
+    void updatePreview();
+
+    LinkEngine *link;
+    bool running = false;
+    QString outputDir;
+    Session session = Idle;
+    Session endedSession = Idle;    // 刚收完的会话, 重发的结束包按它回应答
+    bool endedChecked = false;
+    ReceiveStats stats;
+    QElapsedTimer elapsed;
+    QElapsedTimer lastReport;
+
+    //输出文件
+    QFile output;
+    uchar *mapped = nullptr;    // 窗口/纠删码协议: 整个文件的映射
+    qint64 fileSize = 0;
+    int lastLegacyIndex = -1;
+
+    //窗口协议
+    int mtu = 0;
+    qint64 segmentOffset = 0;   // 块号0对应的文件偏移, 切换参数后从这里重新编号
+    quint32 chunkCount = 0;
+    quint32 expectedIndex = 0;
+    QVector<bool> chunkReceived;
+    bool striped = false;       // 分条传输: 只收分到这条链路的几段, 段之间用切换包跳
+
+    //续传: 会话ID和已连续收到的偏移写到输出目录下的日志, 没收完的文件保留
+    SessionJournal journal;
+    SessionRecord record;
+    bool journaled = false;
+    QElapsedTimer journalTimer;
+
+    //校验模式
+    bool checked = false;
+    IntegrityCheck integrity;
+
+    //差量传输: 差量按窗口协议收到 文件名.delta, 收完用缓存里的基准重建并校验哈希
+    DeltaCache deltaCache;
+    bool deltaSession = false;
+    QString deltaFileName;
+    QByteArray deltaBase;
+    QByteArray deltaBaseHash;
+    QByteArray deltaTargetHash;
+    qint64 deltaTargetSize = 0;
+
+    //预览: 连续收到的部分按扫描截出来补上EOI
+    QString previewPath;
+    qint64 previewScanned = 0;      // 上次看到的连续长度, 没变就不再解析
+    JpegScans::Scanner previewScanner;  // 只解析新接上的连续部分
+
+    //自适应速率: 回完切换包的SACK(TX DONE)才切SF, 新参数上收不到包就退回
+    int pendingSpreadingFactor = 0;
+    int previousSpreadingFactor = 0;
+    QTimer *revertTimer;
+
+    //扫参: 回完调参包的ACK再切, 原参数一直记着, 切回原参数为止
+    bool retunePending = false;
+    RadioConfig retuneConfig;
+    bool retuned = false;
+    RadioConfig retuneHome;
+
+    //纠删码协议
+    int fecBlockSize = 0;
+    quint32 fecBlockCount = 0;
+    quint32 fecDecoded = 0;
+    quint8 fecReceived = 0;
+    FecDecoder decoder;
+};
+
+#endif // FILERECEIVER_H
@@ -0,0 +1,1014 @@
+#include "filesender.h"
+#include "deltacodec.h"
+#include "integritycheck.h"
+#include "jpegscans.h"
+#include "linkengine.h"
+#include "linklog.h"
+#include "transferprotocol.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QtMath>
+#include <cstring>
+
+FileSender::FileSender(LinkEngine *link) : QObject(link), link(link), timeoutTimer(new QTimer(this))
+{
+    timeoutTimer->setSingleShot(true);
+    connect(timeoutTimer, &QTimer::timeout, this, &FileSender::onTimeout);
+}
+
+void FileSender::start(const TransferOptions &options, StripeQueue *queue)
+{
+    stop();
+
+    //打开文件, 普通文件映射到内存; 分条传输时每条链路各自映射同一个文件
+    QString error;
+    QSharedPointer<ChunkSource> source = ChunkSource::open(options.filePath, &error);
+    if (!source) {
+        emit finished(false, options.filePath + " open failed: " + error);
+        return;
+    }
+    begin(options, source, queue);
+}
+
+void FileSender::start(const TransferOptions &options, const QSharedPointer<ChunkSource> &source)
+{
+    stop();
+    begin(options, source, nullptr);
+}
+
+void FileSender::begin(const TransferOptions &options, const QSharedPointer<ChunkSource> &source, StripeQueue *queue)
+{
+    if (options.mtu <= 0 || options.mtu > AtFramer::MaxMtu) {
+        emit finished(false, "Invalid MTU: " + QString::number(options.mtu) + " (1-" + QString::number(AtFramer::MaxMtu) + ")");
+        return;
+    }
+    if (queue && source->size() != queue->size()) {
+        emit finished(false, options.filePath + " changed size during the striped transfer");
+        return;
+    }
+
+    this->source = source;
+    fileSize = source->size();
+    chained = options.chained;
+    currentFileName = QFileInfo(options.filePath).fileName();
+    layerEnds.clear();
+    if (!queue) {
+        prepareLayers(options.layers);
+    }
+    mtu = options.mtu;
+    offset = 0;
+    currentPacketIndex = 0;
+    retryCount = 0;
+    stats = TransferStats();
+    stats.fileSize = fileSize;
+    stats.layers = layerEnds.size();
+
+    //打开串口的接收模式
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=0\r\n"));
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=65533\r\n"));
+
+    // 窗口大于1或者开了纠删码时先用v2开始包协商, 老固件回55AA55再退回停等协议
+    // 分条只走窗口协议, 段是从队列取的, 不续传也不自适应
+    if (stripe) {
+        disconnect(stripe, nullptr, this, nullptr);
+    }
+    stripe = queue;
+    hasPiece = false;
+    stripeIdle = false;
+    stripeDone = 0;
+    windowMode = false;
+    fecMode = false;
+    negotiatingFec = !stripe && options.fecBlock > 0;
+    negotiatingWindow = stripe || (!negotiatingFec && options.window > 1);
+    if (fileSize > MaxSizedFile) {
+        //开始包的文件大小只有32位, 更大的文件只能走不带大小的停等协议
+        negotiatingFec = false;
+        negotiatingWindow = false;
+        if (stripe) {
+            emit finished(false, options.filePath + " is too large to stripe");
+            return;
+        }
+    }
+    if (negotiatingFec) {
+        //块太多FEC的块号会回绕, 已解码块数永远到不了块数, 这种文件退回窗口协议
+        qint64 chunks = (fileSize + mtu - 1) / mtu;
+        int blockSize = qBound(1, options.fecBlock, FecEncoder::MaxSourceSymbols);
+        if ((chunks + blockSize - 1) / blockSize > qint64(Protocol::MaxFecBlocks)) {
+            negotiatingFec = false;
+            negotiatingWindow = options.window > 1;
+        }
+    }
+    if (!stripe && options.adaptive && negotiatingWindow) {
+        mtu = qMin(mtu, MaxAdaptiveMtu);    //自适应从上限以内的MTU开始, 之后也不会涨过上限
+    }
+    segmentOffset = 0;
+    segmentEnd = fileSize;
+    if (stripe) {
+        sendWindow.reset(0, qMax(1, options.window));   //开始包回应后再取第一段
+        connect(stripe, &StripeQueue::changed, this, &FileSender::onStripeChanged);
+    } else if (negotiatingWindow) {
+        sendWindow.reset(static_cast<quint32>((fileSize + mtu - 1) / mtu), options.window);
+    }
+    negotiatingResume = !stripe && options.resume && negotiatingWindow;
+    session = SessionRecord();
+    if (negotiatingResume || (options.delta && negotiatingWindow && !stripe)) {
+        //只有续传和差量用得到, 要哈希整个文件; 分层后this->source已换成截断的前缀, 按实际发送的内容算
+        session.id = SessionJournal::sessionId(this->source.data());
+    }
+    session.fileName = currentFileName;
+    session.fileSize = fileSize;
+    session.mtu = mtu;
+    session.window = options.window;
+    session.radio = link->radioConfig();
+    journalTimer.invalidate();
+    resumeWanted = negotiatingResume;
+    checked = false;
+    checkedWanted = options.checked && negotiatingWindow && !stripe && IntegrityCheck::fileCrc(this->source.data(), &fileCrc);
+    negotiatingChecked = checkedWanted;
+    repairRanges.clear();
+    repairRounds = 0;
+    negotiatingDelta = false;
+    deltaTarget.clear();
+    fullSource.clear();
+    if (options.delta && negotiatingWindow && !stripe) {
+        prepareDelta(options);
+    }
+    if (negotiatingResume) {
+        SessionRecord saved;
+        if (journal.load(session.id, &saved)) {
+            qCDebug(lcLink) << "journal has" << saved.fileName << saved.offset << "of" << saved.fileSize
+                     << "bytes acked, MTU" << saved.mtu << "SF" << saved.radio.spreadingFactor;
+        }
+    }
+    adaptive = !stripe && options.adaptive && negotiatingWindow;
+    if (adaptive || stripe || negotiatingChecked) {
+        RateController::Choice choice;
+        choice.spreadingFactor = link->radioConfig().spreadingFactor;
+        choice.mtu = mtu;
+        rate.reset(choice, adaptive ? MaxAdaptiveMtu : mtu);
+    }
+    if (negotiatingFec) {
+        fecBlockSize = qBound(1, options.fecBlock, FecEncoder::MaxSourceSymbols);
+        quint32 chunks = static_cast<quint32>((fileSize + mtu - 1) / mtu);
+        fecBlockCount = (chunks + fecBlockSize - 1) / fecBlockSize;
+        fecBlock = 0;
+        fecDecoded = 0;
+        fecRank = 0;
+        fecSentSinceStatus = 0;
+        lossEstimate = 0;
+        fecSource.clear();
+    }
+
+    running = true;
+    elapsed.start();
+    sendStartPacket();
+}
+
+void FileSender::stop()
+{
+    if (running && windowMode && resumeWanted) {
+        saveJournal();
+    }
+    if (running) {
+        returnStripePiece();
+    }
+    timeoutTimer->stop();
+    running = false;
+    txPending = false;
+    replyDeferred = false;
+    packetType = NotStarted;
+    source.clear();
+    fullSource.clear();
+    deltaTarget.clear();
+    burst.clear();
+    burstPos = 0;
+    fecSource.clear();
+}
+
+void FileSender::handleEvent(const AtEvent &event)
+{
+    if (!running) {
+        return;
+    }
+
+    switch (event.type) {
+    case AtEvent::TxDone:
+        onTxDone();
+        break;
+    case AtEvent::Ack:
+        onAck();
+        break;
+    case AtEvent::Sack:
+        onSack(event);
+        break;
+    case AtEvent::FecStatus:
+        onFecStatus(event);
+        break;
+    case AtEvent::ResumeAck:
+        onResumeAck(event);
+        break;
+    case AtEvent::Verdict:
+        onVerdict(event);
+        break;
+    default:
+        break;
+    }
+}
+
+void FileSender::transmit(const TxFrame &frame)
+{
+    if (frame.size > 0 && !frame.data) {
+        finish(false, currentFileName + " read failed at offset " + QString::number(offset));
+        return;
+    }
+    lastFrame = frame;
+    if (!link->sendFrame(frame)) {
+        //模块单包放不下(比如文件名太长的开始包)或者串口已关, 等TX DONE超时重试没有意义
+        int length = frame.headerSize + frame.size;
+        finish(false, length > AtFramer::MaxPayloadSize
+               ? "Packet of " + QString::number(length) + " bytes exceeds the " + QString::number(AtFramer::MaxPayloadSize) + "-byte module limit"
+               : QString("Serial port is not open"));
+        return;
+    }
+    txPending = true;
+    replyTimer.start();
+    rttValid = (retryCount == 0);
+
+    //TX DONE迟迟不来也要能超时重试
+    timeoutTimer->start(link->rto()->txDoneTimeout(frame.headerSize + frame.size));
+}
+
+void FileSender::transmitControl(const QByteArray &packet)
+{
+    controlPacket = packet;
+    transmit(TxFrame::fromPayload(controlPacket));
+}
+
+void FileSender::onTxDone()
+{
+    if (!txPending) {
+        return;
+    }
+    txPending = false;
+
+    if (packetType == EndPacket && !checked) {
+        finish(true, "The file has been successfully sent!");
+        return;
+    }
+
+    if (packetType == DataPacket && (windowMode || fecMode) && burstPos < burst.size()) {
+        sendBurstFrame();
+        return;
+    }
+
+    if (replyDeferred) {
+        replyDeferred = false;
+        handleReply();
+        return;
+    }
+
+    //等txdone  再启动超时
+    rttTimer.start();
+    timeoutTimer->start(link->rto()->replyTimeout(expectedReplySize()));
+}
+
+void FileSender::onAck()
+{
+    if (windowMode || fecMode) {
+        return;     //v2对端只回SACK/FEC状态
+    }
+    reportLatency();
+    sampleRtt();
+    if (txPending) {
+        replyDeferred = true;   //本包还没发完, 等TX DONE再处理, 不在模块射频忙的时候写命令
+        return;
+    }
+    handleReply();
+}
+
+void FileSender::onSack(const AtEvent &event)
+{
+    if (packetType == StartPacket && negotiatingWindow) {
+        if (event.expectedSeq != 0 || event.bitmap != 0) {
+            return;     //被打断的上一个文件迟到的SACK, 新会话的开始包只会回全0
+        }
+        //对端支持窗口协议; 差量开始包回SACK说明对端有基准, 发的就是差量
+        if (negotiatingDelta) {
+            negotiatingDelta = false;
+            stats.fileSize = fileSize;
+            stats.deltaTargetSize = deltaTarget.size();
+            session.id.clear();     // 差量不续传
+            qCDebug(lcLink) << "sending" << currentFileName << "as a" << fileSize << "byte delta of" << deltaTarget.size() << "bytes";
+        }
+        negotiatingWindow = false;
+        negotiatingChecked = false;     // 回SACK的对端不校验
+        windowMode = true;
+        stats.windowMode = true;
+    } else if (packetType == DataPacket && windowMode) {
+        int acked = sendWindow.applySack(event.expectedSeq, event.bitmap);
+        stats.ackReceived += acked;
+        offset = qMin(segmentOffset + qint64(sendWindow.base()) * mtu, segmentEnd);
+
+        if (txPending || burstPos < burst.size()) {
+            return;     //迟到的SACK 只更新窗口, 等本轮突发的SACK
+        }
+        if (adaptive) {
+            rate.addBurst(burst.size(), acked, event.snr);
+        }
+    } else if (packetType == SwitchPacket) {
+        if (event.expectedSeq != 0 || event.bitmap != 0) {
+            return;     //切换前突发的迟到SACK, 对端切换后是从0重新编号的
+        }
+    } else {
+        return;
+    }
+
+    reportLatency();
+    sampleRtt();
+    if (txPending) {
+        replyDeferred = true;
+        return;
+    }
+    handleReply();
+}
+
+void FileSender::onFecStatus(const AtEvent &event)
+{
+    if (packetType == StartPacket && negotiatingFec) {
+        negotiatingFec = false;
+        fecMode = true;
+        stats.fecMode = true;
+        fecReceived = event.received;
+    } else if (packetType == DataPacket && fecMode) {
+        if (txPending || burstPos < burst.size()) {
+            return;     //迟到的状态, 等本轮突发的
+        }
+
+        //本轮发出的符号里对端收到了多少, 平滑后用来决定下一轮的冗余
+        int received = static_cast<quint8>(event.received - fecReceived);
+        fecReceived = event.received;
+        if (fecSentSinceStatus > 0) {
+            double loss = 1.0 - qMin(1.0, double(received) / fecSentSinceStatus);
+            lossEstimate = 0.75 * lossEstimate + 0.25 * loss;
+            stats.lossRate = lossEstimate;
+        }
+        fecSentSinceStatus = 0;
+
+        stats.ackReceived++;
+        fecDecoded = event.decodedBlocks;
+        fecRank = event.rank;
+        offset = qMin(qint64(fecDecoded) * fecBlockSize * mtu, fileSize);
+    } else {
+        return;
+    }
+
+    reportLatency();
+    sampleRtt();
+    if (txPending) {
+        replyDeferred = true;
+        return;
+    }
+    handleReply();
+}
+
+void FileSender::onResumeAck(const AtEvent &event)
+{
+    if (packetType != StartPacket || !(negotiatingResume || negotiatingChecked)) {
+        return;
+    }
+
+    //对端已有的部分不再发, 从它给的偏移开始按窗口协议重新编号; 校验开始包也回这个
+    checked = negotiatingChecked;
+    stats.checked = checked;
+    negotiatingChecked = false;
+    negotiatingResume = false;
+    negotiatingWindow = false;
+    windowMode = true;
+    stats.windowMode = true;
+    segmentOffset = qMin<qint64>(event.offset, fileSize);
+    offset = segmentOffset;
+    stats.resumedFrom = segmentOffset;
+    sendWindow.reset(static_cast<quint32>((fileSize - segmentOffset + mtu - 1) / mtu), sendWindow.windowSize());
+    if (segmentOffset > 0) {
+        qCDebug(lcLink) << "resuming" << currentFileName << "at" << segmentOffset << "of" << fileSize;
+    }
+    if (resumeWanted) {
+        journalTimer.start();
+        saveJournal();
+    }
+
+    reportLatency();
+    sampleRtt();
+    if (txPending) {
+        replyDeferred = true;
+        return;
+    }
+    handleReply();
+}
+
+void FileSender::onVerdict(const AtEvent &event)
+{
+    Protocol::Verdict verdict;
+    if (packetType != EndPacket || !checked || !Protocol::parseVerdict(event.payload, event.payloadSize, &verdict)) {
+        return;
+    }
+    repairRanges = verdict.ranges;
+
+    reportLatency();
+    sampleRtt();
+    if (txPending) {
+        replyDeferred = true;
+        return;
+    }
+    handleReply();
+}
+
+void FileSender::reportLatency()
+{
+    emit replyLatency(replyTimer.nsecsElapsed() / 1000000.0);
+}
+
+void FileSender::sampleRtt()
+{
+    //TX DONE之前就到的应答没法算RTT
+    if (rttValid && !txPending) {
+        link->rto()->addSample(rttTimer.nsecsElapsed() / 1000000.0);
+    }
+    rttValid = false;
+}
+
+int FileSender::expectedReplySize() const
+{
+    if (negotiatingResume || negotiatingChecked) {
+        return Protocol::ResumeAckSize;
+    }
+    if (checked && packetType == EndPacket) {
+        return Protocol::VerdictSize + 8 * Protocol::MaxRepairRanges;
+    }
+    if (fecMode || negotiatingFec) {
+        return Protocol::FecStatusSize;
+    }
+    if (windowMode || negotiatingWindow) {
+        return Protocol::SackSize;
+    }
+    return Protocol::LegacyAckSize;
+}
+
+void FileSender::handleReply()
+{
+    retryCount = 0;
+    timeoutTimer->stop();
+
+    if (windowMode) {
+        if (packetType == EndPacket) {
+            //校验模式的结论: 没有要补的段就是对端整个文件校验过了
+            if (repairRanges.isEmpty()) {
+                finish(true, "The file has been successfully sent and verified!");
+            } else if (repairRounds >= MaxRepairRounds) {
+                finish(false, currentFileName + " still fails the integrity check after "
+                       + QString::number(repairRounds) + " repairs");
+            } else {
+                repairRounds++;
+                stats.repairRounds = repairRounds;
+                nextRepairRange();
+            }
+            return;
+        }
+        if (packetType == SwitchPacket) {
+            finishSwitch();     //对端已收到切换包, 回完这个SACK就切到新参数
+        }
+        if (sendWindow.isComplete() && stripe) {
+            nextStripePiece();
+        } else if (sendWindow.isComplete() && !repairRanges.isEmpty()) {
+            nextRepairRange();
+        } else if (sendWindow.isComplete()) {
+            endSession();
+        } else if (adaptive && packetType == DataPacket && rate.propose(&pendingChoice)) {
+            startSwitch(offset);
+        } else {
+            sendWindowBurst();
+        }
+        return;
+    }
+
+    if (fecMode) {
+        if (fecDecoded >= fecBlockCount) {
+            endSession();
+        } else {
+            sendFecBurst();
+        }
+        return;
+    }
+
+    if (packetType == StartPacket && negotiatingDelta) {
+        //对端没有基准或者不认识差量开始包, 整个文件发
+        qCDebug(lcLink) << "peer has no base for" << currentFileName << ", sending the whole file";
+        abandonDelta();
+        sendStartPacket();
+    } else if (packetType == StartPacket && negotiatingChecked) {
+        //对端不认识校验开始包, 不带CRC发
+        qCDebug(lcLink) << "peer does not support checked transfers, sending without CRCs";
+        negotiatingChecked = false;
+        sendStartPacket();
+    } else if (packetType == StartPacket && negotiatingResume) {
+        //对端不认识续传开始包, 改发普通窗口开始包
+        qCDebug(lcLink) << "peer does not support resume, sending a plain window start packet";
+        negotiatingResume = false;
+        sendStartPacket();
+    } else if (packetType == StartPacket && (negotiatingWindow || negotiatingFec)) {
+        //老固件不认识v2开始包, 退回停等协议重新发开始包
+        qCDebug(lcLink) << "peer does not support v2 start packet, fall back to stop-and-wait";
+        negotiatingWindow = false;
+        negotiatingFec = false;
+        sendStartPacket();
+    } else if (packetType == StartPacket) {
+        sendChunk();
+    } else if (packetType == DataPacket) {
+        // 成功确认，继续发送下一块数据
+        offset += currentChunkSize;
+        stats.ackReceived++;
+        if (offset < fileSize) {
+            sendChunk();
+        } else {
+            //发送结尾包
+            sendEndPacket();
+        }
+    }
+}
+
+void FileSender::onTimeout()
+{
+    retryCount++;
+    stats.retries++;
+    link->rto()->backoff();
+    qCDebug(lcLink) << "Timeout reached, retry count: " << retryCount;
+
+    if (retryCount > MaxRetries) {
+        finish(false, "Transmission failed after " + QString::number(MaxRetries) + " retries.");
+        return;
+    }
+
+    link->tracer()->onRetransmit();
+    txPending = false;
+    replyDeferred = false;
+
+    if (packetType == StartPacket && negotiatingDelta && retryCount >= ResumeRetries) {
+        abandonDelta();
+        sendStartPacket();
+    } else if (packetType == StartPacket && negotiatingChecked && retryCount >= ResumeRetries) {
+        negotiatingChecked = false;
+        sendStartPacket();
+    } else if (packetType == StartPacket && negotiatingResume && retryCount >= ResumeRetries) {
+        negotiatingResume = false;
+        sendStartPacket();
+    } else if (packetType == SwitchPacket && adaptive) {
+        //切换包的应答丢了的话对端可能已经切过去了, 先用新参数试, 再不行就都退回旧参数
+        switchAttempts++;
+        if (switchAttempts == SwitchRetries) {
+            switchApplied = true;
+            applySpreadingFactor(pendingChoice.spreadingFactor);
+        } else if (switchAttempts >= 2 * SwitchRetries) {
+            abandonSwitch();
+            return;
+        }
+        transmit(lastFrame);
+    } else if (packetType == DataPacket && windowMode) {
+        //没等到SACK 重发最小的未确认块探测一下对端状态
+        burst.clear();
+        burstPos = 0;
+        stats.packetsSent++;
+        transmit(windowFrame(sendWindow.base(), Protocol::FlagAckRequest));
+    } else if (packetType == DataPacket && fecMode) {
+        //没等到状态 多发一个校验符号顺便要应答
+        burst.clear();
+        burstPos = 0;
+        stats.packetsSent++;
+        fecSentSinceStatus++;
+        transmit(fecFrame(nextFecSymbol(), Protocol::FlagAckRequest));
+    } else {
+        if (packetType == DataPacket) {
+            stats.packetsSent++;
+        }
+        transmit(lastFrame);
+    }
+}
+
+void FileSender::sendStartPacket()
+{
+    packetType = StartPacket;
+    if (negotiatingDelta) {
+        transmitControl(Protocol::deltaStartPacket(currentFileName, sendWindow.windowSize(), mtu, static_cast<quint32>(fileSize),
+                                                   deltaBaseHash, deltaTargetHash, static_cast<quint32>(deltaTarget.size())));
+    } else if (negotiatingChecked) {
+        transmitControl(Protocol::checkedStartPacket(currentFileName, sendWindow.windowSize(), mtu, static_cast<quint32>(fileSize),
+                                                     negotiatingResume ? session.id : QByteArray(), fileCrc));
+    } else if (negotiatingResume) {
+        transmitControl(Protocol::resumeStartPacket(currentFileName, sendWindow.windowSize(), mtu, static_cast<quint32>(fileSize), session.id));
+    } else if (negotiatingFec) {
+        transmitControl(Protocol::fecStartPacket(currentFileName, fecBlockSize, mtu, static_cast<quint32>(fileSize)));
+    } else if (negotiatingWindow && stripe) {
+        transmitControl(Protocol::stripeStartPacket(currentFileName, sendWindow.windowSize(), mtu, static_cast<quint32>(fileSize)));
+    } else if (negotiatingWindow) {
+        transmitControl(Protocol::windowStartPacket(currentFileName, sendWindow.windowSize(), mtu, static_cast<quint32>(fileSize)));
+    } else {
+        transmitControl(Protocol::legacyStartPacket(currentFileName));
+    }
+}
+
+void FileSender::sendChunk()
+{
+    packetType = DataPacket;
+    currentChunkSize = static_cast<int>(qMin<qint64>(mtu, fileSize - offset));
+    currentPacketIndex++;
+
+    TxFrame frame;
+    frame.header[0] = currentPacketIndex;
+    frame.headerSize = Protocol::LegacyHeaderSize;
+    frame.data = source->chunk(offset, currentChunkSize);
+    frame.size = currentChunkSize;
+
+    stats.packetsSent++;
+    transmit(frame);
+    reportProgress();
+}
+
+// 窗口模式: 一轮突发发送窗口内的重传块和新块, 最后一包带请求应答标志, 然后等SACK
+void FileSender::sendWindowBurst()
+{
+    packetType = DataPacket;
+    burst = sendWindow.nextBurst();
+    burstPos = 0;
+    if (burst.isEmpty()) {
+        timeoutTimer->start(link->rto()->replyTimeout(expectedReplySize()));
+        return;
+    }
+    sendBurstFrame();
+    reportProgress();
+}
+
+void FileSender::sendBurstFrame()
+{
+    quint32 index = burst.at(burstPos++);
+    quint8 flags = (burstPos == burst.size()) ? Protocol::FlagAckRequest : 0;
+    stats.packetsSent++;
+    if (fecMode) {
+        fecSentSinceStatus++;
+        transmit(fecFrame(static_cast<int>(index), flags));
+    } else {
+        transmit(windowFrame(index, flags));
+    }
+
+    //这一轮后面还有包: 趁这包在空口上先把下一包写到模块
+    if (running && link->uartPrefetch() && burstPos < burst.size()) {
+        quint32 next = burst.at(burstPos);
+        quint8 nextFlags = (burstPos + 1 == burst.size()) ? Protocol::FlagAckRequest : 0;
+        link->prefetchFrame(fecMode ? fecFrame(static_cast<int>(next), nextFlags) : windowFrame(next, nextFlags));
+    }
+}
+
+TxFrame FileSender::windowFrame(quint32 index, quint8 flags)
+{
+    qint64 chunkOffset = segmentOffset + qint64(index) * mtu;
+
+    TxFrame frame;
+    frame.size = static_cast<int>(qMin<qint64>(mtu, segmentEnd - chunkOffset));
+    frame.data = source->chunk(chunkOffset, frame.size);
+    if (checked && frame.data) {
+        quint32 crc = Protocol::chunkCrc(static_cast<quint32>(chunkOffset), reinterpret_cast<const uchar *>(frame.data), frame.size);
+        frame.headerSize = Protocol::writeCheckedDataHeader(frame.header, SlidingWindow::seqOf(index), flags, crc);
+    } else {
+        frame.headerSize = Protocol::writeWindowDataHeader(frame.header, SlidingWindow::seqOf(index), flags);
+    }
+    return frame;
+}
+
+// 纠删码模式: 对端还差几个符号就发几个, 再按估计的丢包率多发一些, 最后一个要应答
+void FileSender::sendFecBurst()
+{
+    packetType = DataPacket;
+    if (fecSource.isEmpty() || fecDecoded != fecBlock) {
+        loadFecBlock(fecDecoded);
+    }
+
+    int needed = qMax(1, fecBlockSymbols - fecRank);
+    int count = qMin(needed + fecRedundancy(needed), 255);  //对端收到数按字节回绕, 一轮不能超过255
+
+    burst.clear();
+    for (int i = 0; i < count; i++) {
+        burst.append(static_cast<quint32>(nextFecSymbol()));
+    }
+    burstPos = 0;
+    sendBurstFrame();
+    reportProgress();
+}
+
+void FileSender::loadFecBlock(quint32 block)
+{
+    quint32 chunks = static_cast<quint32>((fileSize + mtu - 1) / mtu);
+    quint32 firstChunk = block * fecBlockSize;
+    fecBlock = block;
+    fecBlockSymbols = static_cast<int>(qMin<quint32>(fecBlockSize, chunks - firstChunk));
+    fecNextSymbol = 0;
+    fecRank = 0;
+
+    //符号等长, 最后一块不足MTU的部分补0, 对端按文件大小截掉
+    qint64 sourceOffset = qint64(firstChunk) * mtu;
+    int sourceSize = static_cast<int>(qMin<qint64>(fecBlockSymbols * mtu, fileSize - sourceOffset));
+    fecSource = QByteArray(fecBlockSymbols * mtu, '\0');
+    const char *data = source->chunk(sourceOffset, sourceSize);
+    if (data) {
+        memcpy(fecSource.data(), data, sourceSize);
+    }
+    fecSymbol.resize(mtu);
+    encoder.setBlock(reinterpret_cast<const uchar *>(fecSource.constData()), fecBlockSymbols, mtu);
+}
+
+int FileSender::nextFecSymbol()
+{
+    int symbol = fecNextSymbol++;
+    if (fecNextSymbol >= encoder.symbolCount()) {
+        fecNextSymbol = fecBlockSymbols;    //校验符号用完了从头再来
+    }
+    return symbol;
+}
+
+int FileSender::fecRedundancy(int needed) const
+{
+    if (lossEstimate <= 0) {
+        return 0;
+    }
+    double loss = qMin(lossEstimate, 0.8);
+    return qCeil(needed * loss / (1.0 - loss)) + 1;
+}
+
+TxFrame FileSender::fecFrame(int symbol, quint8 flags)
+{
+    encoder.encode(symbol, reinterpret_cast<uchar *>(fecSymbol.data()));
+
+    TxFrame frame;
+    frame.headerSize = Protocol::writeFecDataHeader(frame.header, static_cast<quint16>(fecBlock & 0xFFFF), static_cast<quint8>(symbol), flags);
+    frame.data = fecSymbol.constData();
+    frame.size = fecSymbol.size();
+    return frame;
+}
+
+// 自适应速率: 从已连续确认的位置开始按新参数续传, 对端用旧参数回SACK后两边一起切
+// 分条时参数不变, 只是跳到新取的段
+void FileSender::startSwitch(qint64 at)
+{
+    previousChoice = rate.current();
+    switchOffset = at;
+    switchAttempts = 0;
+    switchApplied = false;
+    burst.clear();
+    burstPos = 0;
+
+    qCDebug(lcLink) << "rate switch: SF" << previousChoice.spreadingFactor << "->" << pendingChoice.spreadingFactor
+             << "MTU" << previousChoice.mtu << "->" << pendingChoice.mtu << "at" << switchOffset;
+
+    packetType = SwitchPacket;
+    transmitControl(Protocol::switchPacket(pendingChoice.spreadingFactor, pendingChoice.mtu, static_cast<quint32>(switchOffset)));
+}
+
+void FileSender::finishSwitch()
+{
+    if (!switchApplied && pendingChoice.spreadingFactor != previousChoice.spreadingFactor) {
+        applySpreadingFactor(pendingChoice.spreadingFactor);
+    }
+
+    mtu = pendingChoice.mtu;
+    segmentOffset = switchOffset;
+    offset = switchOffset;
+    sendWindow.reset(static_cast<quint32>((segmentEnd - segmentOffset + mtu - 1) / mtu), sendWindow.windowSize());
+    if (adaptive) {
+        rate.accept(pendingChoice);
+        stats.rateSwitches = rate.switches();
+    }
+    packetType = DataPacket;
+}
+
+void FileSender::abandonSwitch()
+{
+    qCDebug(lcLink) << "rate switch failed, back to SF" << previousChoice.spreadingFactor;
+    if (switchApplied) {
+        applySpreadingFactor(previousChoice.spreadingFactor);
+    }
+    rate.reject();
+    packetType = DataPacket;
+    sendWindowBurst();
+}
+
+void FileSender::applySpreadingFactor(int spreadingFactor)
+{
+    if (spreadingFactor == link->radioConfig().spreadingFactor) {
+        return;
+    }
+    RadioConfig config = link->radioConfig();
+    config.spreadingFactor = spreadingFactor;
+    link->writeConfig(config);
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=65533\r\n"));
+}
+
+// 校验模式: 跳到对端说对不上的段按窗口协议重发, SF和MTU不变, 段都补完再发结束包
+void FileSender::nextRepairRange()
+{
+    Protocol::Range range = repairRanges.takeFirst();
+    qint64 from = qMin<qint64>(range.offset, fileSize);
+    segmentEnd = qMin<qint64>(from + range.length, fileSize);
+    stats.repairBytes += segmentEnd - from;
+    qCDebug(lcLink) << "repairing" << currentFileName << "bytes" << from << "to" << segmentEnd;
+    pendingChoice = rate.current();
+    startSwitch(from);
+}
+
+void FileSender::nextStripePiece()
+{
+    stripeIdle = false;
+    if (hasPiece) {
+        hasPiece = false;
+        stripeDone += piece.size;
+        stripe->complete(piece);
+    }
+
+    if (stripe->take(&piece)) {
+        hasPiece = true;
+        offset = piece.offset;
+        segmentOffset = piece.offset;
+        segmentEnd = piece.offset + piece.size;
+        pendingChoice = rate.current();
+        startSwitch(piece.offset);
+    } else if (stripe->isComplete()) {
+        sendEndPacket();
+    } else {
+        //剩下的段别的链路还在发, 它们失败退回来的话接着发
+        stripeIdle = true;
+        packetType = DataPacket;
+        reportProgress();
+    }
+}
+
+void FileSender::onStripeChanged()
+{
+    if (running && stripeIdle) {
+        nextStripePiece();
+    }
+}
+
+void FileSender::returnStripePiece()
+{
+    //没确认的部分退回队列, 别的链路接着发
+    if (stripe && hasPiece) {
+        StripeQueue::Piece rest;
+        rest.offset = offset;
+        rest.size = static_cast<int>(segmentEnd - offset);
+        hasPiece = false;
+        stripe->giveBack(rest);
+    }
+}
+
+// 对端已确认收完: 批量传输中间的文件不发结束包, 下一个文件的开始包顺带结束这一个, 省一个来回
+// 校验模式要等结束包换回来的结论, 照常发
+void FileSender::endSession()
+{
+    if (chained && !checked) {
+        offset = fileSize;
+        finish(true, "The file has been successfully sent!");
+    } else {
+        sendEndPacket();
+    }
+}
+
+void FileSender::sendEndPacket()
+{
+    packetType = EndPacket;
+    offset = fileSize;
+    transmitControl(Protocol::endPacket());
+}
+
+void FileSender::finish(bool ok, const QString &message)
+{
+    timeoutTimer->stop();
+    reportProgress();
+    if (!ok) {
+        returnStripePiece();
+    }
+    if (windowMode && resumeWanted && !session.id.isEmpty()) {
+        //成功了就不用再续传; 发的是差量时没有会话
+        if (ok) {
+            journal.remove(session.id);
+        } else {
+            saveJournal();
+        }
+    }
+    if (ok && !deltaTarget.isEmpty() && !deltaCache.store(currentFileName, deltaTarget, deltaTargetHash)) {
+        qWarning() << "cannot write delta cache in" << deltaCache.directory();
+    }
+    deltaTarget.clear();
+    fullSource.clear();
+    running = false;
+    packetType = NotStarted;
+    source.clear();
+    emit finished(ok, message);
+}
+
+void FileSender::reportProgress()
+{
+    stats.bytesAcked = stripe ? stripeDone + (hasPiece ? offset - segmentOffset : 0) : offset;
+    //差量的偏移对不上原文件的扫描, 不算层
+    while (stats.deltaTargetSize == 0 && stats.layersAcked < layerEnds.size()
+           && offset >= layerEnds.at(stats.layersAcked)) {
+        if (stats.layersAcked++ == 0) {
+            stats.firstLayerMs = elapsed.elapsed();
+        }
+    }
+    stats.spreadingFactor = link->radioConfig().spreadingFactor;
+    stats.mtu = mtu;
+    stats.elapsedMs = elapsed.elapsed();
+    emit progress(stats);
+
+    if (windowMode && resumeWanted && journalTimer.isValid() && journalTimer.elapsed() >= SessionJournal::SaveIntervalMs) {
+        saveJournal();
+    }
+}
+
+void FileSender::saveJournal()
+{
+    if (session.id.isEmpty()) {
+        return;
+    }
+    session.offset = offset;
+    session.mtu = mtu;
+    session.radio = link->radioConfig();
+    if (!journal.save(session)) {
+        qWarning() << "cannot write session journal in" << journal.directory();
+    }
+    journalTimer.restart();
+}
+
+void FileSender::prepareLayers(int layers)
+{
+    if (fileSize > MaxLayeredFile) {
+        return;
+    }
+    const char *data = source->chunk(0, static_cast<int>(fileSize));
+    if (!data) {
+        return;
+    }
+    layerEnds = JpegScans::scanEnds(data, fileSize);
+    if (layers <= 0 || layers >= layerEnds.size()) {
+        return;
+    }
+    //只发前几层: 换成截短的数据, 续传和差量都按截短后的算
+    QByteArray truncated = JpegScans::truncate(QByteArray(data, static_cast<int>(fileSize)), layers);
+    layerEnds.resize(layers);
+    source = ChunkSource::fromData(truncated);
+    fileSize = truncated.size();
+    qCDebug(lcLink) << currentFileName << "truncated to" << layers << "scans," << fileSize << "bytes";
+}
+
+void FileSender::prepareDelta(const TransferOptions &options)
+{
+    if (fileSize > DeltaCache::MaxFileSize || session.id.isEmpty()) {
+        return;
+    }
+    const char *data = source->chunk(0, static_cast<int>(fileSize));
+    if (!data) {
+        return;
+    }
+    //不管这次能不能发差量, 送达后都存起来做下次的基准
+    deltaCache = DeltaCache(options.deltaCacheDir);
+    deltaTarget = QByteArray(data, static_cast<int>(fileSize));
+    deltaTargetHash = session.id;
+
+    QByteArray base;
+    deltaBaseHash = deltaCache.latest(currentFileName);
+    if (!deltaCache.load(deltaBaseHash, &base)) {
+        return;
+    }
+    QByteArray delta = DeltaCodec::encode(base, deltaTarget);
+    if (delta.size() >= fileSize) {
+        return;     // 改动太多, 不如整个发
+    }
+
+    fullSource = source;
+    source = ChunkSource::fromData(delta);
+    fileSize = delta.size();
+    segmentEnd = fileSize;
+    sendWindow.reset(static_cast<quint32>((fileSize + mtu - 1) / mtu), sendWindow.windowSize());
+    negotiatingDelta = true;
+    negotiatingResume = false;
+    negotiatingChecked = false;     // 差量按整个文件的CRC校验不了
+}
+
+void FileSender::abandonDelta()
+{
+    negotiatingDelta = false;
+    source = fullSource;
+    fullSource.clear();
+    fileSize = source->size();
+    segmentEnd = fileSize;
+    sendWindow.reset(static_cast<quint32>((fileSize + mtu - 1) / mtu), sendWindow.windowSize());
+    negotiatingResume = resumeWanted;
+    negotiatingChecked = checkedWanted;
+}
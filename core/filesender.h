@@ -0,0 +1,199 @@
+#ifndef FILESENDER_H
+#define FILESENDER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include "atframer.h"
+#include "atparser.h"
+#include "chunksource.h"
+#include "deltacache.h"
+#include "fec.h"
+#include "linktypes.h"
+#include "ratecontroller.h"
+#include "sessionjournal.h"
+#include "slidingwindow.h"
+#include "stripequeue.h"
+#include "transferprotocol.h"
+
+class LinkEngine;
+
+enum PacketType {
+    NotStarted,
+    DataPacket,  // 发送数据包
+    StartPacket, // 开始包
+    EndPacket,   // 结束包
+    SwitchPacket // 切换参数包(自适应速率)
+};
+
+// 图传发送状态机
+// 每写一包AT+PSEND先等+EVT:TXP2P DONE, 再开始计应答超时; 窗口模式下一轮突发的各包也是收到TX DONE再发下一包
+// 分条模式下从共享队列取段, 每段用切换包(SF不变)跳过去按窗口协议发完再取下一段
+class FileSender : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int MaxRetries = 50;
+    static const int MaxAdaptiveMtu = 240;  // 自适应时MTU的上限, 加帧头不超过模块单包255字节
+    static const int SwitchRetries = 3;     // 切换包用旧参数重试几次后改用新参数试
+    static const int ResumeRetries = 3;     // 续传开始包没人回几次后改发普通开始包
+    static const qint64 MaxSizedFile = 0xFFFFFFFFLL;   // 开始包里文件大小字段的上限
+    static const qint64 MaxLayeredFile = 16 * 1024 * 1024;  // JPEG按扫描分层要整个看一遍
+    static const int MaxRepairRounds = 3;   // 校验模式补发几轮还对不上就算失败
+
+    explicit FileSender(LinkEngine *link);
+
+    bool isRunning() const { return running; }
+    void start(const TransferOptions &options, StripeQueue *queue = nullptr);
+    void start(const TransferOptions &options, const QSharedPointer<ChunkSource> &source);  // 文件已经打开(批量传输预读)
+    void setChained(bool chained) { this->chained = chained; }
+    void stop();
+    void handleEvent(const AtEvent &event);
+
+signals:
+    void progress(const TransferStats &stats);
+    void finished(bool ok, const QString &message);
+    void replyLatency(double ms);   // 发出等应答的包到收到应答的时间
+
+private slots:
+    void onTimeout();
+    void onStripeChanged();
+
+private:
+    void begin(const TransferOptions &options, const QSharedPointer<ChunkSource> &source, StripeQueue *queue);
+    void transmit(const TxFrame &frame);
+    void transmitControl(const QByteArray &packet);
+    void onTxDone();
+    void onAck();
+    void onSack(const AtEvent &event);
+    void onFecStatus(const AtEvent &event);
+    void onResumeAck(const AtEvent &event);
+    void onVerdict(const AtEvent &event);
+    void handleReply();
+    void reportLatency();
+    void sampleRtt();
+    int expectedReplySize() const;
+    void sendStartPacket();
+    void sendChunk();
+    void sendWindowBurst();
+    void sendBurstFrame();
+    TxFrame windowFrame(quint32 index, quint8 flags);
+    void sendFecBurst();
+    void loadFecBlock(quint32 block);
+    int nextFecSymbol();
+    int fecRedundancy(int needed) const;
+    TxFrame fecFrame(int symbol, quint8 flags);
+    void sendEndPacket();
+    void endSession();
+    void startSwitch(qint64 at);
+    void finishSwitch();
+    void abandonSwitch();
+    void applySpreadingFactor(int spreadingFactor);
+    void nextRepairRange();
+    void nextStripePiece();
+    void returnStripePiece();
+    void finish(bool ok, const QString &message);
+    void reportProgress();
+    void saveJournal();
+    void prepareLayers(int layers);
+    void prepareDelta(const TransferOptions &options);
+    void abandonDelta();
+
+    LinkEngine *link;
+    QTimer *timeoutTimer;     // 超时计时器
+    QElapsedTimer elapsed;
+    QElapsedTimer replyTimer; // 从最后一次PSEND开始计
+    QElapsedTimer rttTimer;   // 从TX DONE开始计, 喂给超时估计
+    bool rttValid = false;    // 重发的包不采样
+
+    bool running = false;
+    bool txPending = false;   // 已写PSEND, 还没收到TX DONE
+    bool replyDeferred = false; // TX DONE之前到的应答, 等TX DONE后再处理
+    TxFrame lastFrame;        // 超时重发用, 数据指向source的映射或controlPacket
+    QByteArray controlPacket; // 开始包/结束包
+    PacketType packetType = NotStarted;
+
+    QString currentFileName;  // 文件名也要发送给服务器
+    QSharedPointer<ChunkSource> source;   // 文件数据, 按块取视图, 不整个读进内存
+    qint64 fileSize = 0;      // 文件的大小
+    qint64 offset = 0;        // 当前已确认数据的位置
+    int mtu = 0;
+    int currentChunkSize = 0; // 当前发送包的大小
+    quint8 currentPacketIndex = 0;
+    int retryCount = 0;       // 重试次数
+    bool chained = false;     // 后面还有文件, 窗口/纠删码协议下不发结束包
+    TransferStats stats;
+
+    //窗口传输(选择重传)
+    SlidingWindow sendWindow;
+    bool windowMode = false;        // 对端已确认支持窗口协议
+    bool negotiatingWindow = false; // 已发v2开始包, 等对端回应
+    QVector<quint32> burst;         // 本轮突发的块号(纠删码模式是符号编号)
+    int burstPos = 0;
+    qint64 segmentOffset = 0;       // 窗口块号0对应的文件偏移, 切换MTU后从已确认处重新编号
+    qint64 segmentEnd = 0;          // 本段结束的文件偏移, 不分条时就是文件大小
+
+    //分条传输: 几条链路从同一个队列取段
+    StripeQueue *stripe = nullptr;
+    StripeQueue::Piece piece;       // 正在发的段
+    bool hasPiece = false;
+    bool stripeIdle = false;        // 队列暂时取空, 等别的链路完成或退回
+    qint64 stripeDone = 0;          // 本链路已发完的段的字节数
+
+    //续传: 会话ID是文件内容哈希, 已确认的偏移定期写日志, 下次开始时由对端决定从哪里续
+    SessionJournal journal;
+    SessionRecord session;
+    bool negotiatingResume = false;
+    QElapsedTimer journalTimer;
+
+    //差量传输: 开始前把文件和上一次送达的版本比好, 对端有基准就把source换成差量按窗口协议发
+    DeltaCache deltaCache;
+    bool negotiatingDelta = false;
+    bool resumeWanted = false;      // 退回整个文件发时照常协商续传
+    QByteArray deltaTarget;         // 整个文件, 送达后存进缓存做下次的基准
+    QByteArray deltaTargetHash;
+    QByteArray deltaBaseHash;
+    QSharedPointer<ChunkSource> fullSource;
+
+    //校验模式: 每块带CRC32C, 结束包后等对端的结论, 对不上的段用切换包跳过去补发
+    bool checked = false;
+    bool negotiatingChecked = false;
+    bool checkedWanted = false;     // 差量协商不成时照常协商校验
+    quint32 fileCrc = 0;
+    QVector<Protocol::Range> repairRanges;
+    int repairRounds = 0;
+
+    //渐进式JPEG: 各扫描结束的偏移, 已确认的偏移过了哪个就是哪层能看了
+    QVector<qint64> layerEnds;
+
+    //自适应速率
+    bool adaptive = false;
+    RateController rate;
+    RateController::Choice pendingChoice;
+    RateController::Choice previousChoice;
+    qint64 switchOffset = 0;
+    int switchAttempts = 0;
+    bool switchApplied = false;     // 本端已经切到新SF
+
+    //纠删码传输: 每个源块发K个源符号加按丢包率估算的校验符号, 对端能解码才前进
+    bool fecMode = false;
+    bool negotiatingFec = false;
+    int fecBlockSize = 0;           // K
+    quint32 fecBlockCount = 0;
+    quint32 fecBlock = 0;           // 当前源块
+    int fecBlockSymbols = 0;        // 当前块的K, 最后一块可能不足
+    int fecNextSymbol = 0;
+    int fecRank = 0;                // 对端当前块的秩
+    quint32 fecDecoded = 0;         // 对端已解码的块数
+    quint8 fecReceived = 0;         // 对端累计收到的符号数(回绕)
+    int fecSentSinceStatus = 0;
+    double lossEstimate = 0;
+    QByteArray fecSource;           // 当前块的源符号, 末尾补0
+    QByteArray fecSymbol;
+    FecEncoder encoder;
+};
+
+#endif // FILESENDER_H
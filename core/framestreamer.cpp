@@ -0,0 +1,267 @@
+#include "framestreamer.h"
+#include "filesender.h"
+#include "rtoestimator.h"
+#include "transferprotocol.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+
+FrameStreamer::FrameStreamer(FileSender *sender, RtoEstimator *rto, QObject *parent)
+    : QObject(parent), sender(sender), rto(rto), pollTimer(new QTimer(this)), process(new QProcess(this))
+{
+    connect(pollTimer, &QTimer::timeout, this, &FrameStreamer::poll);
+    connect(process, &QProcess::readyReadStandardOutput, this, &FrameStreamer::onPipeReadable);
+    connect(process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, &FrameStreamer::onPipeFinished);
+}
+
+void FrameStreamer::start(const StreamOptions &options)
+{
+    stop();
+
+    this->options = options;
+    stats = StreamStats();
+    ages.reset();
+    sending = false;
+    settling = false;
+    hasPending = false;
+    preempts = 0;
+    sourceClosed = false;
+    candidateKey.clear();
+    lastKey.clear();
+    pipeBuffer.clear();
+    running = true;
+    elapsed.start();
+
+    if (!options.command.isEmpty()) {
+#ifdef Q_OS_WIN
+        process->start("cmd", QStringList() << "/c" << options.command);
+#else
+        process->start("/bin/sh", QStringList() << "-c" << options.command);
+#endif
+        process->closeWriteChannel();
+    } else {
+        pollTimer->start(qMax(10, options.pollMs));
+        poll();
+    }
+}
+
+void FrameStreamer::stop()
+{
+    running = false;
+    pollTimer->stop();
+    if (process->state() != QProcess::NotRunning) {
+        process->kill();
+        process->waitForFinished(1000);
+    }
+    sending = false;
+    hasPending = false;
+    pending = Frame();
+}
+
+void FrameStreamer::end()
+{
+    stop();
+    stats.elapsedMs = elapsed.elapsed();
+    emit finished(stats);
+}
+
+void FrameStreamer::poll()
+{
+    QDir dir(options.directory);
+    QStringList names = dir.entryList(QDir::Files | QDir::Readable, QDir::Time);
+    if (names.isEmpty()) {
+        return;
+    }
+    QFileInfo info(dir.filePath(names.first()));
+    QString key = info.fileName() + '|' + QString::number(info.size()) + '|'
+            + QString::number(info.lastModified().toMSecsSinceEpoch());
+    if (key == lastKey) {
+        return;
+    }
+    if (key != candidateKey) {
+        candidateKey = key;     // 可能还在写, 下次轮询还一样才算写完
+        return;
+    }
+    lastKey = key;
+
+    //读进内存再发, 相机覆盖同名文件不影响正在发的帧
+    QFile file(info.filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "cannot read" << file.fileName() << file.errorString();
+        return;
+    }
+    Frame frame;
+    frame.name = info.fileName();
+    frame.data = file.readAll();
+    frame.capturedMs = info.lastModified().toMSecsSinceEpoch();
+    offer(frame);
+}
+
+QByteArray FrameStreamer::takeJpegFrame(QByteArray *buffer)
+{
+    static const QByteArray soi("\xFF\xD8", 2);
+    static const QByteArray eoi("\xFF\xD9", 2);
+    int start = buffer->indexOf(soi);
+    if (start < 0) {
+        //最后一个字节可能是下一帧SOI的前半个
+        buffer->remove(0, qMax(0, buffer->size() - 1));
+        return QByteArray();
+    }
+    int end = buffer->indexOf(eoi, start + soi.size());
+    if (end < 0) {
+        buffer->remove(0, start);
+        return QByteArray();
+    }
+    QByteArray frame = buffer->mid(start, end + eoi.size() - start);
+    buffer->remove(0, end + eoi.size());
+    return frame;
+}
+
+void FrameStreamer::onPipeReadable()
+{
+    pipeBuffer.append(process->readAllStandardOutput());
+
+    //一次读到好几帧只要最后一帧, 前面的算丢掉
+    QByteArray latest;
+    QByteArray frame;
+    while (!(frame = takeJpegFrame(&pipeBuffer)).isEmpty()) {
+        if (!latest.isEmpty()) {
+            stats.framesCaptured++;
+            stats.framesDropped++;
+        }
+        latest = frame;
+    }
+    if (pipeBuffer.size() > MaxPipeBuffer) {
+        qWarning() << "no JPEG end marker in" << pipeBuffer.size() << "bytes from the camera, dropping them";
+        pipeBuffer.clear();
+    }
+    if (!latest.isEmpty() && running) {
+        Frame next;
+        next.name = "frame.jpg";
+        next.data = latest;
+        next.capturedMs = QDateTime::currentMSecsSinceEpoch();
+        offer(next);
+    }
+}
+
+void FrameStreamer::onPipeFinished()
+{
+    if (!running) {
+        return;
+    }
+    qDebug() << "camera command exited:" << process->readAllStandardError().trimmed();
+    sourceClosed = true;
+    if (!sending && !settling && !hasPending) {
+        end();
+    }
+}
+
+void FrameStreamer::offer(Frame frame)
+{
+    //帧序号接在原名后面
+    stats.framesCaptured++;
+    QFileInfo info(frame.name);
+    frame.name = QString("%1-%2.%3").arg(info.completeBaseName()).arg(stats.framesCaptured, 6, 10, QChar('0'))
+            .arg(info.suffix().isEmpty() ? QString("bin") : info.suffix());
+
+    if (!sending && !settling) {
+        startFrame(frame);
+        return;
+    }
+    if (hasPending) {
+        stats.framesDropped++;
+    }
+    pending = frame;
+    hasPending = true;
+
+    //当前帧才发了一点就打断, 换最新的
+    double acked = stats.current.fileSize > 0 ? double(stats.current.bytesAcked) / stats.current.fileSize : 0.0;
+    if (sending && acked < options.preemptBelow && preempts < MaxPreempts) {
+        sender->stop();
+        sending = false;
+        settling = true;
+        preempts++;
+        stats.framesPreempted++;
+        stats.elapsedMs = elapsed.elapsed();
+        emit frameDone(stats, false, current.name + " preempted by a newer frame");
+        QTimer::singleShot(rto->replyTimeout(Protocol::SackSize), this, &FrameStreamer::startPending);
+        return;
+    }
+    emit progress(stats);
+}
+
+void FrameStreamer::startPending()
+{
+    settling = false;
+    if (!running) {
+        return;
+    }
+    if (hasPending) {
+        hasPending = false;
+        startFrame(pending);
+    } else if (sourceClosed) {
+        end();
+    }
+}
+
+void FrameStreamer::startFrame(const Frame &frame)
+{
+    current = frame;
+    pending = Frame();
+    stats.fileName = current.name;
+    stats.current = TransferStats();
+
+    //帧之间没关系, 不续传, 每帧都发结束包
+    TransferOptions transfer = options.transfer;
+    transfer.filePath = current.name;
+    transfer.resume = false;
+    transfer.chained = false;
+    sending = true;
+    sender->start(transfer, ChunkSource::fromData(current.data));
+}
+
+void FrameStreamer::frameProgress(const TransferStats &stats)
+{
+    if (!running || !sending) {
+        return;
+    }
+    this->stats.current = stats;
+    this->stats.elapsedMs = elapsed.elapsed();
+    emit progress(this->stats);
+}
+
+void FrameStreamer::frameFinished(bool ok, const QString &message)
+{
+    if (!running || !sending) {
+        return;
+    }
+    sending = false;
+    if (ok) {
+        stats.framesDelivered++;
+        stats.bytesDelivered += current.data.size();
+        preempts = 0;
+        stats.lastAgeMs = qMax<qint64>(0, QDateTime::currentMSecsSinceEpoch() - current.capturedMs);
+        ages.record(static_cast<qint64>(stats.lastAgeMs * 1000000));
+        stats.ageMeanMs = ages.mean() / 1e6;
+        stats.ageP50Ms = ages.percentile(50) / 1e6;
+        stats.ageP99Ms = ages.percentile(99) / 1e6;
+        stats.ageMaxMs = ages.max() / 1e6;
+    } else {
+        stats.framesFailed++;
+    }
+    stats.elapsedMs = elapsed.elapsed();
+    emit frameDone(stats, ok, message);
+
+    if (options.maxFrames > 0 && stats.framesDelivered >= quint64(options.maxFrames)) {
+        end();
+    } else if (hasPending) {
+        hasPending = false;
+        startFrame(pending);
+    } else if (sourceClosed) {
+        end();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef FRAMESTREAMER_H
+#define FRAMESTREAMER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QProcess>
+#include "latencyhistogram.h"
+#include "linktypes.h"
+
+class FileSender;
+class RtoEstimator;
+class QTimer;
+
+// 连续图传: 盯着一个目录(相机往里写图)或者相机命令的标准输出(MJPEG), 一直发最新的一帧
+// 新帧到的时候: 还没开始发的旧帧直接丢; 正在发的确认不到preemptBelow就打断, 否则发完再跳到最新的.
+// 连续打断几次后当前帧一定发完, 帧来得比链路快时也不会一帧都送不到.
+// 打断后等一个应答超时再发新帧的开始包, 旧帧迟到的SACK不会被当成新帧的应答;
+// 每帧的文件名带帧序号, 接收端不会把新帧的开始包当成旧帧重发的
+class FrameStreamer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int MaxPreempts = 3;               // 连续打断这么多次后当前帧发完再说
+    static const int MaxPipeBuffer = 8 * 1024 * 1024;   // 管道里攒这么多还找不到帧尾就丢
+
+    FrameStreamer(FileSender *sender, RtoEstimator *rto, QObject *parent = nullptr);
+
+    bool isRunning() const { return running; }
+    void start(const StreamOptions &options);
+    void stop();
+
+    // 当前帧的FileSender进度和结果
+    void frameProgress(const TransferStats &stats);
+    void frameFinished(bool ok, const QString &message);
+
+    // 从缓冲区取出第一帧完整的JPEG(FFD8...FFD9), 前面的垃圾一起去掉; 还没收全返回空
+    static QByteArray takeJpegFrame(QByteArray *buffer);
+
+signals:
+    void progress(const StreamStats &stats);
+    void frameDone(const StreamStats &stats, bool ok, const QString &message);
+    void finished(const StreamStats &stats);
+
+private slots:
+    void poll();
+    void onPipeReadable();
+    void onPipeFinished();
+    void startPending();
+
+private:
+    struct Frame {
+        QString name;
+        QByteArray data;
+        qint64 capturedMs = 0;      // 采集时间(墙上时钟), 目录里的按修改时间
+    };
+
+    void offer(Frame frame);
+    void startFrame(const Frame &frame);
+    void end();
+
+    FileSender *sender;
+    RtoEstimator *rto;
+    QTimer *pollTimer;
+    QProcess *process;
+    bool running = false;
+    bool sourceClosed = false;  // 相机命令退出了, 发完手上的就结束
+    StreamOptions options;
+    StreamStats stats;
+    QElapsedTimer elapsed;
+    LatencyHistogram ages;
+
+    Frame current;
+    bool sending = false;       // 当前帧在FileSender里
+    bool settling = false;      // 打断后等旧帧的迟到应答过去
+    Frame pending;              // 最新的还没发的帧, 只留一个
+    bool hasPending = false;
+    int preempts = 0;           // 连续打断的次数
+
+    //目录: 最新的文件连续两次轮询大小和修改时间都不变才算写完
+    QString candidateKey;
+    QString lastKey;
+    QByteArray pipeBuffer;
+};
+
+#endif // FRAMESTREAMER_H
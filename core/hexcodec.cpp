@@ -0,0 +1,157 @@
+#include "hexcodec.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEX_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(HEX_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HEX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+namespace Hex {
+
+namespace {
+
+struct Table {
+    char pairs[256][2];
+
+    Table()
+    {
+        static const char digits[] = "0123456789ABCDEF";
+        for (int i = 0; i < 256; i++) {
+            pairs[i][0] = digits[i >> 4];
+            pairs[i][1] = digits[i & 0x0F];
+        }
+    }
+};
+
+const Table &table()
+{
+    static const Table instance;
+    return instance;
+}
+
+#ifdef HEX_HAVE_SSE2
+// 半字节转ASCII: v + '0', 大于9的再加7落到'A'..'F'
+inline __m128i nibblesToAscii(__m128i v)
+{
+    const __m128i nine = _mm_set1_epi8(9);
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(v, nine), _mm_set1_epi8(7));
+    return _mm_add_epi8(_mm_add_epi8(v, _mm_set1_epi8('0')), letters);
+}
+
+int encodeSse2(const uchar *src, int size, char *dst)
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i hi = nibblesToAscii(_mm_and_si128(_mm_srli_epi16(in, 4), mask));
+        __m128i lo = nibblesToAscii(_mm_and_si128(in, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+#endif
+
+#ifdef HEX_HAVE_AVX2
+__attribute__((target("avx2")))
+int encodeAvx2(const uchar *src, int size, char *dst)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i seven = _mm256_set1_epi8(7);
+    const __m256i zero = _mm256_set1_epi8('0');
+    int i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(in, 4), mask);
+        __m256i lo = _mm256_and_si256(in, mask);
+        hi = _mm256_add_epi8(_mm256_add_epi8(hi, zero), _mm256_and_si256(_mm256_cmpgt_epi8(hi, nine), seven));
+        lo = _mm256_add_epi8(_mm256_add_epi8(lo, zero), _mm256_and_si256(_mm256_cmpgt_epi8(lo, nine), seven));
+
+        //unpack按128位通道交织, 再把两个通道的结果按顺序拼回去
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+#endif
+
+enum Implementation {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+Implementation detect()
+{
+#ifdef HEX_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return Avx2;
+    }
+#endif
+#ifdef HEX_HAVE_SSE2
+    return Sse2;
+#else
+    return Scalar;
+#endif
+}
+
+Implementation selected()
+{
+    static const Implementation implementation = detect();
+    return implementation;
+}
+
+}
+
+void encodeUpperScalar(const uchar *src, int size, char *dst)
+{
+    const Table &t = table();
+    for (int i = 0; i < size; i++) {
+        memcpy(dst + 2 * i, t.pairs[src[i]], 2);
+    }
+}
+
+void encodeUpper(const uchar *src, int size, char *dst)
+{
+    int done = 0;
+    switch (selected()) {
+#ifdef HEX_HAVE_AVX2
+    case Avx2:
+        done = encodeAvx2(src, size, dst);
+        break;
+#endif
+#ifdef HEX_HAVE_SSE2
+    case Sse2:
+        done = encodeSse2(src, size, dst);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    //不足一个向量的尾巴查表
+    encodeUpperScalar(src + done, size - done, dst + 2 * done);
+}
+
+const char *implementation()
+{
+    switch (selected()) {
+    case Avx2:
+        return "avx2";
+    case Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+}
@@ -0,0 +1,17 @@
+#ifndef HEXCODEC_H
+#define HEXCODEC_H
+
+#include <QtGlobal>
+
+// 大写16进制编码, 运行时按CPU选AVX2/SSE2/查表实现
+// dst要有2*size字节, 不写结尾的0
+namespace Hex {
+
+void encodeUpper(const uchar *src, int size, char *dst);
+void encodeUpperScalar(const uchar *src, int size, char *dst);
+
+const char *implementation();   // "avx2" / "sse2" / "scalar"
+
+}
+
+#endif // HEXCODEC_H
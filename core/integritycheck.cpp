@@ -0,0 +1,95 @@
+#include "integritycheck.h"
+#include "chunksource.h"
+#include "crc32c.h"
+#include <algorithm>
+
+void IntegrityCheck::reset(quint32 fileCrc)
+{
+    expected = fileCrc;
+    chunks.clear();
+}
+
+bool IntegrityCheck::addChunk(qint64 offset, const uchar *data, int size, quint32 crc)
+{
+    if (Protocol::chunkCrc(static_cast<quint32>(offset), data, size) != crc) {
+        return false;
+    }
+    Chunk chunk;
+    chunk.offset = offset;
+    chunk.size = size;
+    chunk.crc = crc;
+    chunks.append(chunk);
+    return true;
+}
+
+QVector<Protocol::Range> IntegrityCheck::damagedRanges(const uchar *file, qint64 size)
+{
+    QVector<Protocol::Range> ranges;
+    if (Crc32c::compute(file, size) == expected) {
+        chunks.clear();
+        return ranges;
+    }
+
+    auto add = [&ranges](qint64 offset, qint64 length) {
+        if (length <= 0) {
+            return;
+        }
+        if (!ranges.isEmpty() && qint64(ranges.last().offset) + ranges.last().length >= offset) {
+            qint64 end = qMax<qint64>(qint64(ranges.last().offset) + ranges.last().length, offset + length);
+            ranges.last().length = static_cast<quint32>(end - ranges.last().offset);
+            return;
+        }
+        Protocol::Range range;
+        range.offset = static_cast<quint32>(offset);
+        range.length = static_cast<quint32>(length);
+        ranges.append(range);
+    };
+
+    //切换MTU后块的边界会变, 同一段可能记了两次, 按偏移排好一起扫
+    std::sort(chunks.begin(), chunks.end(), [](const Chunk &a, const Chunk &b) { return a.offset < b.offset; });
+    QVector<Chunk> good;
+    qint64 covered = 0;
+    for (const Chunk &chunk : chunks) {
+        if (chunk.offset + chunk.size > size) {
+            continue;
+        }
+        if (chunk.offset > covered) {
+            add(covered, chunk.offset - covered);
+        }
+        if (Protocol::chunkCrc(static_cast<quint32>(chunk.offset), file + chunk.offset, chunk.size) == chunk.crc) {
+            good.append(chunk);
+        } else {
+            add(chunk.offset, chunk.size);
+        }
+        covered = qMax(covered, chunk.offset + chunk.size);
+    }
+    add(covered, size - covered);
+    chunks = good;      // 坏块补完会重新记
+
+    if (ranges.isEmpty()) {
+        add(0, size);
+    }
+    //段太多时后面的并成一段
+    if (ranges.size() > Protocol::MaxRepairRanges) {
+        Protocol::Range &last = ranges[Protocol::MaxRepairRanges - 1];
+        last.length = ranges.last().offset + ranges.last().length - last.offset;
+        ranges.resize(Protocol::MaxRepairRanges);
+    }
+    return ranges;
+}
+
+bool IntegrityCheck::fileCrc(ChunkSource *source, quint32 *crc)
+{
+    const int blockSize = 1024 * 1024;
+    quint32 value = 0;
+    for (qint64 offset = 0; offset < source->size(); offset += blockSize) {
+        int length = static_cast<int>(qMin<qint64>(blockSize, source->size() - offset));
+        const char *data = source->chunk(offset, length);
+        if (!data) {
+            return false;
+        }
+        value = Crc32c::extend(value, reinterpret_cast<const uchar *>(data), length);
+    }
+    *crc = value;
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef INTEGRITYCHECK_H
+#define INTEGRITYCHECK_H
+
+#include <QVector>
+#include "transferprotocol.h"
+
+class ChunkSource;
+
+// 校验模式接收端: 记下每块收到时的CRC, 收完按整个文件的CRC32C校验
+// 对不上时找出要补的段: 收到时校验过但现在对不上的块(写坏了), 和这次没收到过的部分(续传前的);
+// 每块都还对但整个文件不对就只能全部重发. 接收端和模拟器的对端共用
+class IntegrityCheck
+{
+public:
+    void reset(quint32 fileCrc);
+    quint32 fileCrc() const { return expected; }
+
+    // 收到的一块: CRC对得上就记下来返回true, 对不上返回false(当没收到)
+    bool addChunk(qint64 offset, const uchar *data, int size, quint32 crc);
+
+    // 收完: 整个文件的CRC对上返回空, 否则返回要补的段(最多Protocol::MaxRepairRanges段)
+    QVector<Protocol::Range> damagedRanges(const uchar *file, qint64 size);
+
+    // 发送端: 大文件分块算, 不整个读进内存
+    static bool fileCrc(ChunkSource *source, quint32 *crc);
+
+private:
+    struct Chunk {
+        qint64 offset;
+        int size;
+        quint32 crc;
+    };
+
+    quint32 expected = 0;
+    QVector<Chunk> chunks;
+};
+
+#endif // INTEGRITYCHECK_H
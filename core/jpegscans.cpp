@@ -0,0 +1,119 @@
+#include "jpegscans.h"
+
+namespace JpegScans {
+
+namespace {
+
+const uchar MarkerSof2 = 0xC2;      // 渐进式DCT
+const uchar MarkerSoi = 0xD8;
+const uchar MarkerEoi = 0xD9;
+const uchar MarkerSos = 0xDA;
+
+bool isRestart(uchar marker)
+{
+    return marker >= 0xD0 && marker <= 0xD7;
+}
+
+}
+
+void Scanner::feed(const char *data, qint64 size)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    if (stopped) {
+        return;
+    }
+    if (pos == 0) {
+        if (size < 4) {
+            return;
+        }
+        if (p[0] != 0xFF || p[1] != MarkerSoi) {
+            stopped = true;
+            return;
+        }
+        pos = 2;
+    }
+
+    for (;;) {
+        if (inScan) {
+            //压缩数据里的FF后面跟00或者RSTn, 别的就是扫描后面的标记
+            qint64 i = searchFrom;
+            for (; i + 1 < size; i++) {
+                if (p[i] == 0xFF && p[i + 1] != 0x00 && !isRestart(p[i + 1]) && p[i + 1] != 0xFF) {
+                    break;
+                }
+            }
+            if (i + 1 >= size) {
+                searchFrom = i;     // 这个扫描还没收全, 下次从这里接着找
+                return;
+            }
+            found.append(i);
+            pos = i;
+            inScan = false;
+            continue;
+        }
+
+        if (pos + 1 >= size) {
+            return;
+        }
+        if (p[pos] != 0xFF) {
+            stopped = true;     // 标记之间不该有别的数据, 不认识的格式就到此为止
+            return;
+        }
+        uchar marker = p[pos + 1];
+        if (marker == 0xFF) {
+            pos++;      // 填充字节
+            continue;
+        }
+        if (marker == MarkerEoi) {
+            stopped = true;
+            return;
+        }
+        if (marker == 0x01 || isRestart(marker)) {
+            pos += 2;
+            continue;
+        }
+        if (pos + 4 > size) {
+            return;
+        }
+        qint64 length = (p[pos + 2] << 8) | p[pos + 3];
+        if (length < 2) {
+            stopped = true;
+            return;
+        }
+        if (pos + 2 + length > size) {
+            return;
+        }
+        if (marker == MarkerSof2) {
+            progressive = true;
+        }
+        pos += 2 + length;
+        if (marker == MarkerSos) {
+            inScan = true;
+            searchFrom = pos;
+        }
+    }
+}
+
+QVector<qint64> scanEnds(const char *data, qint64 size, bool *progressive)
+{
+    Scanner scanner;
+    scanner.feed(data, size);
+    if (progressive) {
+        *progressive = scanner.isProgressive();
+    }
+    return scanner.ends();
+}
+
+QByteArray truncate(const QByteArray &data, int layers)
+{
+    QVector<qint64> ends = scanEnds(data.constData(), data.size());
+    if (layers <= 0 || layers >= ends.size()) {
+        return data;
+    }
+    QByteArray out = data.left(static_cast<int>(ends.at(layers - 1)));
+    out.append(static_cast<char>(0xFF));
+    out.append(static_cast<char>(MarkerEoi));
+    return out;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef JPEGSCANS_H
+#define JPEGSCANS_H
+
+#include <QByteArray>
+#include <QVector>
+
+// JPEG按扫描(SOS)分层: 渐进式JPEG第一个扫描就是整张图的粗略版本, 后面的扫描逐步补细节,
+// 按字节顺序发本身就是先粗后细. 截在某个扫描的压缩数据后面补上EOI仍然是一张能解码的图:
+// 发送端只发前几层省空口时间, 接收端收到的连续部分每多一层就能出一张预览
+namespace JpegScans {
+
+// 每个完整扫描的压缩数据结束处(后面那个标记的偏移), 按顺序; 不是JPEG或者一个扫描都没收全返回空
+// 数据可以只是文件的前一部分, 只算已经完整的扫描
+QVector<qint64> scanEnds(const char *data, qint64 size, bool *progressive = nullptr);
+
+// 增量解析: 收文件时连续部分不断变长, 每次只看新接上的字节, 不从头再扫
+class Scanner
+{
+public:
+    void reset() { *this = Scanner(); }
+    // data是文件开头的size字节, 之后每次的size只能变大, 前面的内容不能变
+    void feed(const char *data, qint64 size);
+    const QVector<qint64> &ends() const { return found; }
+    bool isProgressive() const { return progressive; }
+
+private:
+    qint64 pos = 0;             // 下一个标记的偏移, 0是还没看SOI
+    qint64 searchFrom = 0;      // 扫描压缩数据时下次从哪里接着找结束标记
+    bool inScan = false;
+    bool stopped = false;       // EOI或者不认识的格式, 后面不再看
+    bool progressive = false;
+    QVector<qint64> found;
+};
+
+// 只留前layers个扫描, 补上EOI; layers<=0或者不比扫描数少时原样返回
+QByteArray truncate(const QByteArray &data, int layers);
+
+}
+
+#endif // JPEGSCANS_H
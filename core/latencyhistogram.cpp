@@ -0,0 +1,85 @@
+#include "latencyhistogram.h"
+#include <QtAlgorithms>
+
+LatencyHistogram::LatencyHistogram() : buckets(BucketCount, 0)
+{
+}
+
+void LatencyHistogram::reset()
+{
+    buckets.fill(0);
+    total = 0;
+    sum = 0;
+    minValue = 0;
+    maxValue = 0;
+}
+
+int LatencyHistogram::bucketIndex(qint64 ns)
+{
+    if (ns < 2 * SubBucketCount) {
+        return static_cast<int>(ns);
+    }
+    //最高位决定区间, 其下SubBucketBits位决定子桶
+    int msb = 63 - static_cast<int>(qCountLeadingZeroBits(static_cast<quint64>(ns)));
+    int shift = msb - SubBucketBits;
+    if (shift > MaxShift) {
+        return BucketCount - 1;
+    }
+    int sub = static_cast<int>(ns >> shift) - SubBucketCount;
+    return 2 * SubBucketCount + (shift - 1) * SubBucketCount + sub;
+}
+
+qint64 LatencyHistogram::bucketLower(int index)
+{
+    if (index < 2 * SubBucketCount) {
+        return index;
+    }
+    int shift = (index - 2 * SubBucketCount) / SubBucketCount + 1;
+    int sub = (index - 2 * SubBucketCount) % SubBucketCount;
+    return qint64(SubBucketCount + sub) << shift;
+}
+
+qint64 LatencyHistogram::bucketUpper(int index)
+{
+    if (index < 2 * SubBucketCount) {
+        return index;
+    }
+    int shift = (index - 2 * SubBucketCount) / SubBucketCount + 1;
+    return bucketLower(index) + (qint64(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 ns)
+{
+    if (ns < 0) {
+        ns = 0;
+    }
+    buckets[bucketIndex(ns)]++;
+    if (total == 0 || ns < minValue) {
+        minValue = ns;
+    }
+    if (ns > maxValue) {
+        maxValue = ns;
+    }
+    total++;
+    sum += ns;
+}
+
+qint64 LatencyHistogram::percentile(double p) const
+{
+    if (total == 0) {
+        return 0;
+    }
+    //向上取整: p50在两个样本时取第一个, p100取最后一个
+    quint64 rank = static_cast<quint64>(p / 100.0 * total + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return qMin(bucketUpper(i), maxValue);
+        }
+    }
+    return maxValue;
+}
@@ -0,0 +1,44 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QVector>
+
+// HDR风格的延迟直方图, 单位ns
+// 对数-线性分桶: 每个2的幂区间再均分64个子桶, 相对误差不超过1/64;
+// 128ns以下每ns一个桶. 桶数固定, 记录是O(1), 内存不随样本数增长
+class LatencyHistogram
+{
+public:
+    static const int SubBucketBits = 6;
+    static const int SubBucketCount = 1 << SubBucketBits;
+    static const int MaxShift = 42;             // 上限约 2^49 ns ≈ 6.5天
+    static const int BucketCount = 2 * SubBucketCount + MaxShift * SubBucketCount;
+
+    LatencyHistogram();
+
+    void record(qint64 ns);
+    void reset();
+
+    quint64 count() const { return total; }
+    qint64 min() const { return total ? minValue : 0; }
+    qint64 max() const { return maxValue; }
+    double mean() const { return total ? double(sum) / total : 0.0; }
+    qint64 percentile(double p) const;      // p: 0~100, 返回所在桶的上界
+
+    //导出用: 按桶遍历, 空桶也算
+    int bucketCount() const { return BucketCount; }
+    quint64 bucketSamples(int index) const { return buckets[index]; }
+    static qint64 bucketLower(int index);
+    static qint64 bucketUpper(int index);
+
+private:
+    static int bucketIndex(qint64 ns);
+
+    QVector<quint64> buckets;
+    quint64 total = 0;
+    double sum = 0;
+    qint64 minValue = 0;
+    qint64 maxValue = 0;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,569 @@
+#include "linkengine.h"
+#include "batchtransfer.h"
+#include "filereceiver.h"
+#include "filesender.h"
+#include "framestreamer.h"
+#include "linklog.h"
+#include "persweep.h"
+#include "pertest.h"
+#include "stripedtransfer.h"
+#include <QDebug>
+
+LinkEngine::LinkEngine(QObject *parent) : QObject(parent), serialPort(new QSerialPort(this)), device(serialPort),
+    commands(new AtCommandQueue(this, this)), latencyTimer(new QTimer(this))
+{
+    //子对象跟着引擎一起moveToThread
+    sender = new FileSender(this);
+    receiver = new FileReceiver(this);
+    perTest = new PerTest(this);
+    sweep = new PerSweep(this, perTest);
+    striped = new StripedTransfer(this);
+    batch = new BatchTransfer(sender, this);
+    stream = new FrameStreamer(sender, &rtoEstimator, this);
+    parser.setHandler(this);
+
+    attach(serialPort);
+    connect(commands, &AtCommandQueue::commandFailed, this, &LinkEngine::commandFailed);
+    latencyTimer->setInterval(LatencyIntervalMs);
+    connect(latencyTimer, &QTimer::timeout, this, &LinkEngine::onLatencyTimer);
+
+    //分条传输时本端的进度先汇总再报
+    connect(sender, &FileSender::progress, this, &LinkEngine::onSenderProgress);
+    connect(sender, &FileSender::finished, this, &LinkEngine::onSenderFinished);
+    connect(striped, &StripedTransfer::progress, this, &LinkEngine::transferProgress);
+    connect(striped, &StripedTransfer::finished, this, &LinkEngine::transferFinished);
+    connect(batch, &BatchTransfer::progress, this, &LinkEngine::batchProgress);
+    connect(batch, &BatchTransfer::fileDone, this, &LinkEngine::batchFileFinished);
+    connect(batch, &BatchTransfer::finished, this, &LinkEngine::batchFinished);
+    connect(stream, &FrameStreamer::progress, this, &LinkEngine::streamProgress);
+    connect(stream, &FrameStreamer::frameDone, this, &LinkEngine::streamFrameFinished);
+    connect(stream, &FrameStreamer::finished, this, &LinkEngine::streamFinished);
+    connect(perTest, &PerTest::progress, this, &LinkEngine::onPerTestProgress);
+    connect(perTest, &PerTest::finished, this, &LinkEngine::onPerTestFinished);
+    connect(sweep, &PerSweep::pointDone, this, &LinkEngine::sweepPointFinished);
+    connect(sweep, &PerSweep::finished, this, &LinkEngine::sweepFinished);
+    connect(receiver, &FileReceiver::progress, this, &LinkEngine::receiveProgress);
+    connect(receiver, &FileReceiver::fileReceived, this, &LinkEngine::fileReceived);
+    connect(receiver, &FileReceiver::previewReady, this, &LinkEngine::previewReceived);
+    connect(receiver, &FileReceiver::finished, this, &LinkEngine::receiveFinished);
+    connect(sender, &FileSender::replyLatency, this, &LinkEngine::replyLatency);
+    connect(perTest, &PerTest::replyLatency, this, &LinkEngine::replyLatency);
+}
+
+LinkEngine::~LinkEngine()
+{
+    if (serialPort->isOpen()) {
+        serialPort->close();
+    }
+}
+
+void LinkEngine::registerMetaTypes()
+{
+    qRegisterMetaType<RadioConfig>("RadioConfig");
+    qRegisterMetaType<TransferOptions>("TransferOptions");
+    qRegisterMetaType<TransferStats>("TransferStats");
+    qRegisterMetaType<StripeOptions>("StripeOptions");
+    qRegisterMetaType<BatchOptions>("BatchOptions");
+    qRegisterMetaType<BatchStats>("BatchStats");
+    qRegisterMetaType<StreamOptions>("StreamOptions");
+    qRegisterMetaType<StreamStats>("StreamStats");
+    qRegisterMetaType<PerTestOptions>("PerTestOptions");
+    qRegisterMetaType<PerStats>("PerStats");
+    qRegisterMetaType<ReceiveOptions>("ReceiveOptions");
+    qRegisterMetaType<ReceiveStats>("ReceiveStats");
+    qRegisterMetaType<SweepOptions>("SweepOptions");
+    qRegisterMetaType<SweepPoint>("SweepPoint");
+    qRegisterMetaType<LatencySummary>("LatencySummary");
+}
+
+void LinkEngine::attach(QIODevice *io)
+{
+    if (device != io) {
+        disconnect(device, nullptr, this, nullptr);
+    }
+    device = io;
+    connect(device, &QIODevice::readyRead, this, &LinkEngine::handleReadyRead, Qt::UniqueConnection);
+    connect(device, &QIODevice::bytesWritten, this, &LinkEngine::onBytesWritten, Qt::UniqueConnection);
+}
+
+void LinkEngine::openPort(const QString &portName, int baudRate)
+{
+    if (device->isOpen()) {
+        device->close();
+    }
+    attach(serialPort);
+
+    serialPort->setPortName(portName);
+    serialPort->setBaudRate(baudRate);
+    serialPort->setDataBits(QSerialPort::Data8);
+    serialPort->setParity(QSerialPort::NoParity);
+    serialPort->setStopBits(QSerialPort::OneStop);
+    serialPort->setFlowControl(QSerialPort::NoFlowControl);
+
+    if (!serialPort->open(QIODevice::ReadWrite)) {
+        emit portError(portName + " open failed: " + serialPort->errorString());
+        return;
+    }
+    linkOpened(portName, baudRate);
+}
+
+void LinkEngine::openDevice(QIODevice *io, const QString &name, int baudRate)
+{
+    if (device->isOpen()) {
+        device->close();
+    }
+    attach(io);
+    if (!io->isOpen() && !io->open(QIODevice::ReadWrite)) {
+        emit portError(name + " open failed: " + io->errorString());
+        attach(serialPort);
+        return;
+    }
+    linkOpened(name, baudRate);
+}
+
+void LinkEngine::linkOpened(const QString &name, int baudRate)
+{
+    parser.reset();
+    commands->clear();
+    this->baudRate = baudRate;
+    rtoEstimator.setBaudRate(baudRate);
+    sendCommand(QByteArrayLiteral("AT+NWM=0\r\n"));
+    latencyTimer->start();
+    emit portOpened(name);
+}
+
+void LinkEngine::closePort()
+{
+    batch->stop();
+    stream->stop();
+    striped->stop();
+    sender->stop();
+    sweep->stop();
+    perTest->stop();
+    receiver->stop();
+    latencyTimer->stop();
+    commands->clear();
+    if (device->isOpen()) {
+        device->close();
+    }
+    attach(serialPort);
+    emit portClosed();
+}
+
+void LinkEngine::sendCommand(const QByteArray &command)
+{
+    if (!device->isOpen()) {
+        return;
+    }
+    //拼好的PSEND(丢包率测试包)也按帧排队, 等TX DONE
+    static const int SendPrefix = 9;   // AT+PSEND=
+    if (command.startsWith("AT+PSEND=")) {
+        int payloadBytes = (command.size() - SendPrefix - 2) / 2;
+        commands->enqueueFrame(command.constData(), command.size(), rtoEstimator.txDoneTimeout(payloadBytes));
+    } else {
+        commands->enqueue(command.constData(), command.size());
+    }
+}
+
+void LinkEngine::queueCommand(const QByteArray &command, const AtCommandQueue::Callback &done)
+{
+    if (!device->isOpen()) {
+        done(false);
+        return;
+    }
+    commands->enqueue(command.constData(), command.size(), AtCommandQueue::DefaultTimeoutMs,
+                      AtCommandQueue::DefaultRetries, done);
+}
+
+void LinkEngine::writeCommand(const char *data, int size, bool frame)
+{
+    capture.record(SerialCapture::Tx, data, size);
+    if (frame) {
+        packetTracer.onWrite();
+    }
+    device->write(data, size);
+}
+
+bool LinkEngine::sendPayload(const QByteArray &payload)
+{
+    return sendFrame(TxFrame::fromPayload(payload));
+}
+
+bool LinkEngine::sendFrame(const TxFrame &frame)
+{
+    if (!device->isOpen()) {
+        return false;
+    }
+    int length;
+    const char *command = framer.build(frame, &length);
+    if (!command) {
+        qWarning() << "payload too long:" << frame.headerSize + frame.size;
+        return false;
+    }
+    //TX DONE超时按这一包的空口时间算
+    commands->enqueueFrame(command, length, rtoEstimator.txDoneTimeout(frame.headerSize + frame.size));
+    return true;
+}
+
+void LinkEngine::prefetchFrame(const TxFrame &frame)
+{
+    if (!device->isOpen() || !commands->prefetchEnabled() || (frame.size > 0 && !frame.data)) {
+        return;
+    }
+    int length;
+    const char *command = prefetchFramer.build(frame, &length);
+    if (command) {
+        commands->prefetchFrame(command, length);
+    }
+}
+
+void LinkEngine::writeConfig(const RadioConfig &config)
+{
+    LoraModulation modulation;
+    modulation.spreadingFactor = config.spreadingFactor;
+    modulation.bandwidthKhz = config.bandwidth;
+    modulation.codingRate = LoraAirtime::codingRateFromIndex(config.codingRate);
+    modulation.preamble = config.preamble;
+    rtoEstimator.configure(modulation, baudRate);
+    radio = config;
+
+    //    confCmd = "AT+NWM=0r\n";
+    //    serialPort.write(confCmd.toLocal8Bit());
+    //    QThread::msleep(1000);  // 睡眠500毫秒
+
+    //按顺序回, 最后一条回完时前面的都回完了; 中间有失败的记下来
+    configOk = true;
+    AtCommandQueue::Callback step = [this](bool ok) {
+        configOk = configOk && ok;
+    };
+    queueCommand("AT+PRECV=0\r\n", step);
+    queueCommand("AT+PFREQ=" + config.frequency.toLatin1() + "\r\n", step);
+    queueCommand("AT+PBW=" + QByteArray::number(config.bandwidth) + "\r\n", step);
+    queueCommand("AT+PSF=" + QByteArray::number(config.spreadingFactor) + "\r\n", step);
+    queueCommand("AT+PCR=" + QByteArray::number(config.codingRate) + "\r\n", step);   // 和crBox的顺序一致
+    queueCommand("AT+PTP=" + QByteArray::number(config.txPower) + "\r\n", step);
+    queueCommand("AT+PPL=" + QByteArray::number(config.preamble) + "\r\n", step);
+
+    QByteArray syncWord = (config.spreadingFactor == 5 || config.spreadingFactor == 6)
+        ? QByteArrayLiteral("AT+SYNCWORD=1424\r\n") : QByteArrayLiteral("AT+SYNCWORD=3444\r\n");
+    queueCommand(syncWord, [this](bool ok) {
+        emit configApplied(ok && configOk);
+    });
+    emit radioConfigChanged(config);
+}
+
+void LinkEngine::setPipelineDepth(int depth)
+{
+    commands->setDepth(depth);
+}
+
+void LinkEngine::setUartPrefetch(bool enabled)
+{
+    commands->setPrefetch(enabled);
+}
+
+void LinkEngine::negotiateBaudRate(int target)
+{
+    if (!device->isOpen() || target == baudRate) {
+        emit baudRateNegotiated(target == baudRate, baudRate);
+        return;
+    }
+
+    //模块按原波特率回OK之后才换, 换完发AT探一下, 不通两边都退回(模块没换的情况)
+    int previous = baudRate;
+    queueCommand("AT+BAUD=" + QByteArray::number(target) + "\r\n", [this, target, previous](bool ok) {
+        if (!ok) {
+            emit baudRateNegotiated(false, previous);
+            return;
+        }
+        applyBaudRate(target);
+        queueCommand(QByteArrayLiteral("AT\r\n"), [this, target, previous](bool ok) {
+            if (!ok) {
+                applyBaudRate(previous);
+            }
+            emit baudRateNegotiated(ok, ok ? target : previous);
+        });
+    });
+}
+
+void LinkEngine::applyBaudRate(int rate)
+{
+    //换的瞬间收到的乱码按未知行丢掉, 解析器不用重置
+    if (device == serialPort) {
+        serialPort->setBaudRate(rate);
+    }
+    baudRate = rate;
+    rtoEstimator.setBaudRate(rate);
+}
+
+void LinkEngine::setAckTimeout(int ms)
+{
+    rtoEstimator.setFixedTimeout(ms);
+}
+
+void LinkEngine::startTransfer(const TransferOptions &options)
+{
+    batch->stop();
+    stream->stop();
+    striped->stop();
+    sweep->stop();
+    perTest->stop();
+    receiver->stop();
+    packetTracer.reset();
+    sender->start(options);
+}
+
+void LinkEngine::startStripedTransfer(const StripeOptions &options)
+{
+    batch->stop();
+    stream->stop();
+    sweep->stop();
+    perTest->stop();
+    receiver->stop();
+    packetTracer.reset();
+    striped->start(options);
+}
+
+void LinkEngine::startBatch(const BatchOptions &options)
+{
+    stream->stop();
+    striped->stop();
+    sweep->stop();
+    perTest->stop();
+    receiver->stop();
+    packetTracer.reset();
+    batch->start(options);
+}
+
+void LinkEngine::startStream(const StreamOptions &options)
+{
+    batch->stop();
+    striped->stop();
+    sweep->stop();
+    perTest->stop();
+    receiver->stop();
+    packetTracer.reset();
+    stream->start(options);
+}
+
+void LinkEngine::startStripe(const TransferOptions &options, StripeQueue *queue)
+{
+    sweep->stop();
+    perTest->stop();
+    receiver->stop();
+    packetTracer.reset();
+    sender->start(options, queue);
+}
+
+void LinkEngine::stopTransfer()
+{
+    batch->stop();
+    stream->stop();
+    striped->stop();
+    sender->stop();
+}
+
+void LinkEngine::onSenderProgress(const TransferStats &stats)
+{
+    if (striped->isRunning()) {
+        striped->linkProgress(this, stats);
+        return;
+    }
+    emit transferProgress(stats);
+    if (batch->isRunning()) {
+        batch->fileProgress(stats);
+    } else if (stream->isRunning()) {
+        stream->frameProgress(stats);
+    }
+}
+
+void LinkEngine::onSenderFinished(bool ok, const QString &message)
+{
+    if (striped->isRunning()) {
+        striped->linkFinished(this, ok, message);
+    } else if (batch->isRunning()) {
+        batch->fileFinished(ok, message);
+    } else if (stream->isRunning()) {
+        stream->frameFinished(ok, message);
+    } else {
+        emit transferFinished(ok, message);
+    }
+}
+
+void LinkEngine::startPerTest(const PerTestOptions &options)
+{
+    batch->stop();
+    stream->stop();
+    striped->stop();
+    sender->stop();
+    sweep->stop();
+    receiver->stop();
+    packetTracer.reset();
+    perTest->start(options);
+}
+
+void LinkEngine::stopPerTest()
+{
+    sweep->stop();
+    perTest->stop();
+}
+
+void LinkEngine::startSweep(const SweepOptions &options)
+{
+    batch->stop();
+    stream->stop();
+    striped->stop();
+    sender->stop();
+    perTest->stop();
+    receiver->stop();
+    packetTracer.reset();
+    sweep->start(options);
+}
+
+void LinkEngine::stopSweep()
+{
+    sweep->stop();
+}
+
+void LinkEngine::onPerTestProgress(const PerStats &stats)
+{
+    emit perTestProgress(stats);
+    if (sweep->isRunning()) {
+        sweep->pointProgress(stats);
+    }
+}
+
+void LinkEngine::onPerTestFinished()
+{
+    if (sweep->isRunning()) {
+        sweep->pointFinished();
+    } else {
+        emit perTestFinished();
+    }
+}
+
+void LinkEngine::startCapture(const QString &path)
+{
+    if (path.isEmpty()) {
+        capture.stop();
+        return;
+    }
+    QString error;
+    if (!capture.start(path, &error)) {
+        emit portError("capture failed: " + error);
+    }
+}
+
+void LinkEngine::exportLatency(const QString &path)
+{
+    QString error;
+    if (!packetTracer.save(path, &error)) {
+        emit portError("latency export failed: " + error);
+    }
+}
+
+void LinkEngine::onLatencyTimer()
+{
+    if (packetTracer.takeChanged()) {
+        emit latencySummary(packetTracer.summary());
+    }
+}
+
+void LinkEngine::startReceive(const ReceiveOptions &options)
+{
+    batch->stop();
+    stream->stop();
+    striped->stop();
+    sender->stop();
+    sweep->stop();
+    perTest->stop();
+    receiver->start(options);
+}
+
+void LinkEngine::stopReceive()
+{
+    receiver->stop();
+}
+
+void LinkEngine::handleReadyRead()
+{
+    char buffer[1024];
+    qint64 size;
+    while ((size = device->read(buffer, sizeof(buffer))) > 0) {
+        capture.record(SerialCapture::Rx, buffer, static_cast<int>(size));
+        emit dataReceived(QByteArray(buffer, static_cast<int>(size)));
+
+        //按行解析, 半行留在解析器里等下一次
+        parser.feed(buffer, static_cast<int>(size));
+    }
+}
+
+void LinkEngine::onBytesWritten()
+{
+    //驱动缓冲里的不算, QSerialPort自己的写缓冲清空就当串口发完
+    if (device->bytesToWrite() == 0) {
+        packetTracer.onDrained();
+    }
+}
+
+void LinkEngine::onAtEvent(const AtEvent &event)
+{
+    //先让命令队列对上OK/ERROR/TX DONE, 补写下一条
+    commands->handleEvent(event);
+
+    switch (event.type) {
+    case AtEvent::RxP2P:
+        emit uplinkQuality(event.rssi, event.snr);
+        break;
+
+    case AtEvent::Ack:
+        packetTracer.onReply();
+        qCDebug(lcLink) << "ACK";
+        if (event.hasLinkInfo) {
+            emit downlinkQuality(event.rssi, event.snr);
+        }
+        break;
+
+    case AtEvent::Sack:
+        packetTracer.onReply();
+        qCDebug(lcLink) << "SACK" << event.expectedSeq << event.bitmap;
+        emit downlinkQuality(event.rssi, event.snr);
+        break;
+
+    case AtEvent::FecStatus:
+        packetTracer.onReply();
+        qCDebug(lcLink) << "FEC" << event.decodedBlocks << event.rank << event.received;
+        emit downlinkQuality(event.rssi, event.snr);
+        break;
+
+    case AtEvent::ResumeAck:
+        packetTracer.onReply();
+        qCDebug(lcLink) << "RESUME" << event.offset;
+        emit downlinkQuality(event.rssi, event.snr);
+        break;
+
+    case AtEvent::Verdict:
+        packetTracer.onReply();
+        qCDebug(lcLink) << "VERDICT" << event.ranges;
+        emit downlinkQuality(event.rssi, event.snr);
+        break;
+
+    case AtEvent::TxDone:
+        packetTracer.onTxDone();
+        qCDebug(lcLink) << "+EVT:TXP2P DONE";
+        break;
+
+    case AtEvent::Error:
+        qCDebug(lcLink) << "AT ERROR";
+        break;
+
+    case AtEvent::Ok:
+        break;
+    }
+
+    //不区分测试模式还是图传, 各自只处理自己运行时的事件
+    sender->handleEvent(event);
+    perTest->handleEvent(event);
+    sweep->handleEvent(event);
+    receiver->handleEvent(event);
+}
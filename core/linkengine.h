@@ -0,0 +1,149 @@
+#ifndef LINKENGINE_H
+#define LINKENGINE_H
+
+#include <QObject>
+#include <QSerialPort>
+#include <QTimer>
+#include "atcommandqueue.h"
+#include "atframer.h"
+#include "atparser.h"
+#include "linktypes.h"
+#include "packettracer.h"
+#include "rtoestimator.h"
+#include "serialcapture.h"
+
+class FileReceiver;
+class FileSender;
+class BatchTransfer;
+class FrameStreamer;
+class PerSweep;
+class PerTest;
+class StripedTransfer;
+class StripeQueue;
+
+// 串口和协议引擎, 运行在工作线程里
+// 串口读写, 响应解析, 图传和丢包率测试的状态机都在这里, 全部由事件驱动;
+// 界面只通过排队的信号槽和它交互
+class LinkEngine : public QObject, public AtEventHandler, public AtCommandWriter
+{
+    Q_OBJECT
+
+public:
+    static const int LatencyIntervalMs = 500;   // 延迟统计刷新间隔
+
+    explicit LinkEngine(QObject *parent = nullptr);
+    ~LinkEngine();
+
+    static void registerMetaTypes();
+
+    bool isOpen() const { return device->isOpen(); }
+    RadioConfig radioConfig() const { return radio; }
+    RtoEstimator *rto() { return &rtoEstimator; }
+    const RtoEstimator *rto() const { return &rtoEstimator; }
+    int pipelineDepth() const { return commands->depth(); }
+    bool uartPrefetch() const { return commands->prefetchEnabled(); }
+    int currentBaudRate() const { return baudRate; }
+    PacketTracer *tracer() { return &packetTracer; }
+    const PacketTracer *tracer() const { return &packetTracer; }
+
+    bool sendPayload(const QByteArray &payload);    // AT+PSEND=<hex>\r\n, 串口没开或超长返回false
+    bool sendFrame(const TxFrame &frame);           // 同上, 帧头+数据指针, 不分配内存
+    void prefetchFrame(const TxFrame &frame);       // 下一包, 当前包在空口上时先写到模块(打开预写时)
+    void queueCommand(const QByteArray &command, const AtCommandQueue::Callback &done);   // 回OK/失败时调用done
+    // 用任意QIODevice代替串口(测试里的假模块等), 设备归调用方; 没打开的按读写打开
+    void openDevice(QIODevice *device, const QString &name, int baudRate);
+    void startStripe(const TransferOptions &options, StripeQueue *queue);  // 作为分条传输的一条链路发
+
+    void onAtEvent(const AtEvent &event) override;
+    void writeCommand(const char *data, int size, bool frame) override;
+
+public slots:
+    void sendCommand(const QByteArray &command);    // 原始AT命令, 需要自带\r\n
+    void openPort(const QString &portName, int baudRate);
+    void closePort();
+    void writeConfig(const RadioConfig &config);
+    void setPipelineDepth(int depth);   // 同时等回复的AT命令条数
+    void setUartPrefetch(bool enabled);
+    void negotiateBaudRate(int baudRate);   // AT+BAUD, 两边一起换, 换完不通就退回
+    void setAckTimeout(int ms);     // >0 固定超时, 0 = 按空口时间和实测RTT自适应
+    void startTransfer(const TransferOptions &options);
+    void startStripedTransfer(const StripeOptions &options);
+    void startBatch(const BatchOptions &options);
+    void startStream(const StreamOptions &options);
+    void stopTransfer();
+    void startPerTest(const PerTestOptions &options);
+    void stopPerTest();
+    void startSweep(const SweepOptions &options);
+    void stopSweep();
+    void startReceive(const ReceiveOptions &options);
+    void stopReceive();
+    void startCapture(const QString &path);     // 空路径停止抓包
+    void exportLatency(const QString &path);    // .json 或 CSV
+
+signals:
+    void portOpened(const QString &portName);
+    void portClosed();
+    void portError(const QString &message);
+    void commandFailed(const QByteArray &command, const QString &reason);
+    void configApplied(bool ok);    // writeConfig的命令全部回完
+    void baudRateNegotiated(bool ok, int baudRate);     // baudRate是之后实际用的
+    void dataReceived(const QByteArray &data);
+    void uplinkQuality(int rssi, int snr);
+    void downlinkQuality(int rssi, int snr);
+    void transferProgress(const TransferStats &stats);
+    void transferFinished(bool ok, const QString &message);
+    void batchProgress(const BatchStats &stats);
+    void batchFileFinished(const BatchStats &stats, bool ok, const QString &message);
+    void batchFinished(const BatchStats &stats);
+    void streamProgress(const StreamStats &stats);
+    void streamFrameFinished(const StreamStats &stats, bool ok, const QString &message);
+    void streamFinished(const StreamStats &stats);
+    void perTestProgress(const PerStats &stats);
+    void perTestFinished();
+    void sweepPointFinished(const SweepPoint &point, int index, int count);
+    void sweepFinished(bool ok, const QString &message);
+    void receiveProgress(const ReceiveStats &stats);
+    void fileReceived(const QString &path);
+    void previewReceived(const QString &path, int layers);  // 渐进式JPEG收到前几层的预览
+    void receiveFinished();
+    void radioConfigChanged(const RadioConfig &config);     // 自适应速率切换参数时也会发
+    void replyLatency(double ms);
+    void latencySummary(const LatencySummary &summary);    // 有新样本时定时发
+
+private slots:
+    void handleReadyRead();
+    void onBytesWritten();
+    void onLatencyTimer();
+    void onSenderProgress(const TransferStats &stats);
+    void onSenderFinished(bool ok, const QString &message);
+    void onPerTestProgress(const PerStats &stats);
+    void onPerTestFinished();
+
+private:
+    void applyBaudRate(int baudRate);
+    void attach(QIODevice *device);
+    void linkOpened(const QString &name, int baudRate);
+
+    QSerialPort *serialPort;
+    QIODevice *device;          //当前读写的设备, 一般就是serialPort
+    AtParser parser;            //串口响应按行解析
+    AtFramer framer;            //PSEND命令拼装
+    AtFramer prefetchFramer;    //预写的下一包单独拼, 不覆盖正在排队的那包
+    AtCommandQueue *commands;   //AT命令排队, 对上OK/ERROR
+    bool configOk = true;
+    FileSender *sender;
+    FileReceiver *receiver;
+    PerTest *perTest;
+    PerSweep *sweep;            //扫参, 逐点跑上面的perTest
+    StripedTransfer *striped;   //分条传输, 本端是第一条链路
+    BatchTransfer *batch;       //批量传输, 用上面的sender逐个发
+    FrameStreamer *stream;      //连续图传, 用上面的sender发最新的帧
+    RtoEstimator rtoEstimator;  //应答超时
+    RadioConfig radio;          //最近一次下发的射频参数
+    int baudRate = 115200;
+    SerialCapture capture;      //串口原始数据抓包
+    PacketTracer packetTracer;  //单包各阶段延迟
+    QTimer *latencyTimer;
+};
+
+#endif // LINKENGINE_H
@@ -0,0 +1,10 @@
+#ifndef LINKLOG_H
+#define LINKLOG_H
+
+#include <QLoggingCategory>
+
+// 链路引擎的调试日志, 默认关: 每包的应答/TX DONE都在这里, 开着会拖慢收发
+// 需要时用 QT_LOGGING_RULES="ism.link.debug=true" 打开
+Q_DECLARE_LOGGING_CATEGORY(lcLink)
+
+#endif // LINKLOG_H
@@ -0,0 +1,207 @@
+#ifndef LINKTYPES_H
+#define LINKTYPES_H
+
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// 界面和链路引擎(工作线程)之间传递的参数和统计, 都按值通过排队信号传递
+
+struct RadioConfig {
+    QString frequency = "915000000";   // Hz
+    int bandwidth = 125;                // kHz
+    int spreadingFactor = 5;
+    int codingRate = 0;                 // crBox索引: 0..2 = 4/5..4/7, 3..5 = 长交织4/5..4/7
+    int preamble = 8;
+    int txPower = 22;
+};
+
+struct TransferOptions {
+    QString filePath;
+    int mtu = 100;
+    int window = 8;     // 1 = 停等协议
+    int fecBlock = 0;   // >0: 纠删码传输, 每个源块的符号数
+    bool adaptive = false;  // 窗口模式下按SNR和丢包自动调SF/MTU
+    bool resume = true;     // 窗口模式下按会话日志和对端协商续传
+    bool chained = false;   // 批量传输后面还有文件: 不发结束包, 由下一个文件的开始包结束
+    bool delta = false;     // 窗口模式下和上一次送达的版本比, 对端有这个版本就只发差量
+    QString deltaCacheDir;  // 差量基准缓存目录, 空用默认目录
+    int layers = 0;         // 渐进式JPEG只发前几个扫描, 0 = 全发
+    bool checked = false;   // 窗口模式下每块带CRC32C, 收完按整个文件的CRC校验, 对不上只补坏的段
+};
+
+struct TransferStats {
+    qint64 fileSize = 0;
+    qint64 bytesAcked = 0;
+    int packetsSent = 0;
+    int ackReceived = 0;
+    int retries = 0;
+    qint64 elapsedMs = 0;
+    bool windowMode = false;
+    bool fecMode = false;
+    double lossRate = 0;    // 纠删码模式估计的丢包率
+    int spreadingFactor = 0;    // 当前SF和MTU, 自适应模式会变
+    int mtu = 0;
+    int rateSwitches = 0;
+    qint64 resumedFrom = 0;     // 续传时对端已有的字节数
+    qint64 deltaTargetSize = 0; // 差量传输时重建出的文件大小, fileSize是差量的大小
+    int links = 1;              // 分条传输的链路数, 和还在发的
+    int activeLinks = 1;
+    int layers = 0;             // JPEG的扫描数(发的), 不是JPEG为0
+    int layersAcked = 0;        // 对端已连续收全的扫描数, 收到第一个就能出预览
+    qint64 firstLayerMs = 0;    // 第一个扫描确认完的时间
+    bool checked = false;       // 对端接受了校验模式
+    int repairRounds = 0;       // 结束时校验没过, 补发的轮数
+    qint64 repairBytes = 0;     // 补发的段的字节数
+};
+
+// 一个文件分条走几个串口(各接一个模块, 各用一个频点)同时发
+struct StripeOptions {
+    TransferOptions transfer;
+    QStringList ports;          // 除当前串口以外的串口
+    QStringList frequencies;    // 每条链路的频点, 第一个给当前串口; 不够的沿用当前频点
+    int baudRate = 115200;
+};
+
+// 批量传输: 一串文件连着发, 下一个文件在当前文件发送时读好
+struct BatchOptions {
+    TransferOptions transfer;   // 每个文件的参数, 不用filePath
+    QStringList paths;          // 文件或目录, 目录取里面的文件按名字排序
+};
+
+struct BatchStats {
+    int fileIndex = 0;          // 当前文件, 从0开始
+    int fileCount = 0;
+    int filesDone = 0;
+    int filesFailed = 0;
+    qint64 totalBytes = 0;
+    qint64 bytesDone = 0;       // 各文件已确认的字节数之和
+    qint64 elapsedMs = 0;
+    QString fileName;
+    TransferStats current;      // 当前文件, 单个文件的速率从这里算
+};
+
+// 连续图传: 一直发最新的一帧, 发不过来的旧帧丢掉
+struct StreamOptions {
+    TransferOptions transfer;   // 每帧的参数, 不用filePath, 不续传
+    QString directory;          // 相机往这个目录写图, 最新修改的文件算一帧
+    QString command;            // 或者: 相机命令, 标准输出是连着的JPEG(MJPEG)
+    int pollMs = 100;           // 目录轮询间隔
+    double preemptBelow = 0.5;  // 新帧到时当前帧确认不到这个比例就打断, 0 = 不打断, 发完再跳到最新的
+    int maxFrames = 0;          // 送达这么多帧结束, 0 = 一直发
+};
+
+struct StreamStats {
+    quint64 framesCaptured = 0;
+    quint64 framesDelivered = 0;
+    quint64 framesDropped = 0;      // 还没开始发就被更新的帧顶掉
+    quint64 framesPreempted = 0;    // 发到一半被更新的帧打断
+    quint64 framesFailed = 0;
+    qint64 bytesDelivered = 0;      // 送达的帧的大小之和, 被打断的帧发出去的不算
+    double lastAgeMs = 0;           // 帧龄: 送达时距采集(目录里的按修改时间)多久
+    double ageMeanMs = 0;
+    double ageP50Ms = 0;
+    double ageP99Ms = 0;
+    double ageMaxMs = 0;
+    qint64 elapsedMs = 0;
+    QString fileName;               // 当前帧
+    TransferStats current;
+};
+
+struct PerTestOptions {
+    int mtu = 100;
+    quint64 maxPackets = 512;   // 收到这么多ACK结束
+    quint64 maxSent = 0;        // 发了这么多包结束, 0 = 不限
+    quint64 minSent = 0;        // 至少发这么多包才看置信区间
+    double ciHalfWidth = 0;     // 成功率95%置信区间半宽小于这个就提前结束, 0 = 不提前
+};
+
+struct PerStats {
+    quint64 sent = 0;
+    quint64 acked = 0;
+    int mtu = 0;
+    qint64 elapsedMs = 0;
+};
+
+struct ReceiveOptions {
+    QString outputDir;
+};
+
+struct ReceiveStats {
+    QString fileName;
+    qint64 fileSize = 0;        // 停等协议的开始包不带大小, 为0
+    qint64 bytesReceived = 0;
+    quint64 packetsReceived = 0;
+    quint64 duplicates = 0;
+    quint64 repliesSent = 0;
+    int filesCompleted = 0;
+    int rssi = 0;               // 本端测到的最近一包
+    int snr = 0;
+    bool windowMode = false;
+    bool fecMode = false;
+    qint64 resumedFrom = 0;
+    int previewLayers = 0;      // 渐进式JPEG已出预览的扫描数
+    bool checked = false;       // 校验模式
+    quint64 crcErrors = 0;      // CRC对不上丢掉的块
+    int repairRounds = 0;       // 收完校验没过, 要补发的次数
+    qint64 elapsedMs = 0;       // 当前文件从开始包算
+};
+
+//扫参: 各维度的取值做笛卡尔积, 空的维度用当前参数
+struct SweepOptions {
+    QStringList frequencies;        // Hz
+    QVector<int> bandwidths;        // kHz
+    QVector<int> spreadingFactors;
+    QVector<int> codingRates;       // crBox索引
+    QVector<int> preambles;
+    QVector<int> mtus;
+    quint64 packetsPerPoint = 200;  // 每个点最多发这么多包
+    quint64 minPackets = 30;
+    double ciHalfWidth = 0.02;      // 0 = 每个点都发满
+};
+
+struct SweepPoint {
+    RadioConfig radio;
+    int mtu = 0;
+    bool reachable = false;     // 调参包没有应答, 这个点没测
+    quint64 sent = 0;
+    quint64 acked = 0;
+    double per = 0;             // 丢包率 0~1
+    double perLow = 0;          // 95%置信区间(Wilson)
+    double perHigh = 0;
+    double goodputKbps = 0;     // 确认的负载字节 / 这个点的用时
+    qint64 elapsedMs = 0;
+};
+
+//单包延迟的一个阶段, 从直方图取的分位数
+struct LatencyStage {
+    QString name;               // uart / air / reply / total / retransmit
+    quint64 count = 0;
+    double p50Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+};
+
+struct LatencySummary {
+    QVector<LatencyStage> stages;
+    double uartShare = 0;       // 串口时间占(串口+空口)的比例, 剩下的是空口
+};
+
+Q_DECLARE_METATYPE(RadioConfig)
+Q_DECLARE_METATYPE(TransferOptions)
+Q_DECLARE_METATYPE(TransferStats)
+Q_DECLARE_METATYPE(StripeOptions)
+Q_DECLARE_METATYPE(BatchOptions)
+Q_DECLARE_METATYPE(BatchStats)
+Q_DECLARE_METATYPE(StreamOptions)
+Q_DECLARE_METATYPE(StreamStats)
+Q_DECLARE_METATYPE(PerTestOptions)
+Q_DECLARE_METATYPE(PerStats)
+Q_DECLARE_METATYPE(ReceiveOptions)
+Q_DECLARE_METATYPE(ReceiveStats)
+Q_DECLARE_METATYPE(SweepOptions)
+Q_DECLARE_METATYPE(SweepPoint)
+Q_DECLARE_METATYPE(LatencySummary)
+
+#endif // LINKTYPES_H
@@ -0,0 +1,57 @@
+#include "loraairtime.h"
+#include <QtMath>
+
+namespace LoraAirtime {
+
+int codingRateFromIndex(int index)
+{
+    //长交织(CR_LI_x)的空口长度和同编码率的普通模式相近, 按普通模式计算
+    return (index % 3) + 1;
+}
+
+double symbolTimeMs(const LoraModulation &modulation)
+{
+    return static_cast<double>(1 << modulation.spreadingFactor) / modulation.bandwidthKhz;
+}
+
+bool lowDataRateOptimize(const LoraModulation &modulation)
+{
+    //符号时间超过16ms时必须打开LDRO
+    return symbolTimeMs(modulation) > 16.0;
+}
+
+double payloadSymbols(const LoraModulation &modulation, int payloadBytes)
+{
+    const int sf = modulation.spreadingFactor;
+    const int crcBits = modulation.crcOn ? 16 : 0;
+    const int headerSymbols = modulation.explicitHeader ? 20 : 0;
+
+    int numerator;
+    int denominator;
+    if (sf < 7) {
+        numerator = 8 * payloadBytes + crcBits - 4 * sf + headerSymbols;
+        denominator = 4 * sf;
+    } else {
+        numerator = 8 * payloadBytes + crcBits - 4 * sf + 8 + headerSymbols;
+        denominator = lowDataRateOptimize(modulation) ? 4 * (sf - 2) : 4 * sf;
+    }
+
+    int blocks = qCeil(static_cast<double>(qMax(numerator, 0)) / denominator);
+    return 8 + blocks * (modulation.codingRate + 4);
+}
+
+double timeOnAirMs(const LoraModulation &modulation, int payloadBytes)
+{
+    double preambleSymbols = modulation.preamble + (modulation.spreadingFactor < 7 ? 6.25 : 4.25);
+    return (preambleSymbols + payloadSymbols(modulation, payloadBytes)) * symbolTimeMs(modulation);
+}
+
+double uartTimeMs(int bytes, int baudRate)
+{
+    if (baudRate <= 0) {
+        return 0.0;
+    }
+    return bytes * 10 * 1000.0 / baudRate;
+}
+
+}
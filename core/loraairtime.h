@@ -0,0 +1,29 @@
+#ifndef LORAAIRTIME_H
+#define LORAAIRTIME_H
+
+// LoRa 空口时间计算 (SX126x 数据手册 6.1.4 的公式, SF5/SF6 的前导码和负载符号数单独处理)
+struct LoraModulation {
+    int spreadingFactor = 5;
+    int bandwidthKhz = 125;
+    int codingRate = 1;         // 1..4 对应 4/5..4/8
+    int preamble = 8;
+    bool crcOn = true;
+    bool explicitHeader = true;
+};
+
+namespace LoraAirtime {
+
+// crBox 的索引转成编码率: CR_4_5/CR_4_6/CR_4_7 以及对应的长交织版本
+int codingRateFromIndex(int index);
+
+double symbolTimeMs(const LoraModulation &modulation);
+bool lowDataRateOptimize(const LoraModulation &modulation);
+double payloadSymbols(const LoraModulation &modulation, int payloadBytes);
+double timeOnAirMs(const LoraModulation &modulation, int payloadBytes);
+
+// 串口传输时间, 8N1 每字节10位
+double uartTimeMs(int bytes, int baudRate);
+
+}
+
+#endif // LORAAIRTIME_H
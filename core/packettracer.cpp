@@ -0,0 +1,181 @@
+#include "packettracer.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+static double toMs(qint64 ns)
+{
+    return ns / 1000000.0;
+}
+
+PacketTracer::PacketTracer()
+{
+    clock.start();
+}
+
+const char *PacketTracer::stageName(int stage)
+{
+    static const char *const names[StageCount] = { "uart", "air", "reply", "total", "retransmit" };
+    return names[stage];
+}
+
+void PacketTracer::reset()
+{
+    for (int i = 0; i < StageCount; i++) {
+        stages[i].reset();
+    }
+    writeAt = -1;
+    drainAt = -1;
+    txDoneAt = -1;
+    replied = false;
+    changed = true;     // 让界面也清掉
+}
+
+void PacketTracer::onWrite()
+{
+    writeAt = now();
+    drainAt = -1;
+    txDoneAt = -1;
+    replied = false;
+}
+
+void PacketTracer::onDrained()
+{
+    if (writeAt < 0 || drainAt >= 0) {
+        return;
+    }
+    drainAt = now();
+    stages[Uart].record(drainAt - writeAt);
+    changed = true;
+}
+
+void PacketTracer::onTxDone()
+{
+    if (writeAt < 0 || txDoneAt >= 0) {
+        return;
+    }
+    txDoneAt = now();
+    //没等到缓冲清空的通知就不拆, 只记总时间
+    if (drainAt >= 0) {
+        stages[Air].record(txDoneAt - drainAt);
+        changed = true;
+    }
+}
+
+void PacketTracer::onReply()
+{
+    //同一包的重复应答只记第一次
+    if (writeAt < 0 || replied) {
+        return;
+    }
+    qint64 at = now();
+    if (txDoneAt >= 0) {
+        stages[Reply].record(at - txDoneAt);
+    }
+    stages[Total].record(at - writeAt);
+    replied = true;
+    changed = true;
+}
+
+void PacketTracer::onRetransmit()
+{
+    if (writeAt < 0) {
+        return;
+    }
+    stages[Retransmit].record(now() - writeAt);
+    changed = true;
+}
+
+bool PacketTracer::takeChanged()
+{
+    bool result = changed;
+    changed = false;
+    return result;
+}
+
+LatencySummary PacketTracer::summary() const
+{
+    LatencySummary result;
+    for (int i = 0; i < StageCount; i++) {
+        LatencyStage stage;
+        stage.name = stageName(i);
+        stage.count = stages[i].count();
+        stage.p50Ms = toMs(stages[i].percentile(50));
+        stage.p99Ms = toMs(stages[i].percentile(99));
+        stage.maxMs = toMs(stages[i].max());
+        result.stages.append(stage);
+    }
+
+    //按总时间算, 不是按中位数: 预写之后串口段大多接近0
+    double uart = stages[Uart].mean() * stages[Uart].count();
+    double air = stages[Air].mean() * stages[Air].count();
+    result.uartShare = (uart + air) > 0 ? uart / (uart + air) : 0.0;
+    return result;
+}
+
+QJsonObject PacketTracer::toJson() const
+{
+    QJsonObject root;
+    for (int i = 0; i < StageCount; i++) {
+        const LatencyHistogram &h = stages[i];
+        QJsonObject stage;
+        stage["count"] = static_cast<double>(h.count());
+        stage["minMs"] = toMs(h.min());
+        stage["meanMs"] = h.mean() / 1000000.0;
+        stage["p50Ms"] = toMs(h.percentile(50));
+        stage["p90Ms"] = toMs(h.percentile(90));
+        stage["p99Ms"] = toMs(h.percentile(99));
+        stage["p999Ms"] = toMs(h.percentile(99.9));
+        stage["maxMs"] = toMs(h.max());
+
+        //只导非空桶: [下界ns, 上界ns, 样本数]
+        QJsonArray buckets;
+        for (int b = 0; b < h.bucketCount(); b++) {
+            if (h.bucketSamples(b) == 0) {
+                continue;
+            }
+            QJsonArray bucket;
+            bucket.append(static_cast<double>(LatencyHistogram::bucketLower(b)));
+            bucket.append(static_cast<double>(LatencyHistogram::bucketUpper(b)));
+            bucket.append(static_cast<double>(h.bucketSamples(b)));
+            buckets.append(bucket);
+        }
+        stage["buckets"] = buckets;
+        root[stageName(i)] = stage;
+    }
+    return root;
+}
+
+QByteArray PacketTracer::toCsv() const
+{
+    QByteArray csv("stage,lower_ns,upper_ns,count\n");
+    for (int i = 0; i < StageCount; i++) {
+        const LatencyHistogram &h = stages[i];
+        for (int b = 0; b < h.bucketCount(); b++) {
+            if (h.bucketSamples(b) == 0) {
+                continue;
+            }
+            csv += stageName(i);
+            csv += "," + QByteArray::number(LatencyHistogram::bucketLower(b));
+            csv += "," + QByteArray::number(LatencyHistogram::bucketUpper(b));
+            csv += "," + QByteArray::number(h.bucketSamples(b));
+            csv += '\n';
+        }
+    }
+    return csv;
+}
+
+bool PacketTracer::save(const QString &path, QString *error) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = path + ": " + file.errorString();
+        return false;
+    }
+    if (path.endsWith(".json", Qt::CaseInsensitive)) {
+        file.write(QJsonDocument(toJson()).toJson());
+    } else {
+        file.write(toCsv());
+    }
+    return true;
+}
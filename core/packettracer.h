@@ -0,0 +1,57 @@
+#ifndef PACKETTRACER_H
+#define PACKETTRACER_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include "latencyhistogram.h"
+#include "linktypes.h"
+
+// 单包延迟追踪, 单调时钟ns
+// 每个PSEND依次打点: 写串口 -> 串口发完(bytesWritten, 缓冲清空) -> +EVT:TXP2P DONE -> 收到应答,
+// 相邻两点的差分别记到各阶段的直方图里, 看时间花在串口, 空口还是主机处理上;
+// 超时重发时记上一次写串口到重发的时间. 模块同时只有一包在发, 只追踪最近一包
+class PacketTracer
+{
+public:
+    enum Stage {
+        Uart,           // 写串口 -> 串口发完
+        Air,            // 串口发完 -> TX DONE, 含模块处理和空口时间
+        Reply,          // TX DONE -> 收到应答
+        Total,          // 写串口 -> 收到应答
+        Retransmit,     // 写串口 -> 超时重发
+        StageCount
+    };
+
+    PacketTracer();
+
+    static const char *stageName(int stage);
+
+    void reset();
+    void onWrite();
+    void onDrained();
+    void onTxDone();
+    void onReply();
+    void onRetransmit();
+
+    const LatencyHistogram &histogram(int stage) const { return stages[stage]; }
+    bool takeChanged();         // 上次取过之后有没有新样本
+    LatencySummary summary() const;
+
+    //导出: .json 是各阶段统计加非空桶, 其它按CSV (stage,lower_ns,upper_ns,count)
+    QJsonObject toJson() const;
+    QByteArray toCsv() const;
+    bool save(const QString &path, QString *error) const;
+
+private:
+    qint64 now() const { return clock.nsecsElapsed(); }
+
+    QElapsedTimer clock;
+    LatencyHistogram stages[StageCount];
+    qint64 writeAt = -1;
+    qint64 drainAt = -1;
+    qint64 txDoneAt = -1;
+    bool replied = false;
+    bool changed = false;
+};
+
+#endif // PACKETTRACER_H
@@ -0,0 +1,259 @@
+#include "persweep.h"
+#include "linkengine.h"
+#include "pertest.h"
+#include <QDebug>
+
+PerSweep::PerSweep(LinkEngine *link, PerTest *perTest) : QObject(link), link(link), perTest(perTest),
+    timer(new QTimer(this))
+{
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &PerSweep::onTimeout);
+}
+
+QVector<SweepPoint> PerSweep::expand(const SweepOptions &options, const RadioConfig &base)
+{
+    QStringList frequencies = options.frequencies.isEmpty() ? QStringList(base.frequency) : options.frequencies;
+    QVector<int> bandwidths = options.bandwidths.isEmpty() ? QVector<int>(1, base.bandwidth) : options.bandwidths;
+    QVector<int> spreadingFactors = options.spreadingFactors.isEmpty() ? QVector<int>(1, base.spreadingFactor) : options.spreadingFactors;
+    QVector<int> codingRates = options.codingRates.isEmpty() ? QVector<int>(1, base.codingRate) : options.codingRates;
+    QVector<int> preambles = options.preambles.isEmpty() ? QVector<int>(1, base.preamble) : options.preambles;
+    QVector<int> mtus = options.mtus.isEmpty() ? QVector<int>(1, PerTestOptions().mtu) : options.mtus;
+
+    //MTU放最里层, 同一组射频参数的几个点连着测, 不用来回调参
+    QVector<SweepPoint> points;
+    for (const QString &frequency : frequencies) {
+        for (int bandwidth : bandwidths) {
+            for (int spreadingFactor : spreadingFactors) {
+                for (int codingRate : codingRates) {
+                    for (int preamble : preambles) {
+                        for (int mtu : mtus) {
+                            SweepPoint point;
+                            point.radio = base;
+                            point.radio.frequency = frequency;
+                            point.radio.bandwidth = bandwidth;
+                            point.radio.spreadingFactor = spreadingFactor;
+                            point.radio.codingRate = codingRate;
+                            point.radio.preamble = preamble;
+                            point.mtu = mtu;
+                            points.append(point);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return points;
+}
+
+bool PerSweep::sameRadio(const RadioConfig &a, const RadioConfig &b)
+{
+    return a.frequency == b.frequency && a.bandwidth == b.bandwidth && a.spreadingFactor == b.spreadingFactor
+            && a.codingRate == b.codingRate && a.preamble == b.preamble;
+}
+
+Protocol::RetuneInfo PerSweep::retuneInfo(const RadioConfig &config)
+{
+    Protocol::RetuneInfo info;
+    info.frequency = config.frequency.toUInt();
+    info.bandwidth = config.bandwidth;
+    info.spreadingFactor = config.spreadingFactor;
+    info.codingRate = config.codingRate;
+    info.preamble = config.preamble;
+    return info;
+}
+
+RadioConfig PerSweep::retuned(RadioConfig config, const Protocol::RetuneInfo &info)
+{
+    config.frequency = QString::number(info.frequency);
+    config.bandwidth = info.bandwidth;
+    config.spreadingFactor = info.spreadingFactor;
+    config.codingRate = info.codingRate;
+    config.preamble = info.preamble;
+    return config;
+}
+
+void PerSweep::start(const SweepOptions &options)
+{
+    stop();
+
+    this->options = options;
+    home = link->radioConfig();
+    current = home;
+    points = expand(options, home);
+    index = -1;
+    returning = false;
+    if (points.isEmpty()) {
+        emit finished(false, "nothing to sweep");
+        return;
+    }
+    nextPoint();
+}
+
+void PerSweep::stop()
+{
+    if (state == Idle) {
+        return;
+    }
+    timer->stop();
+    if (state == Measuring) {
+        perTest->stop();
+    }
+    state = Idle;
+    //对端在别的参数上收不到包会自己退回原参数
+    applyLocal(home);
+}
+
+void PerSweep::nextPoint()
+{
+    index++;
+    if (index >= points.size()) {
+        returning = true;
+        if (sameRadio(current, home)) {
+            finish(true, QString("sweep finished, %1 points").arg(points.size()));
+        } else {
+            retune(home);
+        }
+        return;
+    }
+    if (sameRadio(points[index].radio, current)) {
+        startMeasuring();
+    } else {
+        retune(points[index].radio);
+    }
+}
+
+void PerSweep::retune(const RadioConfig &config)
+{
+    target = config;
+    attempts = 0;
+    retuneClock.start();
+    sendRetune();
+}
+
+void PerSweep::sendRetune()
+{
+    //先在对端应该在的参数上发; 应答丢了对端可能已经切过去, 再在新参数上发; 最后等它退回原参数
+    if (attempts < RetuneAttempts) {
+        applyLocal(current);
+    } else if (attempts < 2 * RetuneAttempts) {
+        applyLocal(target);
+    } else {
+        applyLocal(home);
+    }
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=0\r\n"));
+    link->sendPayload(Protocol::retunePacket(retuneInfo(target)));
+    state = RetuneTx;
+    timer->start(link->rto()->txDoneTimeout(Protocol::RetuneSize));
+}
+
+void PerSweep::handleEvent(const AtEvent &event)
+{
+    if (state == RetuneTx && event.type == AtEvent::TxDone) {
+        link->sendCommand(QByteArrayLiteral("AT+PRECV=65535\r\n"));
+        state = RetuneReply;
+        timer->start(link->rto()->replyTimeout(Protocol::LegacyAckSize));
+    } else if (state == RetuneReply && event.type == AtEvent::Ack) {
+        //对端回完ACK就切了
+        timer->stop();
+        applyLocal(target);
+        current = target;
+        if (returning) {
+            finish(true, QString("sweep finished, %1 points").arg(points.size()));
+            return;
+        }
+        state = Settling;
+        timer->start(SettleMs);
+    }
+}
+
+void PerSweep::onTimeout()
+{
+    switch (state) {
+    case RetuneTx:
+    case RetuneReply:
+        retuneFailed();
+        break;
+    case Settling:
+        startMeasuring();
+        break;
+    default:
+        break;
+    }
+}
+
+void PerSweep::retuneFailed()
+{
+    attempts++;
+    if (attempts < 2 * RetuneAttempts || retuneClock.elapsed() < 2 * Protocol::SwitchRevertMs) {
+        sendRetune();
+        return;
+    }
+
+    //这么久没应答, 对端已经退回原参数了
+    qDebug() << "retune failed, back to base config";
+    current = home;
+    applyLocal(home);
+    if (returning) {
+        finish(true, QString("sweep finished, %1 points (peer did not confirm the base config)").arg(points.size()));
+        return;
+    }
+    SweepPoint &point = points[index];
+    point.reachable = false;
+    emit pointDone(point, index, points.size());
+    nextPoint();
+}
+
+void PerSweep::startMeasuring()
+{
+    state = Measuring;
+    lastStats = PerStats();
+
+    PerTestOptions per;
+    per.mtu = points[index].mtu;
+    per.maxPackets = options.packetsPerPoint;
+    per.maxSent = options.packetsPerPoint;
+    per.minSent = options.minPackets;
+    per.ciHalfWidth = options.ciHalfWidth;
+    perTest->start(per);
+}
+
+void PerSweep::pointProgress(const PerStats &stats)
+{
+    lastStats = stats;
+}
+
+void PerSweep::pointFinished()
+{
+    if (state != Measuring) {
+        return;
+    }
+    SweepPoint &point = points[index];
+    point.reachable = true;
+    point.sent = lastStats.sent;
+    point.acked = qMin(lastStats.acked, lastStats.sent);
+    point.elapsedMs = lastStats.elapsedMs;
+    point.per = point.sent > 0 ? 1.0 - double(point.acked) / point.sent : 0.0;
+
+    double low, high;
+    PerTest::confidenceInterval(point.acked, point.sent, &low, &high);
+    point.perLow = 1.0 - high;
+    point.perHigh = 1.0 - low;
+    point.goodputKbps = point.elapsedMs > 0 ? double(point.acked) * point.mtu * 8 / point.elapsedMs : 0.0;
+
+    emit pointDone(point, index, points.size());
+    nextPoint();
+}
+
+void PerSweep::applyLocal(const RadioConfig &config)
+{
+    if (!sameRadio(link->radioConfig(), config)) {
+        link->writeConfig(config);
+    }
+}
+
+void PerSweep::finish(bool ok, const QString &message)
+{
+    timer->stop();
+    state = Idle;
+    emit finished(ok, message);
+}
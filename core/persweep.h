@@ -0,0 +1,85 @@
+#ifndef PERSWEEP_H
+#define PERSWEEP_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include "atparser.h"
+#include "linktypes.h"
+#include "transferprotocol.h"
+
+class LinkEngine;
+class PerTest;
+
+// 扫参: 按 频点 x BW x SF x CR x 前导码 x MTU 逐点跑丢包率测试, 每个点给出丢包率和有效速率
+// 换射频参数先用当前参数发调参包, 对端回ACK后两边一起切; 应答丢了依次在新参数和原参数上重试,
+// 对端在新参数上一直收不到包会自己退回原参数. 只换MTU的点不用调参.
+// 每个点最多发packetsPerPoint包, 置信区间够窄就提前结束; 扫完调回原参数
+class PerSweep : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int RetuneAttempts = 3;    // 当前参数, 新参数上各试几次, 之后在原参数上一直试
+    static const int SettleMs = 50;         // 两边都切完参数再开始测
+
+    PerSweep(LinkEngine *link, PerTest *perTest);
+
+    static QVector<SweepPoint> expand(const SweepOptions &options, const RadioConfig &base);
+    static bool sameRadio(const RadioConfig &a, const RadioConfig &b);   // 调参包带的几项相同
+    static Protocol::RetuneInfo retuneInfo(const RadioConfig &config);
+    static RadioConfig retuned(RadioConfig config, const Protocol::RetuneInfo &info);
+
+    bool isRunning() const { return state != Idle; }
+    void start(const SweepOptions &options);
+    void stop();
+    void handleEvent(const AtEvent &event);
+
+    // 当前点的PerTest进度和结束
+    void pointProgress(const PerStats &stats);
+    void pointFinished();
+
+signals:
+    void pointDone(const SweepPoint &point, int index, int count);
+    void finished(bool ok, const QString &message);
+
+private slots:
+    void onTimeout();
+
+private:
+    enum State {
+        Idle,
+        RetuneTx,       // 调参包等TX DONE
+        RetuneReply,    // 等对端的ACK
+        Settling,
+        Measuring
+    };
+
+    void nextPoint();
+    void retune(const RadioConfig &config);
+    void sendRetune();
+    void retuneFailed();
+    void startMeasuring();
+    void applyLocal(const RadioConfig &config);
+    void finish(bool ok, const QString &message);
+
+    LinkEngine *link;
+    PerTest *perTest;
+    QTimer *timer;
+    State state = Idle;
+
+    SweepOptions options;
+    QVector<SweepPoint> points;
+    int index = 0;
+    PerStats lastStats;
+
+    RadioConfig home;           // 扫参前的参数, 扫完调回来
+    RadioConfig current;        // 对端应该在的参数
+    RadioConfig target;
+    bool returning = false;     // 在调回原参数
+    int attempts = 0;
+    QElapsedTimer retuneClock;
+};
+
+#endif // PERSWEEP_H
@@ -0,0 +1,174 @@
+#include "pertest.h"
+#include "linkengine.h"
+#include "linklog.h"
+#include "transferprotocol.h"
+#include <QDebug>
+#include <QtMath>
+
+PerTest::PerTest(LinkEngine *link) : QObject(link), link(link),
+    rfTimer(new QTimer(this)), txGuardTimer(new QTimer(this))
+{
+    rfTimer->setSingleShot(true);
+    txGuardTimer->setSingleShot(true);
+    connect(rfTimer, &QTimer::timeout, this, &PerTest::testTimer_timeout);
+    connect(txGuardTimer, &QTimer::timeout, this, &PerTest::txGuard_timeout);
+}
+
+void PerTest::start(const PerTestOptions &options)
+{
+    stop();
+
+    this->options = options;
+    if (options.mtu != testCommandMtu) {
+        QByteArray payload;
+        for (int i = 0; i < options.mtu; i++) {
+            // 添加一个字节到 QByteArray，这里我们简单地添加了循环的索引值
+            payload.append(static_cast<char>(i));
+        }
+        testCommand = "AT+PSEND=" + payload.toHex().toUpper() + "\r\n";
+        testCommandMtu = options.mtu;
+    }
+    stats = PerStats();
+    stats.mtu = options.mtu;
+    running = true;
+    elapsed.start();
+
+    sendTestCmd();
+}
+
+void PerTest::stop()
+{
+    rfTimer->stop();
+    txGuardTimer->stop();
+    running = false;
+}
+
+void PerTest::handleEvent(const AtEvent &event)
+{
+    if (!running) {
+        return;
+    }
+
+    if (event.type == AtEvent::TxDone) {
+        if (!isTxDone && txGuardTimer->isActive()) {
+            txGuardTimer->stop();
+            isTxDone = true;
+            rttValid = true;
+            rttTimer.start();
+            startReceive();
+        }
+    } else if (event.type == AtEvent::Ack) {
+        stats.acked += 1;
+
+        if (isTxDone) {
+            emit replyLatency(replyTimer.nsecsElapsed() / 1000000.0);
+            if (rttValid) {
+                link->rto()->addSample(rttTimer.nsecsElapsed() / 1000000.0);
+            }
+            sendTestCmd();
+        } else {
+            qCDebug(lcLink) << "无效接收ACK";  //响应来晚了 已经有新一包的数据了
+        }
+    }
+}
+
+void PerTest::sendTestCmd()
+{
+    rfTimer->stop();
+
+    if (stats.acked > options.maxPackets || converged()) {
+        reportProgress();
+        stop();
+        emit finished();
+        return;
+    }
+
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=0\r\n"));   //先退出接收模式
+
+    link->sendCommand(testCommand);
+    replyTimer.start();
+    stats.sent += 1;
+
+    //不再原地等TX DONE, 收到+EVT:TXP2P DONE或者等TX DONE超时后再开接收
+    isTxDone = false;
+    rttValid = false;
+    txGuardTimer->start(link->rto()->txDoneTimeout(options.mtu));
+}
+
+void PerTest::startReceive()
+{
+    link->sendCommand(QByteArrayLiteral("AT+PRECV=65535\r\n"));   //开启接收模式    //收到数据会自动退出接收模式   //超时的话 我强关接收模式
+    //收到+EVT:TXP2P DONE 再开始计算超时; 丢包率测试本来就会丢包, 超时不退避
+    rfTimer->start(link->rto()->replyTimeout(Protocol::LegacyAckSize));
+    reportProgress();
+}
+
+void PerTest::testTimer_timeout()
+{
+    if (running) {
+        qCDebug(lcLink) << "testTimer_timeout";
+        sendTestCmd();
+    }
+}
+
+void PerTest::txGuard_timeout()
+{
+    //模块没有报TX DONE, 照常开接收等超时, 这一包的ACK会被当成无效ACK
+    if (running) {
+        qCDebug(lcLink) << "TX DONE timeout";
+        startReceive();
+    }
+}
+
+void PerTest::confidenceInterval(quint64 acked, quint64 sent, double *low, double *high)
+{
+    if (sent == 0) {
+        *low = 0;
+        *high = 1;
+        return;
+    }
+    const double z = 1.96;
+    double n = double(sent);
+    double p = double(qMin(acked, sent)) / n;
+    double denominator = 1 + z * z / n;
+    double center = (p + z * z / (2 * n)) / denominator;
+    double half = z * qSqrt(p * (1 - p) / n + z * z / (4 * n * n)) / denominator;
+    *low = qMax(0.0, center - half);
+    *high = qMin(1.0, center + half);
+}
+
+bool PerTest::converged() const
+{
+    //这里上一包已经有结果(ACK或超时), sent就是有结果的包数
+    if (options.maxSent > 0 && stats.sent >= options.maxSent) {
+        return true;
+    }
+    if (options.ciHalfWidth <= 0 || stats.sent == 0 || stats.sent < options.minSent) {
+        return false;
+    }
+    double low, high;
+    confidenceInterval(stats.acked, stats.sent, &low, &high);
+    return (high - low) / 2 <= options.ciHalfWidth;
+}
+
+void PerTest::reportProgress()
+{
+    stats.elapsedMs = elapsed.elapsed();
+    emit progress(stats);
+}
+
+
+//一个完整的测试流  是先发送收到ACK  或者发送超时    如果一个正在执行单次未完成 是不能进行第二次发送的
+//为了放在在没有收到TX DONE 同时收到了上一包的55AA55 需要手动控制接收 比较好
+
+//现在手动控制也有问题  就是刚要关闭RX的时候 收到包了 就是单片机在操作的射频的时候  来了一个AT中断引起的异常
+
+//accumulatedData:[0] "+EVT:RXP2P:-7:6:55AA55\r\n"   可能是收的时候 我调用了发送（会导致单片机异常）    增加超时时间可以避免这个问题   应该是正在接收 打断了接收中断
+//无效接收ACK
+//accumulatedData:[0] "OK\r\n"
+//accumulatedData:[0] "OK\r\n+EVT:TXP2P DONE\r\n"
+//+EVT:TXP2P DONE
+//testTimer_timeout
+//sendTestCmd
+//accumulatedData:[0] "+EVT:RXP2P:-7:6:55AA55\r\n"
+//无效接收ACK
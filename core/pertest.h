@@ -0,0 +1,61 @@
+#ifndef PERTEST_H
+#define PERTEST_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "atparser.h"
+#include "linktypes.h"
+
+class LinkEngine;
+
+// 丢包率测试
+// 一个完整的测试流: 发送 -> TX DONE -> 打开接收等ACK, 收到ACK或者超时再发下一包
+class PerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PerTest(LinkEngine *link);
+
+    // 成功率的95%置信区间(Wilson), 样本少或者接近0/100%时也靠得住
+    static void confidenceInterval(quint64 acked, quint64 sent, double *low, double *high);
+
+    bool isRunning() const { return running; }
+    void start(const PerTestOptions &options);
+    void stop();
+    void handleEvent(const AtEvent &event);
+
+signals:
+    void progress(const PerStats &stats);
+    void finished();
+    void replyLatency(double ms);   // PSEND到收到ACK的时间
+
+private slots:
+    void testTimer_timeout();
+    void txGuard_timeout();
+
+private:
+    void sendTestCmd();
+    void startReceive();
+    void reportProgress();
+    bool converged() const;
+
+    LinkEngine *link;
+    QTimer *rfTimer;          // 等ACK超时
+    QTimer *txGuardTimer;     // 等TX DONE超时
+    QElapsedTimer elapsed;
+    QElapsedTimer replyTimer;
+    QElapsedTimer rttTimer;   // TX DONE到ACK, 喂给超时估计
+    bool rttValid = false;    // 等TX DONE超时的那包不采样
+
+    bool running = false;
+    bool isTxDone = false;
+    PerTestOptions options;
+    PerStats stats;
+
+    QByteArray testCommand;   // 整条AT+PSEND命令, MTU不变就一直复用
+    int testCommandMtu = -1;
+};
+
+#endif // PERTEST_H
@@ -0,0 +1,100 @@
+#include "ratecontroller.h"
+#include <QtGlobal>
+
+// 留给衰落的余量(dB), 余量每多2.5dB可以降一级SF
+static const double InstallationMargin = 5.0;
+static const double SnrStep = 2.5;
+
+void RateController::reset(const Choice &current, int maxMtu)
+{
+    choice = current;
+    this->maxMtu = qMax(MinMtu, maxMtu);
+    switchCount = 0;
+    clearHistory();
+}
+
+void RateController::clearHistory()
+{
+    sentHistory.clear();
+    ackedHistory.clear();
+    snrHistory.clear();
+    holdOff = History;
+}
+
+void RateController::addBurst(int sent, int acked, int snr)
+{
+    if (sent <= 0) {
+        return;
+    }
+    sentHistory.append(sent);
+    ackedHistory.append(qMin(acked, sent));
+    snrHistory.append(snr);
+    if (sentHistory.size() > History) {
+        sentHistory.removeFirst();
+        ackedHistory.removeFirst();
+        snrHistory.removeFirst();
+    }
+    if (holdOff > 0) {
+        holdOff--;
+    }
+}
+
+double RateController::requiredSnr(int spreadingFactor)
+{
+    //SF5 -2.5dB 起, 每升一级低2.5dB, SF12 -20dB
+    return -2.5 * (spreadingFactor - 4);
+}
+
+bool RateController::propose(Choice *next) const
+{
+    if (holdOff > 0 || sentHistory.size() < History) {
+        return false;
+    }
+
+    int sent = 0;
+    int acked = 0;
+    double snr = 0;
+    for (int i = 0; i < sentHistory.size(); i++) {
+        sent += sentHistory.at(i);
+        acked += ackedHistory.at(i);
+        snr += snrHistory.at(i);
+    }
+    double loss = 1.0 - double(acked) / sent;
+    double margin = snr / snrHistory.size() - requiredSnr(choice.spreadingFactor) - InstallationMargin;
+
+    *next = choice;
+
+    //先看SF: 余量不够或者丢包严重就升SF, 余量充足且基本不丢包就降一级
+    if ((margin < 0 || loss > 0.3) && choice.spreadingFactor < MaxSpreadingFactor) {
+        next->spreadingFactor++;
+        return true;
+    }
+    if (margin >= SnrStep && loss < 0.1 && choice.spreadingFactor > MinSpreadingFactor) {
+        next->spreadingFactor--;
+        return true;
+    }
+
+    //SF不动再看MTU
+    if (loss < 0.05 && choice.mtu < maxMtu) {
+        next->mtu = qMin(maxMtu, choice.mtu * 3 / 2);
+        return true;
+    }
+    if (loss > 0.2 && choice.mtu > MinMtu) {
+        next->mtu = qMax(MinMtu, choice.mtu * 2 / 3);
+        return true;
+    }
+    return false;
+}
+
+void RateController::accept(const Choice &next)
+{
+    choice = next;
+    switchCount++;
+    clearHistory();
+}
+
+void RateController::reject()
+{
+    clearHistory();
+    holdOff = 2 * History;
+}
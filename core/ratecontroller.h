@@ -0,0 +1,49 @@
+#ifndef RATECONTROLLER_H
+#define RATECONTROLLER_H
+
+#include <QVector>
+
+// 传输中自适应SF和MTU, 思路同LoRaWAN ADR: 用SACK里对端测到的SNR算余量, 余量够就降SF提速, 不够就升SF;
+// 再按最近几轮突发的丢包率调MTU. 每次只动一个参数, 切换后要攒够样本才做下一次决定
+class RateController
+{
+public:
+    static const int History = 8;           // 参与决策的最近突发数
+    static const int MinSpreadingFactor = 5;
+    static const int MaxSpreadingFactor = 12;
+    static const int MinMtu = 32;
+
+    struct Choice {
+        int spreadingFactor = 7;
+        int mtu = 100;
+    };
+
+    void reset(const Choice &current, int maxMtu);
+
+    // 每收到一个窗口SACK调一次: 本轮发了几包, 新确认了几包, 对端测到的SNR
+    void addBurst(int sent, int acked, int snr);
+
+    // 有更好的参数时返回true, 由调用方去做切换握手
+    bool propose(Choice *next) const;
+    void accept(const Choice &next);
+    void reject();      // 握手失败, 过一阵再试
+
+    Choice current() const { return choice; }
+    int switches() const { return switchCount; }
+
+    // SX126x 各SF能解调的最低SNR(dB)
+    static double requiredSnr(int spreadingFactor);
+
+private:
+    void clearHistory();
+
+    Choice choice;
+    int maxMtu = 240;
+    QVector<int> sentHistory;
+    QVector<int> ackedHistory;
+    QVector<int> snrHistory;
+    int holdOff = History;      // 还要攒几轮样本才能决策
+    int switchCount = 0;
+};
+
+#endif // RATECONTROLLER_H
@@ -0,0 +1,71 @@
+#include "rtoestimator.h"
+#include <QtMath>
+
+// "+EVT:RXP2P:-120:-20:" 加上 CRLF, 按最长的算
+static const int RxLineOverhead = 22;
+// "AT+PSEND=" 加上 CRLF
+static const int TxLineOverhead = 11;
+
+void RtoEstimator::configure(const LoraModulation &modulation, int baudRate)
+{
+    this->modulation = modulation;
+    this->baudRate = baudRate;
+    reset();
+}
+
+void RtoEstimator::reset()
+{
+    sampled = false;
+    srtt = 0;
+    rttvar = 0;
+    backoffShift = 0;
+}
+
+int RtoEstimator::txDoneTimeout(int payloadBytes) const
+{
+    double uart = LoraAirtime::uartTimeMs(TxLineOverhead + 2 * payloadBytes, baudRate);
+    double air = LoraAirtime::timeOnAirMs(modulation, payloadBytes);
+    return qMin(MaxTimeout, qCeil(uart + air) + TxDoneMargin);
+}
+
+int RtoEstimator::modelTimeout(int replyBytes) const
+{
+    double uart = LoraAirtime::uartTimeMs(RxLineOverhead + 2 * replyBytes, baudRate);
+    double air = LoraAirtime::timeOnAirMs(modulation, replyBytes);
+    return qCeil(uart + air) + TurnaroundMargin;
+}
+
+int RtoEstimator::replyTimeout(int replyBytes) const
+{
+    if (fixedTimeout > 0) {
+        return fixedTimeout;
+    }
+
+    int model = modelTimeout(replyBytes);
+    //还没有样本时给两倍理论值, 和原来按SF查表的量级差不多
+    double timeout = sampled ? qMax<double>(model, srtt + 4 * rttvar) : 2.0 * model;
+    return qMin(MaxTimeout, qCeil(timeout) << backoffShift);
+}
+
+void RtoEstimator::addSample(double ms)
+{
+    if (ms < 0) {
+        return;
+    }
+    if (!sampled) {
+        srtt = ms;
+        rttvar = ms / 2;
+        sampled = true;
+    } else {
+        rttvar = 0.75 * rttvar + 0.25 * qAbs(srtt - ms);
+        srtt = 0.875 * srtt + 0.125 * ms;
+    }
+    backoffShift = 0;
+}
+
+void RtoEstimator::backoff()
+{
+    if (backoffShift < MaxBackoffShift) {
+        backoffShift++;
+    }
+}
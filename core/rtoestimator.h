@@ -0,0 +1,50 @@
+#ifndef RTOESTIMATOR_H
+#define RTOESTIMATOR_H
+
+#include "loraairtime.h"
+
+// 应答超时估计
+// 理论值: 对端回包的空口时间 + 模块把+EVT:RXP2P行吐到串口的时间 + 余量, 都按当前调制参数和包长算;
+// 再用实测的 TX DONE 到收到应答的时间做 Jacobson/Karels 平滑 (RFC 6298), 超时取 SRTT+4*RTTVAR, 不低于理论值
+class RtoEstimator
+{
+public:
+    static const int TurnaroundMargin = 50;     // 对端处理和串口调度的余量(ms)
+    static const int TxDoneMargin = 200;        // 等TX DONE的余量(ms)
+    static const int MaxTimeout = 10000;
+    static const int MaxBackoffShift = 4;
+
+    void configure(const LoraModulation &modulation, int baudRate);
+    void setBaudRate(int baudRate) { configure(modulation, baudRate); }
+    void setFixedTimeout(int ms) { fixedTimeout = ms; }    // >0 时不再自适应
+    void reset();
+
+    // PSEND写出之后等TX DONE: 串口传命令 + 本包空口时间 + 余量
+    int txDoneTimeout(int payloadBytes) const;
+    // TX DONE之后等应答
+    int replyTimeout(int replyBytes) const;
+    // 不考虑实测的理论值
+    int modelTimeout(int replyBytes) const;
+
+    // 只喂没重发过的包的样本(Karn算法), 重发的包分不清是哪次发送的应答
+    void addSample(double ms);
+    // 超时一次翻倍, 直到下一个有效样本
+    void backoff();
+
+    int fixedTimeoutMs() const { return fixedTimeout; }
+    bool hasSamples() const { return sampled; }
+    double smoothedRtt() const { return srtt; }
+    double rttVariance() const { return rttvar; }
+
+private:
+    LoraModulation modulation;
+    int baudRate = 115200;
+    int fixedTimeout = 0;
+
+    bool sampled = false;
+    double srtt = 0;
+    double rttvar = 0;
+    int backoffShift = 0;
+};
+
+#endif // RTOESTIMATOR_H
@@ -0,0 +1,82 @@
+#include "serialcapture.h"
+
+static void putBigEndian(uchar *out, quint64 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        out[i] = static_cast<uchar>(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+static quint64 getBigEndian(const uchar *p, int bytes)
+{
+    quint64 value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+bool SerialCapture::load(const QString &path, QVector<Record> *records, QString *error)
+{
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        *error = path + ": " + in.errorString();
+        return false;
+    }
+    QByteArray content = in.readAll();
+    if (!content.startsWith("ISMCAP1\n")) {
+        *error = path + ": not a serial capture";
+        return false;
+    }
+
+    records->clear();
+    const uchar *p = reinterpret_cast<const uchar *>(content.constData());
+    qint64 pos = 8;
+    while (pos + 13 <= content.size()) {
+        qint64 size = static_cast<qint64>(getBigEndian(p + pos + 9, 4));
+        if (pos + 13 + size > content.size()) {
+            break;
+        }
+        Record record;
+        record.ns = static_cast<qint64>(getBigEndian(p + pos, 8));
+        record.direction = p[pos + 8] == Tx ? Tx : Rx;
+        record.data = content.mid(static_cast<int>(pos + 13), static_cast<int>(size));
+        records->append(record);
+        pos += 13 + size;
+    }
+    return true;
+}
+
+bool SerialCapture::start(const QString &path, QString *error)
+{
+    stop();
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = path + ": " + file.errorString();
+        return false;
+    }
+    file.write("ISMCAP1\n", 8);
+    clock.start();
+    return true;
+}
+
+void SerialCapture::stop()
+{
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+void SerialCapture::record(Direction direction, const char *data, int size)
+{
+    if (!file.isOpen() || size <= 0) {
+        return;
+    }
+    uchar header[13];
+    putBigEndian(header, static_cast<quint64>(clock.nsecsElapsed()), 8);
+    header[8] = static_cast<uchar>(direction);
+    putBigEndian(header + 9, static_cast<quint64>(size), 4);
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(data, size);
+}
@@ -0,0 +1,43 @@
+#ifndef SERIALCAPTURE_H
+#define SERIALCAPTURE_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QVector>
+
+// 串口原始数据抓包, 收发都记, 方便事后分析
+// 文件格式: 文件头 "ISMCAP1\n", 之后每条记录
+//   时间(8, 单调时钟ns, 从开始抓包算) | 方向(1, 0收 1发) | 长度(4) | 数据
+// 整数都是大端; 写文件走QFile的缓冲, 内存占用不随抓包时长增长
+// 回放见serialreplay.h
+class SerialCapture
+{
+public:
+    enum Direction {
+        Rx = 0,
+        Tx = 1
+    };
+
+    struct Record {
+        qint64 ns = 0;
+        Direction direction = Rx;
+        QByteArray data;
+    };
+
+    ~SerialCapture() { stop(); }
+
+    // 整个抓包文件读进内存; 最后一条没写完(抓包时断电)的丢掉
+    static bool load(const QString &path, QVector<Record> *records, QString *error);
+
+    bool start(const QString &path, QString *error);
+    void stop();
+    bool isActive() const { return file.isOpen(); }
+
+    void record(Direction direction, const char *data, int size);
+
+private:
+    QFile file;
+    QElapsedTimer clock;
+};
+
+#endif // SERIALCAPTURE_H
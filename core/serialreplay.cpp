@@ -0,0 +1,169 @@
+#include "serialreplay.h"
+#include <QTimer>
+#include <cstring>
+
+SerialReplay::SerialReplay(QObject *parent) : QIODevice(parent), timer(new QTimer(this))
+{
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &SerialReplay::step);
+}
+
+bool SerialReplay::load(const QString &path, QString *error)
+{
+    QVector<SerialCapture::Record> records;
+    if (!SerialCapture::load(path, &records, error)) {
+        return false;
+    }
+
+    rx.clear();
+    expectedTx.clear();
+    qint64 lastTxNs = 0;
+    for (const SerialCapture::Record &record : records) {
+        if (record.direction == SerialCapture::Tx) {
+            expectedTx.append(record.data);
+            lastTxNs = record.ns;
+            continue;
+        }
+        Rx item;
+        item.ns = record.ns;
+        item.txBefore = expectedTx.size();
+        item.gateNs = lastTxNs;
+        item.data = record.data;
+        rx.append(item);
+    }
+    traceNs = records.isEmpty() ? 0 : records.last().ns;
+    return true;
+}
+
+bool SerialReplay::open(OpenMode mode)
+{
+    if (!QIODevice::open(mode)) {
+        return false;
+    }
+    next = 0;
+    output.clear();
+    counters = ReplayStats();
+    counters.records = rx.size();
+    counters.txExpected = expectedTx.size();
+    counters.traceMs = traceNs / 1000000;
+    writeEnds.clear();
+    writeTimes.clear();
+    writeCursor = 0;
+    gateTx = -1;
+    lastDeliveredNs = 0;
+    clock.start();
+    timer->start(0);
+    return true;
+}
+
+void SerialReplay::close()
+{
+    timer->stop();
+    counters.elapsedMs = clock.isValid() ? clock.elapsed() : 0;
+    QIODevice::close();
+}
+
+ReplayStats SerialReplay::stats() const
+{
+    ReplayStats stats = counters;
+    if (isOpen()) {
+        stats.elapsedMs = clock.elapsed();
+    }
+    return stats;
+}
+
+qint64 SerialReplay::readData(char *data, qint64 maxSize)
+{
+    int size = static_cast<int>(qMin<qint64>(maxSize, output.size()));
+    memcpy(data, output.constData(), size_t(size));
+    output.remove(0, size);
+    return size;
+}
+
+qint64 SerialReplay::writeData(const char *data, qint64 maxSize)
+{
+    //和抓包里写出的比
+    if (counters.firstMismatch < 0) {
+        for (qint64 i = 0; i < maxSize; i++) {
+            qint64 at = counters.txBytes + i;
+            if (at >= expectedTx.size() || expectedTx.at(static_cast<int>(at)) != data[i]) {
+                counters.firstMismatch = at;
+                break;
+            }
+        }
+    }
+    counters.txBytes += maxSize;
+    writeEnds.append(counters.txBytes);
+    writeTimes.append(clock.nsecsElapsed());
+
+    //不在引擎写的调用里回调它
+    QTimer::singleShot(0, this, [this, maxSize]() { emit bytesWritten(maxSize); });
+    if (options.gated && !timer->isActive()) {
+        timer->start(0);
+    }
+    return maxSize;
+}
+
+qint64 SerialReplay::scaled(qint64 ns) const
+{
+    return options.speed > 0 ? static_cast<qint64>(ns / options.speed) : 0;
+}
+
+qint64 SerialReplay::gateOpenedAt(qint64 txBefore, qint64 now)
+{
+    if (txBefore == 0) {
+        return 0;
+    }
+    while (writeCursor < writeEnds.size() && writeEnds.at(writeCursor) < txBefore) {
+        writeCursor++;
+    }
+    return writeCursor < writeEnds.size() ? writeTimes.at(writeCursor) : now;
+}
+
+void SerialReplay::step()
+{
+    if (!isOpen() || next >= rx.size()) {
+        return;
+    }
+    const Rx &item = rx.at(next);
+    qint64 now = clock.nsecsElapsed();
+
+    qint64 due;
+    if (options.gated) {
+        if (item.txBefore != gateTx) {
+            if (counters.txBytes >= item.txBefore) {
+                gateOpenedNs = gateOpenedAt(item.txBefore, now);
+            } else if (now - lastDeliveredNs >= qint64(StallMs) * 1000000) {
+                counters.stalls++;
+                gateOpenedNs = now;
+            } else {
+                //等引擎写出来, writeData会再叫一次
+                timer->start(StallMs - static_cast<int>((now - lastDeliveredNs) / 1000000));
+                return;
+            }
+            gateTx = item.txBefore;
+        }
+        due = gateOpenedNs + scaled(item.ns - item.gateNs);
+    } else {
+        due = scaled(item.ns);
+    }
+    if (now < due) {
+        timer->start(static_cast<int>((due - now + 999999) / 1000000));
+        return;
+    }
+
+    //一条记录一次readyRead, 和串口读到的块一样
+    output.append(item.data);
+    counters.replayed++;
+    counters.rxBytes += item.data.size();
+    lastDeliveredNs = now;
+    next++;
+    emit readyRead();
+
+    if (next >= rx.size()) {
+        counters.elapsedMs = clock.elapsed();
+        emit replayFinished();
+    } else {
+        timer->start(0);
+    }
+}
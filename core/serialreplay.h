@@ -0,0 +1,93 @@
+#ifndef SERIALREPLAY_H
+#define SERIALREPLAY_H
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QVector>
+#include "serialcapture.h"
+
+class QTimer;
+
+struct ReplayOptions {
+    double speed = 1.0;     // 倍速, 0 = 不等, 跑最快
+    bool gated = true;      // 收的数据要等引擎写出对应的命令/数据包后再放
+};
+
+struct ReplayStats {
+    int records = 0;            // 抓包里收方向的记录数
+    int replayed = 0;
+    qint64 rxBytes = 0;         // 已喂给引擎的
+    qint64 txBytes = 0;         // 引擎写出的
+    qint64 txExpected = 0;      // 抓包里写出的
+    qint64 firstMismatch = -1;  // 引擎写出的和抓包里第一个不一样的字节, -1 = 一样
+    int stalls = 0;             // 等不到引擎写出对应的数据, 超时照样放的次数
+    qint64 traceMs = 0;         // 抓包时长
+    qint64 elapsedMs = 0;       // 回放用时
+};
+
+// 抓包回放: 代替串口给LinkEngine::openDevice用, 把抓到的模块输出按原来的时序喂回引擎
+// 按门放(gated): 一条收的记录要等引擎写出的字节数到了抓包里它前面写出的字节数才放(那条命令/那包的回应),
+// 再按抓包里它离那次写出的间隔除以倍速延后; 同一次写出后面的几条按各自的间隔放, 误差不累积.
+// 引擎一直没写出抓包里那些(协议改了, 走了别的分支)就等StallMs后照样放, 记一次stall.
+// 不按门: 只按时间戳放, 复现现场的时序, 不管引擎写了什么.
+// 引擎写出的逐字节和抓包里写出的比, 记第一个不一样的位置
+class SerialReplay : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static const int StallMs = 2000;
+
+    explicit SerialReplay(QObject *parent = nullptr);
+
+    bool load(const QString &path, QString *error);
+    void setOptions(const ReplayOptions &options) { this->options = options; }
+    ReplayStats stats() const;
+    bool isFinished() const { return next >= rx.size(); }
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return output.size() + QIODevice::bytesAvailable(); }
+
+signals:
+    void replayFinished();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private slots:
+    void step();
+
+private:
+    struct Rx {
+        qint64 ns;              // 抓包里的时间
+        qint64 txBefore;        // 抓包里这条之前写出的字节数
+        qint64 gateNs;          // 抓包里这条之前最后一次写出的时间
+        QByteArray data;
+    };
+
+    qint64 scaled(qint64 ns) const;
+    qint64 gateOpenedAt(qint64 txBefore, qint64 now);
+
+    ReplayOptions options;
+    QVector<Rx> rx;
+    QByteArray expectedTx;
+    qint64 traceNs = 0;
+    int next = 0;
+    QByteArray output;
+    QTimer *timer;
+    QElapsedTimer clock;
+    ReplayStats counters;
+
+    //引擎每次写完时累计的字节数和时间, 找门是什么时候开的
+    QVector<qint64> writeEnds;
+    QVector<qint64> writeTimes;
+    int writeCursor = 0;
+    qint64 gateTx = -1;         // 当前门对应的字节数
+    qint64 gateOpenedNs = 0;
+    qint64 lastDeliveredNs = 0;
+};
+
+#endif // SERIALREPLAY_H
@@ -0,0 +1,105 @@
+#include "sessionjournal.h"
+#include "transferprotocol.h"
+#include "chunksource.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+SessionJournal::SessionJournal(const QString &directory)
+    : dir(directory.isEmpty() ? defaultDirectory() : directory)
+{
+}
+
+QString SessionJournal::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/QT_ISM2400/sessions";
+}
+
+QByteArray SessionJournal::sessionId(const QByteArray &content)
+{
+    return QCryptographicHash::hash(content, QCryptographicHash::Sha256).left(Protocol::SessionIdSize);
+}
+
+QByteArray SessionJournal::sessionId(ChunkSource *source)
+{
+    const int blockSize = 1024 * 1024;
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (qint64 offset = 0; offset < source->size(); offset += blockSize) {
+        int length = static_cast<int>(qMin<qint64>(blockSize, source->size() - offset));
+        const char *data = source->chunk(offset, length);
+        if (!data) {
+            return QByteArray();
+        }
+        hash.addData(data, length);
+    }
+    return hash.result().left(Protocol::SessionIdSize);
+}
+
+QString SessionJournal::pathOf(const QByteArray &id) const
+{
+    return QDir(dir).filePath(QString::fromLatin1(id.toHex()) + ".json");
+}
+
+bool SessionJournal::load(const QByteArray &id, SessionRecord *record) const
+{
+    QFile file(pathOf(id));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.value("id").toString() != QString::fromLatin1(id.toHex())) {
+        return false;
+    }
+
+    record->id = id;
+    record->fileName = root.value("fileName").toString();
+    record->fileSize = static_cast<qint64>(root.value("fileSize").toDouble());
+    record->offset = static_cast<qint64>(root.value("offset").toDouble());
+    record->mtu = root.value("mtu").toInt();
+    record->window = root.value("window").toInt();
+    QJsonObject radio = root.value("radio").toObject();
+    record->radio.frequency = radio.value("frequency").toString(record->radio.frequency);
+    record->radio.bandwidth = radio.value("bandwidth").toInt(record->radio.bandwidth);
+    record->radio.spreadingFactor = radio.value("spreadingFactor").toInt(record->radio.spreadingFactor);
+    record->radio.codingRate = radio.value("codingRate").toInt(record->radio.codingRate);
+    record->radio.preamble = radio.value("preamble").toInt(record->radio.preamble);
+    record->radio.txPower = radio.value("txPower").toInt(record->radio.txPower);
+    return record->offset >= 0 && record->offset <= record->fileSize;
+}
+
+bool SessionJournal::save(const SessionRecord &record) const
+{
+    QJsonObject radio;
+    radio["frequency"] = record.radio.frequency;
+    radio["bandwidth"] = record.radio.bandwidth;
+    radio["spreadingFactor"] = record.radio.spreadingFactor;
+    radio["codingRate"] = record.radio.codingRate;
+    radio["preamble"] = record.radio.preamble;
+    radio["txPower"] = record.radio.txPower;
+
+    QJsonObject root;
+    root["id"] = QString::fromLatin1(record.id.toHex());
+    root["fileName"] = record.fileName;
+    root["fileSize"] = double(record.fileSize);
+    root["offset"] = double(record.offset);
+    root["mtu"] = record.mtu;
+    root["window"] = record.window;
+    root["radio"] = radio;
+
+    QDir().mkpath(dir);
+    QSaveFile file(pathOf(record.id));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+void SessionJournal::remove(const QByteArray &id) const
+{
+    QFile::remove(pathOf(id));
+}
@@ -0,0 +1,46 @@
+#ifndef SESSIONJOURNAL_H
+#define SESSIONJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+#include "linktypes.h"
+
+class ChunkSource;
+
+// 续传会话记录, 发送端和接收端各存一份
+struct SessionRecord {
+    QByteArray id;              // 文件内容哈希
+    QString fileName;
+    qint64 fileSize = 0;
+    qint64 offset = 0;          // 已连续确认(接收端: 已连续收到)的字节数
+    int mtu = 0;
+    int window = 0;
+    RadioConfig radio;
+};
+
+// 续传日志: 每个会话一个小JSON文件, 文件名是会话ID的16进制
+// 用QSaveFile整体替换, 写到一半断电也不会留下坏记录
+class SessionJournal
+{
+public:
+    static const int SaveIntervalMs = 1000;     // 传输中最多每秒落盘一次
+
+    explicit SessionJournal(const QString &directory = QString());
+
+    // 发送端默认目录, 界面和命令行共用
+    static QString defaultDirectory();
+    static QByteArray sessionId(const QByteArray &content);
+    static QByteArray sessionId(ChunkSource *source);   // 大文件分块算, 不整个读进内存
+
+    QString directory() const { return dir; }
+    bool load(const QByteArray &id, SessionRecord *record) const;
+    bool save(const SessionRecord &record) const;
+    void remove(const QByteArray &id) const;
+
+private:
+    QString pathOf(const QByteArray &id) const;
+
+    QString dir;
+};
+
+#endif // SESSIONJOURNAL_H
@@ -0,0 +1,89 @@
+#include "slidingwindow.h"
+#include "transferprotocol.h"
+
+SlidingWindow::SlidingWindow()
+{
+}
+
+void SlidingWindow::reset(quint32 totalChunks, int windowSize)
+{
+    chunkCount = totalChunks;
+    window = qBound(1, windowSize, Protocol::MaxWindowSize);
+    windowBase = 0;
+    nextNewChunk = 0;
+    ackedMask = 0;
+    ackedTotal = 0;
+    retransmitCount = 0;
+}
+
+bool SlidingWindow::isAcked(quint32 index) const
+{
+    if (index < windowBase) {
+        return true;
+    }
+    quint32 bit = index - windowBase;
+    return bit < 32 && (ackedMask & (1u << bit));
+}
+
+QVector<quint32> SlidingWindow::nextBurst()
+{
+    QVector<quint32> burst;
+    burst.reserve(window);
+
+    //已发送未确认的块: 上一轮的SACK没有报告收到, 视为丢失
+    for (quint32 index = windowBase; index < nextNewChunk && burst.size() < window; index++) {
+        if (!isAcked(index)) {
+            burst.append(index);
+            retransmitCount++;
+        }
+    }
+
+    //窗口还有空位就发新块
+    while (burst.size() < window && nextNewChunk < chunkCount
+           && nextNewChunk - windowBase < static_cast<quint32>(window)) {
+        burst.append(nextNewChunk++);
+    }
+    return burst;
+}
+
+int SlidingWindow::applySack(quint16 expectedSeq, quint32 bitmap)
+{
+    //16位序号还原成块号, 窗口远小于序号空间, 用有符号差值即可
+    qint32 delta = static_cast<qint16>(expectedSeq - seqOf(windowBase));
+    if (delta < 0 || windowBase + delta > nextNewChunk) {
+        return 0;   //过期或非法的SACK
+    }
+
+    int newlyAcked = 0;
+    for (qint32 i = 0; i < delta; i++) {
+        if (!(i < 32 && (ackedMask & (1u << i)))) {
+            newlyAcked++;
+        }
+    }
+    windowBase += delta;
+    ackedMask = delta >= 32 ? 0 : (ackedMask >> delta);
+
+    for (int i = 0; i < 31; i++) {
+        if (!(bitmap & (1u << i))) {
+            continue;
+        }
+        quint32 index = windowBase + 1 + i;
+        if (index >= nextNewChunk) {
+            break;
+        }
+        quint32 bit = index - windowBase;
+        if (!(ackedMask & (1u << bit))) {
+            ackedMask |= (1u << bit);
+            newlyAcked++;
+        }
+    }
+
+    //窗口头部连续已确认的部分直接滑过去
+    while ((ackedMask & 1u) && windowBase < nextNewChunk) {
+        ackedMask >>= 1;
+        windowBase++;
+    }
+
+    ackedTotal += newlyAcked;
+    return newlyAcked;
+}
@@ -0,0 +1,42 @@
+#ifndef SLIDINGWINDOW_H
+#define SLIDINGWINDOW_H
+
+#include <QVector>
+
+// 选择重传发送窗口
+// 块号从0开始连续编号, 空口上只带低16位序号; 窗口不超过32, 用位掩码记录窗口内的确认状态
+class SlidingWindow
+{
+public:
+    SlidingWindow();
+
+    void reset(quint32 totalChunks, int windowSize);
+
+    // 取下一轮突发要发送的块: 先是窗口内未确认的(重传), 再是新块
+    QVector<quint32> nextBurst();
+
+    // 处理SACK, 返回本次新确认的块数
+    int applySack(quint16 expectedSeq, quint32 bitmap);
+
+    bool isComplete() const { return windowBase >= chunkCount; }
+    quint32 base() const { return windowBase; }
+    quint32 totalChunks() const { return chunkCount; }
+    quint32 ackedChunks() const { return ackedTotal; }
+    quint32 retransmissions() const { return retransmitCount; }
+    int windowSize() const { return window; }
+
+    static quint16 seqOf(quint32 index) { return static_cast<quint16>(index & 0xFFFF); }
+
+private:
+    bool isAcked(quint32 index) const;
+
+    quint32 chunkCount = 0;
+    int window = 1;
+    quint32 windowBase = 0;     // 最小的未确认块
+    quint32 nextNewChunk = 0;   // 下一个从未发送过的块
+    quint32 ackedMask = 0;      // bit i: windowBase+i 已确认
+    quint32 ackedTotal = 0;
+    quint32 retransmitCount = 0;
+};
+
+#endif // SLIDINGWINDOW_H
@@ -0,0 +1,180 @@
+#include "stripedtransfer.h"
+#include "chunksource.h"
+#include "linkengine.h"
+#include <QDebug>
+
+StripedTransfer::StripedTransfer(LinkEngine *primary) : QObject(primary), primary(primary)
+{
+}
+
+void StripedTransfer::start(const StripeOptions &options)
+{
+    stop();
+
+    //各链路自己映射文件, 这里只要大小; 管道没法给几条链路各打开一次
+    QString error;
+    QSharedPointer<ChunkSource> source = ChunkSource::open(options.transfer.filePath, &error);
+    if (!source) {
+        emit finished(false, options.transfer.filePath + " open failed: " + error);
+        return;
+    }
+    if (!source.dynamicCast<MappedChunkSource>()) {
+        emit finished(false, options.transfer.filePath + " is not a regular file, cannot stripe it");
+        return;
+    }
+    if (options.transfer.mtu <= 0) {
+        emit finished(false, "Invalid MTU: " + QString::number(options.transfer.mtu));
+        return;
+    }
+    queue.reset(source->size(), PieceChunks * options.transfer.mtu);
+
+    //每条链路一个频点, 没给的沿用当前频点
+    RadioConfig base = primary->radioConfig();
+    auto linkConfig = [&](int index) {
+        RadioConfig config = base;
+        if (index < options.frequencies.size() && !options.frequencies.at(index).isEmpty()) {
+            config.frequency = options.frequencies.at(index);
+        }
+        return config;
+    };
+
+    Link first;
+    first.engine = primary;
+    links.append(first);
+
+    for (int i = 0; i < options.ports.size(); i++) {
+        LinkEngine *engine = new LinkEngine(this);
+        connect(engine, &LinkEngine::portError, primary, &LinkEngine::portError);
+        connect(engine, &LinkEngine::commandFailed, primary, &LinkEngine::commandFailed);
+        engine->setPipelineDepth(primary->pipelineDepth());
+        engine->setUartPrefetch(primary->uartPrefetch());
+        engine->setAckTimeout(primary->rto()->fixedTimeoutMs());
+        engine->openPort(options.ports.at(i), options.baudRate);
+        if (!engine->isOpen()) {
+            delete engine;
+            continue;
+        }
+        connect(engine, &LinkEngine::transferProgress, this, [this, engine](const TransferStats &stats) {
+            linkProgress(engine, stats);
+        });
+        connect(engine, &LinkEngine::transferFinished, this, [this, engine](bool ok, const QString &message) {
+            linkFinished(engine, ok, message);
+        });
+        engine->writeConfig(linkConfig(i + 1));
+
+        Link link;
+        link.engine = engine;
+        links.append(link);
+    }
+
+    for (int i = 0; i < links.size(); i++) {
+        for (int j = 0; j < i; j++) {
+            if (linkConfig(i).frequency == linkConfig(j).frequency) {
+                qWarning() << "stripe links" << j << "and" << i << "share frequency" << linkConfig(i).frequency;
+            }
+        }
+    }
+    if (options.frequencies.size() > 0 && linkConfig(0).frequency != base.frequency) {
+        primary->writeConfig(linkConfig(0));
+    }
+
+    qDebug() << "striping" << options.transfer.filePath << "over" << links.size() << "links";
+    running = true;
+    elapsed.start();
+    for (int i = 0; i < links.size(); i++) {
+        links[i].engine->startStripe(options.transfer, &queue);
+    }
+}
+
+void StripedTransfer::stop()
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    for (int i = 1; i < links.size(); i++) {
+        links[i].engine->stopTransfer();
+    }
+    closeExtraLinks();
+}
+
+int StripedTransfer::indexOf(LinkEngine *engine) const
+{
+    for (int i = 0; i < links.size(); i++) {
+        if (links.at(i).engine == engine) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void StripedTransfer::linkProgress(LinkEngine *engine, const TransferStats &stats)
+{
+    int index = indexOf(engine);
+    if (!running || index < 0) {
+        return;
+    }
+    links[index].stats = stats;
+    reportProgress();
+}
+
+void StripedTransfer::linkFinished(LinkEngine *engine, bool ok, const QString &message)
+{
+    int index = indexOf(engine);
+    if (!running || index < 0 || links.at(index).done) {
+        return;
+    }
+    links[index].done = true;
+    links[index].message = message;
+    if (!ok) {
+        qWarning() << "stripe link" << index << "failed:" << message;
+    }
+
+    for (const Link &link : links) {
+        if (!link.done) {
+            reportProgress();
+            return;
+        }
+    }
+
+    //全部结束: 队列发完就算成功, 否则是所有链路都失败了
+    reportProgress();
+    running = false;
+    bool complete = queue.isComplete();
+    QString result = complete ? links.first().message : "All stripe links failed: " + message;
+    closeExtraLinks();
+    emit finished(complete, result);
+}
+
+void StripedTransfer::reportProgress()
+{
+    TransferStats total;
+    total.fileSize = queue.size();
+    total.windowMode = true;
+    total.links = links.size();
+    total.activeLinks = 0;
+    for (const Link &link : links) {
+        total.bytesAcked += link.stats.bytesAcked;
+        total.packetsSent += link.stats.packetsSent;
+        total.ackReceived += link.stats.ackReceived;
+        total.retries += link.stats.retries;
+        if (!link.done) {
+            total.activeLinks++;
+        }
+    }
+    total.bytesAcked = qMin(total.bytesAcked, total.fileSize);
+    total.spreadingFactor = primary->radioConfig().spreadingFactor;
+    total.mtu = links.first().stats.mtu;
+    total.elapsedMs = elapsed.elapsed();
+    emit progress(total);
+}
+
+void StripedTransfer::closeExtraLinks()
+{
+    //第一条链路是本端引擎, 不归这里管
+    for (int i = 1; i < links.size(); i++) {
+        links[i].engine->closePort();
+        links[i].engine->deleteLater();
+    }
+    links.clear();
+}
@@ -0,0 +1,56 @@
+#ifndef STRIPEDTRANSFER_H
+#define STRIPEDTRANSFER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QVector>
+#include "linktypes.h"
+#include "stripequeue.h"
+
+class LinkEngine;
+
+// 分条传输: 一个文件同时走几条链路(串口+模块+频点)
+// 本端引擎是第一条链路, 其余串口各开一个引擎; 各链路的FileSender从同一个队列取段,
+// 超时和重试各算各的, 某条链路失败了它没发完的段退回队列由别的链路接着发.
+// 进度按各链路汇总, 队列发完且各链路都结束才算完成
+class StripedTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int PieceChunks = 64;  // 每段多少个MTU
+
+    explicit StripedTransfer(LinkEngine *primary);
+
+    bool isRunning() const { return running; }
+    void start(const StripeOptions &options);
+    void stop();
+
+    // 各链路引擎的FileSender进度和结果
+    void linkProgress(LinkEngine *engine, const TransferStats &stats);
+    void linkFinished(LinkEngine *engine, bool ok, const QString &message);
+
+signals:
+    void progress(const TransferStats &stats);
+    void finished(bool ok, const QString &message);
+
+private:
+    struct Link {
+        LinkEngine *engine = nullptr;
+        TransferStats stats;
+        bool done = false;
+        QString message;
+    };
+
+    int indexOf(LinkEngine *engine) const;
+    void reportProgress();
+    void closeExtraLinks();
+
+    LinkEngine *primary;
+    bool running = false;
+    StripeQueue queue;
+    QVector<Link> links;
+    QElapsedTimer elapsed;
+};
+
+#endif // STRIPEDTRANSFER_H
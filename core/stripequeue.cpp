@@ -0,0 +1,50 @@
+#include "stripequeue.h"
+
+StripeQueue::StripeQueue(QObject *parent) : QObject(parent)
+{
+}
+
+void StripeQueue::reset(qint64 size, int pieceSize)
+{
+    totalSize = size;
+    doneBytes = 0;
+    pending.clear();
+
+    //倒序放, 从队尾取就是从文件头开始发
+    pieceSize = qMax(1, pieceSize);
+    int count = static_cast<int>((totalSize + pieceSize - 1) / pieceSize);
+    pending.reserve(count);
+    for (int i = count - 1; i >= 0; i--) {
+        Piece piece;
+        piece.offset = qint64(i) * pieceSize;
+        piece.size = static_cast<int>(qMin<qint64>(pieceSize, totalSize - piece.offset));
+        pending.append(piece);
+    }
+}
+
+bool StripeQueue::take(Piece *piece)
+{
+    if (pending.isEmpty()) {
+        return false;
+    }
+    *piece = pending.last();
+    pending.removeLast();
+    return true;
+}
+
+void StripeQueue::complete(const Piece &piece)
+{
+    doneBytes += piece.size;
+    if (isComplete()) {
+        emit changed();
+    }
+}
+
+void StripeQueue::giveBack(const Piece &piece)
+{
+    if (piece.size <= 0) {
+        return;
+    }
+    pending.append(piece);
+    emit changed();
+}
@@ -0,0 +1,41 @@
+#ifndef STRIPEQUEUE_H
+#define STRIPEQUEUE_H
+
+#include <QObject>
+#include <QVector>
+
+// 多链路分条传输的共享任务队列
+// 文件切成若干段, 各链路发完手上一段再来取下一段, 快的链路自然多发;
+// 某条链路失败时把没确认的部分还回来, 由别的链路接着发
+class StripeQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Piece {
+        qint64 offset = 0;
+        int size = 0;
+    };
+
+    explicit StripeQueue(QObject *parent = nullptr);
+
+    void reset(qint64 size, int pieceSize);
+    qint64 size() const { return totalSize; }
+
+    bool take(Piece *piece);
+    void complete(const Piece &piece);
+    void giveBack(const Piece &piece);     // 没发完的部分放回队首
+
+    bool isComplete() const { return doneBytes >= totalSize; }
+    qint64 bytesDone() const { return doneBytes; }
+
+signals:
+    void changed();     // 有段放回队列或者全部完成, 空闲的链路据此继续
+
+private:
+    qint64 totalSize = 0;
+    QVector<Piece> pending;     // 队尾是下一个要取的段
+    qint64 doneBytes = 0;
+};
+
+#endif // STRIPEQUEUE_H
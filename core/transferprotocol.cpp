@@ -0,0 +1,386 @@
+#include "transferprotocol.h"
+#include "crc32c.h"
+
+namespace Protocol {
+
+static void appendBigEndian(QByteArray &out, quint32 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        out.append(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+QByteArray legacyStartPacket(const QString &fileName)
+{
+    QByteArray packet("\x00\x00\x55\x55\x00\x00", 6);
+    packet.append(fileName.toUtf8());
+    return packet;
+}
+
+static QByteArray startPacket(quint8 version, const QString &fileName, int window, int mtu, quint32 fileSize)
+{
+    QByteArray packet("\x00\x00\x55\x55", 4);
+    packet.append(static_cast<char>(version));
+    packet.append(static_cast<char>(window));
+    appendBigEndian(packet, static_cast<quint32>(mtu), 2);
+    appendBigEndian(packet, fileSize, 4);
+    packet.append(fileName.toUtf8());
+    return packet;
+}
+
+QByteArray windowStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize)
+{
+    return startPacket(VersionWindow, fileName, window, mtu, fileSize);
+}
+
+QByteArray fecStartPacket(const QString &fileName, int blockSize, int mtu, quint32 fileSize)
+{
+    return startPacket(VersionFec, fileName, blockSize, mtu, fileSize);
+}
+
+QByteArray stripeStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize)
+{
+    return startPacket(VersionStripe, fileName, window, mtu, fileSize);
+}
+
+QByteArray resumeStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize, const QByteArray &sessionId)
+{
+    QByteArray packet("\x00\x00\x55\x55", 4);
+    packet.append(static_cast<char>(VersionResume));
+    packet.append(static_cast<char>(window));
+    appendBigEndian(packet, static_cast<quint32>(mtu), 2);
+    appendBigEndian(packet, fileSize, 4);
+    packet.append(sessionId.left(SessionIdSize).leftJustified(SessionIdSize, '\0'));
+    packet.append(fileName.toUtf8());
+    return packet;
+}
+
+QByteArray deltaStartPacket(const QString &fileName, int window, int mtu, quint32 deltaSize,
+                            const QByteArray &baseHash, const QByteArray &targetHash, quint32 targetSize)
+{
+    QByteArray packet("\x00\x00\x55\x55", 4);
+    packet.append(static_cast<char>(VersionDelta));
+    packet.append(static_cast<char>(window));
+    appendBigEndian(packet, static_cast<quint32>(mtu), 2);
+    appendBigEndian(packet, deltaSize, 4);
+    packet.append(baseHash.left(SessionIdSize).leftJustified(SessionIdSize, '\0'));
+    packet.append(targetHash.left(SessionIdSize).leftJustified(SessionIdSize, '\0'));
+    appendBigEndian(packet, targetSize, 4);
+    packet.append(fileName.toUtf8());
+    return packet;
+}
+
+QByteArray checkedStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize,
+                              const QByteArray &sessionId, quint32 fileCrc)
+{
+    QByteArray packet("\x00\x00\x55\x55", 4);
+    packet.append(static_cast<char>(VersionChecked));
+    packet.append(static_cast<char>(window));
+    appendBigEndian(packet, static_cast<quint32>(mtu), 2);
+    appendBigEndian(packet, fileSize, 4);
+    packet.append(sessionId.left(SessionIdSize).leftJustified(SessionIdSize, '\0'));
+    appendBigEndian(packet, fileCrc, 4);
+    packet.append(fileName.toUtf8());
+    return packet;
+}
+
+quint32 chunkCrc(quint32 offset, const uchar *data, int size)
+{
+    uchar position[4] = {
+        static_cast<uchar>(offset >> 24), static_cast<uchar>(offset >> 16),
+        static_cast<uchar>(offset >> 8), static_cast<uchar>(offset)
+    };
+    return Crc32c::extend(Crc32c::compute(position, 4), data, size);
+}
+
+QByteArray switchPacket(int spreadingFactor, int mtu, quint32 offset)
+{
+    QByteArray packet("\x00\x00\x55\x55", 4);
+    packet.append(static_cast<char>(VersionSwitch));
+    packet.append(static_cast<char>(spreadingFactor));
+    appendBigEndian(packet, static_cast<quint32>(mtu), 2);
+    appendBigEndian(packet, offset, 4);
+    return packet;
+}
+
+QByteArray retunePacket(const RetuneInfo &info)
+{
+    QByteArray packet("\x00\x00\x55\x55", 4);
+    packet.append(static_cast<char>(VersionRetune));
+    appendBigEndian(packet, info.frequency, 4);
+    appendBigEndian(packet, static_cast<quint32>(info.bandwidth), 2);
+    packet.append(static_cast<char>(info.spreadingFactor));
+    packet.append(static_cast<char>(info.codingRate));
+    appendBigEndian(packet, static_cast<quint32>(info.preamble), 2);
+    return packet;
+}
+
+QByteArray fecDataHeader(quint16 block, quint8 symbol, quint8 flags)
+{
+    uchar header[FecHeaderSize];
+    return QByteArray(reinterpret_cast<const char *>(header), writeFecDataHeader(header, block, symbol, flags));
+}
+
+int writeFecDataHeader(uchar *out, quint16 block, quint8 symbol, quint8 flags)
+{
+    out[0] = static_cast<uchar>(block >> 8);
+    out[1] = static_cast<uchar>(block);
+    out[2] = (flags & FlagMask) | FlagFec;
+    out[3] = symbol;
+    return FecHeaderSize;
+}
+
+QByteArray windowDataHeader(quint16 seq, quint8 flags)
+{
+    uchar header[WindowHeaderSize];
+    return QByteArray(reinterpret_cast<const char *>(header), writeWindowDataHeader(header, seq, flags));
+}
+
+int writeWindowDataHeader(uchar *out, quint16 seq, quint8 flags)
+{
+    out[0] = static_cast<uchar>(seq >> 8);
+    out[1] = static_cast<uchar>(seq);
+    out[2] = flags & FlagMask;
+    return WindowHeaderSize;
+}
+
+int writeCheckedDataHeader(uchar *out, quint16 seq, quint8 flags, quint32 crc)
+{
+    int size = writeWindowDataHeader(out, seq, flags);
+    out[size] = static_cast<uchar>(crc >> 24);
+    out[size + 1] = static_cast<uchar>(crc >> 16);
+    out[size + 2] = static_cast<uchar>(crc >> 8);
+    out[size + 3] = static_cast<uchar>(crc);
+    return size + ChunkCrcSize;
+}
+
+QByteArray endPacket()
+{
+    return QByteArray("\xFE\xFD\xFC", 3);
+}
+
+QByteArray legacyAck(int rssi, int snr)
+{
+    QByteArray ack("\x55\xAA\x55", 3);
+    ack.append(static_cast<char>(rssi));
+    ack.append(static_cast<char>(snr));
+    return ack;
+}
+
+QByteArray sackPacket(const Sack &sack)
+{
+    QByteArray packet("\x55\xAA\x56", 3);
+    packet.append(static_cast<char>(sack.rssi));
+    packet.append(static_cast<char>(sack.snr));
+    appendBigEndian(packet, sack.expectedSeq, 2);
+    appendBigEndian(packet, sack.bitmap, 4);
+    return packet;
+}
+
+QByteArray fecStatusPacket(const FecStatus &status)
+{
+    QByteArray packet("\x55\xAA\x57", 3);
+    packet.append(static_cast<char>(status.rssi));
+    packet.append(static_cast<char>(status.snr));
+    appendBigEndian(packet, status.decodedBlocks, 2);
+    packet.append(static_cast<char>(status.rank));
+    packet.append(static_cast<char>(status.received));
+    return packet;
+}
+
+QByteArray resumeAckPacket(const ResumeAck &ack)
+{
+    QByteArray packet("\x55\xAA\x58", 3);
+    packet.append(static_cast<char>(ack.rssi));
+    packet.append(static_cast<char>(ack.snr));
+    appendBigEndian(packet, ack.offset, 4);
+    return packet;
+}
+
+QByteArray verdictPacket(const Verdict &verdict)
+{
+    QByteArray packet("\x55\xAA\x59", 3);
+    packet.append(static_cast<char>(verdict.rssi));
+    packet.append(static_cast<char>(verdict.snr));
+    int count = qMin(verdict.ranges.size(), MaxRepairRanges);
+    packet.append(static_cast<char>(count));
+    for (int i = 0; i < count; i++) {
+        appendBigEndian(packet, verdict.ranges.at(i).offset, 4);
+        appendBigEndian(packet, verdict.ranges.at(i).length, 4);
+    }
+    return packet;
+}
+
+PacketKind packetKind(const QByteArray &payload)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    if (payload.size() >= 6 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x55 && p[3] == 0x55) {
+        if (p[4] == VersionSwitch) {
+            return SwitchKind;
+        }
+        return p[4] == VersionRetune ? RetuneKind : StartKind;
+    }
+    if (payload.size() == 3 && p[0] == 0xFE && p[1] == 0xFD && p[2] == 0xFC) {
+        return EndKind;
+    }
+    return UnknownPacket;
+}
+
+bool parseStart(const QByteArray &payload, StartInfo *info)
+{
+    if (packetKind(payload) != StartKind) {
+        return false;
+    }
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    info->version = p[4];
+    if (info->version == VersionLegacy) {
+        info->window = 1;
+        info->mtu = 0;
+        info->fileSize = 0;
+        info->fileName = QString::fromUtf8(payload.constData() + 6, payload.size() - 6);
+        return true;
+    }
+    if ((info->version == VersionWindow || info->version == VersionFec || info->version == VersionStripe)
+            && payload.size() >= 12) {
+        info->window = p[5];
+        info->mtu = (p[6] << 8) | p[7];
+        info->fileSize = (quint32(p[8]) << 24) | (quint32(p[9]) << 16) | (quint32(p[10]) << 8) | quint32(p[11]);
+        info->fileName = QString::fromUtf8(payload.constData() + 12, payload.size() - 12);
+        return true;
+    }
+    if (info->version == VersionResume && payload.size() >= 12 + SessionIdSize) {
+        info->window = p[5];
+        info->mtu = (p[6] << 8) | p[7];
+        info->fileSize = (quint32(p[8]) << 24) | (quint32(p[9]) << 16) | (quint32(p[10]) << 8) | quint32(p[11]);
+        info->sessionId = payload.mid(12, SessionIdSize);
+        info->fileName = QString::fromUtf8(payload.constData() + 12 + SessionIdSize, payload.size() - 12 - SessionIdSize);
+        return true;
+    }
+    const int deltaHeader = 12 + 2 * SessionIdSize + 4;
+    if (info->version == VersionDelta && payload.size() >= deltaHeader) {
+        const uchar *size = p + 12 + 2 * SessionIdSize;
+        info->window = p[5];
+        info->mtu = (p[6] << 8) | p[7];
+        info->fileSize = (quint32(p[8]) << 24) | (quint32(p[9]) << 16) | (quint32(p[10]) << 8) | quint32(p[11]);
+        info->baseHash = payload.mid(12, SessionIdSize);
+        info->targetHash = payload.mid(12 + SessionIdSize, SessionIdSize);
+        info->targetSize = (quint32(size[0]) << 24) | (quint32(size[1]) << 16) | (quint32(size[2]) << 8) | quint32(size[3]);
+        info->fileName = QString::fromUtf8(payload.constData() + deltaHeader, payload.size() - deltaHeader);
+        return true;
+    }
+    const int checkedHeader = 12 + SessionIdSize + 4;
+    if (info->version == VersionChecked && payload.size() >= checkedHeader) {
+        const uchar *crc = p + 12 + SessionIdSize;
+        info->window = p[5];
+        info->mtu = (p[6] << 8) | p[7];
+        info->fileSize = (quint32(p[8]) << 24) | (quint32(p[9]) << 16) | (quint32(p[10]) << 8) | quint32(p[11]);
+        info->sessionId = payload.mid(12, SessionIdSize);
+        info->fileCrc = (quint32(crc[0]) << 24) | (quint32(crc[1]) << 16) | (quint32(crc[2]) << 8) | quint32(crc[3]);
+        info->fileName = QString::fromUtf8(payload.constData() + checkedHeader, payload.size() - checkedHeader);
+        return true;
+    }
+    return false;
+}
+
+bool parseSwitch(const QByteArray &payload, SwitchInfo *info)
+{
+    if (packetKind(payload) != SwitchKind || payload.size() < 12) {
+        return false;
+    }
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    info->spreadingFactor = p[5];
+    info->mtu = (p[6] << 8) | p[7];
+    info->offset = (quint32(p[8]) << 24) | (quint32(p[9]) << 16) | (quint32(p[10]) << 8) | quint32(p[11]);
+    return true;
+}
+
+bool parseRetune(const QByteArray &payload, RetuneInfo *info)
+{
+    if (packetKind(payload) != RetuneKind || payload.size() < RetuneSize) {
+        return false;
+    }
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    info->frequency = (quint32(p[5]) << 24) | (quint32(p[6]) << 16) | (quint32(p[7]) << 8) | quint32(p[8]);
+    info->bandwidth = (p[9] << 8) | p[10];
+    info->spreadingFactor = p[11];
+    info->codingRate = p[12];
+    info->preamble = (p[13] << 8) | p[14];
+    return true;
+}
+
+bool parseSack(const QByteArray &payload, Sack *sack)
+{
+    return parseSack(reinterpret_cast<const uchar *>(payload.constData()), payload.size(), sack);
+}
+
+bool parseSack(const uchar *p, int size, Sack *sack)
+{
+    if (size < SackSize) {
+        return false;
+    }
+    if (p[0] != 0x55 || p[1] != 0xAA || p[2] != 0x56) {
+        return false;
+    }
+    sack->rssi = static_cast<qint8>(p[3]);
+    sack->snr = static_cast<qint8>(p[4]);
+    sack->expectedSeq = static_cast<quint16>((p[5] << 8) | p[6]);
+    sack->bitmap = (quint32(p[7]) << 24) | (quint32(p[8]) << 16) | (quint32(p[9]) << 8) | quint32(p[10]);
+    return true;
+}
+
+bool parseFecStatus(const uchar *p, int size, FecStatus *status)
+{
+    if (size < FecStatusSize) {
+        return false;
+    }
+    if (p[0] != 0x55 || p[1] != 0xAA || p[2] != 0x57) {
+        return false;
+    }
+    status->rssi = static_cast<qint8>(p[3]);
+    status->snr = static_cast<qint8>(p[4]);
+    status->decodedBlocks = static_cast<quint16>((p[5] << 8) | p[6]);
+    status->rank = p[7];
+    status->received = p[8];
+    return true;
+}
+
+bool parseResumeAck(const uchar *p, int size, ResumeAck *ack)
+{
+    if (size < ResumeAckSize) {
+        return false;
+    }
+    if (p[0] != 0x55 || p[1] != 0xAA || p[2] != 0x58) {
+        return false;
+    }
+    ack->rssi = static_cast<qint8>(p[3]);
+    ack->snr = static_cast<qint8>(p[4]);
+    ack->offset = (quint32(p[5]) << 24) | (quint32(p[6]) << 16) | (quint32(p[7]) << 8) | quint32(p[8]);
+    return true;
+}
+
+bool parseVerdict(const uchar *p, int size, Verdict *verdict)
+{
+    if (size < VerdictSize) {
+        return false;
+    }
+    if (p[0] != 0x55 || p[1] != 0xAA || p[2] != 0x59) {
+        return false;
+    }
+    int count = p[5];
+    if (count > MaxRepairRanges || size < VerdictSize + 8 * count) {
+        return false;
+    }
+    verdict->rssi = static_cast<qint8>(p[3]);
+    verdict->snr = static_cast<qint8>(p[4]);
+    verdict->ranges.clear();
+    for (int i = 0; i < count; i++) {
+        const uchar *r = p + VerdictSize + 8 * i;
+        Range range;
+        range.offset = (quint32(r[0]) << 24) | (quint32(r[1]) << 16) | (quint32(r[2]) << 8) | quint32(r[3]);
+        range.length = (quint32(r[4]) << 24) | (quint32(r[5]) << 16) | (quint32(r[6]) << 8) | quint32(r[7]);
+        verdict->ranges.append(range);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,220 @@
+#ifndef TRANSFERPROTOCOL_H
+#define TRANSFERPROTOCOL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// 图传帧格式 (AT+PSEND 的负载, 串口上以16进制发送)
+//
+// 旧协议(停等, 老固件):
+//   开始包  00 00 55 55 00 00 | 文件名
+//   数据包  序号(1) | 数据
+//   结束包  FE FD FC
+//   ACK     55 AA 55 | rssi | snr
+//
+// 窗口协议(v2, 选择重传):
+//   开始包  00 00 55 55 01 | 窗口(1) | MTU(2) | 文件大小(4) | 文件名
+//   数据包  序号(2) | 标志(1) | 数据          标志bit0: 请求应答(一轮突发的最后一包)
+//   结束包  FE FD FC
+//   SACK    55 AA 56 | rssi | snr | 期望序号(2) | 位图(4)
+//           位图bit i 表示 期望序号+1+i 已收到, 期望序号之前的全部已收到
+//
+// 窗口协议传输中切换参数(自适应速率):
+//   切换包  00 00 55 55 03 | SF(1) | 新MTU(2) | 续传的文件偏移(4)
+//           对端用旧参数回SACK(期望序号0)后切到新SF, 从偏移处按新MTU重新编号;
+//           一段时间在新参数上收不到包就退回旧参数
+//
+// 续传(窗口协议):
+//   开始包  00 00 55 55 04 | 窗口(1) | MTU(2) | 文件大小(4) | 会话ID(8, 文件内容哈希) | 文件名
+//   应答    55 AA 58 | rssi | snr | 续传的文件偏移(4)
+//           接收端按会话ID找到没收完的文件, 回它已连续收到的字节数(新会话回0), 之后按窗口协议从该偏移重新编号;
+//           不认识续传开始包的对端回 55AA55 或不回, 发送端退回普通窗口开始包
+//
+// 多链路分条(窗口协议):
+//   开始包  00 00 55 55 05 | 窗口(1) | MTU(2) | 文件大小(4) | 文件名
+//           每条链路(串口+频点)各发一个, 接收端不截断输出文件, 各链路只写自己那几段;
+//           之后用切换包(SF不变)跳到分到的段, 段内按窗口协议编号
+//
+// 纠删码协议(v2, FEC):
+//   开始包  00 00 55 55 02 | 源块符号数K(1) | MTU(2) | 文件大小(4) | 文件名
+//   数据包  块号(2) | 标志(1) | 符号编号(1) | 符号(MTU字节, 最后一块不足的补0)
+//           标志bit0: 请求应答, bit1: FEC帧; 编号0..K-1是源符号, K以后是校验符号
+//   结束包  FE FD FC
+//   状态    55 AA 57 | rssi | snr | 已解码块数(2) | 当前块的秩(1) | 累计收到符号数(1, 回绕)
+//           当前块还需要 K-秩 个符号; 发送端用累计收到数估算丢包率
+//
+// 扫参(丢包率测试逐点换参数):
+//   调参包  00 00 55 55 06 | 频率(4, Hz) | BW(2, kHz) | SF(1) | CR(1, crBox索引) | 前导码(2)
+//           对端用旧参数回ACK(55AA55)后切到新参数, 和当前参数一样的只回ACK;
+//           第一次调参前的参数记为原参数, 调参后一段时间收不到包就退回原参数, 调回原参数即结束扫参
+//
+// 差量传输(窗口协议, 见deltacodec.h):
+//   开始包  00 00 55 55 07 | 窗口(1) | MTU(2) | 差量大小(4) | 基准哈希(8) | 目标哈希(8) | 目标大小(4) | 文件名
+//           两端都缓存送达过的文件, 哈希同续传的会话ID; 发送端拿上一次送达的版本做基准编码,
+//           对端有这个基准就回SACK, 之后按窗口协议发差量, 收完用基准重建并校验目标哈希;
+//           没有基准回 55AA55, 不认识的对端回 55AA55 或不回, 发送端退回整个文件发
+//
+// 校验模式(窗口协议, 见integritycheck.h):
+//   开始包  00 00 55 55 08 | 窗口(1) | MTU(2) | 文件大小(4) | 会话ID(8, 全0不续传) | 文件CRC32C(4) | 文件名
+//           应答同续传(55AA58 + 偏移); 不认识的对端回 55AA55 或不回, 发送端退回续传/普通窗口开始包
+//   数据包  序号(2) | 标志(1) | CRC32C(4) | 数据
+//           CRC算的是 文件偏移(4) + 数据, 放错位置的块也对不上; 对不上的块当没收到, SACK里不置位,
+//           发送端照常只重发这一块
+//   结束包  FE FD FC, 发送端等对端的结论再结束, 不批量连发
+//   结论    55 AA 59 | rssi | snr | 段数(1) | [偏移(4) | 长度(4)] * 段数
+//           段数0: 整个文件的CRC对上了; 否则是要补发的段, 发送端用切换包(SF和MTU不变)逐段跳过去
+//           按窗口协议补发, 补完再发结束包
+//
+// 批量传输: 窗口/纠删码协议下对端已确认收完一个文件后, 下一个文件的开始包同时结束这一个,
+// 不再单发结束包; 最后一个文件照常发结束包
+//
+// 多字节字段均为大端. 老固件对v2开始包只会回 55AA55, 发送端据此回退到旧协议.
+namespace Protocol {
+
+const int LegacyHeaderSize = 1;
+const int WindowHeaderSize = 3;
+const int MaxWindowSize = 32;
+
+const quint8 VersionLegacy = 0x00;
+const quint8 VersionWindow = 0x01;
+const quint8 VersionFec = 0x02;
+const quint8 VersionSwitch = 0x03;
+const quint8 VersionResume = 0x04;
+const quint8 VersionStripe = 0x05;
+const quint8 VersionRetune = 0x06;
+const quint8 VersionDelta = 0x07;
+const quint8 VersionChecked = 0x08;
+
+const quint8 FlagAckRequest = 0x01;
+const quint8 FlagMask = 0x01;
+const quint8 FlagFec = 0x02;
+
+const int LegacyAckSize = 5;
+const int SackSize = 11;
+const int FecHeaderSize = 4;
+const int FecStatusSize = 9;
+const int ResumeAckSize = 9;
+const int SessionIdSize = 8;
+const int RetuneSize = 15;
+const int ChunkCrcSize = 4;
+const int CheckedHeaderSize = WindowHeaderSize + ChunkCrcSize;
+const int VerdictSize = 6;          // 不带段的结论
+const int MaxRepairRanges = 8;
+const quint32 MaxFecBlocks = 0xFFFF;    // 块号和状态里的已解码块数都是2字节
+
+const int SwitchRevertMs = 5000;    // 接收端切换参数后这么久收不到包就退回旧参数
+
+struct Sack {
+    int rssi = 0;
+    int snr = 0;
+    quint16 expectedSeq = 0;
+    quint32 bitmap = 0;
+};
+
+struct FecStatus {
+    int rssi = 0;
+    int snr = 0;
+    quint16 decodedBlocks = 0;
+    quint8 rank = 0;
+    quint8 received = 0;
+};
+
+struct ResumeAck {
+    int rssi = 0;
+    int snr = 0;
+    quint32 offset = 0;
+};
+
+struct SwitchInfo {
+    int spreadingFactor = 0;
+    int mtu = 0;
+    quint32 offset = 0;
+};
+
+struct RetuneInfo {
+    quint32 frequency = 0;      // Hz
+    int bandwidth = 0;          // kHz
+    int spreadingFactor = 0;
+    int codingRate = 0;
+    int preamble = 0;
+};
+
+struct Range {
+    quint32 offset = 0;
+    quint32 length = 0;
+};
+
+struct Verdict {
+    int rssi = 0;
+    int snr = 0;
+    QVector<Range> ranges;      // 空: 校验通过
+};
+
+struct StartInfo {
+    quint8 version = VersionLegacy;
+    int window = 1;             // FEC: 源块符号数
+    int mtu = 0;
+    quint32 fileSize = 0;
+    QByteArray sessionId;       // 续传开始包
+    QByteArray baseHash;        // 差量开始包, fileSize是差量的大小
+    QByteArray targetHash;
+    quint32 targetSize = 0;
+    quint32 fileCrc = 0;        // 校验模式的开始包
+    QString fileName;
+};
+
+enum PacketKind {
+    UnknownPacket,
+    StartKind,
+    EndKind,
+    SwitchKind,
+    RetuneKind
+};
+
+QByteArray legacyStartPacket(const QString &fileName);
+QByteArray windowStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize);
+QByteArray windowDataHeader(quint16 seq, quint8 flags);
+QByteArray fecStartPacket(const QString &fileName, int blockSize, int mtu, quint32 fileSize);
+QByteArray fecDataHeader(quint16 block, quint8 symbol, quint8 flags);
+QByteArray switchPacket(int spreadingFactor, int mtu, quint32 offset);
+QByteArray resumeStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize, const QByteArray &sessionId);
+QByteArray stripeStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize);
+QByteArray retunePacket(const RetuneInfo &info);
+QByteArray deltaStartPacket(const QString &fileName, int window, int mtu, quint32 deltaSize,
+                            const QByteArray &baseHash, const QByteArray &targetHash, quint32 targetSize);
+QByteArray checkedStartPacket(const QString &fileName, int window, int mtu, quint32 fileSize,
+                              const QByteArray &sessionId, quint32 fileCrc);
+
+// 校验模式数据块的CRC: 文件偏移(4, 大端) + 数据
+quint32 chunkCrc(quint32 offset, const uchar *data, int size);
+
+// 帧头直接写到调用方的缓冲区, 返回写入的字节数
+int writeWindowDataHeader(uchar *out, quint16 seq, quint8 flags);
+int writeFecDataHeader(uchar *out, quint16 block, quint8 symbol, quint8 flags);
+int writeCheckedDataHeader(uchar *out, quint16 seq, quint8 flags, quint32 crc);
+QByteArray endPacket();
+
+// 接收端的应答
+QByteArray legacyAck(int rssi, int snr);
+QByteArray sackPacket(const Sack &sack);
+QByteArray fecStatusPacket(const FecStatus &status);
+QByteArray resumeAckPacket(const ResumeAck &ack);
+QByteArray verdictPacket(const Verdict &verdict);
+
+// 解析原始(已从16进制解码的)负载, 成功返回true
+bool parseSack(const uchar *data, int size, Sack *sack);
+bool parseSack(const QByteArray &payload, Sack *sack);
+bool parseFecStatus(const uchar *data, int size, FecStatus *status);
+bool parseResumeAck(const uchar *data, int size, ResumeAck *ack);
+bool parseVerdict(const uchar *data, int size, Verdict *verdict);
+bool parseStart(const QByteArray &payload, StartInfo *info);
+bool parseSwitch(const QByteArray &payload, SwitchInfo *info);
+bool parseRetune(const QByteArray &payload, RetuneInfo *info);
+
+// 开始包/结束包识别, 其余都按数据包处理
+PacketKind packetKind(const QByteArray &payload);
+
+}
+
+#endif // TRANSFERPROTOCOL_H
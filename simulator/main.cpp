@@ -0,0 +1,90 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "modemsimulator.h"
+
+// Ctrl+C 通过socketpair转回事件循环, 正常退出才会打印统计并删掉软链接
+static int signalFds[2];
+
+static void handleSignal(int)
+{
+    char c = 1;
+    ssize_t ignored = ::write(signalFds[0], &c, 1);
+    (void)ignored;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("modem-simulator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Pseudo-terminal LoRa P2P modem simulator for 2G4_Test");
+    parser.addHelpOption();
+
+    QCommandLineOption sfOption("sf", "Peer spreading factor (5-12), the host must configure the same.", "sf", "7");
+    QCommandLineOption bwOption("bw", "Peer bandwidth in kHz (125, 250, 500).", "khz", "125");
+    QCommandLineOption crOption("cr", "Coding rate 4/(4+cr), cr = 1-4.", "cr", "1");
+    QCommandLineOption preambleOption("preamble", "Preamble length in symbols.", "symbols", "8");
+    QCommandLineOption baudOption("baud", "UART baud rate between host and modem.", "baud", "115200");
+    QCommandLineOption lossOption("loss", "Probability that a host packet is lost (0-1).", "p", "0");
+    QCommandLineOption ackLossOption("ack-loss", "Probability that a peer reply is lost (0-1).", "p", "0");
+    QCommandLineOption jitterOption("jitter", "Extra random air delay per reply, 0..ms.", "ms", "0");
+    QCommandLineOption turnaroundOption("turnaround", "Peer processing time before replying.", "ms", "10");
+    QCommandLineOption rssiOption("rssi", "Reported RSSI in dBm.", "dbm", "-60");
+    QCommandLineOption snrOption("snr", "Reported SNR in dB.", "db", "8");
+    QCommandLineOption seedOption("seed", "Random seed for loss and jitter.", "seed", "1");
+    QCommandLineOption legacyOption("legacy-peer", "Peer only understands the stop-and-wait protocol.");
+    QCommandLineOption linkOption("link", "Create a symlink to the pty slave at this path.", "path");
+    QCommandLineOption outputOption("output", "Directory where the peer stores received files.", "dir", ".");
+    parser.addOptions({sfOption, bwOption, crOption, preambleOption, baudOption, lossOption, ackLossOption,
+                       jitterOption, turnaroundOption, rssiOption, snrOption, seedOption, legacyOption,
+                       linkOption, outputOption});
+    parser.process(a);
+
+    SimulatorOptions options;
+    options.modulation.spreadingFactor = parser.value(sfOption).toInt();
+    options.modulation.bandwidthKhz = parser.value(bwOption).toInt();
+    options.modulation.codingRate = parser.value(crOption).toInt();
+    options.modulation.preamble = parser.value(preambleOption).toInt();
+    options.baudRate = parser.value(baudOption).toInt();
+    options.uplinkLoss = parser.value(lossOption).toDouble();
+    options.downlinkLoss = parser.value(ackLossOption).toDouble();
+    options.jitterMs = parser.value(jitterOption).toInt();
+    options.turnaroundMs = parser.value(turnaroundOption).toInt();
+    options.rssi = parser.value(rssiOption).toInt();
+    options.snr = parser.value(snrOption).toInt();
+    options.seed = parser.value(seedOption).toUInt();
+    options.legacyPeer = parser.isSet(legacyOption);
+    options.linkPath = parser.value(linkOption);
+    options.outputDir = parser.value(outputOption);
+
+    if (options.baudRate <= 0 || options.modulation.spreadingFactor < 5 || options.modulation.spreadingFactor > 12) {
+        QTextStream(stderr) << "invalid --baud or --sf\n";
+        return 2;
+    }
+
+    ModemSimulator simulator(options);
+    QString error;
+    if (!simulator.open(&error)) {
+        QTextStream(stderr) << error << "\n";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << simulator.slaveName() << "\n";
+    out.flush();
+
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, signalFds) == 0) {
+        QSocketNotifier *notifier = new QSocketNotifier(signalFds[1], QSocketNotifier::Read, &a);
+        QObject::connect(notifier, SIGNAL(activated(int)), &a, SLOT(quit()));
+        ::signal(SIGINT, handleSignal);
+        ::signal(SIGTERM, handleSignal);
+    }
+
+    return a.exec();
+}
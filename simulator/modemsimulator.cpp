@@ -0,0 +1,408 @@
+#include "modemsimulator.h"
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+#include <QtMath>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+ModemSimulator::ModemSimulator(const SimulatorOptions &options, QObject *parent)
+    : QObject(parent), options(options), peer(options.legacyPeer), peerModulation(options.modulation), random(options.seed)
+{
+    peer.setOutputDir(options.outputDir);
+    clock.start();
+}
+
+ModemSimulator::~ModemSimulator()
+{
+    qInfo().nospace() << "tx " << txPackets << ", rx " << rxPackets
+                      << ", lost uplink " << lostUplink << ", lost downlink " << lostDownlink
+                      << ", missed (not listening) " << missedNotListening
+                      << ", missed (SF/BW mismatch) " << missedMismatch
+                      << ", files " << peer.filesCompleted();
+
+    if (!options.linkPath.isEmpty()) {
+        QFile::remove(options.linkPath);
+    }
+    if (slaveFd >= 0) {
+        ::close(slaveFd);
+    }
+    if (masterFd >= 0) {
+        ::close(masterFd);
+    }
+}
+
+bool ModemSimulator::open(QString *error)
+{
+    masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFd < 0 || grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) {
+        *error = QString("posix_openpt failed: ") + strerror(errno);
+        return false;
+    }
+
+    const char *name = ptsname(masterFd);
+    if (!name) {
+        *error = QString("ptsname failed: ") + strerror(errno);
+        return false;
+    }
+    slavePath = QString::fromLocal8Bit(name);
+
+    //从端设成原始模式, 不做行编辑和回显
+    slaveFd = ::open(name, O_RDWR | O_NOCTTY);
+    termios tio;
+    if (slaveFd >= 0 && tcgetattr(slaveFd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(slaveFd, TCSANOW, &tio);
+    }
+
+    fcntl(masterFd, F_SETFL, fcntl(masterFd, F_GETFL) | O_NONBLOCK);
+
+    readNotifier = new QSocketNotifier(masterFd, QSocketNotifier::Read, this);
+    connect(readNotifier, SIGNAL(activated(int)), this, SLOT(onMasterReadable()));
+    writeNotifier = new QSocketNotifier(masterFd, QSocketNotifier::Write, this);
+    writeNotifier->setEnabled(false);
+    connect(writeNotifier, SIGNAL(activated(int)), this, SLOT(onMasterWritable()));
+
+    if (!options.linkPath.isEmpty()) {
+        QFile::remove(options.linkPath);
+        if (!QFile::link(slavePath, options.linkPath)) {
+            qWarning() << "cannot create link" << options.linkPath;
+        }
+    }
+    return true;
+}
+
+double ModemSimulator::now() const
+{
+    return clock.nsecsElapsed() / 1000000.0;
+}
+
+bool ModemSimulator::chance(double probability)
+{
+    return probability > 0.0 && random.generateDouble() < probability;
+}
+
+int ModemSimulator::airDelayMs(double airtimeMs)
+{
+    int jitter = options.jitterMs > 0 ? random.bounded(options.jitterMs + 1) : 0;
+    return qCeil(airtimeMs) + jitter;
+}
+
+void ModemSimulator::onMasterReadable()
+{
+    char buffer[4096];
+    ssize_t size = ::read(masterFd, buffer, sizeof(buffer));
+    if (size <= 0) {
+        return;
+    }
+
+    //字节按波特率陆续到达模块, 传完才能被解析
+    InputChunk chunk;
+    chunk.readyAt = qMax(now(), inputBusyUntil) + LoraAirtime::uartTimeMs(static_cast<int>(size), options.baudRate);
+    chunk.data = QByteArray(buffer, static_cast<int>(size));
+    inputBusyUntil = chunk.readyAt;
+    inputQueue.enqueue(chunk);
+
+    QTimer::singleShot(qMax(0, qCeil(chunk.readyAt - now())), this, [this]() { processInput(); });
+}
+
+void ModemSimulator::processInput()
+{
+    while (!inputQueue.isEmpty() && inputQueue.head().readyAt <= now() + 0.5) {
+        InputChunk chunk = inputQueue.dequeue();
+        if (echo) {
+            uartWrite(chunk.data);
+        }
+        lineBuffer.append(chunk.data);
+    }
+
+    int end;
+    while ((end = lineBuffer.indexOf('\n')) >= 0) {
+        QByteArray line = lineBuffer.left(end);
+        lineBuffer.remove(0, end + 1);
+        handleLine(line.trimmed());
+    }
+}
+
+void ModemSimulator::handleLine(const QByteArray &line)
+{
+    if (line.isEmpty()) {
+        return;
+    }
+
+    QByteArray upper = line.toUpper();
+    int separator = line.indexOf('=');
+    QByteArray command = separator >= 0 ? upper.left(separator) : upper;
+    QByteArray value = separator >= 0 ? line.mid(separator + 1) : QByteArray();
+    bool ok = true;
+    bool busy = now() < txBusyUntil;
+
+    if (command == "AT") {
+        uartWrite("OK\r\n");
+    } else if (command == "ATE") {
+        echo = !echo;
+        uartWrite("OK\r\n");
+    } else if (command == "AT+PSEND") {
+        handleSend(value);
+    } else if (busy) {
+        //射频忙的时候不接受配置
+        uartWrite("AT_BUSY_ERROR\r\n");
+    } else if (command == "AT+PRECV") {
+        int rx = value.toInt(&ok);
+        if (!ok || rx < 0 || rx > RxSingle) {
+            uartWrite("AT_PARAM_ERROR\r\n");
+        } else {
+            setReceive(rx);
+            uartWrite("OK\r\n");
+        }
+    } else if (command == "AT+PSF") {
+        int sf = value.toInt(&ok);
+        ok = ok && sf >= 5 && sf <= 12;
+        if (ok) options.modulation.spreadingFactor = sf;
+        uartWrite(ok ? "OK\r\n" : "AT_PARAM_ERROR\r\n");
+    } else if (command == "AT+PBW") {
+        int bw = value.toInt(&ok);
+        ok = ok && (bw == 125 || bw == 250 || bw == 500);
+        if (ok) options.modulation.bandwidthKhz = bw;
+        uartWrite(ok ? "OK\r\n" : "AT_PARAM_ERROR\r\n");
+    } else if (command == "AT+PCR") {
+        int cr = value.toInt(&ok);
+        ok = ok && cr >= 0 && cr <= 5;
+        if (ok) options.modulation.codingRate = LoraAirtime::codingRateFromIndex(cr);
+        uartWrite(ok ? "OK\r\n" : "AT_PARAM_ERROR\r\n");
+    } else if (command == "AT+PPL") {
+        int preamble = value.toInt(&ok);
+        ok = ok && preamble >= 5 && preamble <= 65535;
+        if (ok) options.modulation.preamble = preamble;
+        uartWrite(ok ? "OK\r\n" : "AT_PARAM_ERROR\r\n");
+    } else if (command == "AT+BAUD") {
+        //OK按原波特率回, 之后的按新的算
+        int baud = value.toInt(&ok);
+        ok = ok && baud >= 9600 && baud <= 921600;
+        uartWrite(ok ? "OK\r\n" : "AT_PARAM_ERROR\r\n");
+        if (ok) options.baudRate = baud;
+    } else if (command == "AT+NWM" || command == "AT+PFREQ" || command == "AT+PTP" || command == "AT+SYNCWORD") {
+        uartWrite("OK\r\n");
+    } else {
+        uartWrite("AT_ERROR\r\n");
+    }
+}
+
+void ModemSimulator::handleSend(const QByteArray &hex)
+{
+    if (now() < txBusyUntil || (rxMode != RxOff && rxMode != RxTxAllowed)) {
+        uartWrite("AT_BUSY_ERROR\r\n");
+        return;
+    }
+
+    QByteArray payload = QByteArray::fromHex(hex);
+    if (payload.isEmpty() || payload.size() > 255 || (hex.size() % 2) != 0) {
+        uartWrite("AT_PARAM_ERROR\r\n");
+        return;
+    }
+
+    uartWrite("OK\r\n");
+
+    double airtime = LoraAirtime::timeOnAirMs(options.modulation, payload.size());
+    txBusyUntil = now() + airtime;
+    txPackets++;
+    LoraModulation modulation = options.modulation;
+    QTimer::singleShot(qCeil(airtime), this, [this, payload, modulation]() { transmitDone(payload, modulation); });
+}
+
+bool ModemSimulator::sameChannel(const LoraModulation &a, const LoraModulation &b)
+{
+    return a.spreadingFactor == b.spreadingFactor && a.bandwidthKhz == b.bandwidthKhz;
+}
+
+void ModemSimulator::transmitDone(const QByteArray &payload, const LoraModulation &modulation)
+{
+    uartWrite("+EVT:TXP2P DONE\r\n");
+
+    if (!sameChannel(modulation, peerModulation)) {
+        missedMismatch++;
+        return;
+    }
+    if (chance(options.uplinkLoss)) {
+        lostUplink++;
+        return;
+    }
+
+    peerGeneration++;   //对端收到包, 当前参数可用
+    if (peerRetuned) {
+        watchRetune();
+    }
+    int rssi = options.rssi + random.bounded(-2, 3);
+    int snr = options.snr + random.bounded(-1, 2);
+    QByteArray reply = peer.receive(payload, rssi, snr);
+    if (reply.isEmpty()) {
+        return;
+    }
+
+    //切换包的应答还用旧参数回, 回完再切
+    int spreadingFactor = 0;
+    peer.takeSpreadingFactorChange(&spreadingFactor);
+    Protocol::RetuneInfo retune;
+    bool retuning = peer.takeRetune(&retune);
+    LoraModulation replyModulation = peerModulation;
+    int delay = options.turnaroundMs + airDelayMs(LoraAirtime::timeOnAirMs(replyModulation, reply.size()));
+    QTimer::singleShot(delay, this, [this, reply, replyModulation, spreadingFactor, retuning, retune]() {
+        peerReply(reply, replyModulation);
+        if (spreadingFactor != 0) {
+            switchPeer(spreadingFactor);
+        }
+        if (retuning) {
+            retunePeer(retune);
+        }
+    });
+}
+
+void ModemSimulator::peerReply(const QByteArray &reply, const LoraModulation &modulation)
+{
+    if (chance(options.downlinkLoss)) {
+        lostDownlink++;
+        return;
+    }
+    receiveFromAir(reply, modulation);
+}
+
+void ModemSimulator::switchPeer(int spreadingFactor)
+{
+    if (spreadingFactor == peerModulation.spreadingFactor) {
+        return;
+    }
+    LoraModulation previous = peerModulation;
+    peerModulation.spreadingFactor = spreadingFactor;
+    qInfo() << "peer switched to SF" << spreadingFactor;
+
+    //新参数上一直收不到包(切换包的应答丢了, 上位机已经退回), 对端也退回去
+    int generation = ++peerGeneration;
+    QTimer::singleShot(Protocol::SwitchRevertMs, this, [this, generation, previous]() {
+        if (generation == peerGeneration) {
+            peerModulation = previous;
+            qInfo() << "peer reverted to SF" << previous.spreadingFactor;
+        }
+    });
+}
+
+void ModemSimulator::retunePeer(const Protocol::RetuneInfo &info)
+{
+    LoraModulation target = peerModulation;
+    target.spreadingFactor = info.spreadingFactor;
+    target.bandwidthKhz = info.bandwidth;
+    target.codingRate = LoraAirtime::codingRateFromIndex(info.codingRate);
+    target.preamble = info.preamble;
+    if (!peerRetuned) {
+        peerHome = peerModulation;
+        peerRetuned = true;
+    }
+    peerModulation = target;
+    qInfo() << "peer retuned to SF" << target.spreadingFactor << "BW" << target.bandwidthKhz;
+
+    //调回原参数就结束扫参, 否则一直收不到包就退回原参数
+    if (sameChannel(target, peerHome) && target.codingRate == peerHome.codingRate && target.preamble == peerHome.preamble) {
+        peerRetuned = false;
+        return;
+    }
+    peerGeneration++;
+    watchRetune();
+}
+
+void ModemSimulator::watchRetune()
+{
+    int generation = peerGeneration;
+    QTimer::singleShot(Protocol::SwitchRevertMs, this, [this, generation]() {
+        if (peerRetuned && generation == peerGeneration) {
+            peerModulation = peerHome;
+            peerRetuned = false;
+            qInfo() << "peer reverted to SF" << peerHome.spreadingFactor << "BW" << peerHome.bandwidthKhz;
+        }
+    });
+}
+
+bool ModemSimulator::isReceiving() const
+{
+    return rxMode != RxOff && now() >= txBusyUntil;
+}
+
+void ModemSimulator::receiveFromAir(const QByteArray &payload, const LoraModulation &modulation)
+{
+    if (!sameChannel(modulation, options.modulation)) {
+        missedMismatch++;
+        return;
+    }
+
+    //半双工: 回包在空中的这段时间里本端发过包, 或者没开接收, 都收不到
+    double airtime = LoraAirtime::timeOnAirMs(modulation, payload.size());
+    if (!isReceiving() || txBusyUntil > now() - airtime) {
+        missedNotListening++;
+        return;
+    }
+
+    rxPackets++;
+    int rssi = options.rssi + random.bounded(-2, 3);
+    int snr = options.snr + random.bounded(-1, 2);
+    uartWrite("+EVT:RXP2P:" + QByteArray::number(rssi) + ":" + QByteArray::number(snr) + ":"
+              + payload.toHex().toUpper() + "\r\n");
+
+    if (rxMode != RxTxAllowed && rxMode != RxContinuous) {
+        rxMode = RxOff;
+        rxGeneration++;
+    }
+}
+
+void ModemSimulator::setReceive(int value)
+{
+    rxMode = value;
+    rxGeneration++;
+
+    //1..65532 是接收窗口(ms), 超时退出接收
+    if (value > 0 && value < RxTxAllowed) {
+        int generation = rxGeneration;
+        QTimer::singleShot(value, this, [this, generation]() {
+            if (generation == rxGeneration && rxMode != RxOff) {
+                rxMode = RxOff;
+                uartWrite("+EVT:RXP2P RECEIVE TIMEOUT\r\n");
+            }
+        });
+    }
+}
+
+void ModemSimulator::uartWrite(const QByteArray &text)
+{
+    //回复按波特率排队, 传完才到上位机
+    outputBusyUntil = qMax(now(), outputBusyUntil) + LoraAirtime::uartTimeMs(text.size(), options.baudRate);
+    QTimer::singleShot(qMax(0, qCeil(outputBusyUntil - now())), this, [this, text]() { writeMaster(text); });
+}
+
+void ModemSimulator::writeMaster(const QByteArray &data)
+{
+    if (!pendingWrite.isEmpty()) {
+        pendingWrite.append(data);
+        return;
+    }
+
+    ssize_t written = ::write(masterFd, data.constData(), data.size());
+    if (written < 0) {
+        written = 0;
+    }
+    if (written < data.size()) {
+        pendingWrite = data.mid(static_cast<int>(written));
+        writeNotifier->setEnabled(true);
+    }
+}
+
+void ModemSimulator::onMasterWritable()
+{
+    ssize_t written = ::write(masterFd, pendingWrite.constData(), pendingWrite.size());
+    if (written > 0) {
+        pendingWrite.remove(0, static_cast<int>(written));
+    }
+    if (pendingWrite.isEmpty()) {
+        writeNotifier->setEnabled(false);
+    }
+}
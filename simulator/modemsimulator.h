@@ -0,0 +1,110 @@
+#ifndef MODEMSIMULATOR_H
+#define MODEMSIMULATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QRandomGenerator>
+#include <QSocketNotifier>
+#include "loraairtime.h"
+#include "peermodel.h"
+
+struct SimulatorOptions {
+    LoraModulation modulation;  // 对端的调制参数, 上位机配成一样的才能通
+    int baudRate = 115200;
+    double uplinkLoss = 0.0;    // 发往对端的包丢失概率
+    double downlinkLoss = 0.0;  // 对端回包丢失概率
+    int jitterMs = 0;           // 每次空口传输额外的随机延时 0..jitterMs
+    int turnaroundMs = 10;      // 对端收到包到开始回包的处理时间
+    int rssi = -60;
+    int snr = 8;
+    quint32 seed = 1;
+    bool legacyPeer = false;    // 对端是只认停等协议的老固件
+    QString linkPath;           // 给伪终端从端建一个固定路径的软链接
+    QString outputDir;          // 对端收到的文件写到这里
+};
+
+// 伪终端模块模拟器
+// 在伪终端上模拟本工具用到的AT指令, 空口时间按LoRa公式计算, 串口按波特率限速,
+// 对端固件由PeerModel模拟, 可以配置丢包和抖动; 随机数固定种子, 同样的参数结果可复现
+class ModemSimulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ModemSimulator(const SimulatorOptions &options, QObject *parent = nullptr);
+    ~ModemSimulator();
+
+    bool open(QString *error);
+    QString slaveName() const { return slavePath; }
+
+private slots:
+    void onMasterReadable();
+    void onMasterWritable();
+
+private:
+    enum RxMode {
+        RxOff = 0,
+        RxTxAllowed = 65533,    // 连续接收, 允许直接发送
+        RxContinuous = 65534,
+        RxSingle = 65535        // 收到一包后退出接收
+    };
+
+    double now() const;
+    void processInput();
+    void handleLine(const QByteArray &line);
+    void handleSend(const QByteArray &hex);
+    void setReceive(int value);
+    void uartWrite(const QByteArray &text);
+    void writeMaster(const QByteArray &data);
+    void transmitDone(const QByteArray &payload, const LoraModulation &modulation);
+    void peerReply(const QByteArray &reply, const LoraModulation &modulation);
+    void switchPeer(int spreadingFactor);
+    void retunePeer(const Protocol::RetuneInfo &info);
+    void watchRetune();
+    void receiveFromAir(const QByteArray &payload, const LoraModulation &modulation);
+    static bool sameChannel(const LoraModulation &a, const LoraModulation &b);
+    bool isReceiving() const;
+    int airDelayMs(double airtimeMs);
+    bool chance(double probability);
+
+    SimulatorOptions options;   // modulation 是本端模块当前的配置
+    PeerModel peer;
+    LoraModulation peerModulation;
+    int peerGeneration = 0;     // 对端退回旧参数的超时判断用
+    bool peerRetuned = false;   // 扫参中, 一直收不到包就退回peerHome
+    LoraModulation peerHome;
+    QRandomGenerator random;
+    QElapsedTimer clock;
+
+    int masterFd = -1;
+    int slaveFd = -1;   // 一直开着从端, 上位机关串口时主端不会读到EIO
+    QString slavePath;
+    QSocketNotifier *readNotifier = nullptr;
+    QSocketNotifier *writeNotifier = nullptr;
+    QByteArray pendingWrite;
+
+    //串口按波特率限速: 收到的字节在串口上传完才交给AT解析, 回复也要排队发
+    struct InputChunk {
+        double readyAt;
+        QByteArray data;
+    };
+    QQueue<InputChunk> inputQueue;
+    double inputBusyUntil = 0;
+    double outputBusyUntil = 0;
+    QByteArray lineBuffer;
+
+    bool echo = false;
+    int rxMode = RxOff;
+    int rxGeneration = 0;       // 接收窗口超时判断用
+    double txBusyUntil = 0;
+
+    quint64 txPackets = 0;
+    quint64 rxPackets = 0;
+    quint64 lostUplink = 0;
+    quint64 lostDownlink = 0;
+    quint64 missedNotListening = 0;
+    quint64 missedMismatch = 0;
+};
+
+#endif // MODEMSIMULATOR_H
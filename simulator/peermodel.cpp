@@ -0,0 +1,418 @@
+#include "peermodel.h"
+#include "deltacache.h"
+#include "deltacodec.h"
+#include "sessionjournal.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <cstring>
+
+PeerModel::PeerModel(bool legacyFirmware) : legacyFirmware(legacyFirmware)
+{
+}
+
+QByteArray PeerModel::receive(const QByteArray &payload, int rssi, int snr)
+{
+    received++;
+
+    Protocol::StartInfo start;
+    Protocol::SwitchInfo change;
+    Protocol::RetuneInfo retune;
+    switch (Protocol::packetKind(payload)) {
+    case Protocol::StartKind:
+        //批量传输的下一个文件: 上一个收完了就当收到结束包
+        if (sessionComplete()) {
+            saveFile();
+            resumableId.clear();
+            endedSession = session;
+            session = Idle;
+        }
+        checked = false;
+        if (!legacyFirmware && Protocol::parseStart(payload, &start) && start.version == Protocol::VersionDelta && start.mtu > 0) {
+            if (session == WindowSession && deltaSession && fileName == start.fileName && deltaBaseHash == start.baseHash
+                    && expectedIndex == 0) {
+                return windowSack(rssi, snr);   //重发的差量开始包
+            }
+            //没有基准回ACK, 发送端改发整个文件
+            session = Idle;
+            resumableId.clear();
+            deltaSession = false;
+            if (!bases.contains(start.baseHash)) {
+                return Protocol::legacyAck(rssi, snr);
+            }
+            session = WindowSession;
+            stripeFile.close();
+            striped = false;
+            fileName = start.fileName;
+            mtu = start.mtu;
+            segmentOffset = 0;
+            chunkCount = (start.fileSize + mtu - 1) / mtu;
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+            fileData = QByteArray(static_cast<int>(start.fileSize), '\0');
+            deltaSession = true;
+            deltaBase = bases.value(start.baseHash);
+            deltaBaseHash = start.baseHash;
+            deltaTargetHash = start.targetHash;
+            return windowSack(rssi, snr);
+        }
+        deltaSession = false;
+        if (!legacyFirmware && Protocol::parseStart(payload, &start) && start.version == Protocol::VersionFec
+                && start.mtu > 0 && start.window > 0 && start.window <= FecEncoder::MaxSourceSymbols) {
+            session = FecSession;
+            resumableId.clear();
+            striped = false;
+            fileName = start.fileName;
+            mtu = start.mtu;
+            fecBlockSize = start.window;
+            chunkCount = (start.fileSize + mtu - 1) / mtu;
+            fecBlockCount = (chunkCount + fecBlockSize - 1) / fecBlockSize;
+            fecDecoded = 0;
+            fecReceived = 0;
+            fileData = QByteArray(static_cast<int>(start.fileSize), '\0');
+            startFecBlock();
+            return fecStatus(rssi, snr);
+        }
+        if (!legacyFirmware && Protocol::parseStart(payload, &start) && start.mtu > 0
+                && (start.version == Protocol::VersionResume || start.version == Protocol::VersionChecked)) {
+            //同一个会话没收完就从已连续收到的地方续, 重发的开始包结果一样; 校验开始包的会话ID全0不续传
+            bool wantResume = start.version == Protocol::VersionResume
+                    || start.sessionId != QByteArray(Protocol::SessionIdSize, '\0');
+            qint64 resumeOffset = 0;
+            if (wantResume && start.sessionId == resumableId && fileData.size() == static_cast<int>(start.fileSize)
+                    && (session == WindowSession || session == Idle)) {
+                resumeOffset = qMin<qint64>(segmentOffset + qint64(expectedIndex) * mtu, fileData.size());
+            } else {
+                fileData = QByteArray(static_cast<int>(start.fileSize), '\0');
+            }
+            session = WindowSession;
+            fileName = start.fileName;
+            resumableId = wantResume ? start.sessionId : QByteArray();
+            striped = false;
+            checked = start.version == Protocol::VersionChecked;
+            integrity.reset(start.fileCrc);
+            mtu = start.mtu;
+            segmentOffset = static_cast<int>(resumeOffset);
+            chunkCount = static_cast<quint32>((fileData.size() - segmentOffset + mtu - 1) / mtu);
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+
+            Protocol::ResumeAck ack;
+            ack.rssi = rssi;
+            ack.snr = snr;
+            ack.offset = static_cast<quint32>(resumeOffset);
+            return Protocol::resumeAckPacket(ack);
+        }
+        if (!legacyFirmware && Protocol::parseStart(payload, &start) && start.mtu > 0
+                && (start.version == Protocol::VersionWindow || start.version == Protocol::VersionStripe)) {
+            if (session == WindowSession && striped && start.version == Protocol::VersionStripe
+                    && fileName == start.fileName && segmentOffset == 0 && expectedIndex == 0) {
+                return windowSack(rssi, snr);   //重发的分条开始包
+            }
+            session = WindowSession;
+            resumableId.clear();
+            stripeFile.close();
+            striped = start.version == Protocol::VersionStripe;
+            fileName = start.fileName;
+            mtu = start.mtu;
+            segmentOffset = 0;
+            chunkCount = (start.fileSize + mtu - 1) / mtu;
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+            fileData = QByteArray(static_cast<int>(start.fileSize), '\0');
+            if (striped && !outputDir.isEmpty()) {
+                //别的模拟器(别的频点)也在写这个文件, 只写自己收到的块
+                stripeFile.setFileName(QDir(outputDir).filePath(fileName));
+                if (!stripeFile.open(QIODevice::ReadWrite) || !stripeFile.resize(start.fileSize)) {
+                    qWarning() << "cannot write" << stripeFile.fileName() << stripeFile.errorString();
+                    stripeFile.close();
+                }
+            }
+            return windowSack(rssi, snr);
+        }
+        //老固件: 开始包后面全当文件名
+        session = LegacySession;
+        resumableId.clear();
+        striped = false;
+        fileName = QString::fromUtf8(payload.constData() + 6, payload.size() - 6);
+        fileData.clear();
+        lastLegacyIndex = -1;
+        return Protocol::legacyAck(rssi, snr);
+
+    case Protocol::SwitchKind:
+        if (session == WindowSession && Protocol::parseSwitch(payload, &change) && change.mtu > 0
+                && change.offset <= static_cast<quint32>(fileData.size())) {
+            //偏移之前的都已确认, 之后的按新MTU重新编号, 重复的切换包结果一样
+            segmentOffset = static_cast<int>(change.offset);
+            mtu = change.mtu;
+            chunkCount = static_cast<quint32>((fileData.size() - segmentOffset + mtu - 1) / mtu);
+            expectedIndex = 0;
+            chunkReceived = QVector<bool>(static_cast<int>(chunkCount), false);
+            pendingSpreadingFactor = change.spreadingFactor;
+            return windowSack(rssi, snr);
+        }
+        return QByteArray();
+
+    case Protocol::RetuneKind:
+        if (!legacyFirmware && Protocol::parseRetune(payload, &retune)) {
+            //切不切由模拟器比较当前参数决定, 重发的调参包照样回ACK
+            pendingRetune = retune;
+            retunePending = true;
+            return Protocol::legacyAck(rssi, snr);
+        }
+        return QByteArray();
+
+    case Protocol::EndKind: {
+        //结束包的应答丢了会重发, 按刚结束的会话回同样的应答
+        Session ended = session != Idle ? session : endedSession;
+        bool verified = session != Idle ? checked : endedChecked;
+        Protocol::Verdict verdict;
+        verdict.rssi = rssi;
+        verdict.snr = snr;
+        if (session == WindowSession && checked) {
+            //整个文件的CRC对不上就回要补的段, 会话不结束; 续传不能越过坏的段
+            verdict.ranges = integrity.damagedRanges(reinterpret_cast<const uchar *>(fileData.constData()), fileData.size());
+            if (!verdict.ranges.isEmpty()) {
+                segmentOffset = static_cast<int>(verdict.ranges.first().offset);
+                chunkCount = 0;
+                expectedIndex = 0;
+                chunkReceived.clear();
+                return Protocol::verdictPacket(verdict);
+            }
+        }
+        if (session != Idle) {
+            saveFile();
+            resumableId.clear();
+        }
+        endedSession = ended;
+        endedChecked = verified;
+        session = Idle;
+        if (ended == WindowSession && verified) {
+            return Protocol::verdictPacket(verdict);
+        }
+        if (ended == WindowSession) {
+            return windowSack(rssi, snr);
+        }
+        if (ended == FecSession) {
+            return fecStatus(rssi, snr);
+        }
+        return Protocol::legacyAck(rssi, snr);
+    }
+
+    default:
+        break;
+    }
+
+    if (session == FecSession && payload.size() > Protocol::FecHeaderSize
+            && (static_cast<quint8>(payload.at(2)) & Protocol::FlagFec)) {
+        return receiveFecData(payload, rssi, snr);
+    }
+
+    if (session == WindowSession && payload.size() >= (checked ? Protocol::CheckedHeaderSize : Protocol::WindowHeaderSize)
+            && (static_cast<quint8>(payload.at(2)) & ~Protocol::FlagMask) == 0) {
+        return receiveWindowData(payload, rssi, snr);
+    }
+
+    if (session == LegacySession && !payload.isEmpty()) {
+        //重发的包序号不变, 不重复写
+        int index = static_cast<quint8>(payload.at(0));
+        if (index != lastLegacyIndex) {
+            fileData.append(payload.constData() + Protocol::LegacyHeaderSize, payload.size() - Protocol::LegacyHeaderSize);
+            lastLegacyIndex = index;
+        }
+    }
+
+    //丢包率测试的包和停等协议的数据包都回ACK
+    return Protocol::legacyAck(rssi, snr);
+}
+
+QByteArray PeerModel::receiveWindowData(const QByteArray &payload, int rssi, int snr)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    quint16 seq = static_cast<quint16>((p[0] << 8) | p[1]);
+    quint8 flags = p[2];
+
+    qint32 delta = static_cast<qint16>(seq - static_cast<quint16>(expectedIndex & 0xFFFF));
+    qint64 index = qint64(expectedIndex) + delta;
+    const int headerSize = checked ? Protocol::CheckedHeaderSize : Protocol::WindowHeaderSize;
+    if (index >= 0 && index < chunkCount && !chunkReceived.at(static_cast<int>(index))) {
+        qint64 offset = segmentOffset + index * mtu;
+        int size = qMin(payload.size() - headerSize, fileData.size() - static_cast<int>(offset));
+        if (checked) {
+            //CRC对不上当没收到
+            const uchar *c = p + Protocol::WindowHeaderSize;
+            quint32 crc = (quint32(c[0]) << 24) | (quint32(c[1]) << 16) | (quint32(c[2]) << 8) | quint32(c[3]);
+            if (size != payload.size() - headerSize || !integrity.addChunk(offset, p + headerSize, size, crc)) {
+                return (flags & Protocol::FlagAckRequest) ? windowSack(rssi, snr) : QByteArray();
+            }
+        }
+        if (size > 0) {
+            memcpy(fileData.data() + offset, payload.constData() + headerSize, size);
+            if (stripeFile.isOpen()) {
+                stripeFile.seek(offset);
+                stripeFile.write(payload.constData() + headerSize, size);
+            }
+        }
+        chunkReceived[static_cast<int>(index)] = true;
+        while (expectedIndex < chunkCount && chunkReceived.at(static_cast<int>(expectedIndex))) {
+            expectedIndex++;
+        }
+    }
+
+    if (flags & Protocol::FlagAckRequest) {
+        return windowSack(rssi, snr);
+    }
+    return QByteArray();
+}
+
+bool PeerModel::takeSpreadingFactorChange(int *spreadingFactor)
+{
+    if (pendingSpreadingFactor == 0) {
+        return false;
+    }
+    *spreadingFactor = pendingSpreadingFactor;
+    pendingSpreadingFactor = 0;
+    return true;
+}
+
+bool PeerModel::takeRetune(Protocol::RetuneInfo *info)
+{
+    if (!retunePending) {
+        return false;
+    }
+    *info = pendingRetune;
+    retunePending = false;
+    return true;
+}
+
+QByteArray PeerModel::windowSack(int rssi, int snr) const
+{
+    Protocol::Sack sack;
+    sack.rssi = rssi;
+    sack.snr = snr;
+    sack.expectedSeq = static_cast<quint16>(expectedIndex & 0xFFFF);
+    for (int i = 0; i < 31; i++) {
+        quint32 index = expectedIndex + 1 + i;
+        if (index >= chunkCount) {
+            break;
+        }
+        if (chunkReceived.at(static_cast<int>(index))) {
+            sack.bitmap |= (1u << i);
+        }
+    }
+    return Protocol::sackPacket(sack);
+}
+
+QByteArray PeerModel::receiveFecData(const QByteArray &payload, int rssi, int snr)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    quint16 block = static_cast<quint16>((p[0] << 8) | p[1]);
+    quint8 flags = p[2];
+    int symbol = p[3];
+    fecReceived++;
+
+    int size = payload.size() - Protocol::FecHeaderSize;
+    if (block == static_cast<quint16>(fecDecoded & 0xFFFF) && fecDecoded < fecBlockCount && size == mtu) {
+        decoder.addSymbol(symbol, p + Protocol::FecHeaderSize);
+        if (decoder.isDecoded()) {
+            //源符号写回文件, 末块补的0按文件大小截掉
+            qint64 blockOffset = qint64(fecDecoded) * fecBlockSize * mtu;
+            for (int i = 0; i < decoder.sourceCount(); i++) {
+                qint64 offset = blockOffset + qint64(i) * mtu;
+                int copy = static_cast<int>(qMin<qint64>(mtu, fileData.size() - offset));
+                if (copy > 0) {
+                    memcpy(fileData.data() + offset, decoder.sourceSymbol(i), copy);
+                }
+            }
+            fecDecoded++;
+            startFecBlock();
+        }
+    }
+
+    if (flags & Protocol::FlagAckRequest) {
+        return fecStatus(rssi, snr);
+    }
+    return QByteArray();
+}
+
+QByteArray PeerModel::fecStatus(int rssi, int snr) const
+{
+    Protocol::FecStatus status;
+    status.rssi = rssi;
+    status.snr = snr;
+    status.decodedBlocks = static_cast<quint16>(fecDecoded & 0xFFFF);
+    status.rank = static_cast<quint8>(fecDecoded < fecBlockCount ? decoder.rank() : 0);
+    status.received = fecReceived;
+    return Protocol::fecStatusPacket(status);
+}
+
+void PeerModel::startFecBlock()
+{
+    if (fecDecoded < fecBlockCount) {
+        int symbols = static_cast<int>(qMin<quint32>(fecBlockSize, chunkCount - fecDecoded * fecBlockSize));
+        decoder.reset(symbols, mtu);
+    }
+}
+
+bool PeerModel::sessionComplete() const
+{
+    if (session == WindowSession) {
+        return !striped && !checked && expectedIndex >= chunkCount;
+    }
+    if (session == FecSession) {
+        return fecDecoded >= fecBlockCount;
+    }
+    return false;
+}
+
+void PeerModel::saveFile()
+{
+    completed++;
+    qInfo() << "peer received" << fileName << fileData.size() << "bytes";
+
+    if (striped) {
+        stripeFile.close();
+        return;
+    }
+    if (deltaSession) {
+        deltaSession = false;
+        QByteArray target;
+        if (!DeltaCodec::apply(deltaBase, fileData, &target) || SessionJournal::sessionId(target) != deltaTargetHash) {
+            qWarning() << "peer cannot rebuild" << fileName << "from its delta";
+            return;
+        }
+        fileData = target;
+    }
+    keepBase();
+    if (outputDir.isEmpty() || fileName.isEmpty()) {
+        return;
+    }
+    QFile file(QDir(outputDir).filePath(fileName));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "cannot write" << file.fileName() << file.errorString();
+        return;
+    }
+    file.write(fileData);
+}
+
+void PeerModel::keepBase()
+{
+    if (fileName.isEmpty() || fileData.size() > DeltaCache::MaxFileSize) {
+        return;
+    }
+    QByteArray hash = SessionJournal::sessionId(fileData);
+    QList<QByteArray> &versions = baseVersions[fileName];
+    versions.removeAll(hash);
+    versions.prepend(hash);
+    bases.insert(hash, fileData);
+    while (versions.size() > DeltaCache::KeepVersions) {
+        QByteArray old = versions.takeLast();
+        bool used = false;
+        for (const QList<QByteArray> &other : baseVersions) {
+            used = used || other.contains(old);
+        }
+        if (!used) {
+            bases.remove(old);
+        }
+    }
+}
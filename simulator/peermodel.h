@@ -0,0 +1,97 @@
+#ifndef PEERMODEL_H
+#define PEERMODEL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include "fec.h"
+#include "integritycheck.h"
+#include "transferprotocol.h"
+
+// 模拟对端固件: 收图传帧, 回ACK/SACK, 收完写文件
+class PeerModel
+{
+public:
+    explicit PeerModel(bool legacyFirmware = false);
+
+    void setOutputDir(const QString &dir) { outputDir = dir; }
+
+    // 对端收到一包, rssi/snr 是它测到的信号质量, 返回要回的负载(空表示不回)
+    QByteArray receive(const QByteArray &payload, int rssi, int snr);
+
+    // 收到切换包后要改的SF, 由模拟器在回包发完后切过去; 没有返回false
+    bool takeSpreadingFactorChange(int *spreadingFactor);
+
+    // 收到扫参的调参包后要切的参数, 同上
+    bool takeRetune(Protocol::RetuneInfo *info);
+
+    quint64 packetsReceived() const { return received; }
+    quint64 filesCompleted() const { return completed; }
+
+private:
+    enum Session {
+        Idle,
+        LegacySession,
+        WindowSession,
+        FecSession
+    };
+
+    QByteArray receiveWindowData(const QByteArray &payload, int rssi, int snr);
+    QByteArray windowSack(int rssi, int snr) const;
+    QByteArray receiveFecData(const QByteArray &payload, int rssi, int snr);
+    QByteArray fecStatus(int rssi, int snr) const;
+    void startFecBlock();
+    bool sessionComplete() const;
+    void saveFile();
+    void keepBase();
+
+    bool legacyFirmware;
+    QString outputDir;
+    Session session = Idle;
+    Session endedSession = Idle;
+    bool endedChecked = false;
+
+    QString fileName;
+    QByteArray fileData;
+    int lastLegacyIndex = -1;
+
+    //窗口协议
+    int mtu = 0;
+    int segmentOffset = 0;          // 块号0对应的文件偏移, 切换参数后从这里重新编号
+    quint32 chunkCount = 0;
+    quint32 expectedIndex = 0;      // 下一个期望的块
+    QVector<bool> chunkReceived;
+    int pendingSpreadingFactor = 0;
+    bool retunePending = false;
+    Protocol::RetuneInfo pendingRetune;
+    QByteArray resumableId;         // 没收完的续传会话, 模拟器进程一直在, 放内存里就行
+    bool striped = false;           // 分条传输只收到文件的一部分, 收到的块直接写进输出文件
+    QFile stripeFile;
+
+    //校验模式: 每块带CRC, 结束包时整个文件校验
+    bool checked = false;
+    IntegrityCheck integrity;
+
+    //差量传输: 送达过的文件按内容哈希放内存, 每个文件名只留最近几个版本
+    QHash<QByteArray, QByteArray> bases;
+    QHash<QString, QList<QByteArray>> baseVersions;
+    bool deltaSession = false;      // fileData收的是差量, 收完用基准重建
+    QByteArray deltaBase;
+    QByteArray deltaBaseHash;
+    QByteArray deltaTargetHash;
+
+    //纠删码协议
+    int fecBlockSize = 0;
+    quint32 fecBlockCount = 0;
+    quint32 fecDecoded = 0;
+    quint8 fecReceived = 0;
+    FecDecoder decoder;
+
+    quint64 received = 0;
+    quint64 completed = 0;
+};
+
+#endif // PEERMODEL_H
@@ -0,0 +1,19 @@
+# 伪终端模块模拟器: 不接硬件也能跑图传和丢包率测试
+# 用法: ./modem-simulator --sf 7 --loss 0.05 --link /tmp/ttyLORA, 界面里串口填 /tmp/ttyLORA
+
+QT = core
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+TARGET = modem-simulator
+
+include(../core/core.pri)
+
+SOURCES += \
+    main.cpp \
+    modemsimulator.cpp \
+    peermodel.cpp
+
+HEADERS += \
+    modemsimulator.h \
+    peermodel.h
@@ -0,0 +1,13 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// 进程内malloc次数计数, 看热点路径每次操作分配了几次
+// glibc下替换malloc/calloc/realloc转到__libc_*, 其它平台不支持, available()返回false
+namespace AllocationCounter {
+bool available();
+quint64 count();
+}
+
+#endif // ALLOCATIONCOUNTER_H
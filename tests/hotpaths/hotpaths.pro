@@ -0,0 +1,20 @@
+# 热点路径基准: QBENCHMARK 看耗时, regression 按 baseline.json 检查每次操作的分配次数和耗时
+# 更新基线(发布前在目标机器上跑): HOTPATH_UPDATE_BASELINE=1 ./tst_hotpaths regression
+# 耗时允许的倍数: HOTPATH_TOLERANCE, 默认3
+
+QT = core testlib
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+
+TARGET = tst_hotpaths
+
+include(../../core/core.pri)
+
+DEFINES += HOTPATH_BASELINE=\\\"$$PWD/baseline.json\\\"
+
+SOURCES += \
+    allocationcounter.cpp \
+    tst_hotpaths.cpp
+
+HEADERS += \
+    allocationcounter.h
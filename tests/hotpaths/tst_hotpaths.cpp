@@ -0,0 +1,465 @@
+#include <QtTest>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <cstring>
+#include <functional>
+#include "allocationcounter.h"
+#include "atframer.h"
+#include "atparser.h"
+#include "crc32c.h"
+#include "hexcodec.h"
+#include "latencyhistogram.h"
+#include "linkengine.h"
+#include "packettracer.h"
+#include "rtoestimator.h"
+#include "transferprotocol.h"
+
+namespace {
+
+// 只数事件, 不做别的, 测的是解析本身
+class CountingHandler : public AtEventHandler
+{
+public:
+    void onAtEvent(const AtEvent &event) override
+    {
+        events++;
+        payloadBytes += event.payloadSize;
+    }
+
+    quint64 events = 0;
+    quint64 payloadBytes = 0;
+};
+
+// 假串口: 写进来的直接丢掉, inject的数据同步发readyRead给引擎读
+class SinkDevice : public QIODevice
+{
+public:
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return input.size() - position + QIODevice::bytesAvailable(); }
+
+    void inject(const QByteArray &data)
+    {
+        input = data;
+        position = 0;
+        emit readyRead();
+    }
+
+    qint64 written = 0;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        qint64 size = qMin<qint64>(maxSize, input.size() - position);
+        memcpy(data, input.constData() + position, size_t(size));
+        position += size;
+        return size;
+    }
+
+    qint64 writeData(const char *data, qint64 maxSize) override
+    {
+        Q_UNUSED(data);
+        written += maxSize;
+        emit bytesWritten(maxSize);     // 当作立刻发完, 包追踪的串口段接近0
+        return maxSize;
+    }
+
+private:
+    QByteArray input;
+    qint64 position = 0;
+};
+
+QByteArray rxLine(int rssi, int snr, const QByteArray &payload)
+{
+    return "+EVT:RXP2P:" + QByteArray::number(rssi) + ":" + QByteArray::number(snr) + ":"
+            + payload.toHex().toUpper() + "\r\n";
+}
+
+// 窗口协议发送端收到的: 每包OK和TX DONE, 一轮8包回一个SACK
+QByteArray senderStream(int frames)
+{
+    QByteArray stream;
+    Protocol::Sack sack;
+    sack.rssi = -71;
+    sack.snr = 6;
+    for (int i = 0; i < frames; i++) {
+        stream += "OK\r\n+EVT:TXP2P DONE\r\n";
+        if (i % 8 == 7) {
+            sack.expectedSeq = quint16(i + 1);
+            sack.bitmap = 0x0000000Au;
+            stream += rxLine(sack.rssi, sack.snr, Protocol::sackPacket(sack));
+        }
+    }
+    return stream;
+}
+
+// 老协议发送端: 每包一个带rssi/snr的ACK
+QByteArray ackStream(int frames)
+{
+    QByteArray stream;
+    for (int i = 0; i < frames; i++) {
+        stream += "OK\r\n+EVT:TXP2P DONE\r\n" + rxLine(-60, 9, Protocol::legacyAck(-60, 9));
+    }
+    return stream;
+}
+
+// 接收端收到的: 200字节数据包
+QByteArray receiverStream(int frames)
+{
+    QByteArray stream;
+    QByteArray payload(Protocol::WindowHeaderSize + 200, '\0');
+    for (int i = 0; i < payload.size(); i++) {
+        payload[i] = char(i * 37);
+    }
+    for (int i = 0; i < frames; i++) {
+        Protocol::writeWindowDataHeader(reinterpret_cast<uchar *>(payload.data()), quint16(i), 0);
+        stream += rxLine(-80, 5, payload);
+    }
+    return stream;
+}
+
+void feedChunks(AtParser &parser, const QByteArray &stream, int chunkSize)
+{
+    for (int offset = 0; offset < stream.size(); offset += chunkSize) {
+        parser.feed(stream.constData() + offset, qMin(chunkSize, stream.size() - offset));
+    }
+}
+
+}
+
+// 热点路径: 串口响应解析, PSEND组帧和16进制编码, 每包的统计更新, 引擎一包的收发
+// benchmark类的看耗时; regression按基线检查分配次数和耗时, 慢了或者多分配了就失败
+class TestHotPaths : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void parseSenderStream_data();
+    void parseSenderStream();
+    void parseAckStream();
+    void parseReceiverStream();
+    void framePsend_data();
+    void framePsend();
+    void hexEncode_data();
+    void hexEncode();
+    void crc32c_data();
+    void crc32c();
+    void tracerPacket();
+    void rtoSample();
+    void enginePacket();
+
+    void regression_data();
+    void regression();
+
+private:
+    void enginePacketOnce();
+
+    struct HotPath {
+        QString name;
+        std::function<void()> run;
+        int iterations;
+    };
+
+    QVector<HotPath> hotPaths;
+    QJsonObject baseline;
+    QJsonObject measured;
+    bool updateBaseline = false;
+
+    //regression里用的对象, 和benchmark的分开, 保证每次测的状态一样
+    CountingHandler handler;
+    AtParser parser;
+    AtFramer framer;
+    QByteArray senderBytes;
+    QByteArray receiverBytes;
+    QByteArray frameData;
+    PacketTracer tracer;
+    RtoEstimator rto;
+    SinkDevice sink;
+    LinkEngine *engine = nullptr;
+    QByteArray replyBytes;
+};
+
+void TestHotPaths::initTestCase()
+{
+    LinkEngine::registerMetaTypes();
+    qInfo() << "hex encoder:" << Hex::implementation();
+
+    updateBaseline = qEnvironmentVariableIsSet("HOTPATH_UPDATE_BASELINE");
+    QFile file(HOTPATH_BASELINE);
+    if (file.open(QIODevice::ReadOnly)) {
+        baseline = QJsonDocument::fromJson(file.readAll()).object();
+    }
+
+    parser.setHandler(&handler);
+    senderBytes = senderStream(64);
+    receiverBytes = receiverStream(16);
+    frameData = QByteArray(AtFramer::MaxPayloadSize, '\x5A');
+
+    sink.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    engine = new LinkEngine(this);
+    engine->openDevice(&sink, "sink", 115200);
+    sink.inject("OK\r\n");      // AT+NWM=0
+
+    Protocol::Sack sack;
+    replyBytes = "OK\r\n+EVT:TXP2P DONE\r\n" + rxLine(-70, 7, Protocol::sackPacket(sack));
+
+    hotPaths = {
+        { "parser.senderStream", [this]() { feedChunks(parser, senderBytes, 64); }, 200 },
+        { "parser.receiverStream", [this]() { feedChunks(parser, receiverBytes, 64); }, 200 },
+        { "framer.psendMax", [this]() {
+              TxFrame frame;
+              frame.headerSize = Protocol::writeWindowDataHeader(frame.header, 1, 0);
+              frame.data = frameData.constData();
+              frame.size = AtFramer::MaxPayloadSize - frame.headerSize;
+              int length;
+              framer.build(frame, &length);
+          }, 20000 },
+        { "tracer.packet", [this]() {
+              tracer.onWrite();
+              tracer.onDrained();
+              tracer.onTxDone();
+              tracer.onReply();
+          }, 20000 },
+        { "rto.sample", [this]() { rto.addSample(42.5); rto.replyTimeout(Protocol::SackSize); }, 20000 },
+        { "engine.packet", [this]() { enginePacketOnce(); }, 2000 },
+    };
+}
+
+void TestHotPaths::cleanupTestCase()
+{
+    if (!updateBaseline || measured.isEmpty()) {
+        return;
+    }
+    for (const QString &name : measured.keys()) {
+        baseline[name] = measured.value(name);
+    }
+    QFile file(HOTPATH_BASELINE);
+    QVERIFY2(file.open(QIODevice::WriteOnly), qPrintable(file.errorString()));
+    file.write(QJsonDocument(baseline).toJson());
+    qInfo() << "baseline written to" << file.fileName();
+}
+
+void TestHotPaths::parseSenderStream_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::newRow("16B reads") << 16;
+    QTest::newRow("64B reads") << 64;
+    QTest::newRow("1KB reads") << 1024;
+}
+
+void TestHotPaths::parseSenderStream()
+{
+    QFETCH(int, chunkSize);
+    QByteArray stream = senderStream(256);
+    CountingHandler counter;
+    AtParser benchParser(&counter);
+    QBENCHMARK {
+        feedChunks(benchParser, stream, chunkSize);
+    }
+    QVERIFY(counter.events > 0);
+    QCOMPARE(benchParser.droppedLines(), quint64(0));
+}
+
+void TestHotPaths::parseAckStream()
+{
+    QByteArray stream = ackStream(256);
+    CountingHandler counter;
+    AtParser benchParser(&counter);
+    QBENCHMARK {
+        feedChunks(benchParser, stream, 64);
+    }
+    QVERIFY(counter.events > 0);
+}
+
+void TestHotPaths::parseReceiverStream()
+{
+    QByteArray stream = receiverStream(64);
+    CountingHandler counter;
+    AtParser benchParser(&counter);
+    QBENCHMARK {
+        feedChunks(benchParser, stream, 64);
+    }
+    QVERIFY(counter.payloadBytes > 0);
+}
+
+void TestHotPaths::framePsend_data()
+{
+    QTest::addColumn<int>("payloadSize");
+    QTest::newRow("64B") << 64;
+    QTest::newRow("255B") << AtFramer::MaxPayloadSize;
+}
+
+void TestHotPaths::framePsend()
+{
+    QFETCH(int, payloadSize);
+    AtFramer benchFramer;
+    TxFrame frame;
+    frame.headerSize = Protocol::writeWindowDataHeader(frame.header, 7, Protocol::FlagAckRequest);
+    frame.data = frameData.constData();
+    frame.size = payloadSize - frame.headerSize;
+    int length = 0;
+    QBENCHMARK {
+        benchFramer.build(frame, &length);
+    }
+    QCOMPARE(length, 9 + 2 * payloadSize + 2);
+}
+
+void TestHotPaths::hexEncode_data()
+{
+    QTest::addColumn<bool>("scalar");
+    QTest::newRow(Hex::implementation()) << false;
+    QTest::newRow("scalar") << true;
+}
+
+void TestHotPaths::hexEncode()
+{
+    QFETCH(bool, scalar);
+    QByteArray out(2 * frameData.size(), '\0');
+    const uchar *src = reinterpret_cast<const uchar *>(frameData.constData());
+    QBENCHMARK {
+        if (scalar) {
+            Hex::encodeUpperScalar(src, frameData.size(), out.data());
+        } else {
+            Hex::encodeUpper(src, frameData.size(), out.data());
+        }
+    }
+    QCOMPARE(out.left(4), QByteArray("5A5A"));
+}
+
+void TestHotPaths::crc32c_data()
+{
+    QTest::addColumn<bool>("scalar");
+    QTest::newRow(Crc32c::implementation()) << false;
+    QTest::newRow("scalar") << true;
+}
+
+void TestHotPaths::crc32c()
+{
+    QFETCH(bool, scalar);
+    QCOMPARE(Crc32c::compute(reinterpret_cast<const uchar *>("123456789"), 9), 0xE3069283u);
+
+    const uchar *src = reinterpret_cast<const uchar *>(frameData.constData());
+    quint32 crc = 0;
+    QBENCHMARK {
+        crc = scalar ? Crc32c::extendScalar(0, src, frameData.size()) : Crc32c::extend(0, src, frameData.size());
+    }
+    QCOMPARE(crc, Crc32c::extendScalar(0, src, frameData.size()));
+}
+
+void TestHotPaths::tracerPacket()
+{
+    PacketTracer benchTracer;
+    QBENCHMARK {
+        benchTracer.onWrite();
+        benchTracer.onDrained();
+        benchTracer.onTxDone();
+        benchTracer.onReply();
+    }
+    QVERIFY(benchTracer.histogram(PacketTracer::Total).count() > 0);
+}
+
+void TestHotPaths::rtoSample()
+{
+    RtoEstimator estimator;
+    int timeout = 0;
+    QBENCHMARK {
+        estimator.addSample(42.5);
+        timeout = estimator.replyTimeout(Protocol::SackSize);
+    }
+    QVERIFY(timeout > 0);
+}
+
+void TestHotPaths::enginePacket()
+{
+    //sendFrame到回完SACK: 组帧, 命令队列, 写串口, 读串口, 解析, 事件分发
+    qint64 before = sink.written;
+    QBENCHMARK {
+        enginePacketOnce();
+    }
+    QVERIFY(sink.written > before);
+    QCOMPARE(engine->isOpen(), true);
+    QCOMPARE(engine->tracer()->histogram(PacketTracer::Air).count() > 0, true);
+}
+
+void TestHotPaths::enginePacketOnce()
+{
+    TxFrame frame;
+    frame.headerSize = Protocol::writeWindowDataHeader(frame.header, 1, 0);
+    frame.data = frameData.constData();
+    frame.size = 200;
+    engine->sendFrame(frame);
+    sink.inject(replyBytes);
+}
+
+void TestHotPaths::regression_data()
+{
+    QTest::addColumn<int>("index");
+    for (int i = 0; i < hotPaths.size(); i++) {
+        QTest::newRow(qPrintable(hotPaths.at(i).name)) << i;
+    }
+}
+
+void TestHotPaths::regression()
+{
+    QFETCH(int, index);
+    const HotPath &path = hotPaths.at(index);
+
+    //先跑一轮把缓冲区之类的一次性分配跑掉
+    for (int i = 0; i < path.iterations / 10 + 1; i++) {
+        path.run();
+    }
+
+    quint64 allocationsBefore = AllocationCounter::count();
+    for (int i = 0; i < path.iterations; i++) {
+        path.run();
+    }
+    double allocsPerOp = double(AllocationCounter::count() - allocationsBefore) / path.iterations;
+
+    //取几轮里最快的, 少受调度影响
+    double nsPerOp = 0;
+    for (int round = 0; round < 5; round++) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < path.iterations; i++) {
+            path.run();
+        }
+        double ns = double(timer.nsecsElapsed()) / path.iterations;
+        nsPerOp = round == 0 ? ns : qMin(nsPerOp, ns);
+    }
+
+    QJsonObject result;
+    result["allocsPerOp"] = allocsPerOp;
+    result["nsPerOp"] = nsPerOp;
+    measured[path.name] = result;
+    qInfo() << path.name << allocsPerOp << "allocs/op" << qRound64(nsPerOp) << "ns/op";
+
+    if (updateBaseline) {
+        return;
+    }
+    if (!baseline.contains(path.name)) {
+        QSKIP("no baseline yet, run with HOTPATH_UPDATE_BASELINE=1");
+    }
+
+    QJsonObject expected = baseline.value(path.name).toObject();
+    if (AllocationCounter::available() && expected.contains("allocsPerOp")) {
+        double allowed = expected.value("allocsPerOp").toDouble();
+        QVERIFY2(allocsPerOp <= allowed + 0.01,
+                 qPrintable(QString("%1 allocations per op, baseline %2").arg(allocsPerOp).arg(allowed)));
+    }
+
+    //耗时跟机器有关, 基线要在同一台机器上记
+    double tolerance = qEnvironmentVariableIsSet("HOTPATH_TOLERANCE")
+            ? qgetenv("HOTPATH_TOLERANCE").toDouble() : 3.0;
+    double expectedNs = expected.value("nsPerOp").toDouble();
+    if (expectedNs > 0) {
+        QVERIFY2(nsPerOp <= expectedNs * tolerance,
+                 qPrintable(QString("%1 ns per op, baseline %2 ns").arg(nsPerOp, 0, 'f', 0).arg(expectedNs, 0, 'f', 0)));
+    }
+}
+
+QTEST_GUILESS_MAIN(TestHotPaths)
+
+#include "tst_hotpaths.moc"
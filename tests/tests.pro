@@ -0,0 +1,8 @@
+# 测试: make check 跑全部
+# hotpaths: 热点路径基准(QBENCHMARK)和分配次数/耗时回归, 基线在 hotpaths/baseline.json
+# transfer: 进程内假模块(可丢包, 乱序)上的端到端图传
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    hotpaths \
+    transfer
@@ -0,0 +1,175 @@
+#include "fakemodem.h"
+#include "transferprotocol.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+#include <cstring>
+
+FakeModem::FakeModem(const FakeModemOptions &options, QObject *parent) : QIODevice(parent), options(options),
+    random(options.seed)
+{
+}
+
+void FakeModem::connectPeer(FakeModem *peer)
+{
+    this->peer = peer;
+    peer->peer = this;
+    peer->answering = true;
+}
+
+qint64 FakeModem::readData(char *data, qint64 maxSize)
+{
+    int size = static_cast<int>(qMin<qint64>(maxSize, output.size()));
+    memcpy(data, output.constData(), size_t(size));
+    output.remove(0, size);
+    return size;
+}
+
+qint64 FakeModem::writeData(const char *data, qint64 maxSize)
+{
+    lineBuffer.append(data, static_cast<int>(maxSize));
+    int end;
+    while ((end = lineBuffer.indexOf('\n')) >= 0) {
+        QByteArray line = lineBuffer.left(end).trimmed();
+        lineBuffer.remove(0, end + 1);
+        handleLine(line);
+    }
+    QTimer::singleShot(0, this, [this, maxSize]() { emit bytesWritten(maxSize); });
+    return maxSize;
+}
+
+void FakeModem::handleLine(const QByteArray &line)
+{
+    if (line.isEmpty()) {
+        return;
+    }
+    int separator = line.indexOf('=');
+    QByteArray command = separator >= 0 ? line.left(separator).toUpper() : line.toUpper();
+    QByteArray value = separator >= 0 ? line.mid(separator + 1) : QByteArray();
+
+    if (command == "AT+PSEND") {
+        handleSend(value);
+    } else if (txBusy) {
+        reply("AT_BUSY_ERROR\r\n");
+    } else if (command == "AT+PRECV") {
+        rxMode = value.toInt();
+        reply("OK\r\n");
+    } else if (command.startsWith("AT")) {
+        reply("OK\r\n");    // 射频参数不用管, 两边一直是通的
+    } else {
+        reply("AT_ERROR\r\n");
+    }
+}
+
+void FakeModem::handleSend(const QByteArray &hex)
+{
+    QByteArray payload = QByteArray::fromHex(hex);
+    if (txBusy) {
+        reply("AT_BUSY_ERROR\r\n");
+        return;
+    }
+    if (payload.isEmpty() || payload.size() > 255 || (hex.size() % 2) != 0) {     // 和模块一样单包最多255字节
+        reply("AT_PARAM_ERROR\r\n");
+        return;
+    }
+
+    reply("OK\r\n");
+    txBusy = true;
+    sent++;
+    QTimer::singleShot(0, this, [this, payload]() { transmitDone(payload); });
+}
+
+void FakeModem::transmitDone(const QByteArray &payload)
+{
+    txBusy = false;
+    reply("+EVT:TXP2P DONE\r\n");
+    if (!peer) {
+        return;
+    }
+    if (answering) {
+        if (!peer->chance(peer->options.downlinkLoss)) {
+            peer->receiveFrame(payload);
+        }
+        return;
+    }
+
+    if (chance(options.uplinkLoss)) {
+        lost++;
+        return;
+    }
+
+    //只弄坏数据包, 而且只翻头后面的字节: 序号和标志本来就没有校验
+    QByteArray frame = payload;
+    bool data = Protocol::packetKind(payload) == Protocol::UnknownPacket;
+    if (data && frame.size() > Protocol::WindowHeaderSize && chance(options.corruption)) {
+        int at = Protocol::WindowHeaderSize + static_cast<int>(random.bounded(frame.size() - Protocol::WindowHeaderSize));
+        frame[at] = static_cast<char>(frame.at(at) ^ 0x5A);
+        corrupted++;
+    }
+
+    //只打乱数据包, 开始/结束/切换包照常到
+    if (options.reorderEvery > 0 && data) {
+        dataFrames++;
+        if (held.isEmpty() && dataFrames % options.reorderEvery == 0) {
+            held = frame;
+            reordered++;
+            return;
+        }
+    }
+    deliver(frame);
+}
+
+void FakeModem::deliver(const QByteArray &payload)
+{
+    Protocol::PacketKind kind = Protocol::packetKind(payload);
+    Protocol::StartInfo start;
+    if (kind == Protocol::StartKind && Protocol::parseStart(payload, &start)) {
+        startedFile = start.fileName;
+    }
+    if (options.damageAt >= 0 && kind == Protocol::EndKind) {
+        damageStored();
+        options.damageAt = -1;
+    }
+    peer->receiveFrame(payload);
+    if (!held.isEmpty()) {
+        //扣下的包排在后面到
+        QByteArray late = held;
+        held.clear();
+        peer->receiveFrame(late);
+    }
+}
+
+void FakeModem::receiveFrame(const QByteArray &payload)
+{
+    if (rxMode == 0) {
+        return;
+    }
+    reply("+EVT:RXP2P:-60:8:" + payload.toHex().toUpper() + "\r\n");
+}
+
+void FakeModem::damageStored()
+{
+    //对端把收到的块直接写在映射的输出文件里, 从文件改它看得到
+    QFile file(QDir(options.outputDir).filePath(QFileInfo(startedFile).fileName()));
+    char byte;
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(options.damageAt) || !file.getChar(&byte)
+            || !file.seek(options.damageAt)) {
+        return;
+    }
+    file.putChar(static_cast<char>(byte ^ 0xFF));
+}
+
+void FakeModem::reply(const QByteArray &text)
+{
+    //和串口一样晚一点才读得到, 不在引擎写命令的调用里回调它
+    QTimer::singleShot(0, this, [this, text]() {
+        output.append(text);
+        emit readyRead();
+    });
+}
+
+bool FakeModem::chance(double probability)
+{
+    return probability > 0 && random.generateDouble() < probability;
+}
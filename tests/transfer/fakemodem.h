@@ -0,0 +1,71 @@
+#ifndef FAKEMODEM_H
+#define FAKEMODEM_H
+
+#include <QIODevice>
+#include <QRandomGenerator>
+
+struct FakeModemOptions {
+    double uplinkLoss = 0.0;    // 发往对端的包丢失概率
+    double downlinkLoss = 0.0;  // 对端回包丢失概率
+    int reorderEvery = 0;       // >0: 每隔这么多个数据包扣下一个, 等下一包到了再交给对端
+    double corruption = 0.0;    // 数据包到对端时翻掉一个字节的概率(空口CRC漏检)
+    int damageAt = -1;          // >=0: 第一个结束包到对端前把对端存的文件这个字节翻掉(存储出错)
+    quint32 seed = 1;
+    QString outputDir;          // 对端的输出目录, 弄坏存储时按开始包里的文件名找文件
+};
+
+// 进程内的假模块, 直接给LinkEngine::openDevice用
+// 只实现图传用到的几条AT命令; 不按波特率和空口时间限速, 回复都在下一轮事件循环里到
+// 两个假模块connectPeer后空口就通了, 对端接另一个LinkEngine跑FileReceiver, 和两台电脑对测一样;
+// 丢包/乱序/弄坏按发送端这个的选项, 随机数也只用它的, 固定种子, 同样的参数每次丢的是同样的包
+class FakeModem : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit FakeModem(const FakeModemOptions &options = FakeModemOptions(), QObject *parent = nullptr);
+
+    // this是发送端, peer是对端
+    void connectPeer(FakeModem *peer);
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return output.size() + QIODevice::bytesAvailable(); }
+
+    bool isReceiving() const { return rxMode != 0; }
+    int framesSent() const { return sent; }
+    int framesLost() const { return lost; }
+    int framesReordered() const { return reordered; }
+    int framesCorrupted() const { return corrupted; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void handleLine(const QByteArray &line);
+    void handleSend(const QByteArray &hex);
+    void transmitDone(const QByteArray &payload);
+    void deliver(const QByteArray &payload);
+    void receiveFrame(const QByteArray &payload);
+    void damageStored();
+    void reply(const QByteArray &text);
+    bool chance(double probability);
+
+    FakeModemOptions options;
+    FakeModem *peer = nullptr;
+    bool answering = false;     // 对端这头: 发的是回包, 按发送端的downlinkLoss丢
+    QRandomGenerator random;
+    QByteArray lineBuffer;
+    QByteArray output;
+    int rxMode = 0;
+    bool txBusy = false;
+    QByteArray held;            // 乱序: 扣下的数据包
+    QString startedFile;        // 最近一个开始包里的文件名
+    int dataFrames = 0;
+    int sent = 0;
+    int lost = 0;
+    int reordered = 0;
+    int corrupted = 0;
+};
+
+#endif // FAKEMODEM_H
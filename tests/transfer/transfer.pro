@@ -0,0 +1,16 @@
+# 端到端图传测试: 两个进程内假模块(QIODevice)之间可以丢包和乱序, 两端都是LinkEngine, 对端跑FileReceiver
+
+QT = core testlib
+CONFIG += testcase console c++11
+CONFIG -= app_bundle
+
+TARGET = tst_transfer
+
+include(../../core/core.pri)
+
+SOURCES += \
+    fakemodem.cpp \
+    tst_transfer.cpp
+
+HEADERS += \
+    fakemodem.h
@@ -0,0 +1,504 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <functional>
+#include "fakemodem.h"
+#include "jpegscans.h"
+#include "linkengine.h"
+#include "serialreplay.h"
+#include "transferprotocol.h"
+
+// runTransfer的可选项, 不给就是用假模块发一个文件, 对端存成image.bin
+struct RunOptions {
+    QString outputName = "image.bin";   // 对端存的文件名, 读回到Run::received
+    QIODevice *device = nullptr;        // 代替假模块, 比如回放抓包
+    const StreamOptions *stream = nullptr;  // 不为空时跑连续图传, 等streamFinished
+    std::function<void(LinkEngine &)> beforeOpen;                  // 打开串口前, 比如开始抓包
+    std::function<void(LinkEngine &, FakeModem &, LinkEngine &)> beforeStart;    // 两端配好后开始传输前, 比如先传一版
+    std::function<bool(const TransferStats &)> stopWhen;           // 进度满足条件就停下不等传完, 算成功
+};
+
+// 端到端图传: LinkEngine(发送端) -> 假模块 -> 假模块 -> LinkEngine(对端, FileReceiver), 丢包和乱序可配, 结果按字节比对
+class TestTransfer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void transfer_data();
+    void transfer();
+    void deterministic();
+    void delta();
+    void stream();
+    void layers();
+    void checked();
+    void oversized();
+    void fecBlockLimit();
+    void replay();
+
+private:
+    struct Run {
+        bool ok = false;
+        QString message;
+        QByteArray received;
+        int framesSent = 0;
+        int framesLost = 0;
+        int framesCorrupted = 0;
+        TransferStats stats;
+        StreamStats streamStats;
+    };
+
+    Run runTransfer(const FakeModemOptions &modemOptions, const TransferOptions &transfer,
+                    const RunOptions &runOptions = RunOptions());
+    static bool sendOnce(LinkEngine &engine, LinkEngine &peer, const TransferOptions &transfer);
+
+    QTemporaryDir dir;
+    QString inputPath;
+    QByteArray input;
+};
+
+void TestTransfer::initTestCase()
+{
+    LinkEngine::registerMetaTypes();
+    QVERIFY(dir.isValid());
+
+    //固定种子的随机内容, 30个200字节的块
+    QRandomGenerator random(7);
+    input.resize(6000);
+    for (int i = 0; i < input.size(); i++) {
+        input[i] = static_cast<char>(random.bounded(256));
+    }
+    inputPath = dir.filePath("image.bin");
+    QFile file(inputPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(input);
+}
+
+TestTransfer::Run TestTransfer::runTransfer(const FakeModemOptions &modemOptions, const TransferOptions &transfer,
+                                            const RunOptions &runOptions)
+{
+    //一次运行一套新的假模块和两端引擎, 串口打开后都配成bw500/sf5, 空口时间短超时也短
+    Run run;
+    FakeModemOptions options = modemOptions;
+    if (options.outputDir.isEmpty()) {
+        options.outputDir = dir.filePath("out");
+    }
+    QDir(options.outputDir).removeRecursively();
+    QDir().mkpath(options.outputDir);
+
+    FakeModem modem(options);
+    FakeModem peerModem;
+    LinkEngine engine;
+    LinkEngine peer;
+    RadioConfig radio;
+    radio.bandwidth = 500;
+    radio.spreadingFactor = 5;
+    QIODevice *device = runOptions.device ? runOptions.device : &modem;
+    if (device == &modem) {
+        //对端开着接收再开始, 不然开始包会丢在它的PRECV之前
+        modem.connectPeer(&peerModem);
+        peerModem.open(QIODevice::ReadWrite);
+        peer.openDevice(&peerModem, "peer", 115200);
+        peer.writeConfig(radio);
+        ReceiveOptions receive;
+        receive.outputDir = options.outputDir;
+        peer.startReceive(receive);
+        if (!QTest::qWaitFor([&]() { return peerModem.isReceiving(); }, 5000)) {
+            run.message = "receiver did not start";
+            return run;
+        }
+        modem.open(QIODevice::ReadWrite);
+    }
+    if (runOptions.beforeOpen) {
+        runOptions.beforeOpen(engine);
+    }
+    engine.openDevice(device, runOptions.device ? "replay" : "fake", 115200);
+    engine.writeConfig(radio);
+    if (runOptions.beforeStart) {
+        runOptions.beforeStart(engine, modem, peer);
+    }
+
+    QSignalSpy progress(&engine, &LinkEngine::transferProgress);
+    QSignalSpy received(&peer, &LinkEngine::fileReceived);
+    bool stopped = false;
+    if (runOptions.stream) {
+        QSignalSpy streamed(&engine, &LinkEngine::streamFinished);
+        engine.startStream(*runOptions.stream);
+        if (!streamed.wait(60000)) {
+            run.message = "timed out";
+            return run;
+        }
+        run.ok = true;
+        run.streamStats = streamed.first().at(0).value<StreamStats>();
+    } else {
+        QSignalSpy finished(&engine, &LinkEngine::transferFinished);
+        if (runOptions.stopWhen) {
+            QObject::connect(&engine, &LinkEngine::transferProgress, &engine, [&](const TransferStats &stats) {
+                stopped = stopped || runOptions.stopWhen(stats);
+            });
+        }
+        engine.startTransfer(transfer);
+        //参数不对时开始前就同步报错了, 不用等
+        if (!QTest::qWaitFor([&]() { return stopped || !finished.isEmpty(); }, 60000)) {
+            run.message = "timed out";
+            return run;
+        }
+        if (stopped) {
+            engine.stopTransfer();
+            run.ok = true;
+            run.message = "stopped";
+        } else {
+            run.ok = finished.first().at(0).toBool();
+            run.message = finished.first().at(1).toString();
+        }
+    }
+    run.framesSent = modem.framesSent();
+    run.framesLost = modem.framesLost();
+    run.framesCorrupted = modem.framesCorrupted();
+    if (!progress.isEmpty()) {
+        run.stats = progress.last().at(0).value<TransferStats>();
+    }
+
+    //发送端TX DONE就算发完了, 对端的结束包还在事件队列里; 结束包丢了就等不到, 关掉接收把收到的写盘
+    if (run.ok && !stopped && device == &modem) {
+        QTest::qWaitFor([&]() { return !received.isEmpty(); }, 2000);
+    }
+    engine.startCapture(QString());     // 开了抓包的话只抓到传完, 关串口的命令不算
+    engine.closePort();
+    peer.closePort();
+    QFile output(QDir(options.outputDir).filePath(runOptions.outputName));
+    if (output.open(QIODevice::ReadOnly)) {
+        run.received = output.readAll();
+    }
+    return run;
+}
+
+// 在已经连好的两端上发一个文件, 等对端收完, 给beforeStart里先传一版用
+bool TestTransfer::sendOnce(LinkEngine &engine, LinkEngine &peer, const TransferOptions &transfer)
+{
+    QSignalSpy finished(&engine, &LinkEngine::transferFinished);
+    QSignalSpy received(&peer, &LinkEngine::fileReceived);
+    engine.startTransfer(transfer);
+    return QTest::qWaitFor([&]() { return !finished.isEmpty(); }, 60000) && finished.first().at(0).toBool()
+            && QTest::qWaitFor([&]() { return !received.isEmpty(); }, 5000);
+}
+
+void TestTransfer::transfer_data()
+{
+    QTest::addColumn<int>("window");
+    QTest::addColumn<int>("fecBlock");
+    QTest::addColumn<double>("uplinkLoss");
+    QTest::addColumn<double>("downlinkLoss");
+    QTest::addColumn<int>("reorderEvery");
+
+    QTest::newRow("window") << 8 << 0 << 0.0 << 0.0 << 0;
+    QTest::newRow("window 10% loss") << 8 << 0 << 0.10 << 0.05 << 0;
+    QTest::newRow("window reordered") << 8 << 0 << 0.0 << 0.0 << 5;
+    QTest::newRow("window loss and reorder") << 8 << 0 << 0.05 << 0.05 << 7;
+    QTest::newRow("fec 10% loss") << 8 << 8 << 0.10 << 0.05 << 0;
+    QTest::newRow("stop-and-wait 5% loss") << 1 << 0 << 0.05 << 0.05 << 0;
+}
+
+void TestTransfer::transfer()
+{
+    QFETCH(int, window);
+    QFETCH(int, fecBlock);
+    QFETCH(double, uplinkLoss);
+    QFETCH(double, downlinkLoss);
+    QFETCH(int, reorderEvery);
+
+    FakeModemOptions modemOptions;
+    modemOptions.uplinkLoss = uplinkLoss;
+    modemOptions.downlinkLoss = downlinkLoss;
+    modemOptions.reorderEvery = reorderEvery;
+
+    TransferOptions transfer;
+    transfer.filePath = inputPath;
+    transfer.mtu = 200;
+    transfer.window = window;
+    transfer.fecBlock = fecBlock;
+    transfer.resume = false;
+
+    Run run = runTransfer(modemOptions, transfer);
+    QVERIFY2(run.ok, qPrintable(run.message));
+    QCOMPARE(run.received.size(), input.size());
+    QVERIFY(run.received == input);
+    if (uplinkLoss > 0) {
+        QVERIFY(run.framesLost > 0);
+    }
+}
+
+void TestTransfer::deterministic()
+{
+    //同样的种子丢同样的包, 发的包数也一样
+    FakeModemOptions modemOptions;
+    modemOptions.uplinkLoss = 0.1;
+    modemOptions.downlinkLoss = 0.1;
+    modemOptions.seed = 42;
+
+    TransferOptions transfer;
+    transfer.filePath = inputPath;
+    transfer.mtu = 200;
+    transfer.window = 8;
+    transfer.resume = false;
+
+    Run first = runTransfer(modemOptions, transfer);
+    Run second = runTransfer(modemOptions, transfer);
+    QVERIFY2(first.ok && second.ok, qPrintable(first.message + " / " + second.message));
+    QCOMPARE(second.framesSent, first.framesSent);
+    QCOMPARE(second.framesLost, first.framesLost);
+}
+
+void TestTransfer::delta()
+{
+    //同一个对端连发两版: 第一版整个发, 第二版只改了几处, 应该只发差量, 收到的和第二版一样
+    QString cacheDir = dir.filePath("delta-cache");
+    QDir(cacheDir).removeRecursively();
+
+    QByteArray second = input;
+    second.replace(1000, 16, QByteArray(16, 'x'));
+    second.insert(3000, "inserted");
+    second.append("tail");
+    QString path = dir.filePath("delta/image.bin");
+    QDir().mkpath(dir.filePath("delta"));
+    auto writeVersion = [&path](const QByteArray &version) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(version) == version.size();
+    };
+
+    TransferOptions transfer;
+    transfer.filePath = path;
+    transfer.mtu = 200;
+    transfer.resume = false;
+    transfer.delta = true;
+    transfer.deltaCacheDir = cacheDir;
+
+    QVERIFY(writeVersion(input));
+    bool firstOk = false;
+    int firstFrames = 0;
+    RunOptions runOptions;
+    runOptions.beforeStart = [&](LinkEngine &engine, FakeModem &modem, LinkEngine &peer) {
+        firstOk = sendOnce(engine, peer, transfer) && writeVersion(second);
+        firstFrames = modem.framesSent();
+    };
+    Run run = runTransfer(FakeModemOptions(), transfer, runOptions);
+    QVERIFY(firstOk);
+    QVERIFY2(run.ok, qPrintable(run.message));
+    QVERIFY(run.received == second);
+
+    QCOMPARE(run.stats.deltaTargetSize, qint64(second.size()));
+    QVERIFY(run.stats.fileSize < second.size() / 10);
+    QVERIFY((run.framesSent - firstFrames) * 5 < firstFrames);
+}
+
+void TestTransfer::stream()
+{
+    //目录里放一帧, 连续图传发一帧就停: 接收端按帧序号存, 内容一样
+    QString source = dir.filePath("stream");
+    QDir().mkpath(source);
+    QFile frame(QDir(source).filePath("frame.jpg"));
+    QVERIFY(frame.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    frame.write(input);
+    frame.close();
+
+    StreamOptions stream;
+    stream.transfer.mtu = 200;
+    stream.directory = source;
+    stream.pollMs = 10;
+    stream.maxFrames = 1;
+    RunOptions runOptions;
+    runOptions.outputName = "frame-000001.jpg";
+    runOptions.stream = &stream;
+    Run run = runTransfer(FakeModemOptions(), stream.transfer, runOptions);
+    QVERIFY2(run.ok, qPrintable(run.message));
+
+    QCOMPARE(run.streamStats.framesDelivered, quint64(1));
+    QCOMPARE(run.streamStats.bytesDelivered, qint64(input.size()));
+    QVERIFY(run.streamStats.lastAgeMs >= 0);
+    QVERIFY(run.received == input);
+}
+
+void TestTransfer::layers()
+{
+    //按JPEG的段结构拼一个4个扫描的渐进式文件, 只发前2个扫描: 收到的是截短加EOI的, 进度里有第一层的时间
+    auto segment = [](uchar marker, const QByteArray &body) {
+        QByteArray out;
+        out.append(static_cast<char>(0xFF));
+        out.append(static_cast<char>(marker));
+        out.append(static_cast<char>((body.size() + 2) >> 8));
+        out.append(static_cast<char>((body.size() + 2) & 0xFF));
+        return out + body;
+    };
+    QByteArray jpeg("\xFF\xD8", 2);
+    jpeg += segment(0xC2, QByteArray(15, 1));
+    for (int scan = 0; scan < 4; scan++) {
+        jpeg += segment(0xC4, QByteArray(20, 2));
+        jpeg += segment(0xDA, QByteArray(10, 3));
+        jpeg += input.mid(scan * 1500, 1500).replace('\xFF', '\x7F');
+    }
+    jpeg += QByteArray("\xFF\xD9", 2);
+    QCOMPARE(JpegScans::scanEnds(jpeg.constData(), jpeg.size()).size(), 4);
+    //增量解析按任意长度一段段喂, 每一步都和从头扫的结果一样
+    JpegScans::Scanner scanner;
+    for (int size = 1; size <= jpeg.size(); size += 37) {
+        scanner.feed(jpeg.constData(), size);
+        QCOMPARE(scanner.ends(), JpegScans::scanEnds(jpeg.constData(), size));
+    }
+    scanner.feed(jpeg.constData(), jpeg.size());
+    QCOMPARE(scanner.ends(), JpegScans::scanEnds(jpeg.constData(), jpeg.size()));
+    QVERIFY(scanner.isProgressive());
+
+    QString path = dir.filePath("scans.jpg");
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(jpeg);
+    file.close();
+
+    TransferOptions transfer;
+    transfer.filePath = path;
+    transfer.mtu = 200;
+    transfer.resume = false;
+    transfer.layers = 2;
+    RunOptions runOptions;
+    runOptions.outputName = "scans.jpg";
+    Run run = runTransfer(FakeModemOptions(), transfer, runOptions);
+    QVERIFY2(run.ok, qPrintable(run.message));
+
+    QByteArray expected = JpegScans::truncate(jpeg, 2);
+    QVERIFY(expected.size() < jpeg.size() / 2 + 100);
+    QVERIFY(run.received == expected);
+    QCOMPARE(run.stats.layers, 2);
+    QCOMPARE(run.stats.layersAcked, 2);
+    QVERIFY(run.stats.firstLayerMs <= run.stats.elapsedMs);
+
+    //校验模式的整文件CRC也只算截短后的内容, 不然每轮校验都对不上
+    transfer.checked = true;
+    run = runTransfer(FakeModemOptions(), transfer, runOptions);
+    QVERIFY2(run.ok, qPrintable(run.message));
+    QVERIFY(run.received == expected);
+    QVERIFY(run.stats.checked);
+    QCOMPARE(run.stats.repairRounds, 0);
+}
+
+void TestTransfer::checked()
+{
+    //空口有错包漏检, 对端存的文件还坏了一个字节: 不校验收到的是坏的; 校验模式丢掉错包重发, 结束时查出坏字节补发那一块
+    FakeModemOptions modemOptions;
+    modemOptions.corruption = 0.2;
+    modemOptions.seed = 3;
+
+    TransferOptions transfer;
+    transfer.filePath = inputPath;
+    transfer.mtu = 200;
+    transfer.window = 8;
+    transfer.resume = false;
+
+    Run plain = runTransfer(modemOptions, transfer);
+    QVERIFY2(plain.ok, qPrintable(plain.message));
+    QVERIFY(plain.framesCorrupted > 0);
+    QVERIFY(plain.received != input);
+
+    modemOptions.damageAt = 4321;
+    transfer.checked = true;
+    Run run = runTransfer(modemOptions, transfer);
+    QVERIFY2(run.ok, qPrintable(run.message));
+    QVERIFY(run.framesCorrupted > 0);
+    QVERIFY(run.received == input);
+    QVERIFY(run.stats.checked);
+    QCOMPARE(run.stats.repairRounds, 1);
+    QCOMPARE(run.stats.repairBytes, qint64(200));
+}
+
+void TestTransfer::oversized()
+{
+    //最长帧头下模块单包放不下的MTU直接报错, 不能等TX DONE超时重试
+    TransferOptions transfer;
+    transfer.filePath = inputPath;
+    transfer.mtu = AtFramer::MaxMtu + 1;
+    transfer.resume = false;
+    transfer.checked = true;
+    Run run = runTransfer(FakeModemOptions(), transfer);
+    QVERIFY(!run.ok);
+    QVERIFY2(run.message.startsWith("Invalid MTU"), qPrintable(run.message));
+    QCOMPARE(run.framesSent, 0);
+
+    transfer.mtu = AtFramer::MaxMtu;
+    run = runTransfer(FakeModemOptions(), transfer);
+    QVERIFY2(run.ok, qPrintable(run.message));
+    QVERIFY(run.received == input);
+}
+
+void TestTransfer::fecBlockLimit()
+{
+    //FEC的块号和已解码块数只有16位: 65535块还走FEC, 再多一块就退回窗口协议, 不然永远传不完
+    QString path = dir.filePath("fec-limit.bin");
+    TransferOptions transfer;
+    transfer.filePath = path;
+    transfer.mtu = 1;
+    transfer.fecBlock = 1;
+    transfer.window = 8;
+    transfer.resume = false;
+    RunOptions runOptions;
+    runOptions.outputName = "fec-limit.bin";
+    runOptions.stopWhen = [](const TransferStats &stats) { return stats.fecMode || stats.windowMode; };
+
+    for (qint64 blocks : { qint64(Protocol::MaxFecBlocks), qint64(Protocol::MaxFecBlocks) + 1 }) {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(QByteArray(int(blocks), 'f'));
+        file.close();
+
+        Run run = runTransfer(FakeModemOptions(), transfer, runOptions);
+        QVERIFY2(run.ok, qPrintable(run.message));
+        QCOMPARE(run.stats.fecMode, blocks <= Protocol::MaxFecBlocks);
+        QCOMPARE(run.stats.windowMode, blocks > Protocol::MaxFecBlocks);
+    }
+}
+
+void TestTransfer::replay()
+{
+    //抓一次带丢包的传输, 再拿抓包代替模块跑同样的传输: 引擎写出的和抓包逐字节一样, 回应全放完, 传输成功
+    FakeModemOptions options;
+    options.uplinkLoss = 0.1;
+    QString trace = dir.filePath("transfer.cap");
+
+    TransferOptions transfer;
+    transfer.filePath = inputPath;
+    transfer.mtu = 200;
+    transfer.window = 8;
+    transfer.resume = false;
+
+    RunOptions captureOptions;
+    captureOptions.beforeOpen = [&trace](LinkEngine &engine) {
+        engine.startCapture(trace);
+    };
+    Run captured = runTransfer(options, transfer, captureOptions);
+    QVERIFY2(captured.ok, qPrintable(captured.message));
+
+    QVector<SerialCapture::Record> records;
+    QString error;
+    QVERIFY2(SerialCapture::load(trace, &records, &error), qPrintable(error));
+    QVERIFY(records.size() > 10);
+
+    SerialReplay device;
+    QVERIFY2(device.load(trace, &error), qPrintable(error));
+    ReplayOptions replayOptions;
+    replayOptions.speed = 0;
+    device.setOptions(replayOptions);
+    RunOptions replayRun;
+    replayRun.device = &device;
+    Run replayed = runTransfer(FakeModemOptions(), transfer, replayRun);
+    QVERIFY2(replayed.ok, qPrintable(replayed.message));
+
+    ReplayStats stats = device.stats();
+    QCOMPARE(stats.firstMismatch, qint64(-1));
+    QCOMPARE(stats.stalls, 0);
+    QVERIFY(stats.txBytes <= stats.txExpected);
+}
+
+QTEST_GUILESS_MAIN(TestTransfer)
+
+#include "tst_transfer.moc"